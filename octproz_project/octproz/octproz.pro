@@ -43,7 +43,18 @@ SOURCES += \
 	$$SOURCEDIR/stringspinbox.cpp \
 	$$SOURCEDIR/controlpanel.cpp \
 	$$SOURCEDIR/extensioneventfilter.cpp \
-	$$SOURCEDIR/octalgorithmparametersmanager.cpp
+	$$SOURCEDIR/octalgorithmparametersmanager.cpp \
+	$$SOURCEDIR/offlineprocessor.cpp \
+	$$SOURCEDIR/threadpool.cpp \
+	$$SOURCEDIR/cpukernels.cpp \
+	$$SOURCEDIR/cpufeatures.cpp \
+	$$SOURCEDIR/inputconversion.cpp \
+	$$SOURCEDIR/resamplingplan.cpp \
+	$$SOURCEDIR/fftplancache.cpp \
+	$$SOURCEDIR/cpuprocessingbackend.cpp \
+	$$SOURCEDIR/cudaprocessingbackend.cpp \
+	$$SOURCEDIR/autotuner.cpp \
+	$$SOURCEDIR/stagetimings.cpp
 
 	unix{
 		SOURCES += $$SOURCEDIR/cuda_code.cu
@@ -59,6 +70,7 @@ HEADERS += \
 	$$SHAREDIR/octproz_devkit.h \
 	$$SHAREDIR/acquisitionbuffer.h \
 	$$SHAREDIR/acquisitionsystem.h \
+	$$SHAREDIR/tracer.h \
 	$$SOURCEDIR/raycastvolume.h \
 	$$SOURCEDIR/systemmanager.h \
 	$$QCUSTOMPLOTDIR/qcustomplot.h \
@@ -82,7 +94,22 @@ HEADERS += \
 	$$SOURCEDIR/controlpanel.h \
 	$$SOURCEDIR/extensioneventfilter.h \
 	$$SOURCEDIR/outputwindow.h \
-	$$SOURCEDIR/octalgorithmparametersmanager.h
+	$$SOURCEDIR/octalgorithmparametersmanager.h \
+	$$SOURCEDIR/offlineprocessor.h \
+	$$SOURCEDIR/threadpool.h \
+	$$SOURCEDIR/cpukernels.h \
+	$$SOURCEDIR/cpufeatures.h \
+	$$SOURCEDIR/inputconversion.h \
+	$$SOURCEDIR/resamplingplan.h \
+	$$SOURCEDIR/fftplancache.h \
+	$$SOURCEDIR/displayprojection.h \
+	$$SOURCEDIR/volumestorage.h \
+	$$SOURCEDIR/volumering.h \
+	$$SOURCEDIR/processingbackend.h \
+	$$SOURCEDIR/cpuprocessingbackend.h \
+	$$SOURCEDIR/cudaprocessingbackend.h \
+	$$SOURCEDIR/autotuner.h \
+	$$SOURCEDIR/stagetimings.h
 
 FORMS += \
 	$$SOURCEDIR/octproz.ui \
@@ -129,6 +156,9 @@ unix{
 #include cuda configuration
 include(pri/cuda.pri)
 
+#include fftw configuration (needed by the cpu processing backend)
+include(pri/fftw.pri)
+
 #include pri file to copy documentation to build folder
 include(pri/docs.pri)
 
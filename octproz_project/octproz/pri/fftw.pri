@@ -0,0 +1,14 @@
+#FFTW is used by the multithreaded CPU processing backend
+
+#path of the fftw installation on windows (precompiled dlls from http://www.fftw.org/install/windows.html)
+#the import library libfftw3f-3.lib can be created with: lib /def:libfftw3f-3.def
+win32{
+	FFTW_DIR = $$shell_path($$PWD/../../thirdparty/fftw)
+	INCLUDEPATH += $$FFTW_DIR
+	LIBS += -L$$FFTW_DIR -llibfftw3f-3
+}
+
+#on linux fftw can be installed with: sudo apt-get install libfftw3-dev
+unix{
+	LIBS += -lfftw3f
+}
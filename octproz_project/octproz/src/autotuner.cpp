@@ -0,0 +1,253 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "autotuner.h"
+#include "cudaprocessingbackend.h"
+#include "cpuprocessingbackend.h"
+#include "settings.h"
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <algorithm>
+
+
+Autotuner::Autotuner(ProcessingBackend* backend, OctAlgorithmParameters* params) {
+	this->backend = backend;
+	this->params = params;
+	this->buffersPerSecond = 0.0;
+}
+
+QString Autotuner::getKey() const {
+	QString key = QString("%1 %2 %3x%4x%5 %6bit")
+		.arg(this->backend->getName())
+		.arg(QString::fromStdString(this->backend->getDeviceName()))
+		.arg(this->params->samplesPerLine)
+		.arg(this->params->ascansPerBscan)
+		.arg(this->params->bscansPerBuffer)
+		.arg(this->params->bitDepth);
+	return key.replace(QRegularExpression("[^A-Za-z0-9]+"), "_"); //keep the key readable in the ini file
+}
+
+bool Autotuner::applyStoredConfiguration() {
+	QVariantList values = Settings::getInstance()->getStoredSettings(AUTOTUNING_SETTINGS_GROUP).value(this->getKey()).toList();
+	if (values.size() != 4) {
+		return false;
+	}
+	unsigned int storedValues[4];
+	for (int i = 0; i < 4; i++) {
+		bool ok = false;
+		storedValues[i] = values.at(i).toUInt(&ok);
+		if (!ok) {
+			return false;
+		}
+	}
+
+	//the settings file may be edited by hand or stem from another version. Only values that run() could have chosen are accepted, anything else is tuned again
+	AutotuningConfiguration configuration;
+	configuration.cudaBlockSize = 0;
+	configuration.cpuThreads = 0;
+	configuration.cpuLinesPerFftBlock = 0;
+	configuration.pipelineWorkers = std::max(1u, this->params->pipelineWorkers);
+	if (this->isCuda()) {
+		configuration.cudaBlockSize = storedValues[0];
+		if (!this->isCandidate(&AutotuningConfiguration::cudaBlockSize, configuration)) {
+			return false;
+		}
+	} else {
+		configuration.cpuThreads = storedValues[1];
+		configuration.cpuLinesPerFftBlock = storedValues[2];
+		configuration.pipelineWorkers = storedValues[3];
+		if (!this->isCandidate(&AutotuningConfiguration::cpuThreads, configuration)
+				|| !this->isCandidate(&AutotuningConfiguration::cpuLinesPerFftBlock, configuration)
+				|| !this->isCandidate(&AutotuningConfiguration::pipelineWorkers, configuration)) {
+			return false;
+		}
+	}
+	this->applyConfiguration(configuration);
+	return true;
+}
+
+void Autotuner::run(void** h_buffers, unsigned int bufferCount) {
+	//only processing itself is benchmarked. Requests that the backend consumes are kept for the actual start
+	bool bscanViewEnabled = this->params->bscanViewEnabled;
+	bool enFaceViewEnabled = this->params->enFaceViewEnabled;
+	bool volumeViewEnabled = this->params->volumeViewEnabled;
+	bool streamToHost = this->params->streamToHost;
+	bool redetermineFixedPatternNoise = this->params->redetermineFixedPatternNoise;
+	bool postProcessBackgroundRecordingRequested = this->params->postProcessBackgroundRecordingRequested;
+	this->params->bscanViewEnabled = false;
+	this->params->enFaceViewEnabled = false;
+	this->params->volumeViewEnabled = false;
+	this->params->streamToHost = false;
+	this->params->redetermineFixedPatternNoise = false;
+	this->params->postProcessBackgroundRecordingRequested = false;
+
+	AutotuningConfiguration best;
+	best.cudaBlockSize = 0;
+	best.cpuThreads = 0;
+	best.cpuLinesPerFftBlock = 0;
+	best.pipelineWorkers = std::max(1u, this->params->pipelineWorkers);
+	if (this->isCuda()) {
+		best.cudaBlockSize = CUDA_DEFAULT_BLOCK_SIZE;
+		this->buffersPerSecond = this->benchmark(best, h_buffers, bufferCount);
+		this->tune(&AutotuningConfiguration::cudaBlockSize, best, h_buffers, bufferCount);
+	} else {
+		best.cpuThreads = static_cast<CpuProcessingBackend*>(this->backend)->getThreadCount();
+		best.cpuLinesPerFftBlock = CPU_FFT_LINES_PER_BLOCK;
+		//start with the largest worker candidate that does not exceed the configured number of workers and that stays a candidate if the thread count is halved
+		AutotuningConfiguration fewestThreads = best;
+		fewestThreads.cpuThreads = this->getCandidates(&AutotuningConfiguration::cpuThreads, best).back();
+		std::vector<unsigned int> workerCandidates = this->getCandidates(&AutotuningConfiguration::pipelineWorkers, fewestThreads);
+		unsigned int workers = workerCandidates.front();
+		for (size_t i = 0; i < workerCandidates.size(); i++) {
+			if (workerCandidates[i] <= best.pipelineWorkers) {
+				workers = std::max(workers, workerCandidates[i]);
+			}
+		}
+		best.pipelineWorkers = workers;
+		this->buffersPerSecond = this->benchmark(best, h_buffers, bufferCount);
+		this->tune(&AutotuningConfiguration::cpuThreads, best, h_buffers, bufferCount);
+		this->tune(&AutotuningConfiguration::cpuLinesPerFftBlock, best, h_buffers, bufferCount);
+		this->tune(&AutotuningConfiguration::pipelineWorkers, best, h_buffers, bufferCount);
+	}
+
+	this->params->bscanViewEnabled = bscanViewEnabled;
+	this->params->enFaceViewEnabled = enFaceViewEnabled;
+	this->params->volumeViewEnabled = volumeViewEnabled;
+	this->params->streamToHost = streamToHost;
+	this->params->redetermineFixedPatternNoise = redetermineFixedPatternNoise;
+	this->params->postProcessBackgroundRecordingRequested = postProcessBackgroundRecordingRequested;
+	this->applyConfiguration(best);
+
+	QVariantMap result;
+	result.insert(this->getKey(), QVariantList() << best.cudaBlockSize << best.cpuThreads << best.cpuLinesPerFftBlock << best.pipelineWorkers);
+	Settings::getInstance()->storeSettings(AUTOTUNING_SETTINGS_GROUP, result);
+}
+
+QString Autotuner::getConfigurationDescription() const {
+	if (this->isCuda()) {
+		return QString("%1 threads per block").arg(this->params->cudaBlockSize);
+	}
+	return QString("%1 threads, %2 A-scans per tile, %3 workers").arg(this->params->cpuThreads).arg(this->params->cpuLinesPerFftBlock).arg(this->params->pipelineWorkers);
+}
+
+bool Autotuner::isCuda() const {
+	return dynamic_cast<CudaProcessingBackend*>(this->backend) != nullptr;
+}
+
+void Autotuner::applyConfiguration(const AutotuningConfiguration& configuration) {
+	this->params->cudaBlockSize = configuration.cudaBlockSize;
+	this->params->cpuThreads = configuration.cpuThreads;
+	this->params->cpuLinesPerFftBlock = configuration.cpuLinesPerFftBlock;
+	this->params->pipelineWorkers = configuration.pipelineWorkers;
+}
+
+double Autotuner::benchmark(const AutotuningConfiguration& configuration, void** h_buffers, unsigned int bufferCount) {
+	this->applyConfiguration(configuration);
+	if (!this->backend->init(h_buffers, bufferCount, this->params)) {
+		this->backend->cleanup();
+		return 0.0;
+	}
+
+	//the first buffers include fixed-pattern noise determination and the first access to all buffers
+	bool processed = true;
+	for (unsigned int i = 0; i < bufferCount; i++) {
+		processed = this->backend->process(h_buffers[i]) && processed;
+	}
+	this->backend->synchronize();
+	if (!processed) {
+		this->backend->cleanup();
+		return 0.0;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	unsigned int processedBuffers = 0;
+	while (processedBuffers < AUTOTUNING_MIN_BUFFERS_PER_CANDIDATE || timer.elapsed() < AUTOTUNING_MILLISECONDS_PER_CANDIDATE) {
+		this->backend->process(h_buffers[processedBuffers%bufferCount]);
+		processedBuffers++;
+	}
+	this->backend->synchronize();
+	double seconds = static_cast<double>(timer.nsecsElapsed())/1.0e9;
+	this->backend->cleanup();
+	return seconds > 0.0 ? processedBuffers/seconds : 0.0;
+}
+
+std::vector<unsigned int> Autotuner::getCandidates(unsigned int AutotuningConfiguration::* parameter, const AutotuningConfiguration& configuration) const {
+	std::vector<unsigned int> candidates;
+	if (parameter == &AutotuningConfiguration::cudaBlockSize) {
+		size_t samplesPerBuffer = (size_t)this->params->samplesPerLine*this->params->ascansPerBscan*this->params->bscansPerBuffer;
+		candidates.push_back(CUDA_DEFAULT_BLOCK_SIZE);
+		for (unsigned int blockSize = 32; blockSize <= CUDA_MAX_BLOCK_SIZE; blockSize *= 2) {
+			if (blockSize != CUDA_DEFAULT_BLOCK_SIZE && isValidCudaBlockSize(blockSize, samplesPerBuffer)) {
+				candidates.push_back(blockSize);
+			}
+		}
+	} else if (parameter == &AutotuningConfiguration::cpuThreads) {
+		//hyper-threading does not always pay off for the fft stage, so half of the logical cores is tried as well
+		unsigned int threads = static_cast<CpuProcessingBackend*>(this->backend)->getThreadCount();
+		candidates.push_back(threads);
+		if (threads > 1) {
+			candidates.push_back(threads/2);
+		}
+	} else if (parameter == &AutotuningConfiguration::cpuLinesPerFftBlock) {
+		//only tile sizes that keep every tile aligned for the fft plans, see CPU_FFT_LINES_ALIGNMENT
+		candidates.push_back(CPU_FFT_LINES_PER_BLOCK);
+		for (unsigned int lines = CPU_FFT_LINES_ALIGNMENT; lines <= 64; lines *= 2) {
+			if (lines != CPU_FFT_LINES_PER_BLOCK) {
+				candidates.push_back(lines);
+			}
+		}
+	} else if (parameter == &AutotuningConfiguration::pipelineWorkers) {
+		//the number of workers depends on the thread count, so it is always tuned after cpuThreads
+		unsigned int maxWorkers = std::max(1u, std::min(configuration.cpuThreads, (unsigned int)CPU_MAX_PIPELINE_WORKERS));
+		for (unsigned int workers = 1; workers <= maxWorkers; workers *= 2) {
+			candidates.push_back(workers);
+		}
+	}
+	return candidates;
+}
+
+bool Autotuner::isCandidate(unsigned int AutotuningConfiguration::* parameter, const AutotuningConfiguration& configuration) const {
+	std::vector<unsigned int> candidates = this->getCandidates(parameter, configuration);
+	return std::find(candidates.begin(), candidates.end(), configuration.*parameter) != candidates.end();
+}
+
+void Autotuner::tune(unsigned int AutotuningConfiguration::* parameter, AutotuningConfiguration& best, void** h_buffers, unsigned int bufferCount) {
+	std::vector<unsigned int> candidates = this->getCandidates(parameter, best);
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (candidates[i] == best.*parameter) {
+			continue;
+		}
+		AutotuningConfiguration candidate = best;
+		candidate.*parameter = candidates[i];
+		double buffersPerSecond = this->benchmark(candidate, h_buffers, bufferCount);
+		if (buffersPerSecond > this->buffersPerSecond) {
+			this->buffersPerSecond = buffersPerSecond;
+			best = candidate;
+		}
+	}
+}
@@ -0,0 +1,78 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include "processingbackend.h"
+#include "octalgorithmparameters.h"
+#include <QString>
+#include <vector>
+
+#define AUTOTUNING_SETTINGS_GROUP "autotuning"
+#define AUTOTUNING_MILLISECONDS_PER_CANDIDATE 300
+#define AUTOTUNING_MIN_BUFFERS_PER_CANDIDATE 3
+
+struct AutotuningConfiguration {
+	unsigned int cudaBlockSize;
+	unsigned int cpuThreads;
+	unsigned int cpuLinesPerFftBlock;
+	unsigned int pipelineWorkers;
+};
+
+
+/**
+* Determines the processing granularity that gives the highest throughput for the current acquisition geometry and hardware: threads per
+* block of the cuda kernels, or thread count, tile size and number of pipeline workers of the CPU backend. The candidates are benchmarked
+* one parameter after the other with the acquisition buffers as input while display and streaming are switched off. The winner is stored
+* in the settings file under getKey() and is applied again on later starts with the same geometry and hardware without benchmarking.
+**/
+class Autotuner
+{
+public:
+	Autotuner(ProcessingBackend* backend, OctAlgorithmParameters* params);
+
+	QString getKey() const; ///backend, device name, samplesPerLine, ascansPerBscan, bscansPerBuffer and bitDepth
+	bool applyStoredConfiguration(); ///returns false if no result is stored for getKey() or if a stored value is not one of the candidates of run()
+	void run(void** h_buffers, unsigned int bufferCount); ///benchmarks all candidates, applies and stores the fastest one. Has to be called from the processing thread with its OpenGL context current, the backend must not be initialized
+	QString getConfigurationDescription() const; ///configuration that is currently applied to params
+	double getBuffersPerSecond() const { return this->buffersPerSecond; } ///throughput of the fastest candidate of the last run()
+
+private:
+	bool isCuda() const;
+	void applyConfiguration(const AutotuningConfiguration& configuration);
+	double benchmark(const AutotuningConfiguration& configuration, void** h_buffers, unsigned int bufferCount); ///processed buffers per second, 0 if the backend could not be initialized or could not process the buffers
+	std::vector<unsigned int> getCandidates(unsigned int AutotuningConfiguration::* parameter, const AutotuningConfiguration& configuration) const; ///values run() tries for parameter, the first one is the starting value. The worker candidates depend on configuration.cpuThreads
+	bool isCandidate(unsigned int AutotuningConfiguration::* parameter, const AutotuningConfiguration& configuration) const;
+	void tune(unsigned int AutotuningConfiguration::* parameter, AutotuningConfiguration& best, void** h_buffers, unsigned int bufferCount);
+
+	ProcessingBackend* backend;
+	OctAlgorithmParameters* params;
+	double buffersPerSecond;
+};
+
+#endif // AUTOTUNER_H
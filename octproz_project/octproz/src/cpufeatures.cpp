@@ -0,0 +1,152 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "cpufeatures.h"
+
+#if defined(OCTPROZ_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(OCTPROZ_X86)
+static void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, leaf, subleaf);
+	for (int i = 0; i < 4; i++) {
+		regs[i] = static_cast<unsigned int>(info[i]);
+	}
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+SIMD_LEVEL CpuFeatures::detectSimdLevel() {
+	SIMD_LEVEL level = SIMD_NONE;
+#if defined(OCTPROZ_X86)
+	unsigned int regs[4] = {0, 0, 0, 0};
+	cpuid(0, 0, regs);
+	unsigned int maxLeaf = regs[0];
+	if (maxLeaf < 1) {
+		return level;
+	}
+	cpuid(1, 0, regs);
+	bool sse2 = (regs[3] & (1u << 26)) != 0;
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	if (sse2) {
+		level = SIMD_SSE2;
+	}
+
+	//avx registers are only usable if the operating system saves them on context switches (checked via xgetbv)
+	if (osxsave && avx && maxLeaf >= 7) {
+		unsigned long long xcr0 = xgetbv0();
+		bool osAvx = (xcr0 & 0x6) == 0x6;
+		bool osAvx512 = (xcr0 & 0xe6) == 0xe6;
+		cpuid(7, 0, regs);
+		bool avx2 = (regs[1] & (1u << 5)) != 0;
+		bool avx512f = (regs[1] & (1u << 16)) != 0;
+		if (osAvx && avx2) {
+			level = SIMD_AVX2;
+			if (osAvx512 && avx512f) {
+				level = SIMD_AVX512;
+			}
+		}
+	}
+#endif
+	return level;
+}
+
+bool CpuFeatures::detectFma() {
+#if defined(OCTPROZ_X86)
+	if (detectSimdLevel() < SIMD_AVX2) {
+		return false;
+	}
+	unsigned int regs[4] = {0, 0, 0, 0};
+	cpuid(1, 0, regs);
+	return (regs[2] & (1u << 12)) != 0;
+#else
+	return false;
+#endif
+}
+
+SIMD_LEVEL CpuFeatures::getSimdLevel() {
+	static const SIMD_LEVEL simdLevel = detectSimdLevel();
+	return simdLevel;
+}
+
+bool CpuFeatures::hasFma() {
+	static const bool fma = detectFma();
+	return fma;
+}
+
+const char* CpuFeatures::getSimdLevelName(SIMD_LEVEL level) {
+	switch (level) {
+		case SIMD_SSE2: return "SSE2";
+		case SIMD_AVX2: return "AVX2";
+		case SIMD_AVX512: return "AVX-512";
+		default: return "scalar";
+	}
+}
+
+std::string CpuFeatures::getProcessorName() {
+	std::string name;
+#if defined(OCTPROZ_X86)
+	unsigned int regs[4] = {0, 0, 0, 0};
+	cpuid(0x80000000, 0, regs);
+	if (regs[0] >= 0x80000004) {
+		char brand[49] = {0};
+		for (unsigned int leaf = 0; leaf < 3; leaf++) {
+			cpuid(0x80000002+leaf, 0, regs);
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) {
+					brand[16*leaf+4*i+j] = static_cast<char>((regs[i] >> (8*j)) & 0xff);
+				}
+			}
+		}
+		name = brand;
+		name.erase(0, name.find_first_not_of(' '));
+		name.erase(name.find_last_not_of(' ')+1);
+	}
+#endif
+	return name.empty() ? "unknown" : name;
+}
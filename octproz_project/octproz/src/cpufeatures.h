@@ -0,0 +1,72 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#include <string>
+
+//x86 vector instruction sets that are used by the CPU processing backend. On other architectures (e.g. Jetson Nano) only SIMD_NONE is available
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OCTPROZ_X86
+#endif
+
+//function attributes to compile single functions for a specific instruction set without changing the compiler flags of the whole project. msvc does not need them
+#if defined(OCTPROZ_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#define TARGET_AVX2_FMA
+#define TARGET_AVX512
+#endif
+
+enum SIMD_LEVEL {
+	SIMD_NONE,
+	SIMD_SSE2,
+	SIMD_AVX2,
+	SIMD_AVX512
+};
+
+
+class CpuFeatures
+{
+public:
+	static SIMD_LEVEL getSimdLevel(); ///highest instruction set that is supported by cpu and operating system. Detected once via cpuid
+	static bool hasFma(); ///fused multiply-add (FMA3), usually available together with AVX2
+	static const char* getSimdLevelName(SIMD_LEVEL level);
+	static std::string getProcessorName(); ///brand string of the processor, "unknown" if it can not be determined
+
+private:
+	static SIMD_LEVEL detectSimdLevel();
+	static bool detectFma();
+};
+
+#endif // CPUFEATURES_H
@@ -0,0 +1,546 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "cpukernels.h"
+#include "cpufeatures.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <float.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(OCTPROZ_X86)
+#include <immintrin.h>
+#endif
+
+#define CPU_TRANSPOSE_TILE 32
+
+#if defined(OCTPROZ_X86)
+//inclusive prefix sum of four doubles: [a, a+b, a+b+c, a+b+c+d]
+TARGET_AVX2 static inline __m256d prefixSum4(__m256d x) {
+	x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, 0x90), _mm256_setzero_pd(), 0x1));
+	x = _mm256_add_pd(x, _mm256_permute2f128_pd(x, x, 0x08));
+	return x;
+}
+
+TARGET_AVX2 static void prefixSumAvx2(double* prefix, const float* in, const int width) {
+	__m256d carry = _mm256_setzero_pd();
+	int j = 0;
+	for (; j + 4 <= width; j += 4) {
+		__m256d x = _mm256_add_pd(prefixSum4(_mm256_cvtps_pd(_mm_loadu_ps(&in[j]))), carry);
+		_mm256_storeu_pd(&prefix[j+1], x);
+		carry = _mm256_permute4x64_pd(x, 0xFF);
+	}
+	for (; j < width; j++) {
+		prefix[j+1] = prefix[j] + in[j];
+	}
+}
+
+//samples whose window is not clamped by the A-scan borders all have the same window length 2*windowSize
+TARGET_AVX2 static int rollingAverageInteriorAvx2(float* out, const float* in, const double* prefix, const int windowSize, const int firstSample, const int lastSample) {
+	const __m256d invWindowLength = _mm256_set1_pd(1.0/(2.0*windowSize));
+	int j = firstSample;
+	for (; j + 4 <= lastSample; j += 4) {
+		__m256d sum = _mm256_sub_pd(_mm256_loadu_pd(&prefix[j+windowSize+1]), _mm256_loadu_pd(&prefix[j-windowSize+1]));
+		__m128 rollingAverage = _mm256_cvtpd_ps(_mm256_mul_pd(sum, invWindowLength));
+		_mm_storeu_ps(&out[j], _mm_sub_ps(_mm_loadu_ps(&in[j]), rollingAverage));
+	}
+	return j;
+}
+#endif
+
+void CpuKernels::rollingAverageBackgroundRemoval(float* output, const float* input, const int rollingAverageWindowSize, const int width, const size_t firstLine, const size_t lastLine) {
+	//the window of sample j is [j-windowSize+1, j+windowSize] clamped to the current A-scan (same as the cuda kernel). With a prefix sum of the
+	//A-scan every window sum is a single subtraction, so the cost per A-scan does not depend on the window size.
+	//The prefix sum is accumulated in double precision, otherwise the difference of two large sums would lose the small background variations.
+	thread_local std::vector<double> prefixBuffer;
+	if (prefixBuffer.size() < static_cast<size_t>(width+1)) {
+		prefixBuffer.resize(width+1);
+	}
+	double* prefix = prefixBuffer.data();
+	prefix[0] = 0.0;
+#if defined(OCTPROZ_X86)
+	const bool useAvx2 = CpuFeatures::getSimdLevel() >= SIMD_AVX2;
+#endif
+
+	for (size_t line = firstLine; line < lastLine; line++) {
+		const float* in = &input[line*width];
+		float* out = &output[line*width];
+
+		int j = 0;
+#if defined(OCTPROZ_X86)
+		if (useAvx2) {
+			prefixSumAvx2(prefix, in, width);
+		} else
+#endif
+		{
+			for (j = 0; j < width; j++) {
+				prefix[j+1] = prefix[j] + in[j];
+			}
+		}
+
+		//samples up to interiorBegin-1 and from interiorEnd on have clamped windows
+		const int interiorBegin = std::max(0, rollingAverageWindowSize - 1);
+		const int interiorEnd = std::max(interiorBegin, width - rollingAverageWindowSize);
+		for (j = 0; j < width; j++) {
+#if defined(OCTPROZ_X86)
+			if (useAvx2 && j == interiorBegin && rollingAverageWindowSize > 0) {
+				j = rollingAverageInteriorAvx2(out, in, prefix, rollingAverageWindowSize, interiorBegin, interiorEnd);
+				if (j >= width) {
+					break;
+				}
+			}
+#endif
+			int startIdx = std::max(0, j - rollingAverageWindowSize + 1);
+			int endIdx = std::min(width - 1, j + rollingAverageWindowSize);
+			float rollingAverage = static_cast<float>((prefix[endIdx+1] - prefix[startIdx]) / (endIdx - startIdx + 1));
+			out[j] = in[j] - rollingAverage;
+		}
+	}
+}
+
+void CpuKernels::windowing(float* inOut, const float* window, const int width, const size_t firstLine, const size_t lastLine) {
+	for (size_t line = firstLine; line < lastLine; line++) {
+		float* data = &inOut[line*width];
+		for (int j = 0; j < width; j++) {
+			data[j] = data[j] * window[j];
+		}
+	}
+}
+
+void CpuKernels::realToComplexAndDispersionCompensation(CpuComplex* output, const float* input, const CpuComplex* phaseComplex, const int width, const size_t firstLine, const size_t lastLine) {
+	for (size_t line = firstLine; line < lastLine; line++) {
+		const float* in = &input[line*width];
+		CpuComplex* out = &output[line*width];
+		//input is real valued, so full complex multiplication is not necessary
+		for (int j = 0; j < width; j++) {
+			out[j].x = in[j] * phaseComplex[j].x;
+			out[j].y = in[j] * phaseComplex[j].y;
+		}
+	}
+}
+
+void CpuKernels::fillDispersivePhase(CpuComplex* phaseComplex, const float* phase, const double factor, const int width, const int direction) {
+	for (int i = 0; i < width; i++) {
+		phaseComplex[i].x = cosf(factor*phase[i]);
+		phaseComplex[i].y = sinf(factor*phase[i]) * direction;
+	}
+}
+
+/*	Algorithm implemented by Ben Matthias after S.Moon et al., "Reference spectrum extraction and fixed-pattern noise removal in
+optical coherence tomography", Optics Express 18(23):24395-24404, 2010	*/
+void CpuKernels::getSegmentStatistics(CpuSegmentStatistics* statistics, const CpuComplex* segment, const int lineStride, const int segmentWidth, const size_t firstSample, const size_t lastSample) {
+	for (size_t index = firstSample; index < lastSample; index++) {
+		statistics[index].meanX = 0.0f;
+		statistics[index].meanY = 0.0f;
+		statistics[index].m2 = 0.0f;
+	}
+
+	//Welford update. A-scans are traversed in the outer loop, so the inner loop reads contiguous memory
+	for (int j = 0; j < segmentWidth; j++) {
+		const CpuComplex* line = &segment[(size_t)j*lineStride];
+		const float factor = 1.0f / (float)(j+1);
+		for (size_t index = firstSample; index < lastSample; index++) {
+			CpuSegmentStatistics& stat = statistics[index];
+			float dx = line[index].x - stat.meanX;
+			float dy = line[index].y - stat.meanY;
+			stat.meanX += dx*factor;
+			stat.meanY += dy*factor;
+			stat.m2 += dx*(line[index].x - stat.meanX) + dy*(line[index].y - stat.meanY);
+		}
+	}
+}
+
+void CpuKernels::getMinimumVarianceMean(CpuComplex* meanLine, const CpuSegmentStatistics* statistics, const int statisticsStride, const int segments, const size_t firstSample, const size_t lastSample) {
+	//all segments have the same number of A-scans, so m2 can be compared instead of the variance
+	for (size_t index = firstSample; index < lastSample; index++) {
+		const CpuSegmentStatistics* minVarianceSegment = &statistics[index];
+		for (int i = 1; i < segments; i++) {
+			const CpuSegmentStatistics* current = &statistics[(size_t)i*statisticsStride + index];
+			if (current->m2 < minVarianceSegment->m2) {
+				minVarianceSegment = current;
+			}
+		}
+		meanLine[index].x = minVarianceSegment->meanX;
+		meanLine[index].y = minVarianceSegment->meanY;
+	}
+}
+
+void CpuKernels::meanALineSubtraction(CpuComplex* inOut, const CpuComplex* meanLine, const int lineStride, const int outputAscanLength, const size_t firstLine, const size_t lastLine) {
+	//only the first half of each A-scan is subtracted, because the second half gets truncated anyway
+	for (size_t line = firstLine; line < lastLine; line++) {
+		CpuComplex* data = &inOut[line*lineStride];
+		for (int j = 0; j < outputAscanLength; j++) {
+			data[j].x -= meanLine[j].x;
+			data[j].y -= meanLine[j].y;
+		}
+	}
+}
+
+//coefficients of polynomial approximations of log2(1+f) for f in [sqrt(0.5)-1, sqrt(2)-1] (Chebyshev interpolation, constant term is 0).
+//max. error: degree 6: 4.2e-6 (1.3e-5 dB), degree 3: 1.4e-3 (4.2e-3 dB)
+static const float LOG2_COEFFS_HIGH_ACCURACY[6] = {1.44270039f, -0.721195757f, 0.479925573f, -0.366925776f, 0.316898197f, -0.202289268f};
+static const float LOG2_COEFFS_LOW_ACCURACY[3] = {1.44450748f, -0.750233114f, 0.443646878f};
+#define SQRT_HALF_BITS 0x3f3504f3
+
+template <int DEGREE>
+static inline float fastLog2(const float x, const float* coeffs) {
+	//x = m*2^e with m in [sqrt(0.5), sqrt(2)), log2(x) = e + log2(m)
+	if (!(x >= FLT_MIN)) {
+		return -INFINITY; //zero, denormals and NaN
+	}
+	int32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	int32_t exponent = (bits - SQRT_HALF_BITS) >> 23;
+	int32_t mantissaBits = static_cast<int32_t>(static_cast<uint32_t>(bits) - (static_cast<uint32_t>(exponent) << 23));
+	float m;
+	memcpy(&m, &mantissaBits, sizeof(m));
+	float f = m - 1.0f;
+	float p = coeffs[DEGREE-1];
+	for (int i = DEGREE-2; i >= 0; i--) {
+		p = p*f + coeffs[i];
+	}
+	return static_cast<float>(exponent) + p*f;
+}
+
+template <int DEGREE>
+static void truncateLogFast(float* out, const CpuComplex* in, const int length, const float scale, const float offset, const float* coeffs) {
+	for (int j = 0; j < length; j++) {
+		float power = in[j].x*in[j].x + in[j].y*in[j].y;
+		out[j] = CpuKernels::saturate(scale*fastLog2<DEGREE>(power, coeffs) + offset);
+	}
+}
+
+#if defined(OCTPROZ_X86)
+template <int DEGREE>
+TARGET_AVX2_FMA static inline __m256 fastLog2Avx2(const __m256 x, const float* coeffs) {
+	__m256i bits = _mm256_castps_si256(x);
+	__m256i exponent = _mm256_srai_epi32(_mm256_sub_epi32(bits, _mm256_set1_epi32(SQRT_HALF_BITS)), 23);
+	__m256 f = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_sub_epi32(bits, _mm256_slli_epi32(exponent, 23))), _mm256_set1_ps(1.0f));
+	__m256 p = _mm256_set1_ps(coeffs[DEGREE-1]);
+	for (int i = DEGREE-2; i >= 0; i--) {
+		p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(coeffs[i]));
+	}
+	__m256 result = _mm256_fmadd_ps(p, f, _mm256_cvtepi32_ps(exponent));
+	__m256 invalid = _mm256_cmp_ps(x, _mm256_set1_ps(FLT_MIN), _CMP_NGE_UQ); //zero, denormals and NaN
+	return _mm256_blendv_ps(result, _mm256_set1_ps(-INFINITY), invalid);
+}
+
+template <int DEGREE>
+TARGET_AVX2_FMA static void truncateLogFastAvx2(float* out, const CpuComplex* in, const int length, const float scale, const float offset, const float* coeffs) {
+	const __m256 scaleVec = _mm256_set1_ps(scale);
+	const __m256 offsetVec = _mm256_set1_ps(offset);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	int j = 0;
+	for (; j + 8 <= length; j += 8) {
+		//8 complex values: squared components are added pairwise with hadd, which interleaves the 128 bit lanes of both inputs
+		__m256 a = _mm256_loadu_ps(reinterpret_cast<const float*>(&in[j]));
+		__m256 b = _mm256_loadu_ps(reinterpret_cast<const float*>(&in[j+4]));
+		__m256 power = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+		power = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(power), 0xD8));
+		__m256 value = _mm256_fmadd_ps(fastLog2Avx2<DEGREE>(power, coeffs), scaleVec, offsetVec);
+		_mm256_storeu_ps(&out[j], _mm256_min_ps(_mm256_max_ps(value, zero), one)); //max_ps returns zero for NaN, like saturate()
+	}
+	truncateLogFast<DEGREE>(&out[j], &in[j], length - j, scale, offset, coeffs);
+}
+#endif
+
+static void truncateLogLine(float* out, const CpuComplex* in, const int length, const float scale, const float offset, const LOG_ACCURACY logAccuracy, const bool useAvx2) {
+	switch (logAccuracy) {
+	case LOG_ACCURACY::FAST_LOG_HIGH_ACCURACY:
+#if defined(OCTPROZ_X86)
+		if (useAvx2) {
+			truncateLogFastAvx2<6>(out, in, length, scale, offset, LOG2_COEFFS_HIGH_ACCURACY);
+			break;
+		}
+#endif
+		truncateLogFast<6>(out, in, length, scale, offset, LOG2_COEFFS_HIGH_ACCURACY);
+		break;
+	case LOG_ACCURACY::FAST_LOG_LOW_ACCURACY:
+#if defined(OCTPROZ_X86)
+		if (useAvx2) {
+			truncateLogFastAvx2<3>(out, in, length, scale, offset, LOG2_COEFFS_LOW_ACCURACY);
+			break;
+		}
+#endif
+		truncateLogFast<3>(out, in, length, scale, offset, LOG2_COEFFS_LOW_ACCURACY);
+		break;
+	default:
+		for (int j = 0; j < length; j++) {
+			float power = in[j].x*in[j].x + in[j].y*in[j].y;
+			out[j] = CpuKernels::saturate(scale*log2f(power) + offset);
+		}
+		break;
+	}
+}
+
+//float output is written in place. Compact sample types are truncated into a line of floats first and quantized afterwards
+static inline float* getTruncationLine(float* output, float* lineBuffer) {
+	(void)lineBuffer;
+	return output;
+}
+
+template <typename T>
+static inline float* getTruncationLine(T* output, float* lineBuffer) {
+	(void)output;
+	return lineBuffer;
+}
+
+static inline void storeTruncationLine(float* output, const float* line, const int length) {
+	(void)output;
+	(void)line;
+	(void)length;
+}
+
+template <typename T>
+static inline void storeTruncationLine(T* output, const float* line, const int length) {
+	for (int j = 0; j < length; j++) {
+		storeVolumeSample(output[j], line[j]);
+	}
+}
+
+//writes output line by line. Without lineGather output line i is the truncated input line i. With lineGather it is the interpolation of the
+//truncated input lines lineGather[i].line0 and lineGather[i].line1, which covers bscan flip and sinusoidal scan correction without additional passes
+template <typename T, typename TruncateLine>
+static void truncateLines(T* output, const CpuComplex* input, const int inputLineStride, const int outputAscanLength, const CpuLineGather* lineGather, const size_t firstLine, const size_t lastLine, TruncateLine truncateLine) {
+	thread_local std::vector<float> lineBuffers;
+	if (lineBuffers.size() < 2*static_cast<size_t>(outputAscanLength)) {
+		lineBuffers.resize(2*outputAscanLength);
+	}
+	for (size_t line = firstLine; line < lastLine; line++) {
+		T* outputLine = &output[line*outputAscanLength];
+		float* out = getTruncationLine(outputLine, lineBuffers.data());
+		if (lineGather == nullptr) {
+			truncateLine(out, &input[line*inputLineStride]);
+		} else {
+			const CpuLineGather& gather = lineGather[line];
+			truncateLine(out, &input[(size_t)gather.line0*inputLineStride]);
+			if (gather.weight != 0.0f) {
+				float* out1 = lineBuffers.data() + outputAscanLength;
+				truncateLine(out1, &input[(size_t)gather.line1*inputLineStride]);
+				for (int j = 0; j < outputAscanLength; j++) {
+					out[j] = out[j] + (out1[j] - out[j]) * gather.weight;
+				}
+			}
+		}
+		storeTruncationLine(outputLine, out, outputAscanLength);
+	}
+}
+
+void CpuKernels::postProcessTruncateLog(void* output, const VOLUME_STORAGE outputStorage, const CpuComplex* input, const int inputLineStride, const int outputAscanLength, const float max, const float min, const float addend, const float coeff, const LOG_ACCURACY logAccuracy, const CpuLineGather* lineGather, const size_t firstLine, const size_t lastLine) {
+	//see postProcessTruncateLog in cuda_code.cu for notes on log scaling and fft normalization.
+	//coeff*(((10*log10(power/outputAscanLength) - min) / (max - min)) + addend) is rewritten as scale*log2(power) + offset, which is a single multiply-add per sample
+	const float scale = static_cast<float>(coeff * 10.0 * log10(2.0) / (max - min));
+	const float offset = static_cast<float>(coeff * (((-10.0 * log10(static_cast<double>(outputAscanLength)) - min) / (max - min)) + addend));
+#if defined(OCTPROZ_X86)
+	const bool useAvx2 = CpuFeatures::getSimdLevel() >= SIMD_AVX2 && CpuFeatures::hasFma();
+#else
+	const bool useAvx2 = false;
+#endif
+	auto truncateLine = [&](float* out, const CpuComplex* in) {
+		truncateLogLine(out, in, outputAscanLength, scale, offset, logAccuracy, useAvx2);
+	};
+	FOR_VOLUME_STORAGE(outputStorage, truncateLines(static_cast<VolumeSample*>(output), input, inputLineStride, outputAscanLength, lineGather, firstLine, lastLine, truncateLine));
+}
+
+void CpuKernels::postProcessTruncateLin(void* output, const VOLUME_STORAGE outputStorage, const CpuComplex* input, const int inputLineStride, const int outputAscanLength, const float max, const float min, const float addend, const float coeff, const CpuLineGather* lineGather, const size_t firstLine, const size_t lastLine) {
+	auto truncateLine = [&](float* out, const CpuComplex* in) {
+		for (int j = 0; j < outputAscanLength; j++) {
+			float realComponent = in[j].x;
+			float imaginaryComponent = in[j].y;
+			float value = coeff * ((((sqrtf((realComponent*realComponent) + (imaginaryComponent*imaginaryComponent))/(outputAscanLength)) - min) / (max - min)) + addend);
+			out[j] = saturate(value);
+		}
+	};
+	FOR_VOLUME_STORAGE(outputStorage, truncateLines(static_cast<VolumeSample*>(output), input, inputLineStride, outputAscanLength, lineGather, firstLine, lastLine, truncateLine));
+}
+
+void CpuKernels::fillSinusoidalScanCorrectionCurve(float* sinusoidalResampleCurve, const int length) {
+	for (int index = 0; index < length; index++) {
+		sinusoidalResampleCurve[index] = ((float)length/M_PI)*acos((float)(1.0-((2.0*(float)index)/(float)length)));
+	}
+}
+
+void CpuKernels::fillLineGather(CpuLineGather* lineGather, const float* sinusoidalResampleCurve, const int ascansPerBscan, const size_t linesInBuffer, const bool bscanFlip) {
+	//the result is the same as truncation, followed by flip of every second bscan, followed by sinusoidal scan correction of the flipped buffer
+	for (size_t line = 0; line < linesInBuffer; line++) {
+		size_t line0 = line;
+		size_t line1 = line;
+		float weight = 0.0f;
+		if (sinusoidalResampleCurve != nullptr && line + 1 < linesInBuffer) { //the last A-scan of a buffer is not resampled, same as in the cuda kernel
+			size_t posInBscan = line % ascansPerBscan;
+			size_t bscan = line / ascansPerBscan;
+			float x = sinusoidalResampleCurve[posInBscan];
+			line0 = bscan*ascansPerBscan + (size_t)x;
+			line1 = std::min(line0 + 1, linesInBuffer - 1);
+			weight = x - (int)x;
+		}
+		//flipping is its own inverse, so the flipped position of a line is also the unflipped source of that position
+		lineGather[line].line0 = static_cast<unsigned int>(getFlippedLine(line0, ascansPerBscan, bscanFlip));
+		lineGather[line].line1 = static_cast<unsigned int>(getFlippedLine(line1, ascansPerBscan, bscanFlip));
+		lineGather[line].weight = weight;
+	}
+}
+
+template <typename T>
+static void getPostProcessBackgroundSamples(float* output, const T* input, const int samplesPerAscan, const int ascansPerBuffer) {
+	for (int index = 0; index < samplesPerAscan; index++) {
+		float sum = 0;
+		for (int i = 0; i < ascansPerBuffer; i++) {
+			sum += loadVolumeSample(input[index+(size_t)i*samplesPerAscan]);
+		}
+		output[index] = sum/ascansPerBuffer;
+	}
+}
+
+void CpuKernels::getPostProcessBackground(float* output, const void* input, const VOLUME_STORAGE inputStorage, const int samplesPerAscan, const int ascansPerBuffer) {
+	FOR_VOLUME_STORAGE(inputStorage, getPostProcessBackgroundSamples(output, static_cast<const VolumeSample*>(input), samplesPerAscan, ascansPerBuffer));
+}
+
+template <typename T>
+static void postProcessBackgroundRemovalSamples(T* data, const float* background, const float backgroundWeight, const float backgroundOffset, const int samplesPerAscan, const size_t firstLine, const size_t lastLine) {
+	for (size_t line = firstLine; line < lastLine; line++) {
+		T* ascan = &data[line*samplesPerAscan];
+		for (int j = 0; j < samplesPerAscan; j++) {
+			storeVolumeSample(ascan[j], CpuKernels::saturate(loadVolumeSample(ascan[j]) - (backgroundWeight * background[j] + backgroundOffset)));
+		}
+	}
+}
+
+void CpuKernels::postProcessBackgroundRemoval(void* data, const VOLUME_STORAGE storage, const float* background, const float backgroundWeight, const float backgroundOffset, const int samplesPerAscan, const size_t firstLine, const size_t lastLine) {
+	FOR_VOLUME_STORAGE(storage, postProcessBackgroundRemovalSamples(static_cast<VolumeSample*>(data), background, backgroundWeight, backgroundOffset, samplesPerAscan, firstLine, lastLine));
+}
+
+template <typename T>
+static void updateDisplayProjectionSamples(float* displayBuffer, DisplayProjectionPixel* projection, const T* processedVolume, const size_t pixels, const size_t pixelStride, const size_t frameStride, const unsigned int frameNr, const DisplayProjectionWindow* window, const size_t firstPixel, const size_t lastPixel) {
+	//both views are displayed mirrored
+	if (window == nullptr) {
+		for (size_t p = firstPixel; p < lastPixel; p++) {
+			displayBuffer[(pixels-1)-p] = loadVolumeSample(processedVolume[p*pixelStride + (size_t)frameNr*frameStride]);
+		}
+		return;
+	}
+	for (size_t p = firstPixel; p < lastPixel; p++) {
+		scrollProjectionPixel(projection[p], &processedVolume[p*pixelStride], frameStride, *window);
+		displayBuffer[(pixels-1)-p] = getProjectionValue(projection[p], *window);
+	}
+}
+
+void CpuKernels::updateDisplayProjection(float* displayBuffer, DisplayProjectionPixel* projection, const void* processedVolume, const VOLUME_STORAGE storage, const size_t pixels, const size_t pixelStride, const size_t frameStride, const unsigned int frameNr, const DisplayProjectionWindow* window, const size_t firstPixel, const size_t lastPixel) {
+	FOR_VOLUME_STORAGE(storage, updateDisplayProjectionSamples(displayBuffer, projection, static_cast<const VolumeSample*>(processedVolume), pixels, pixelStride, frameStride, frameNr, window, firstPixel, lastPixel));
+}
+
+template <typename T>
+static void removeDisplayProjectionSamples(DisplayProjectionPixel* projection, const T* processedVolume, const size_t pixelStride, const size_t frameStride, const DisplayProjectionWindow& window, const unsigned int firstFrame, const unsigned int lastFrame, const size_t firstPixel, const size_t lastPixel) {
+	for (size_t p = firstPixel; p < lastPixel; p++) {
+		removeProjectionFrames(projection[p], &processedVolume[p*pixelStride], frameStride, window, firstFrame, lastFrame);
+	}
+}
+
+void CpuKernels::removeDisplayProjectionFrames(DisplayProjectionPixel* projection, const void* processedVolume, const VOLUME_STORAGE storage, const size_t pixelStride, const size_t frameStride, const DisplayProjectionWindow& window, const unsigned int firstFrame, const unsigned int lastFrame, const size_t firstPixel, const size_t lastPixel) {
+	FOR_VOLUME_STORAGE(storage, removeDisplayProjectionSamples(projection, static_cast<const VolumeSample*>(processedVolume), pixelStride, frameStride, window, firstFrame, lastFrame, firstPixel, lastPixel));
+}
+
+template <typename T>
+static void addDisplayProjectionSamples(DisplayProjectionPixel* projection, const T* processedVolume, const size_t pixelStride, const size_t frameStride, const DisplayProjectionWindow& window, const unsigned int firstFrame, const unsigned int lastFrame, const size_t firstPixel, const size_t lastPixel) {
+	for (size_t p = firstPixel; p < lastPixel; p++) {
+		addProjectionFrames(projection[p], &processedVolume[p*pixelStride], frameStride, window, firstFrame, lastFrame);
+	}
+}
+
+void CpuKernels::addDisplayProjectionFrames(DisplayProjectionPixel* projection, const void* processedVolume, const VOLUME_STORAGE storage, const size_t pixelStride, const size_t frameStride, const DisplayProjectionWindow& window, const unsigned int firstFrame, const unsigned int lastFrame, const size_t firstPixel, const size_t lastPixel) {
+	FOR_VOLUME_STORAGE(storage, addDisplayProjectionSamples(projection, static_cast<const VolumeSample*>(processedVolume), pixelStride, frameStride, window, firstFrame, lastFrame, firstPixel, lastPixel));
+}
+
+template <typename T>
+static void transposeToEnFaceSamples(T* enFaceVolume, const T* processedBuffer, const size_t samplesPerAscan, const size_t linesInVolume, const size_t firstLineInVolume, const size_t linesInBuffer, const size_t firstDepth, const size_t lastDepth) {
+	//tiles of CPU_TRANSPOSE_TILE x CPU_TRANSPOSE_TILE samples, so that the A-scans that are read and the depth rows that are written both stay in the cache
+	for (size_t z0 = firstDepth; z0 < lastDepth; z0 += CPU_TRANSPOSE_TILE) {
+		size_t z1 = z0 + CPU_TRANSPOSE_TILE < lastDepth ? z0 + CPU_TRANSPOSE_TILE : lastDepth;
+		for (size_t l0 = 0; l0 < linesInBuffer; l0 += CPU_TRANSPOSE_TILE) {
+			size_t l1 = l0 + CPU_TRANSPOSE_TILE < linesInBuffer ? l0 + CPU_TRANSPOSE_TILE : linesInBuffer;
+			for (size_t z = z0; z < z1; z++) {
+				T* row = &enFaceVolume[z*linesInVolume + firstLineInVolume];
+				for (size_t l = l0; l < l1; l++) {
+					row[l] = processedBuffer[l*samplesPerAscan + z];
+				}
+			}
+		}
+	}
+}
+
+void CpuKernels::transposeToEnFace(void* enFaceVolume, const void* processedBuffer, const VOLUME_STORAGE storage, const size_t samplesPerAscan, const size_t linesInVolume, const size_t firstLineInVolume, const size_t linesInBuffer, const size_t firstDepth, const size_t lastDepth) {
+	FOR_VOLUME_STORAGE(storage, transposeToEnFaceSamples(static_cast<VolumeSample*>(enFaceVolume), static_cast<const VolumeSample*>(processedBuffer), samplesPerAscan, linesInVolume, firstLineInVolume, linesInBuffer, firstDepth, lastDepth));
+}
+
+template <typename T>
+static void updateDisplayedVolumeSamples(unsigned char* output, const T* processedBuffer, const unsigned int samplesPerAscan, const unsigned int linesInBuffer, const size_t firstDepth, const size_t lastDepth) {
+	//output is one slab of the 3d texture: x = A-scan within B-scan, y = B-scan, z = depth (flipped back to front)
+	for (size_t z = firstDepth; z < lastDepth; z++) {
+		unsigned char* slice = &output[z*linesInBuffer];
+		size_t sampleIndex = (samplesPerAscan-1) - z;
+		for (size_t line = 0; line < linesInBuffer; line++) {
+			slice[line] = (unsigned char)(loadVolumeSample(processedBuffer[line*samplesPerAscan + sampleIndex]) * 255.0f);
+		}
+	}
+}
+
+void CpuKernels::updateDisplayedVolume(unsigned char* output, const void* processedBuffer, const VOLUME_STORAGE storage, const unsigned int samplesPerAscan, const unsigned int linesInBuffer, const size_t firstDepth, const size_t lastDepth) {
+	FOR_VOLUME_STORAGE(storage, updateDisplayedVolumeSamples(output, static_cast<const VolumeSample*>(processedBuffer), samplesPerAscan, linesInBuffer, firstDepth, lastDepth));
+}
+
+template <typename TOut, typename T>
+static void quantizeToOutput(TOut* out, const T* input, const float maxValue, const size_t firstSample, const size_t lastSample) {
+	for (size_t i = firstSample; i < lastSample; i++) {
+		out[i] = (TOut)(loadVolumeSample(input[i]) * maxValue);
+	}
+}
+
+template <typename T>
+static void volumeToOutput(void* output, const T* input, const unsigned int outputBitdepth, const size_t firstSample, const size_t lastSample) {
+	if (outputBitdepth <= 8) {
+		quantizeToOutput(static_cast<unsigned char*>(output), input, 255.0f, firstSample, lastSample);
+	} else if (outputBitdepth > 8 && outputBitdepth <= 10) {
+		quantizeToOutput(static_cast<unsigned short*>(output), input, 1023.0f, firstSample, lastSample);
+	} else if (outputBitdepth > 10 && outputBitdepth <= 12) {
+		quantizeToOutput(static_cast<unsigned short*>(output), input, 4095.0f, firstSample, lastSample);
+	} else if (outputBitdepth > 12 && outputBitdepth <= 16) {
+		quantizeToOutput(static_cast<unsigned short*>(output), input, 65535.0f, firstSample, lastSample);
+	} else if (outputBitdepth > 16 && outputBitdepth <= 24) {
+		quantizeToOutput(static_cast<unsigned int*>(output), input, 16777215.0f, firstSample, lastSample);
+	} else {
+		unsigned int* out = static_cast<unsigned int*>(output);
+		for (size_t i = firstSample; i < lastSample; i++) { out[i] = (unsigned int)(loadVolumeSample(input[i]) * (4294967295.0)); }
+	}
+}
+
+void CpuKernels::floatToOutput(void* output, const void* input, const VOLUME_STORAGE inputStorage, const unsigned int outputBitdepth, const size_t firstSample, const size_t lastSample) {
+	FOR_VOLUME_STORAGE(inputStorage, volumeToOutput(output, static_cast<const VolumeSample*>(input), outputBitdepth, firstSample, lastSample));
+}
@@ -0,0 +1,91 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef CPUKERNELS_H
+#define CPUKERNELS_H
+
+#include <stddef.h>
+#include "octalgorithmparameters.h"
+#include "displayprojection.h"
+#include "volumestorage.h"
+
+
+//complex sample with the same memory layout as cufftComplex and fftwf_complex
+struct CpuComplex {
+	float x;
+	float y;
+};
+
+//source A-scans of one output A-scan of the truncation: output = truncated(line0) + (truncated(line1) - truncated(line0)) * weight
+struct CpuLineGather {
+	unsigned int line0;
+	unsigned int line1;
+	float weight;
+};
+
+//running mean and sum of squared deviations (Welford) of one depth sample within one fixed-pattern noise segment
+struct CpuSegmentStatistics {
+	float meanX;
+	float meanY;
+	float m2;
+};
+
+/**
+* Host implementations of the processing steps in cuda_code.cu.
+* Every function works on a range of A-scans (or samples) so that it can be distributed with ThreadPool::parallelFor().
+* width is always the number of samples of a raw A-scan, firstLine/lastLine are A-scan indices within the current buffer (lastLine is exclusive).
+* Complex spectra are either full length (lineStride = width) or half spectra of a real-to-complex fft (lineStride = width/2+1).
+* Processed data is passed as void pointer together with its VOLUME_STORAGE, see volumestorage.h.
+**/
+class CpuKernels
+{
+public:
+	static void rollingAverageBackgroundRemoval(float* output, const float* input, const int rollingAverageWindowSize, const int width, const size_t firstLine, const size_t lastLine);
+	static void windowing(float* inOut, const float* window, const int width, const size_t firstLine, const size_t lastLine);
+	static void realToComplexAndDispersionCompensation(CpuComplex* output, const float* input, const CpuComplex* phaseComplex, const int width, const size_t firstLine, const size_t lastLine);
+	static void fillDispersivePhase(CpuComplex* phaseComplex, const float* phase, const double factor, const int width, const int direction);
+	static void getSegmentStatistics(CpuSegmentStatistics* statistics, const CpuComplex* segment, const int lineStride, const int segmentWidth, const size_t firstSample, const size_t lastSample); ///single pass over the segmentWidth A-scans that start at segment
+	static void getMinimumVarianceMean(CpuComplex* meanLine, const CpuSegmentStatistics* statistics, const int statisticsStride, const int segments, const size_t firstSample, const size_t lastSample); ///statistics of segment i start at statistics[i*statisticsStride]
+	static void meanALineSubtraction(CpuComplex* inOut, const CpuComplex* meanLine, const int lineStride, const int outputAscanLength, const size_t firstLine, const size_t lastLine);
+	static void postProcessTruncateLog(void* output, const VOLUME_STORAGE outputStorage, const CpuComplex* input, const int inputLineStride, const int outputAscanLength, const float max, const float min, const float addend, const float coeff, const LOG_ACCURACY logAccuracy, const CpuLineGather* lineGather, const size_t firstLine, const size_t lastLine); ///lineGather may be nullptr
+	static void postProcessTruncateLin(void* output, const VOLUME_STORAGE outputStorage, const CpuComplex* input, const int inputLineStride, const int outputAscanLength, const float max, const float min, const float addend, const float coeff, const CpuLineGather* lineGather, const size_t firstLine, const size_t lastLine); ///lineGather may be nullptr
+	static void fillSinusoidalScanCorrectionCurve(float* sinusoidalResampleCurve, const int length);
+	static void fillLineGather(CpuLineGather* lineGather, const float* sinusoidalResampleCurve, const int ascansPerBscan, const size_t linesInBuffer, const bool bscanFlip); ///sinusoidalResampleCurve is nullptr if sinusoidal scan correction is off
+	static void getPostProcessBackground(float* output, const void* input, const VOLUME_STORAGE inputStorage, const int samplesPerAscan, const int ascansPerBuffer);
+	static void postProcessBackgroundRemoval(void* data, const VOLUME_STORAGE storage, const float* background, const float backgroundWeight, const float backgroundOffset, const int samplesPerAscan, const size_t firstLine, const size_t lastLine);
+	static void updateDisplayProjection(float* displayBuffer, DisplayProjectionPixel* projection, const void* processedVolume, const VOLUME_STORAGE storage, const size_t pixels, const size_t pixelStride, const size_t frameStride, const unsigned int frameNr, const DisplayProjectionWindow* window, const size_t firstPixel, const size_t lastPixel); ///window is nullptr if a single frame is displayed
+	static void removeDisplayProjectionFrames(DisplayProjectionPixel* projection, const void* processedVolume, const VOLUME_STORAGE storage, const size_t pixelStride, const size_t frameStride, const DisplayProjectionWindow& window, const unsigned int firstFrame, const unsigned int lastFrame, const size_t firstPixel, const size_t lastPixel);
+	static void addDisplayProjectionFrames(DisplayProjectionPixel* projection, const void* processedVolume, const VOLUME_STORAGE storage, const size_t pixelStride, const size_t frameStride, const DisplayProjectionWindow& window, const unsigned int firstFrame, const unsigned int lastFrame, const size_t firstPixel, const size_t lastPixel);
+	static void transposeToEnFace(void* enFaceVolume, const void* processedBuffer, const VOLUME_STORAGE storage, const size_t samplesPerAscan, const size_t linesInVolume, const size_t firstLineInVolume, const size_t linesInBuffer, const size_t firstDepth, const size_t lastDepth); ///enFaceVolume[depth*linesInVolume + line] = processedBuffer[line*samplesPerAscan + depth]
+	static void updateDisplayedVolume(unsigned char* output, const void* processedBuffer, const VOLUME_STORAGE storage, const unsigned int samplesPerAscan, const unsigned int linesInBuffer, const size_t firstDepth, const size_t lastDepth);
+	static void floatToOutput(void* output, const void* input, const VOLUME_STORAGE inputStorage, const unsigned int outputBitdepth, const size_t firstSample, const size_t lastSample);
+
+	static inline size_t getFlippedLine(const size_t line, const int ascansPerBscan, const bool bscanFlip) { size_t bscan = line/ascansPerBscan; return (bscanFlip && bscan % 2 == 0) ? bscan*ascansPerBscan + (ascansPerBscan-1-line%ascansPerBscan) : line; } ///with bscanFlip every second B-scan is in reverse A-scan order
+	static inline float saturate(const float value) { return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f; } ///same as __saturatef: clamps to [0.0, 1.0] and maps NaN to 0.0
+};
+
+#endif // CPUKERNELS_H
@@ -0,0 +1,1214 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "cpuprocessingbackend.h"
+#include "gpu2hostnotifier.h"
+#include "stagetimings.h"
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+
+template <typename T>
+static T* allocateBuffer(size_t count) {
+	T* buffer = static_cast<T*>(fftwf_malloc(sizeof(T)*count)); //fftwf_malloc returns memory with the alignment that is needed for simd fft
+	if (buffer != nullptr) {
+		memset(buffer, 0, sizeof(T)*count);
+	}
+	return buffer;
+}
+
+template <typename T>
+static void freeBuffer(T*& buffer) {
+	if (buffer != nullptr) {
+		fftwf_free(buffer);
+		buffer = nullptr;
+	}
+}
+
+
+CpuProcessingBackend::CpuProcessingBackend(unsigned int numberOfThreads) {
+	this->threadPool = new ThreadPool(numberOfThreads);
+	this->postFftThreadPool = this->threadPool;
+	this->resamplingPlan = new ResamplingPlan();
+	this->params = nullptr;
+	this->initialized = false;
+	this->signalLength = 0;
+	this->ascansPerBscan = 0;
+	this->bscansPerBuffer = 0;
+	this->buffersPerVolume = 0;
+	this->linesPerBuffer = 0;
+	this->samplesPerBuffer = 0;
+	this->samplesPerVolume = 0;
+	this->bufferNumberInVolume = 0;
+	this->streamingBufferNumber = 0;
+	this->streamedBuffers = 0;
+	this->fixedPatternNoiseDetermined = false;
+	this->nextPipelineSlot = 0;
+	this->nextPipelineWorker = 0;
+	this->bytesPerBuffer = 0;
+	this->fftBufferSize = 0;
+	this->volumeStorage = FLOAT32_VOLUME;
+	this->bytesPerVolumeSample = sizeof(float);
+	this->processedVolume = nullptr;
+	this->enFaceVolume = nullptr;
+	this->enFaceVolumeValid = false;
+	this->volumeRingBuffer = nullptr;
+	this->resampleCurve = nullptr;
+	this->windowCurve = nullptr;
+	this->dispersionCurve = nullptr;
+	this->sinusoidalResampleCurve = nullptr;
+	this->lineGather = nullptr;
+	this->lineGatherMode = -1;
+	this->phaseCartesian = nullptr;
+	this->meanALine = nullptr;
+	this->segmentStatistics = nullptr;
+	this->noiseSegments = 0;
+	this->noiseSegmentWidth = 0;
+	this->postProcBackgroundLine = nullptr;
+	this->bscanDisplayBuffer = nullptr;
+	this->enFaceDisplayBuffer = nullptr;
+	this->volumeDisplayBuffer = nullptr;
+	this->bscanProjection = nullptr;
+	this->enFaceProjection = nullptr;
+	this->fftPlan = nullptr;
+	this->fftPlanRemainder = nullptr;
+	this->realFftPlan = nullptr;
+	this->realFftPlanRemainder = nullptr;
+	this->linesPerFftBlock = 1;
+	this->realInputFft = true;
+	this->buffersInFlight = 1;
+	this->jobsInFlight = 0;
+	this->pipelineStopRequested = false;
+	this->pendingDisplayUpdates = 0;
+	this->displayUploadNanoseconds = 0;
+	this->volumeDisplayBufferNumber = 0;
+	this->stageCapture = false;
+	std::fill(this->stageCaptured, this->stageCaptured+NUMBER_OF_CAPTURE_STAGES, false);
+	this->glBufferBscan = 0;
+	this->glBufferEnFaceView = 0;
+	this->glTextureVolumeView = 0;
+	this->host_streamingBuffer1 = nullptr;
+	this->host_streamingBuffer2 = nullptr;
+}
+
+CpuProcessingBackend::~CpuProcessingBackend() {
+	this->cleanup();
+	if (this->postFftThreadPool != this->threadPool) {
+		delete this->postFftThreadPool;
+	}
+	delete this->threadPool;
+	delete this->resamplingPlan;
+}
+
+std::string CpuProcessingBackend::getDeviceName() const {
+	return CpuFeatures::getProcessorName() + " " + std::to_string(this->threadPool->getThreadCount()) + " threads";
+}
+
+bool CpuProcessingBackend::init(void** h_buffers, unsigned int bufferCount, OctAlgorithmParameters* parameters) {
+	//acquisition buffers are read directly by the worker threads, so there is nothing to register here
+	(void)h_buffers;
+	(void)bufferCount;
+
+	this->cleanup();
+	this->lastError.clear();
+	this->params = parameters;
+	this->signalLength = parameters->samplesPerLine;
+	this->ascansPerBscan = parameters->ascansPerBscan;
+	this->bscansPerBuffer = parameters->bscansPerBuffer;
+	this->buffersPerVolume = parameters->buffersPerVolume;
+	this->linesPerBuffer = this->ascansPerBscan*this->bscansPerBuffer;
+	this->samplesPerBuffer = this->signalLength*this->linesPerBuffer;
+	this->samplesPerVolume = this->samplesPerBuffer*this->buffersPerVolume;
+	if (this->samplesPerBuffer == 0) {
+		return false;
+	}
+
+	//with several workers the cores are shared equally between them. Every worker needs a slot to work on while the post-fft stage releases another one
+	unsigned int workerCount = std::max(1u, std::min((unsigned int)CPU_MAX_PIPELINE_WORKERS, parameters->pipelineWorkers));
+	this->buffersInFlight = std::max(1u, std::min((unsigned int)CPU_MAX_BUFFERS_IN_FLIGHT, parameters->buffersInFlight));
+	if (workerCount > 1) {
+		this->buffersInFlight = std::max(this->buffersInFlight, workerCount+1);
+	}
+
+	//thread count and tile size can be determined for the current geometry and processor by the autotuner
+	unsigned int fftThreads = this->threadPool->getThreadCount();
+	if (parameters->cpuThreads > 0) {
+		fftThreads = std::min(fftThreads, parameters->cpuThreads);
+	}
+	//the fft plans are executed at the first line of every tile and only work on arrays with the alignment of the arrays they were planned on.
+	//A tile that is smaller than the buffer is rounded up to CPU_FFT_LINES_ALIGNMENT lines, a single tile starts at the beginning of the buffer anyway
+	size_t linesPerFftBlock = parameters->cpuLinesPerFftBlock > 0 ? parameters->cpuLinesPerFftBlock : CPU_FFT_LINES_PER_BLOCK;
+	linesPerFftBlock = (linesPerFftBlock + CPU_FFT_LINES_ALIGNMENT - 1) / CPU_FFT_LINES_ALIGNMENT * CPU_FFT_LINES_ALIGNMENT;
+	this->linesPerFftBlock = std::min(linesPerFftBlock, this->linesPerBuffer);
+	bool workerBuffersAllocated = true;
+	for (unsigned int i = 0; i < workerCount; i++) {
+		CpuPipelineWorker* worker = new CpuPipelineWorker();
+		bool ownThreadPool = workerCount > 1 || fftThreads < this->threadPool->getThreadCount();
+		worker->threadPool = ownThreadPool ? new ThreadPool(std::max(1u, fftThreads/workerCount)) : this->threadPool;
+		for (unsigned int j = 0; j < 2*worker->threadPool->getThreadCount(); j++) {
+			float* tile = allocateBuffer<float>(this->linesPerFftBlock*this->signalLength);
+			workerBuffersAllocated = workerBuffersAllocated && tile != nullptr;
+			worker->tileBuffers.push_back(tile);
+		}
+		this->pipelineWorkers.push_back(worker);
+	}
+	this->bytesPerBuffer = InputConversion::getBytesPerSample(parameters->bitDepth)*this->samplesPerBuffer;
+	this->volumeStorage = parameters->volumeStorage;
+	this->bytesPerVolumeSample = getVolumeSampleSize(this->volumeStorage);
+	this->fftBufferSize = (this->signalLength/2+1)*this->linesPerBuffer;
+	for (unsigned int i = 0; i < this->buffersInFlight; i++) {
+		CpuPipelineSlot slot;
+		slot.rawData = workerCount > 1 ? allocateBuffer<unsigned char>(this->bytesPerBuffer) : nullptr;
+		slot.spectra = allocateBuffer<CpuComplex>(this->fftBufferSize);
+		slot.lineStride = 0;
+		slot.realInput = true;
+		slot.spectraReady = false;
+		workerBuffersAllocated = workerBuffersAllocated && slot.spectra != nullptr && (workerCount == 1 || slot.rawData != nullptr);
+		this->pipelineSlots.push_back(slot);
+	}
+	this->nextPipelineSlot = 0;
+	this->nextPipelineWorker = 0;
+	this->processedVolume = allocateBuffer<unsigned char>(this->bytesPerVolumeSample*(this->samplesPerVolume/2));
+	this->volumeRing.init((size_t)parameters->volumeRingMegabytes*1048576, this->bytesPerVolumeSample*(this->samplesPerVolume/2));
+	this->volumeRingBuffer = this->volumeRing.isEnabled() ? allocateBuffer<unsigned char>(this->volumeRing.getMemorySize()) : nullptr;
+	this->resampleCurve = allocateBuffer<float>(this->signalLength);
+	this->windowCurve = allocateBuffer<float>(this->signalLength);
+	this->dispersionCurve = allocateBuffer<float>(this->signalLength);
+	this->sinusoidalResampleCurve = allocateBuffer<float>(this->ascansPerBscan);
+	this->lineGather = allocateBuffer<CpuLineGather>(this->linesPerBuffer);
+	this->lineGatherMode = -1;
+	this->phaseCartesian = allocateBuffer<CpuComplex>(this->signalLength);
+	this->meanALine = allocateBuffer<CpuComplex>(this->signalLength);
+	this->segmentStatistics = allocateBuffer<CpuSegmentStatistics>(FIXED_PATTERN_NOISE_REMOVAL_SEGMENTS*(this->signalLength/2));
+	this->postProcBackgroundLine = allocateBuffer<float>(this->signalLength/2);
+	this->bscanDisplayBuffer = allocateBuffer<float>(this->signalLength*this->ascansPerBscan/2);
+	this->enFaceDisplayBuffer = allocateBuffer<float>(this->ascansPerBscan*this->bscansPerBuffer*this->buffersPerVolume);
+	this->volumeDisplayBuffer = allocateBuffer<unsigned char>(this->samplesPerBuffer/2);
+	this->bscanProjection = allocateBuffer<DisplayProjectionPixel>(this->signalLength*this->ascansPerBscan/2);
+	this->enFaceProjection = allocateBuffer<DisplayProjectionPixel>(this->ascansPerBscan*this->bscansPerBuffer*this->buffersPerVolume);
+	this->bscanProjectionWindow.invalidate();
+	this->enFaceProjectionWindow.invalidate();
+
+	if (!workerBuffersAllocated || this->processedVolume == nullptr || (this->volumeRing.isEnabled() && this->volumeRingBuffer == nullptr)
+			|| this->lineGather == nullptr || this->resampleCurve == nullptr || this->windowCurve == nullptr
+			|| this->dispersionCurve == nullptr || this->sinusoidalResampleCurve == nullptr || this->phaseCartesian == nullptr
+			|| this->meanALine == nullptr || this->segmentStatistics == nullptr || this->postProcBackgroundLine == nullptr || this->bscanDisplayBuffer == nullptr
+			|| this->enFaceDisplayBuffer == nullptr || this->volumeDisplayBuffer == nullptr || this->bscanProjection == nullptr || this->enFaceProjection == nullptr) {
+		this->cleanup();
+		return false;
+	}
+
+	CpuKernels::fillSinusoidalScanCorrectionCurve(this->sinusoidalResampleCurve, this->ascansPerBscan);
+
+	//curves that have been calculated before processing was started are used right away. the cuda implementation relies on the update flags instead
+	if (parameters->resampleCurve != nullptr && parameters->resampleCurveLength > 0 && parameters->resampleCurveLength <= (int)this->signalLength) {
+		memcpy(this->resampleCurve, parameters->resampleCurve, sizeof(float)*parameters->resampleCurveLength);
+	}
+	this->resamplingPlan->build(this->resampleCurve, this->signalLength, parameters->resamplingInterpolation);
+	if (parameters->windowCurve != nullptr) {
+		memcpy(this->windowCurve, parameters->windowCurve, sizeof(float)*this->signalLength);
+	}
+	if (parameters->dispersionCurve != nullptr) {
+		memcpy(this->dispersionCurve, parameters->dispersionCurve, sizeof(float)*this->signalLength);
+		CpuKernels::fillDispersivePhase(this->phaseCartesian, this->dispersionCurve, 1.0, this->signalLength, 1);
+	}
+
+	//real-to-complex fft plans for blocks of A-scans. the blocks are distributed to the worker threads with fftwf_execute_dft_r2c, which is thread safe.
+	//plans for the complex fft (only needed for dispersion compensation) are requested in prepareComplexFft(). The plans are owned by FftPlanCache
+	//and survive cleanup(), so only the very first start with a new buffer size pays the planning cost
+	int remainingLines = static_cast<int>(this->linesPerBuffer % this->linesPerFftBlock);
+	this->realFftPlan = this->getFftPlan(static_cast<int>(this->linesPerFftBlock), true);
+	if (remainingLines > 0) {
+		this->realFftPlanRemainder = this->getFftPlan(remainingLines, true);
+	}
+	if (this->realFftPlan == nullptr || (remainingLines > 0 && this->realFftPlanRemainder == nullptr)) {
+		this->cleanup();
+		return false;
+	}
+
+	this->bufferNumberInVolume = parameters->buffersPerVolume-1;
+	this->streamingBufferNumber = 0;
+	this->streamedBuffers = 0;
+	this->fixedPatternNoiseDetermined = false;
+	this->realInputFft = true;
+	this->pendingDisplayUpdates = 0;
+	this->displayUploadNanoseconds = 0;
+	this->startPipeline();
+	this->initialized = true;
+	return true;
+}
+
+void CpuProcessingBackend::cleanup() {
+	this->stopPipeline();
+	//fft plans are owned by FftPlanCache and are kept for the next start
+	this->fftPlan = nullptr;
+	this->fftPlanRemainder = nullptr;
+	this->realFftPlan = nullptr;
+	this->realFftPlanRemainder = nullptr;
+	for (size_t i = 0; i < this->pipelineWorkers.size(); i++) {
+		CpuPipelineWorker* worker = this->pipelineWorkers[i];
+		for (size_t j = 0; j < worker->tileBuffers.size(); j++) {
+			freeBuffer(worker->tileBuffers[j]);
+		}
+		if (worker->threadPool != this->threadPool) {
+			delete worker->threadPool;
+		}
+		delete worker;
+	}
+	this->pipelineWorkers.clear();
+	for (size_t i = 0; i < this->pipelineSlots.size(); i++) {
+		freeBuffer(this->pipelineSlots[i].rawData);
+		freeBuffer(this->pipelineSlots[i].spectra);
+	}
+	this->pipelineSlots.clear();
+	this->fftBufferSize = 0;
+	freeBuffer(this->processedVolume);
+	freeBuffer(this->enFaceVolume);
+	this->enFaceVolumeValid = false;
+	freeBuffer(this->volumeRingBuffer);
+	this->volumeRing.init(0, 0);
+	freeBuffer(this->resampleCurve);
+	freeBuffer(this->windowCurve);
+	freeBuffer(this->dispersionCurve);
+	freeBuffer(this->sinusoidalResampleCurve);
+	freeBuffer(this->lineGather);
+	freeBuffer(this->phaseCartesian);
+	freeBuffer(this->meanALine);
+	freeBuffer(this->segmentStatistics);
+	freeBuffer(this->postProcBackgroundLine);
+	freeBuffer(this->bscanDisplayBuffer);
+	freeBuffer(this->enFaceDisplayBuffer);
+	freeBuffer(this->volumeDisplayBuffer);
+	freeBuffer(this->bscanProjection);
+	freeBuffer(this->enFaceProjection);
+	this->initialized = false;
+	this->fixedPatternNoiseDetermined = false;
+}
+
+void CpuProcessingBackend::startPipeline() {
+	if (this->buffersInFlight < 2) {
+		if (this->postFftThreadPool != this->threadPool) {
+			delete this->postFftThreadPool;
+			this->postFftThreadPool = this->threadPool;
+		}
+		return;
+	}
+
+	//the post-fft stage gets its own workers, since ThreadPool::parallelFor can only be used by one thread at a time. The fft stage is
+	//usually the more expensive one and keeps the full pool
+	if (this->postFftThreadPool == this->threadPool) {
+		this->postFftThreadPool = new ThreadPool(std::max(1u, this->threadPool->getThreadCount()/2));
+	}
+	this->jobsInFlight = 0;
+	this->pipelineStopRequested = false;
+	this->pipelineThread = std::thread(&CpuProcessingBackend::pipelineLoop, this);
+	if (this->pipelineWorkers.size() > 1) {
+		for (size_t i = 0; i < this->pipelineWorkers.size(); i++) {
+			this->pipelineWorkers[i]->thread = std::thread(&CpuProcessingBackend::workerLoop, this, this->pipelineWorkers[i]);
+		}
+	}
+}
+
+void CpuProcessingBackend::stopPipeline() {
+	if (!this->pipelineThread.joinable()) {
+		return;
+	}
+	this->waitForPipeline(0);
+	{
+		std::lock_guard<std::mutex> lock(this->pipelineMutex);
+		this->pipelineStopRequested = true;
+	}
+	this->pipelineCondition.notify_all();
+	this->pipelineThread.join();
+	for (size_t i = 0; i < this->pipelineWorkers.size(); i++) {
+		if (this->pipelineWorkers[i]->thread.joinable()) {
+			this->pipelineWorkers[i]->thread.join();
+		}
+	}
+}
+
+void CpuProcessingBackend::pipelineLoop() {
+	//slots are submitted round-robin, so taking them in slot order keeps the acquisition order even if the workers finish out of order
+	unsigned int slotIndex = 0;
+	while (true) {
+		CpuPipelineSlot& slot = this->pipelineSlots[slotIndex];
+		{
+			std::unique_lock<std::mutex> lock(this->pipelineMutex);
+			this->pipelineCondition.wait(lock, [this, &slot]{ return this->pipelineStopRequested || slot.spectraReady; });
+			if (!slot.spectraReady) {
+				return;
+			}
+		}
+
+		this->postFftStage(slot.spectra, slot.lineStride);
+
+		{
+			std::lock_guard<std::mutex> lock(this->pipelineMutex);
+			slot.spectraReady = false;
+			this->jobsInFlight--;
+		}
+		this->pipelineCondition.notify_all();
+		slotIndex = (slotIndex+1)%this->pipelineSlots.size();
+	}
+}
+
+void CpuProcessingBackend::workerLoop(CpuPipelineWorker* worker) {
+	while (true) {
+		unsigned int slotIndex;
+		{
+			std::unique_lock<std::mutex> lock(this->pipelineMutex);
+			this->pipelineCondition.wait(lock, [this, worker]{ return this->pipelineStopRequested || !worker->slots.empty(); });
+			if (worker->slots.empty()) {
+				return;
+			}
+			slotIndex = worker->slots.front();
+			worker->slots.pop_front();
+		}
+
+		CpuPipelineSlot& slot = this->pipelineSlots[slotIndex];
+		this->rawDataToSpectra(worker, slot.rawData, slot.realInput, slot.spectra);
+
+		{
+			std::lock_guard<std::mutex> lock(this->pipelineMutex);
+			slot.spectraReady = true;
+		}
+		this->pipelineCondition.notify_all();
+	}
+}
+
+void CpuProcessingBackend::waitForPipeline(unsigned int maxJobsInFlight) {
+	std::unique_lock<std::mutex> lock(this->pipelineMutex);
+	while (this->jobsInFlight > maxJobsInFlight) {
+		this->pipelineCondition.wait(lock, [this, maxJobsInFlight]{ return this->jobsInFlight <= maxJobsInFlight || this->pendingDisplayUpdates != 0; });
+
+		//the post-fft stage may wait for the upload of the previous volume display data, so uploads have to be done while waiting
+		if (this->pendingDisplayUpdates != 0) {
+			lock.unlock();
+			this->uploadPendingDisplayUpdates();
+			lock.lock();
+		}
+	}
+}
+
+void CpuProcessingBackend::synchronize() {
+	this->waitForPipeline(0);
+}
+
+void CpuProcessingBackend::setPendingDisplayUpdates(int updates) {
+	{
+		std::lock_guard<std::mutex> lock(this->pipelineMutex);
+		this->pendingDisplayUpdates |= updates;
+	}
+	this->pipelineCondition.notify_all();
+	if (this->displayUpdateNotifier) {
+		this->displayUpdateNotifier();
+	}
+}
+
+bool CpuProcessingBackend::hasPendingDisplayUpdates() {
+	std::lock_guard<std::mutex> lock(this->pipelineMutex);
+	return this->pendingDisplayUpdates != 0;
+}
+
+void CpuProcessingBackend::setDisplayUpdateNotifier(const std::function<void()>& notifier) {
+	this->displayUpdateNotifier = notifier;
+}
+
+void CpuProcessingBackend::uploadPendingDisplayUpdates() {
+	std::lock_guard<std::mutex> displayLock(this->displayMutex);
+	int updates;
+	{
+		std::lock_guard<std::mutex> lock(this->pipelineMutex);
+		updates = this->pendingDisplayUpdates;
+		this->pendingDisplayUpdates = 0;
+	}
+	if (updates == 0) {
+		return;
+	}
+	StageClock::time_point uploadStart = StageClock::now();
+	if ((updates & CPU_PENDING_BSCAN_UPDATE) && this->glBufferBscan != 0) {
+		this->uploadToGlBuffer(this->glBufferBscan, this->bscanDisplayBuffer, sizeof(float)*(this->signalLength*this->ascansPerBscan/2));
+	}
+	if ((updates & CPU_PENDING_ENFACE_UPDATE) && this->glBufferEnFaceView != 0) {
+		this->uploadToGlBuffer(this->glBufferEnFaceView, this->enFaceDisplayBuffer, sizeof(float)*(this->bscansPerBuffer*this->buffersPerVolume*this->ascansPerBscan));
+	}
+	if (updates & CPU_PENDING_VOLUME_UPDATE) {
+		this->uploadVolumeDisplayBuffer();
+	}
+	this->displayUploadNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(StageClock::now()-uploadStart).count();
+	this->pipelineCondition.notify_all(); //the post-fft stage may be waiting for the volume display buffer
+}
+
+bool CpuProcessingBackend::curvesChanged() const {
+	return (this->params->resampling && (this->params->resamplingUpdated || this->params->resamplingInterpolation != this->resamplingPlan->getInterpolation()))
+			|| (this->params->dispersionCompensation && this->params->dispersionUpdated)
+			|| (this->params->windowing && this->params->windowUpdated);
+}
+
+void CpuProcessingBackend::updateCurves() {
+	//the resampling plan has to be rebuilt if the curve or the interpolation method changed
+	if (this->params->resampling && this->params->resamplingUpdated) {
+		if (this->params->resampleCurve != nullptr && this->params->resampleCurveLength > 0 && this->params->resampleCurveLength <= (int)this->signalLength) {
+			memcpy(this->resampleCurve, this->params->resampleCurve, sizeof(float)*this->params->resampleCurveLength);
+		}
+		this->resamplingPlan->build(this->resampleCurve, this->signalLength, this->params->resamplingInterpolation);
+		this->params->resamplingUpdated = false;
+	}
+	if (this->params->resampling && this->params->resamplingInterpolation != this->resamplingPlan->getInterpolation()) {
+		this->resamplingPlan->build(this->resampleCurve, this->signalLength, this->params->resamplingInterpolation);
+	}
+	if (this->params->dispersionCompensation && this->params->dispersionUpdated) {
+		if (this->params->dispersionCurve != nullptr) {
+			memcpy(this->dispersionCurve, this->params->dispersionCurve, sizeof(float)*this->signalLength);
+			CpuKernels::fillDispersivePhase(this->phaseCartesian, this->dispersionCurve, 1.0, this->signalLength, 1);
+		}
+		this->params->dispersionUpdated = false;
+	}
+	if (this->params->windowing && this->params->windowUpdated) {
+		if (this->params->windowCurve != nullptr) {
+			memcpy(this->windowCurve, this->params->windowCurve, sizeof(float)*this->signalLength);
+		}
+		this->params->windowUpdated = false;
+	}
+}
+
+bool CpuProcessingBackend::process(void* h_inputSignal) {
+	if (!this->initialized) {
+		this->lastError = "Buffers are not initialized.";
+		return false;
+	}
+
+	//workers read the curves while they transform earlier buffers
+	if (this->curvesChanged()) {
+		if (this->pipelineWorkers.size() > 1) {
+			this->waitForPipeline(0);
+		}
+		this->updateCurves();
+	}
+
+	//Without dispersion compensation the signal is real valued and a real-to-complex fft is used that only calculates the half spectrum
+	//which is kept after truncation anyway. The r2c transform is a forward fft, its result is the complex conjugate of the inverse fft, which
+	//does not change the magnitude.
+	bool realInput = !this->params->dispersionCompensation;
+	if (realInput != this->realInputFft) {
+		this->waitForPipeline(0);
+		this->realInputFft = realInput;
+		this->fixedPatternNoiseDetermined = false; //the mean A-scan of the other fft type can not be reused
+	}
+	if (!realInput && !this->prepareComplexFft()) {
+		this->lastError = "Could not allocate buffers for dispersion compensation.";
+		return false;
+	}
+	int lineStride = realInput ? static_cast<int>(this->signalLength/2+1) : static_cast<int>(this->signalLength);
+
+	//the capture buffers are written by the tiles of every buffer in flight, so they are only resized while nothing is in flight
+	if (this->stageCapture && this->capturedStages[CAPTURE_SPECTRA].size() != this->samplesPerBuffer) {
+		this->waitForPipeline(0);
+		this->capturedStages[CAPTURE_SPECTRA].resize(this->samplesPerBuffer);
+		this->capturedStages[CAPTURE_FFT].resize(this->samplesPerBuffer/2);
+		this->capturedStages[CAPTURE_FIXED_PATTERN_NOISE_REMOVAL].resize(this->samplesPerBuffer/2);
+	}
+	this->stageCaptured[CAPTURE_SPECTRA] = this->stageCapture;
+	this->stageCaptured[CAPTURE_FFT] = this->stageCapture;
+
+	//the slot of the oldest buffer in flight is reused as soon as its post-fft stage is done
+	this->waitForPipeline(this->buffersInFlight-1);
+	unsigned int slotIndex = this->nextPipelineSlot;
+	this->nextPipelineSlot = (this->nextPipelineSlot+1)%this->buffersInFlight;
+	CpuPipelineSlot& slot = this->pipelineSlots[slotIndex];
+	slot.lineStride = lineStride;
+	slot.realInput = realInput;
+
+	if (this->pipelineWorkers.size() > 1) {
+		//the acquisition buffer may be reused as soon as process() returns, so the worker gets a copy
+		const unsigned char* input = static_cast<const unsigned char*>(h_inputSignal);
+		this->threadPool->parallelFor(this->bytesPerBuffer, [&](size_t first, size_t last) {
+			memcpy(&slot.rawData[first], &input[first], last-first);
+		}, 1<<20);
+		{
+			std::lock_guard<std::mutex> lock(this->pipelineMutex);
+			this->pipelineWorkers[this->nextPipelineWorker]->slots.push_back(slotIndex);
+			this->jobsInFlight++;
+		}
+		this->pipelineCondition.notify_all();
+		this->nextPipelineWorker = (this->nextPipelineWorker+1)%this->pipelineWorkers.size();
+	} else {
+		//Conversion, background removal, k-linearization, windowing, dispersion compensation and IFFT
+		this->rawDataToSpectra(this->pipelineWorkers[0], h_inputSignal, realInput, slot.spectra);
+
+		//everything after the fft only needs the spectra, so it runs on the pipeline thread while the next buffer is acquired and transformed
+		if (this->pipelineThread.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(this->pipelineMutex);
+				slot.spectraReady = true;
+				this->jobsInFlight++;
+			}
+			this->pipelineCondition.notify_all();
+		} else {
+			this->postFftStage(slot.spectra, lineStride);
+		}
+	}
+	this->uploadPendingDisplayUpdates();
+	return true;
+}
+
+void CpuProcessingBackend::postFftStage(CpuComplex* spectra, int lineStride) {
+	StageTimings* timings = StageTimings::getInstance();
+	StageClock::time_point stageStart = StageClock::now();
+
+	//Fixed-pattern noise removal
+	this->stageCaptured[CAPTURE_FIXED_PATTERN_NOISE_REMOVAL] = this->stageCapture && this->params->fixedPatternNoiseRemoval;
+	if (this->params->fixedPatternNoiseRemoval) {
+		this->fixedPatternNoiseRemoval(spectra, lineStride);
+		if (this->stageCapture) {
+			this->captureStage(CAPTURE_FIXED_PATTERN_NOISE_REMOVAL, spectra, lineStride, static_cast<int>(this->signalLength/2), lineStride != static_cast<int>(this->signalLength), 0, this->linesPerBuffer);
+		}
+		StageClock::time_point stageEnd = StageClock::now();
+		timings->record(STAGE_FIXED_PATTERN_NOISE, StageTimings::getMilliseconds(stageStart, stageEnd));
+		stageStart = stageEnd;
+	}
+
+	//get current buffer number in volume (a volume may consist of one or more buffers)
+	if (this->buffersPerVolume > 1) {
+		this->bufferNumberInVolume = (this->bufferNumberInVolume+1)%this->buffersPerVolume;
+	}
+	if (this->bufferNumberInVolume == 0) {
+		this->volumeRing.startVolume();
+	}
+
+	//get current position in processed volume buffer
+	unsigned char* currBuffer = &this->processedVolume[this->bytesPerVolumeSample*(this->samplesPerBuffer/2)*this->bufferNumberInVolume];
+	this->removeBufferFromDisplayProjections();
+	this->postFftProcessing(spectra, lineStride, currBuffer);
+	this->storeBufferInVolumeRing(currBuffer);
+	this->updateEnFaceVolume(currBuffer);
+	this->addBufferToDisplayProjections();
+	StageClock::time_point stageEnd = StageClock::now();
+	timings->record(STAGE_POST_PROCESSING, StageTimings::getMilliseconds(stageStart, stageEnd));
+	stageStart = stageEnd;
+
+	//update display buffers
+	if (this->params->bscanViewEnabled) {
+		this->updateBscanDisplayBuffer(this->params->frameNr, this->params->functionFramesBscan, this->params->displayFunctionBscan);
+	}
+	if (this->params->enFaceViewEnabled) {
+		this->updateEnFaceDisplayBuffer(this->params->frameNrEnFaceView, this->params->functionFramesEnFaceView, this->params->displayFunctionEnFaceView);
+	}
+	if (this->params->volumeViewEnabled) {
+		this->updateVolumeDisplayBuffer(currBuffer, this->bufferNumberInVolume);
+	}
+	if (this->params->bscanViewEnabled || this->params->enFaceViewEnabled || this->params->volumeViewEnabled) {
+		//the uploads of the display buffers happen on the processing thread and are added to the next buffer
+		stageEnd = StageClock::now();
+		double uploadMilliseconds = this->displayUploadNanoseconds.exchange(0)/1.0e6;
+		timings->record(STAGE_DISPLAY, StageTimings::getMilliseconds(stageStart, stageEnd) + uploadMilliseconds);
+	}
+
+	//Copy/Stream processed data to host continuously
+	if (this->params->streamToHost && !this->params->streamingParamsChanged) {
+		this->params->currentBufferNr = this->bufferNumberInVolume;
+		this->streamProcessedData(currBuffer);
+	}
+}
+
+void CpuProcessingBackend::rawDataToSpectra(CpuPipelineWorker* worker, const void* rawData, bool realInput, CpuComplex* spectraBuffer) {
+	//all steps up to the fft are done for a tile of linesPerFftBlock A-scans at a time, so that the intermediate results stay in the cache
+	//instead of passing the whole buffer through memory for every step. Every thread works with its own pair of tile buffers and takes the
+	//next unprocessed tile until all tiles of the buffer are done.
+	const int width = static_cast<int>(this->signalLength);
+	const size_t halfSpectrumLength = this->signalLength/2+1;
+	const unsigned int bitDepth = this->params->bitDepth;
+	const bool bitshift = this->params->bitshift;
+	const size_t bytesPerSample = InputConversion::getBytesPerSample(bitDepth);
+	const bool backgroundRemoval = this->params->backgroundRemoval;
+	const int windowSize = this->params->rollingAverageWindowSize;
+	const bool resampling = this->params->resampling;
+	const bool windowing = this->params->windowing;
+	const bool capture = this->stageCapture;
+	const size_t tiles = (this->linesPerBuffer + this->linesPerFftBlock - 1) / this->linesPerFftBlock;
+	std::atomic<size_t> nextTile(0);
+
+	//the steps of a tile are timed separately and summed over all tiles and threads
+	std::atomic<long long> conversionNanoseconds(0);
+	std::atomic<long long> resamplingNanoseconds(0);
+	std::atomic<long long> fftNanoseconds(0);
+
+	worker->threadPool->parallelFor(worker->threadPool->getThreadCount(), [&](size_t firstThread, size_t lastThread) {
+		for (size_t threadIndex = firstThread; threadIndex < lastThread; threadIndex++) {
+			StageClock::duration conversionTime(0);
+			StageClock::duration resamplingTime(0);
+			StageClock::duration fftTime(0);
+			size_t tile;
+			while ((tile = nextTile++) < tiles) {
+				StageClock::time_point stepStart = StageClock::now();
+				const size_t firstLine = tile*this->linesPerFftBlock;
+				const size_t lines = std::min(this->linesPerFftBlock, this->linesPerBuffer - firstLine);
+				const bool completeTile = lines == this->linesPerFftBlock;
+				float* signal = worker->tileBuffers[2*threadIndex];
+				float* tmp = worker->tileBuffers[2*threadIndex+1];
+
+				//convert input array to float array (simd implementation is selected at runtime)
+				const unsigned char* rawTile = static_cast<const unsigned char*>(rawData) + firstLine*this->signalLength*bytesPerSample;
+				InputConversion::inputToFloat(signal, rawTile, bitDepth, bitshift, 0, lines*this->signalLength);
+
+				//rolling average background subtraction
+				if (backgroundRemoval) {
+					CpuKernels::rollingAverageBackgroundRemoval(tmp, signal, windowSize, width, 0, lines);
+					std::swap(signal, tmp);
+				}
+				StageClock::time_point stepEnd = StageClock::now();
+				conversionTime += stepEnd-stepStart;
+				stepStart = stepEnd;
+
+				//k-linearization with precomputed tap positions and weights
+				if (resampling) {
+					this->resamplingPlan->apply(tmp, signal, 0, lines);
+					std::swap(signal, tmp);
+				}
+
+				//windowing
+				if (windowing) {
+					CpuKernels::windowing(signal, this->windowCurve, width, 0, lines);
+				}
+
+				//dispersion compensation and IFFT
+				if (realInput) {
+					stepEnd = StageClock::now();
+					resamplingTime += stepEnd-stepStart;
+					if (capture) {
+						std::complex<float>* captured = &this->capturedStages[CAPTURE_SPECTRA][firstLine*this->signalLength];
+						for (size_t i = 0; i < lines*this->signalLength; i++) {
+							captured[i] = std::complex<float>(signal[i], 0.0f);
+						}
+					}
+					fftwf_complex* spectra = reinterpret_cast<fftwf_complex*>(&spectraBuffer[firstLine*halfSpectrumLength]);
+					fftwf_execute_dft_r2c(completeTile ? this->realFftPlan : this->realFftPlanRemainder, signal, spectra);
+					if (capture) {
+						this->captureStage(CAPTURE_FFT, &spectraBuffer[firstLine*halfSpectrumLength], static_cast<int>(halfSpectrumLength), width/2, true, firstLine, lines);
+					}
+				} else {
+					CpuComplex* spectra = &spectraBuffer[firstLine*this->signalLength];
+					CpuKernels::realToComplexAndDispersionCompensation(spectra, signal, this->phaseCartesian, width, 0, lines);
+					stepEnd = StageClock::now();
+					resamplingTime += stepEnd-stepStart;
+					if (capture) {
+						this->captureStage(CAPTURE_SPECTRA, spectra, width, width, false, firstLine, lines);
+					}
+					fftwf_complex* fftData = reinterpret_cast<fftwf_complex*>(spectra);
+					fftwf_execute_dft(completeTile ? this->fftPlan : this->fftPlanRemainder, fftData, fftData);
+					if (capture) {
+						this->captureStage(CAPTURE_FFT, spectra, width, width/2, false, firstLine, lines);
+					}
+				}
+				fftTime += StageClock::now()-stepEnd;
+			}
+			conversionNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(conversionTime).count();
+			resamplingNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(resamplingTime).count();
+			fftNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(fftTime).count();
+		}
+	});
+
+	//the steps of all threads overlap, so the share of the wall time of every step is its summed thread time divided by the number of threads
+	StageTimings* timings = StageTimings::getInstance();
+	double nanosecondsPerMillisecond = 1.0e6*worker->threadPool->getThreadCount();
+	timings->record(STAGE_CONVERSION, conversionNanoseconds/nanosecondsPerMillisecond);
+	if (resampling || windowing || !realInput) {
+		timings->record(STAGE_RESAMPLING, resamplingNanoseconds/nanosecondsPerMillisecond);
+	}
+	timings->record(STAGE_FFT, fftNanoseconds/nanosecondsPerMillisecond);
+}
+
+bool CpuProcessingBackend::prepareComplexFft() {
+	if (this->fftPlan != nullptr) {
+		return true;
+	}
+
+	//enlarge fft buffers from half spectra to full spectra. process() has already waited for the pipeline, so no spectra buffer is in use
+	for (size_t i = 0; i < this->pipelineSlots.size(); i++) {
+		CpuComplex* fullSpectra = allocateBuffer<CpuComplex>(this->samplesPerBuffer);
+		if (fullSpectra == nullptr) {
+			return false;
+		}
+		freeBuffer(this->pipelineSlots[i].spectra);
+		this->pipelineSlots[i].spectra = fullSpectra;
+	}
+	this->fftBufferSize = this->samplesPerBuffer;
+
+	int remainingLines = static_cast<int>(this->linesPerBuffer % this->linesPerFftBlock);
+	this->fftPlan = this->getFftPlan(static_cast<int>(this->linesPerFftBlock), false);
+	if (remainingLines > 0) {
+		this->fftPlanRemainder = this->getFftPlan(remainingLines, false);
+	}
+	if (this->fftPlan == nullptr || (remainingLines > 0 && this->fftPlanRemainder == nullptr)) {
+		this->fftPlan = nullptr;
+		return false;
+	}
+	return true;
+}
+
+fftwf_plan CpuProcessingBackend::getFftPlan(int lines, bool realInput) {
+	FftPlanKey key;
+	key.signalLength = static_cast<int>(this->signalLength);
+	key.batch = lines;
+	key.precision = FFT_SINGLE;
+	key.direction = realInput ? FFTW_FORWARD : FFTW_BACKWARD;
+	key.inPlace = !realInput;
+	key.realInput = realInput;
+	return FftPlanCache::getInstance()->getPlan(key);
+}
+
+void CpuProcessingBackend::captureStage(CAPTURE_STAGE stage, const CpuComplex* data, int lineStride, int samplesPerLine, bool conjugate, size_t firstLine, size_t lines) {
+	//data points to the first of the lines A-scans, the captured A-scans start at firstLine. The r2c transform is a forward fft, see process()
+	const float sign = conjugate ? -1.0f : 1.0f;
+	for (size_t line = 0; line < lines; line++) {
+		const CpuComplex* in = &data[line*lineStride];
+		std::complex<float>* out = &this->capturedStages[stage][(firstLine+line)*samplesPerLine];
+		for (int i = 0; i < samplesPerLine; i++) {
+			out[i] = std::complex<float>(in[i].x, sign*in[i].y);
+		}
+	}
+}
+
+void CpuProcessingBackend::fixedPatternNoiseRemoval(CpuComplex* data, int lineStride) {
+	//just the first half of the mean A-scan is needed, because the second half gets truncated anyway
+	const int outputAscanLength = static_cast<int>(this->signalLength/2);
+	const int height = static_cast<int>(std::min((size_t)this->params->bscansForNoiseDetermination*this->ascansPerBscan, this->linesPerBuffer));
+	const int segments = std::max(1, std::min(FIXED_PATTERN_NOISE_REMOVAL_SEGMENTS, height));
+	const int segmentWidth = height / segments;
+	//in continuous mode all segments are determined again from every buffer, so the mean A-scan follows changes of the fixed-pattern noise immediately
+	if (!this->fixedPatternNoiseDetermined || this->params->continuousFixedPatternNoiseDetermination || this->params->redetermineFixedPatternNoise) {
+		this->noiseSegments = segments;
+		this->noiseSegmentWidth = segmentWidth;
+		this->updateNoiseSegments(data, lineStride);
+		this->fixedPatternNoiseDetermined = true;
+		this->params->redetermineFixedPatternNoise = false;
+	}
+	this->postFftThreadPool->parallelFor(this->linesPerBuffer, [&](size_t first, size_t last) {
+		CpuKernels::meanALineSubtraction(data, this->meanALine, lineStride, outputAscanLength, first, last);
+	});
+}
+
+void CpuProcessingBackend::updateNoiseSegments(const CpuComplex* data, int lineStride) {
+	//segments and depth ranges are distributed to the threads, then the segment with minimum variance is selected for every depth
+	const size_t outputAscanLength = this->signalLength/2;
+	const size_t count = (size_t)this->noiseSegments*outputAscanLength;
+	this->postFftThreadPool->parallelFor(count, [&](size_t first, size_t last) {
+		size_t pos = first;
+		while (pos < last) {
+			size_t segment = pos/outputAscanLength;
+			size_t firstSample = pos%outputAscanLength;
+			size_t lastSample = std::min(outputAscanLength, firstSample + (last-pos));
+			const CpuComplex* segmentData = &data[segment*this->noiseSegmentWidth*lineStride];
+			CpuKernels::getSegmentStatistics(&this->segmentStatistics[segment*outputAscanLength], segmentData, lineStride, this->noiseSegmentWidth, firstSample, lastSample);
+			pos += lastSample-firstSample;
+		}
+	}, 256);
+	this->postFftThreadPool->parallelFor(outputAscanLength, [&](size_t first, size_t last) {
+		CpuKernels::getMinimumVarianceMean(this->meanALine, this->segmentStatistics, static_cast<int>(outputAscanLength), this->noiseSegments, first, last);
+	}, 256);
+}
+
+const CpuLineGather* CpuProcessingBackend::updateLineGather() {
+	const bool bscanFlip = this->params->bscanFlip;
+	const bool sinusoidalScanCorrection = this->params->sinusoidalScanCorrection;
+	if (!bscanFlip && !sinusoidalScanCorrection) {
+		return nullptr;
+	}
+	int mode = (bscanFlip ? 1 : 0) | (sinusoidalScanCorrection ? 2 : 0);
+	if (mode != this->lineGatherMode) {
+		CpuKernels::fillLineGather(this->lineGather, sinusoidalScanCorrection ? this->sinusoidalResampleCurve : nullptr, this->ascansPerBscan, this->linesPerBuffer, bscanFlip);
+		this->lineGatherMode = mode;
+	}
+	return this->lineGather;
+}
+
+void CpuProcessingBackend::postFftProcessing(const CpuComplex* data, int lineStride, void* currBuffer) {
+	const int outputAscanLength = static_cast<int>(this->signalLength/2);
+
+	//truncate contains: Mirror artefact removal, Log, Magnitude, Copy to output buffer, flip of every second bscan and sinusoidal scan correction.
+	const float max = this->params->signalGrayscaleMax;
+	const float min = this->params->signalGrayscaleMin;
+	const float addend = this->params->signalAddend;
+	const float coeff = this->params->signalMultiplicator;
+	const LOG_ACCURACY logAccuracy = this->params->logAccuracy;
+	const CpuLineGather* lineGather = this->updateLineGather();
+	if (this->params->signalLogScaling) {
+		this->postFftThreadPool->parallelFor(this->linesPerBuffer, [&](size_t first, size_t last) {
+			CpuKernels::postProcessTruncateLog(currBuffer, this->volumeStorage, data, lineStride, outputAscanLength, max, min, addend, coeff, logAccuracy, lineGather, first, last);
+		});
+	} else {
+		this->postFftThreadPool->parallelFor(this->linesPerBuffer, [&](size_t first, size_t last) {
+			CpuKernels::postProcessTruncateLin(currBuffer, this->volumeStorage, data, lineStride, outputAscanLength, max, min, addend, coeff, lineGather, first, last);
+		});
+	}
+
+	//post process background removal
+	if (this->params->postProcessBackgroundRemoval) {
+		if (this->params->postProcessBackgroundRecordingRequested) {
+			CpuKernels::getPostProcessBackground(this->postProcBackgroundLine, currBuffer, this->volumeStorage, outputAscanLength, this->ascansPerBscan);
+			if (this->params->postProcessBackground != nullptr) {
+				memcpy(this->params->postProcessBackground, this->postProcBackgroundLine, sizeof(float)*outputAscanLength);
+				Gpu2HostNotifier::backgroundSignalCallback(this->params->postProcessBackground);
+			}
+			this->params->postProcessBackgroundRecordingRequested = false;
+		}
+		if (this->params->postProcessBackgroundUpdated) {
+			if (this->params->postProcessBackground != nullptr) {
+				memcpy(this->postProcBackgroundLine, this->params->postProcessBackground, sizeof(float)*outputAscanLength);
+			}
+			this->params->postProcessBackgroundUpdated = false;
+		}
+		const float weight = this->params->postProcessBackgroundWeight;
+		const float offset = this->params->postProcessBackgroundOffset;
+		this->postFftThreadPool->parallelFor(this->linesPerBuffer, [&](size_t first, size_t last) {
+			CpuKernels::postProcessBackgroundRemoval(currBuffer, this->volumeStorage, this->postProcBackgroundLine, weight, offset, outputAscanLength, first, last);
+		});
+	}
+}
+
+void CpuProcessingBackend::updateEnFaceVolume(const void* currBuffer) {
+	//the en face view reads one sample of every A-scan. In processedVolume these samples are signalLength/2 samples apart, in the depth-major copy they are contiguous
+	if (!this->params->enFaceViewEnabled) {
+		freeBuffer(this->enFaceVolume);
+		this->enFaceVolumeValid = false;
+		return;
+	}
+	if (this->enFaceVolume == nullptr) {
+		this->enFaceVolume = allocateBuffer<unsigned char>(this->bytesPerVolumeSample*(this->samplesPerVolume/2));
+		this->enFaceVolumeValid = false;
+		if (this->enFaceVolume == nullptr) {
+			return; //not enough memory, the en face view falls back to processedVolume
+		}
+	}
+	size_t samplesPerAscan = this->signalLength/2;
+	size_t linesPerVolume = this->linesPerBuffer*this->buffersPerVolume;
+	if (this->enFaceVolumeValid) {
+		size_t firstLine = this->bufferNumberInVolume*this->linesPerBuffer;
+		this->postFftThreadPool->parallelFor(samplesPerAscan, [&](size_t first, size_t last) {
+			CpuKernels::transposeToEnFace(this->enFaceVolume, currBuffer, this->volumeStorage, samplesPerAscan, linesPerVolume, firstLine, this->linesPerBuffer, first, last);
+		}, 32);
+	} else {
+		//the view has just been enabled: copy the whole volume once
+		this->postFftThreadPool->parallelFor(samplesPerAscan, [&](size_t first, size_t last) {
+			CpuKernels::transposeToEnFace(this->enFaceVolume, this->processedVolume, this->volumeStorage, samplesPerAscan, linesPerVolume, 0, linesPerVolume, first, last);
+		}, 32);
+		this->enFaceVolumeValid = true;
+	}
+}
+
+void CpuProcessingBackend::storeBufferInVolumeRing(const void* currBuffer) {
+	if (!this->volumeRing.isEnabled()) {
+		return;
+	}
+	size_t bytesPerProcessedBuffer = this->bytesPerVolumeSample*(this->samplesPerBuffer/2);
+	unsigned char* destination = &this->volumeRingBuffer[this->volumeRing.getCurrentVolumeOffset() + bytesPerProcessedBuffer*this->bufferNumberInVolume];
+	const unsigned char* source = static_cast<const unsigned char*>(currBuffer);
+	this->postFftThreadPool->parallelFor(bytesPerProcessedBuffer, [&](size_t first, size_t last) {
+		memcpy(&destination[first], &source[first], last-first);
+	}, 65536);
+}
+
+const void* CpuProcessingBackend::getVolumeFromRing(unsigned int volumesAgo) const {
+	size_t offset = 0;
+	if (!this->volumeRing.getVolumeOffset(volumesAgo, offset)) {
+		return nullptr;
+	}
+	return &this->volumeRingBuffer[offset];
+}
+
+const void* CpuProcessingBackend::getEnFaceSource(size_t& pixelStride, size_t& frameStride) const {
+	if (this->enFaceVolumeValid) {
+		pixelStride = 1;
+		frameStride = this->linesPerBuffer*this->buffersPerVolume;
+		return this->enFaceVolume;
+	}
+	pixelStride = this->signalLength/2;
+	frameStride = 1;
+	return this->processedVolume;
+}
+
+void CpuProcessingBackend::removeBufferFromDisplayProjections() {
+	//the running sums need the old values of the frames that are overwritten by the current buffer.
+	//B-scan view: the buffer replaces bscansPerBuffer frames of every pixel. En face view: the buffer replaces all frames of linesPerBuffer pixels
+	if (!this->params->bscanViewEnabled) {
+		this->bscanProjectionWindow.invalidate();
+	}
+	if (!this->params->enFaceViewEnabled) {
+		this->enFaceProjectionWindow.invalidate();
+	}
+	size_t bscanPixels = this->signalLength*this->ascansPerBscan/2;
+	size_t ascanLength = this->signalLength/2;
+	unsigned int firstBscan = this->bufferNumberInVolume*this->bscansPerBuffer;
+	unsigned int lastBscan = firstBscan + this->bscansPerBuffer;
+	size_t firstLine = this->bufferNumberInVolume*this->linesPerBuffer;
+	if (this->bscanProjectionWindow.overlaps(firstBscan, lastBscan)) {
+		this->postFftThreadPool->parallelFor(bscanPixels, [&](size_t first, size_t last) {
+			CpuKernels::removeDisplayProjectionFrames(this->bscanProjection, this->processedVolume, this->volumeStorage, 1, bscanPixels, this->bscanProjectionWindow, firstBscan, lastBscan, first, last);
+		}, 1024);
+	}
+	if (this->enFaceProjectionWindow.valid) {
+		size_t pixelStride, frameStride;
+		const void* enFaceSource = this->getEnFaceSource(pixelStride, frameStride);
+		this->postFftThreadPool->parallelFor(this->linesPerBuffer, [&](size_t first, size_t last) {
+			CpuKernels::removeDisplayProjectionFrames(this->enFaceProjection, enFaceSource, this->volumeStorage, pixelStride, frameStride, this->enFaceProjectionWindow, 0, ascanLength, firstLine+first, firstLine+last);
+		}, 64);
+	}
+}
+
+void CpuProcessingBackend::addBufferToDisplayProjections() {
+	size_t bscanPixels = this->signalLength*this->ascansPerBscan/2;
+	size_t ascanLength = this->signalLength/2;
+	unsigned int firstBscan = this->bufferNumberInVolume*this->bscansPerBuffer;
+	unsigned int lastBscan = firstBscan + this->bscansPerBuffer;
+	size_t firstLine = this->bufferNumberInVolume*this->linesPerBuffer;
+	if (this->bscanProjectionWindow.overlaps(firstBscan, lastBscan)) {
+		this->postFftThreadPool->parallelFor(bscanPixels, [&](size_t first, size_t last) {
+			CpuKernels::addDisplayProjectionFrames(this->bscanProjection, this->processedVolume, this->volumeStorage, 1, bscanPixels, this->bscanProjectionWindow, firstBscan, lastBscan, first, last);
+		}, 1024);
+	}
+	if (this->enFaceProjectionWindow.valid) {
+		size_t pixelStride, frameStride;
+		const void* enFaceSource = this->getEnFaceSource(pixelStride, frameStride);
+		this->postFftThreadPool->parallelFor(this->linesPerBuffer, [&](size_t first, size_t last) {
+			CpuKernels::addDisplayProjectionFrames(this->enFaceProjection, enFaceSource, this->volumeStorage, pixelStride, frameStride, this->enFaceProjectionWindow, 0, ascanLength, firstLine+first, firstLine+last);
+		}, 64);
+	}
+}
+
+void CpuProcessingBackend::updateBscanDisplayBuffer(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
+	if (this->glBufferBscan == 0) {
+		this->bscanProjectionWindow.invalidate();
+		return;
+	}
+	unsigned int depth = this->bscansPerBuffer*this->buffersPerVolume;
+	unsigned int samplesPerFrame = this->signalLength*this->ascansPerBscan/2;
+	frameNr = frameNr < depth ? frameNr : 0;
+	const void* volume = this->getVolumeFromRing(this->params->displayedVolumeAge);
+	if (volume != nullptr) {
+		//the running projection state belongs to processedVolume, volumes of the ring are projected from scratch
+		this->bscanProjectionWindow.invalidate();
+	}
+	const DisplayProjectionWindow* window = this->bscanProjectionWindow.setWindow(frameNr, displayFunctionFrames, displayFunction, depth) ? &this->bscanProjectionWindow : nullptr;
+	{
+		std::lock_guard<std::mutex> displayLock(this->displayMutex);
+		const void* source = volume != nullptr ? volume : this->processedVolume;
+		this->postFftThreadPool->parallelFor(samplesPerFrame, [&](size_t first, size_t last) {
+			CpuKernels::updateDisplayProjection(this->bscanDisplayBuffer, this->bscanProjection, source, this->volumeStorage, samplesPerFrame, 1, samplesPerFrame, frameNr, window, first, last);
+		}, 1024);
+	}
+	if (volume != nullptr) {
+		this->bscanProjectionWindow.invalidate();
+	}
+	this->setPendingDisplayUpdates(CPU_PENDING_BSCAN_UPDATE);
+}
+
+void CpuProcessingBackend::updateEnFaceDisplayBuffer(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
+	if (this->glBufferEnFaceView == 0) {
+		this->enFaceProjectionWindow.invalidate();
+		return;
+	}
+	unsigned int frameWidth = this->signalLength/2;
+	unsigned int samplesPerFrame = this->bscansPerBuffer*this->buffersPerVolume*this->ascansPerBscan;
+	frameNr = frameNr < frameWidth ? frameNr : 0;
+	size_t pixelStride, frameStride;
+	const void* enFaceSource = this->getEnFaceSource(pixelStride, frameStride);
+	const void* volume = this->getVolumeFromRing(this->params->displayedVolumeAge);
+	if (volume != nullptr) {
+		this->enFaceProjectionWindow.invalidate();
+		enFaceSource = volume;
+		pixelStride = this->signalLength/2;
+		frameStride = 1;
+	}
+	const DisplayProjectionWindow* window = this->enFaceProjectionWindow.setWindow(frameNr, displayFunctionFrames, displayFunction, frameWidth) ? &this->enFaceProjectionWindow : nullptr;
+	{
+		std::lock_guard<std::mutex> displayLock(this->displayMutex);
+		this->postFftThreadPool->parallelFor(samplesPerFrame, [&](size_t first, size_t last) {
+			CpuKernels::updateDisplayProjection(this->enFaceDisplayBuffer, this->enFaceProjection, enFaceSource, this->volumeStorage, samplesPerFrame, pixelStride, frameStride, frameNr, window, first, last);
+		}, 1024);
+	}
+	if (volume != nullptr) {
+		this->enFaceProjectionWindow.invalidate();
+	}
+	this->setPendingDisplayUpdates(CPU_PENDING_ENFACE_UPDATE);
+}
+
+void CpuProcessingBackend::updateVolumeDisplayBuffer(const void* currBuffer, unsigned int currentBufferNr) {
+	if (this->glTextureVolumeView == 0) {
+		return;
+	}
+
+	//the display buffer holds a single buffer of the volume, so the previous one has to be uploaded before it is overwritten
+	{
+		std::unique_lock<std::mutex> lock(this->pipelineMutex);
+		this->pipelineCondition.wait(lock, [this]{ return (this->pendingDisplayUpdates & CPU_PENDING_VOLUME_UPDATE) == 0; });
+	}
+
+	unsigned int samplesPerAscan = this->signalLength/2;
+	unsigned int lines = this->linesPerBuffer;
+	{
+		std::lock_guard<std::mutex> displayLock(this->displayMutex);
+		this->postFftThreadPool->parallelFor(samplesPerAscan, [&](size_t first, size_t last) {
+			CpuKernels::updateDisplayedVolume(this->volumeDisplayBuffer, currBuffer, this->volumeStorage, samplesPerAscan, lines, first, last);
+		}, 8);
+		this->volumeDisplayBufferNumber = currentBufferNr;
+	}
+	this->setPendingDisplayUpdates(CPU_PENDING_VOLUME_UPDATE);
+}
+
+void CpuProcessingBackend::uploadVolumeDisplayBuffer() {
+	QOpenGLContext* context = QOpenGLContext::currentContext();
+	if (this->glTextureVolumeView == 0 || context == nullptr) {
+		return;
+	}
+
+	//texture dimensions: x = A-scans per B-scan, y = B-scans per volume, z = samples per A-scan
+	unsigned int samplesPerAscan = this->signalLength/2;
+	QOpenGLFunctions* gl = context->functions();
+	QOpenGLExtraFunctions* glExtra = context->extraFunctions();
+	gl->glBindTexture(GL_TEXTURE_3D, this->glTextureVolumeView);
+	gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glExtra->glTexSubImage3D(GL_TEXTURE_3D, 0, 0, this->volumeDisplayBufferNumber*this->bscansPerBuffer, 0, this->ascansPerBscan, this->bscansPerBuffer, samplesPerAscan, GL_RED, GL_UNSIGNED_BYTE, this->volumeDisplayBuffer);
+	gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	gl->glBindTexture(GL_TEXTURE_3D, 0);
+	gl->glFlush();
+}
+
+void CpuProcessingBackend::uploadToGlBuffer(unsigned int buf, const void* data, size_t bytes) {
+	QOpenGLContext* context = QOpenGLContext::currentContext();
+	if (context == nullptr) {
+		return;
+	}
+	QOpenGLFunctions* gl = context->functions();
+	gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buf);
+	gl->glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, bytes, data);
+	gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	gl->glFlush();
+}
+
+void CpuProcessingBackend::streamProcessedData(const void* currBuffer) {
+	if (this->streamedBuffers % (this->params->streamingBuffersToSkip + 1) == 0) {
+		this->streamedBuffers = 0; //set to zero to avoid overflow
+		this->streamingBufferNumber = (this->streamingBufferNumber + 1) % 2;
+		void* hostDestBuffer = this->streamingBufferNumber == 0 ? this->host_streamingBuffer1 : this->host_streamingBuffer2;
+		if (hostDestBuffer != nullptr) {
+			StageClock::time_point stageStart = StageClock::now();
+			const unsigned int bitDepth = this->params->bitDepth;
+			this->postFftThreadPool->parallelFor(this->samplesPerBuffer/2, [&](size_t first, size_t last) {
+				CpuKernels::floatToOutput(hostDestBuffer, currBuffer, this->volumeStorage, bitDepth, first, last);
+			}, 4096);
+			Gpu2HostNotifier::dh2StreamingCallback(hostDestBuffer);
+			StageTimings::getInstance()->record(STAGE_STREAMING, StageTimings::getMilliseconds(stageStart, StageClock::now()));
+		}
+	}
+	this->streamedBuffers++;
+}
+
+//display buffers, projections and streaming buffers are used by the post-fft stage, so the pipeline is drained before they are touched here
+void CpuProcessingBackend::changeDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
+	if (this->initialized) {
+		this->waitForPipeline(0);
+		this->updateBscanDisplayBuffer(frameNr, displayFunctionFrames, displayFunction);
+		this->uploadPendingDisplayUpdates();
+	}
+}
+
+void CpuProcessingBackend::changeDisplayedEnFaceFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
+	if (this->initialized) {
+		this->waitForPipeline(0);
+		this->updateEnFaceDisplayBuffer(frameNr, displayFunctionFrames, displayFunction);
+		this->uploadPendingDisplayUpdates();
+	}
+}
+
+void CpuProcessingBackend::setStageCapture(bool enabled) {
+	this->waitForPipeline(0);
+	this->stageCapture = enabled;
+	std::fill(this->stageCaptured, this->stageCaptured+NUMBER_OF_CAPTURE_STAGES, false);
+}
+
+bool CpuProcessingBackend::getCapturedStage(CAPTURE_STAGE stage, std::vector<std::complex<float> >& samples) {
+	if (stage < 0 || stage >= NUMBER_OF_CAPTURE_STAGES || !this->stageCaptured[stage]) {
+		return false;
+	}
+	samples = this->capturedStages[stage];
+	return true;
+}
+
+unsigned int CpuProcessingBackend::getCompleteVolumesInRing() {
+	this->waitForPipeline(0);
+	return this->volumeRing.getCompleteVolumes();
+}
+
+bool CpuProcessingBackend::copyBscanFromVolumeRing(unsigned int volumesAgo, unsigned int bscanNr, void* output) {
+	if (!this->initialized || output == nullptr || bscanNr >= this->bscansPerBuffer*this->buffersPerVolume) {
+		return false;
+	}
+	this->waitForPipeline(0);
+	const unsigned char* volume = static_cast<const unsigned char*>(this->getVolumeFromRing(volumesAgo));
+	if (volume == nullptr) {
+		return false;
+	}
+	size_t samplesPerBscan = this->ascansPerBscan*(this->signalLength/2);
+	const unsigned char* bscan = &volume[this->bytesPerVolumeSample*samplesPerBscan*bscanNr];
+	const unsigned int bitDepth = this->params->bitDepth;
+	this->postFftThreadPool->parallelFor(samplesPerBscan, [&](size_t first, size_t last) {
+		CpuKernels::floatToOutput(output, bscan, this->volumeStorage, bitDepth, first, last);
+	}, 4096);
+	return true;
+}
+
+void CpuProcessingBackend::registerGlBufferBscan(unsigned int buf) {
+	this->waitForPipeline(0);
+	this->glBufferBscan = buf;
+}
+
+void CpuProcessingBackend::registerGlBufferEnFaceView(unsigned int buf) {
+	this->waitForPipeline(0);
+	this->glBufferEnFaceView = buf;
+}
+
+void CpuProcessingBackend::registerGlBufferVolumeView(unsigned int buf) {
+	this->waitForPipeline(0);
+	this->glTextureVolumeView = buf;
+}
+
+void CpuProcessingBackend::registerStreamingBuffers(void* h_streamingBuffer1, void* h_streamingBuffer2, size_t bytesPerBuffer) {
+	(void)bytesPerBuffer;
+	this->waitForPipeline(0);
+	this->host_streamingBuffer1 = h_streamingBuffer1;
+	this->host_streamingBuffer2 = h_streamingBuffer2;
+}
+
+void CpuProcessingBackend::unregisterStreamingBuffers() {
+	this->waitForPipeline(0);
+	this->host_streamingBuffer1 = nullptr;
+	this->host_streamingBuffer2 = nullptr;
+}
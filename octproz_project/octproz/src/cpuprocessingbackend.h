@@ -0,0 +1,230 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef CPUPROCESSINGBACKEND_H
+#define CPUPROCESSINGBACKEND_H
+
+#include "processingbackend.h"
+#include "cpukernels.h"
+#include "inputconversion.h"
+#include "resamplingplan.h"
+#include "fftplancache.h"
+#include "threadpool.h"
+#include "volumering.h"
+#include <fftw3.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define CPU_FFT_LINES_PER_BLOCK 16
+#define CPU_FFT_LINES_ALIGNMENT 4 ///A-scans per tile are a multiple of this, so every tile of the fft buffers starts 32 byte aligned for any line stride, as the cached fft plans require
+#define CPU_MAX_BUFFERS_IN_FLIGHT 8
+#define CPU_MAX_PIPELINE_WORKERS 16
+
+#define CPU_PENDING_BSCAN_UPDATE 1
+#define CPU_PENDING_ENFACE_UPDATE 2
+#define CPU_PENDING_VOLUME_UPDATE 4
+
+struct CpuPipelineSlot {
+	unsigned char* rawData; ///copy of the acquisition buffer. Only allocated if there is more than one worker, otherwise the acquisition buffer is converted right away
+	CpuComplex* spectra; ///half spectra of the real-to-complex fft. Full spectra are only needed (and allocated) if dispersion compensation is used
+	int lineStride;
+	bool realInput;
+	bool spectraReady; ///set when conversion and fft are done. The post-fft stage takes the slots in the order in which they were submitted
+};
+
+//conversion and fft of whole buffers. Every worker has its own threads and tile buffers, so several buffers can be transformed at the same time
+struct CpuPipelineWorker {
+	ThreadPool* threadPool;
+	std::vector<float*> tileBuffers; ///two buffers of linesPerFftBlock A-scans for every thread. All steps before the fft are done within these buffers
+	std::deque<unsigned int> slots; ///submitted slots that have not been transformed yet
+	std::thread thread;
+};
+
+
+//multithreaded host implementation of the processing pipeline of cuda_code.cu. It is used if no cuda capable gpu is available or if it is selected in the sidebar.
+//With more than one buffer in flight processing is split into two stages: conversion up to the fft runs on the processing thread, everything after the fft
+//(fixed-pattern noise removal, truncation, display and streaming) runs on a pipeline thread with its own thread pool while the next buffer is transformed.
+//With more than one pipeline worker the processing thread only copies the acquisition buffer and the workers transform whole buffers round-robin.
+//The post-fft stage always releases the buffers in acquisition order. OpenGL uploads always happen on the processing thread, which is the only thread
+//with the shared context.
+class CpuProcessingBackend : public ProcessingBackend
+{
+public:
+	CpuProcessingBackend(unsigned int numberOfThreads = 0);
+	~CpuProcessingBackend();
+
+	const char* getName() const override { return "CPU"; }
+	std::string getDeviceName() const override;
+	bool init(void** h_buffers, unsigned int bufferCount, OctAlgorithmParameters* params) override;
+	bool process(void* h_inputSignal) override;
+	std::string getLastError() const override { return this->lastError; }
+	void synchronize() override;
+	void cleanup() override;
+
+	bool hasPendingDisplayUpdates() override;
+	void uploadPendingDisplayUpdates() override;
+	void setDisplayUpdateNotifier(const std::function<void()>& notifier) override;
+
+	void changeDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) override;
+	void changeDisplayedEnFaceFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) override;
+
+	void registerGlBufferBscan(unsigned int buf) override;
+	void registerGlBufferEnFaceView(unsigned int buf) override;
+	void registerGlBufferVolumeView(unsigned int buf) override;
+
+	void registerStreamingBuffers(void* h_streamingBuffer1, void* h_streamingBuffer2, size_t bytesPerBuffer) override;
+	void unregisterStreamingBuffers() override;
+
+	void setStageCapture(bool enabled) override;
+	bool getCapturedStage(CAPTURE_STAGE stage, std::vector<std::complex<float> >& samples) override;
+
+	unsigned int getCompleteVolumesInRing() override;
+	bool copyBscanFromVolumeRing(unsigned int volumesAgo, unsigned int bscanNr, void* output) override;
+
+	unsigned int getThreadCount() const { return this->threadPool->getThreadCount(); }
+	const void* getProcessedVolume() const { return this->processedVolume; } ///call synchronize() first if buffers may still be in flight. Samples are stored as getVolumeStorage()
+	VOLUME_STORAGE getVolumeStorage() const { return this->volumeStorage; }
+
+
+private:
+	void startPipeline();
+	void stopPipeline();
+	void pipelineLoop();
+	void workerLoop(CpuPipelineWorker* worker);
+	void waitForPipeline(unsigned int maxJobsInFlight); ///blocks until at most maxJobsInFlight buffers are in the post-fft stage. Display updates that become ready meanwhile are uploaded
+	void postFftStage(CpuComplex* spectra, int lineStride);
+	void setPendingDisplayUpdates(int updates);
+	bool curvesChanged() const;
+	void updateCurves();
+	void rawDataToSpectra(CpuPipelineWorker* worker, const void* rawData, bool realInput, CpuComplex* spectra);
+	bool prepareComplexFft();
+	fftwf_plan getFftPlan(int lines, bool realInput);
+	void captureStage(CAPTURE_STAGE stage, const CpuComplex* data, int lineStride, int samplesPerLine, bool conjugate, size_t firstLine, size_t lines); ///copies samplesPerLine samples of every A-scan to capturedStages[stage]
+	void fixedPatternNoiseRemoval(CpuComplex* data, int lineStride);
+	void updateNoiseSegments(const CpuComplex* data, int lineStride); ///statistics of noiseSegments segments of noiseSegmentWidth A-scans and their minimum variance mean
+	const CpuLineGather* updateLineGather();
+	void postFftProcessing(const CpuComplex* data, int lineStride, void* currBuffer);
+	void updateEnFaceVolume(const void* currBuffer);
+	void storeBufferInVolumeRing(const void* currBuffer);
+	const void* getVolumeFromRing(unsigned int volumesAgo) const; ///nullptr if the volume is not in the ring
+	const void* getEnFaceSource(size_t& pixelStride, size_t& frameStride) const; ///enFaceVolume if it is up to date, processedVolume otherwise
+	void removeBufferFromDisplayProjections();
+	void addBufferToDisplayProjections();
+	void updateBscanDisplayBuffer(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction);
+	void updateEnFaceDisplayBuffer(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction);
+	void updateVolumeDisplayBuffer(const void* currBuffer, unsigned int currentBufferNr);
+	void uploadVolumeDisplayBuffer();
+	void streamProcessedData(const void* currBuffer);
+	void uploadToGlBuffer(unsigned int buf, const void* data, size_t bytes);
+
+	ThreadPool* threadPool;
+	ThreadPool* postFftThreadPool; ///used for all steps after the fft. This is threadPool if only one buffer is in flight
+	OctAlgorithmParameters* params;
+	bool initialized;
+	std::string lastError;
+
+	size_t signalLength;
+	size_t ascansPerBscan;
+	size_t bscansPerBuffer;
+	size_t buffersPerVolume;
+	size_t linesPerBuffer;
+	size_t samplesPerBuffer;
+	size_t samplesPerVolume;
+	unsigned int bufferNumberInVolume;
+	unsigned int streamingBufferNumber;
+	unsigned int streamedBuffers;
+	bool fixedPatternNoiseDetermined;
+
+	std::vector<CpuPipelineWorker*> pipelineWorkers; ///the first worker uses threadPool and runs on the processing thread if there is only one
+	std::vector<CpuPipelineSlot> pipelineSlots; ///one slot for every buffer in flight
+	unsigned int nextPipelineSlot;
+	unsigned int nextPipelineWorker;
+	size_t bytesPerBuffer;
+	size_t fftBufferSize;
+	VOLUME_STORAGE volumeStorage;
+	size_t bytesPerVolumeSample;
+	unsigned char* processedVolume; ///samples of type volumeStorage
+	unsigned char* enFaceVolume; ///depth-major copy of processedVolume (enFaceVolume[depth*linesPerVolume + line]) that is kept while the en face view is enabled, so that en face frames are contiguous
+	bool enFaceVolumeValid;
+	VolumeRing volumeRing;
+	unsigned char* volumeRingBuffer; ///volumeRing.volumes volumes with samples of type volumeStorage
+	float* resampleCurve;
+	ResamplingPlan* resamplingPlan;
+	float* windowCurve;
+	float* dispersionCurve;
+	float* sinusoidalResampleCurve;
+	CpuLineGather* lineGather; ///source A-scans for bscan flip and sinusoidal scan correction, which are both done during truncation
+	int lineGatherMode; ///bscan flip and sinusoidal scan correction flags lineGather was filled for, -1 if not filled yet
+	CpuComplex* phaseCartesian;
+	CpuComplex* meanALine;
+	CpuSegmentStatistics* segmentStatistics; ///FIXED_PATTERN_NOISE_REMOVAL_SEGMENTS x signalLength/2
+	int noiseSegments;
+	int noiseSegmentWidth;
+	float* postProcBackgroundLine;
+	float* bscanDisplayBuffer;
+	float* enFaceDisplayBuffer;
+	unsigned char* volumeDisplayBuffer;
+	DisplayProjectionPixel* bscanProjection; ///running sum or maximum of every B-scan view pixel for averaging and MIP, see displayprojection.h
+	DisplayProjectionPixel* enFaceProjection;
+	DisplayProjectionWindow bscanProjectionWindow;
+	DisplayProjectionWindow enFaceProjectionWindow;
+
+	fftwf_plan fftPlan;
+	fftwf_plan fftPlanRemainder;
+	fftwf_plan realFftPlan;
+	fftwf_plan realFftPlanRemainder;
+	size_t linesPerFftBlock;
+	bool realInputFft;
+
+	unsigned int buffersInFlight;
+	std::thread pipelineThread;
+	std::mutex pipelineMutex; ///guards the worker queues, CpuPipelineSlot::spectraReady, jobsInFlight, pipelineStopRequested and pendingDisplayUpdates
+	std::condition_variable pipelineCondition;
+	unsigned int jobsInFlight; ///buffers that have been submitted and are not finished yet
+	bool pipelineStopRequested;
+	std::mutex displayMutex; ///display buffers are filled by the post-fft stage and uploaded by the processing thread
+	int pendingDisplayUpdates; ///CPU_PENDING_..._UPDATE flags of display buffers that are filled but not uploaded yet
+	std::function<void()> displayUpdateNotifier; ///see ProcessingBackend::setDisplayUpdateNotifier(). Called by the post-fft stage after pendingDisplayUpdates has been set
+	std::atomic<long long> displayUploadNanoseconds; ///time of the OpenGL uploads since the last display stage timing, see StageTimings
+	unsigned int volumeDisplayBufferNumber;
+
+	bool stageCapture; ///see ProcessingBackend::setStageCapture()
+	bool stageCaptured[NUMBER_OF_CAPTURE_STAGES];
+	std::vector<std::complex<float> > capturedStages[NUMBER_OF_CAPTURE_STAGES]; ///written by the tiles of rawDataToSpectra() and by the post-fft stage
+
+	unsigned int glBufferBscan;
+	unsigned int glBufferEnFaceView;
+	unsigned int glTextureVolumeView;
+	void* host_streamingBuffer1;
+	void* host_streamingBuffer2;
+};
+
+#endif // CPUPROCESSINGBACKEND_H
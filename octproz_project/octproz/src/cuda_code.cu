@@ -29,10 +29,25 @@
 #define CUDA_CODE_CU
 
 #include "kernels.h"
-
-#define EIGHT_OVER_PI_SQUARED 0.8105694691f
-#define PI_OVER_8 0.3926990817f
-#define PI 3.141592654f
+#include "cpukernels.h"
+#include "displayprojection.h"
+#include "volumering.h"
+#include "stagetimings.h"
+#include "resamplingplan.h"
+#include "processingbackend.h"
+
+#define FFT_PLAN_CACHE_SIZE 4
+#define ROLLING_AVERAGE_BLOCK_SIZE 256
+#define ROLLING_AVERAGE_MAX_SHARED_MEMORY 49152 //default limit of dynamic and static shared memory per block
+#define TRANSPOSE_TILE_DIM 32
+#define TRANSPOSE_BLOCK_ROWS 8
+#define MAX_BUFFERS_IN_FLIGHT 8
+#define STAGE_EVENT_SETS (2*MAX_BUFFERS_IN_FLIGHT)
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <tuple>
 
 
 int blockSize;
@@ -46,29 +61,56 @@ surface<void, cudaSurfaceType3D> surfaceWrite;
 
 cudaStream_t stream[nStreams];
 cudaStream_t userRequestStream;
-
-cudaEvent_t syncEvent;
+cudaStream_t copyStream; ///host to device copies of raw data, so that the upload of the next buffer overlaps with processing of the current one
+
+//every buffer in flight uses one pipeline slot with its own device input buffer. The events order the stages of consecutive buffers:
+//upload(n) waits until processing(n-buffersInFlight) has read the input buffer of the slot, processing(n) waits for upload(n) and processing(n-1),
+//and post-processing(n) waits for output(n-1), since the processed volume, the en face copy and the display projections are shared by all buffers
+struct PipelineSlot {
+	cudaEvent_t uploadDone;
+	cudaEvent_t processingDone;
+	cudaEvent_t outputDone;
+};
+PipelineSlot pipelineSlots[MAX_BUFFERS_IN_FLIGHT];
+int buffersInFlight = 1;
+
+//per-stage timing (see StageTimings). Every buffer records start and end events of its stages in the next event set. The sets are read
+//without blocking as soon as they are complete, a set that is still pending when it is reused STAGE_EVENT_SETS buffers later is waited for
+struct StageEventSet {
+	cudaEvent_t start[NUMBER_OF_PROCESSING_STAGES];
+	cudaEvent_t end[NUMBER_OF_PROCESSING_STAGES];
+	bool stageUsed[NUMBER_OF_PROCESSING_STAGES];
+	int lastStage;
+	bool pending;
+};
+StageEventSet stageEventSets[STAGE_EVENT_SETS];
+int nextStageEventSet = 0;
+int oldestStageEventSet = 0;
 
 cudaGraphicsResource* cuBufHandleBscan = NULL;
 cudaGraphicsResource* cuBufHandleEnFaceView = NULL;
 cudaGraphicsResource* cuBufHandleVolumeView = NULL;
 
-const int nBuffers = 1;
 int currBuffer = 0;
-void* d_inputBuffer[nBuffers];
+void* d_inputBuffer[MAX_BUFFERS_IN_FLIGHT];
 void* d_outputBuffer;
 
-void* host_buffer1 = NULL;
-void* host_buffer2 = NULL;
+std::vector<void*> hostBuffers; ///acquisition buffers that are registered with cuda, so that their uploads are real asynchronous copies
 void* host_RecordBuffer = NULL;
 void* host_streamingBuffer1;
 void* host_streamingBuffer2;
 
 cufftComplex* d_inputLinearized;
 float* d_windowCurve= NULL;
-float* d_resampleCurve = NULL;
+std::vector<float> h_resampleCurve; ///host copy of the last resample curve, resamplingPlan is rebuilt from it if only the interpolation changes
+ResamplingPlan resamplingPlan;
+int* d_resamplingFirstTaps = NULL; ///tap tables of resamplingPlan, d_resamplingWeights has room for RESAMPLING_MAX_TAPS weights per sample
+float* d_resamplingWeights = NULL;
 float* d_dispersionCurve = NULL;
-float* d_sinusoidalResampleCurve = NULL;
+CpuLineGather* d_lineGather = NULL;
+std::vector<CpuLineGather> h_lineGather;
+std::vector<float> h_sinusoidalResampleCurve;
+int lineGatherMode = -1; //bscan flip and sinusoidal scan correction flags d_lineGather was filled for, -1 if not filled yet
 cufftComplex* d_phaseCartesian = NULL;
 unsigned int bufferNumber = 0;
 unsigned int bufferNumberInVolume = 0;
@@ -76,6 +118,7 @@ unsigned int streamingBufferNumber = 0;
 
 cufftComplex* d_fftBuffer = NULL;
 cufftHandle d_plan;
+std::map<std::tuple<int, int, cufftType>, cufftHandle> fftPlanCache; //key: signal length, batch, fft type. cufft plans are in-place/out-of-place agnostic and the direction is chosen on execution
 cufftComplex* d_meanALine = NULL;
 float* d_postProcBackgroundLine = NULL;
 
@@ -89,15 +132,31 @@ size_t samplesPerBuffer = 0;
 size_t samplesPerVolume = 0;
 size_t buffersPerVolume = 0;
 size_t bytesPerSample = 0;
-
-float* d_processedBuffer = NULL;
-float* d_sinusoidalScanTmpBuffer = NULL;
+VOLUME_STORAGE volumeStorage = FLOAT32_VOLUME;
+size_t bytesPerVolumeSample = sizeof(float);
+
+unsigned char* d_processedBuffer = NULL; ///samples of type volumeStorage
+unsigned char* d_enFaceVolume = NULL; ///depth-major copy of d_processedBuffer (d_enFaceVolume[depth*linesPerVolume + line]) that is kept while the en face view is enabled
+bool enFaceVolumeValid = false;
+VolumeRing volumeRing;
+unsigned char* d_volumeRing = NULL; ///copies of the last complete volumes, samples of type volumeStorage
+void* d_volumeRingOutput = NULL; ///one B-scan of d_volumeRing converted to the streaming output format
+DisplayProjectionPixel* d_bscanProjection = NULL;
+DisplayProjectionPixel* d_enFaceProjection = NULL;
+DisplayProjectionWindow bscanProjectionWindow;
+DisplayProjectionWindow enFaceProjectionWindow;
+cudaEvent_t displayProjectionEvent; ///orders all work on d_bscanProjection and d_enFaceProjection between the processing streams and userRequestStream
 OctAlgorithmParameters* params = NULL;
 
 unsigned int processedBuffers;
 unsigned int streamedBuffers;
 
 bool fixedPatternNoiseDetermined = false;
+float3* d_segmentStatistics = NULL; //FIXED_PATTERN_NOISE_REMOVAL_SEGMENTS x signalLength/2
+
+bool stageCapture = false; //see ProcessingBackend::setStageCapture()
+bool stageCaptured[NUMBER_OF_CAPTURE_STAGES] = {false, false, false};
+std::vector<cufftComplex> h_capturedStages[NUMBER_OF_CAPTURE_STAGES];
 
 
 
@@ -171,20 +230,83 @@ __global__ void rollingAverageBackgroundRemoval(cufftComplex* out, cufftComplex*
 	}
 }
 
-//todo: use/evaluate cuda texture for interpolation in klinearization kernel
-__global__ void klinearization(cufftComplex* out, cufftComplex *in, const float* resampleCurve, const int width, const int samples) {
+//same result as rollingAverageBackgroundRemoval, but every window sum is the difference of two prefix sums, so the cost does not depend on the window size.
+//One block processes one A-scan. The double precision prefix sum of the A-scan is kept in dynamic shared memory (width+1 values).
+__global__ void rollingAverageBackgroundRemovalPrefixSum(cufftComplex* out, const cufftComplex* in, const int rollingAverageWindowSize, const int width) {
+	extern __shared__ double prefix[];
+	__shared__ double segmentSums[ROLLING_AVERAGE_BLOCK_SIZE];
+	const cufftComplex* lineIn = &in[blockIdx.x*width];
+	cufftComplex* lineOut = &out[blockIdx.x*width];
+	const int tid = threadIdx.x;
+
+	//coalesced copy of the A-scan into shared memory
+	for (int j = tid; j < width; j += blockDim.x) {
+		prefix[j+1] = lineIn[j].x;
+	}
+	if (tid == 0) {
+		prefix[0] = 0.0;
+	}
+	__syncthreads();
+
+	//every thread calculates the prefix sum of a contiguous segment
+	const int segmentLength = (width + blockDim.x - 1) / blockDim.x;
+	const int segmentBegin = min(tid*segmentLength, width);
+	const int segmentEnd = min(segmentBegin+segmentLength, width);
+	double sum = 0.0;
+	for (int j = segmentBegin; j < segmentEnd; j++) {
+		sum += prefix[j+1];
+		prefix[j+1] = sum;
+	}
+	segmentSums[tid] = sum;
+	__syncthreads();
+
+	//inclusive scan of the segment sums
+	for (int offset = 1; offset < blockDim.x; offset *= 2) {
+		double value = tid >= offset ? segmentSums[tid-offset] : 0.0;
+		__syncthreads();
+		segmentSums[tid] += value;
+		__syncthreads();
+	}
+
+	//add sum of all previous segments
+	const double segmentOffset = tid > 0 ? segmentSums[tid-1] : 0.0;
+	for (int j = segmentBegin; j < segmentEnd; j++) {
+		prefix[j+1] += segmentOffset;
+	}
+	__syncthreads();
+
+	//subtract rolling average. The window is clamped to the A-scan as in rollingAverageBackgroundRemoval
+	for (int j = tid; j < width; j += blockDim.x) {
+		int startIdx = max(0, j - rollingAverageWindowSize + 1);
+		int endIdx = min(width - 1, j + rollingAverageWindowSize);
+		float rollingAverage = (float)((prefix[endIdx+1] - prefix[startIdx]) / (endIdx - startIdx + 1));
+		lineOut[j].x = lineIn[j].x - rollingAverage;
+		lineOut[j].y = 0;
+	}
+}
+
+//k-linearization with the tap indices and weights of ResamplingPlan (2 taps linear, 4 taps cubic, 16 taps Lanczos), so every output sample
+//is a short dot product. TAPS is the number of taps per sample as compile time constant, 0 uses the runtime value taps
+template <int TAPS>
+inline __device__ float resampleWithPlan(const cufftComplex* line, const int* firstTap, const float* weights, const int taps, const int j) {
+	const int n = TAPS > 0 ? TAPS : taps;
+	const cufftComplex* x = &line[firstTap[j]];
+	const float* w = &weights[j*n];
+	float sum = 0.0f;
+#pragma unroll
+	for (int t = 0; t < n; t++) {
+		sum += x[t].x*w[t];
+	}
+	return sum;
+}
+
+template <int TAPS>
+__global__ void klinearization(cufftComplex* out, cufftComplex *in, const int* firstTap, const float* weights, const int taps, const int width, const int samples) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
 	int j = index%width;
 	int offset = index-j;
 
-	float x = resampleCurve[j];
-	int x0 = (int)x;
-	int x1 = x0 + 1;
-
-	float f_x0 = in[offset + x0].x;
-	float f_x1 = in[offset + x1].x;
-
-	out[index].x = f_x0 + (f_x1 - f_x0) * (x - x0);
+	out[index].x = resampleWithPlan<TAPS>(&in[offset], firstTap, weights, taps, j);
 	out[index].y = 0;
 }
 
@@ -209,126 +331,6 @@ __global__ void klinearizationQuadratic(cufftComplex* out, cufftComplex *in, con
 	out[index].y = 0;
 }
 
-inline __device__ float cubicHermiteInterpolation(const float y0, const float y1, const float y2, const float y3, const float positionBetweenY1andY2){
-	const float a = -y0 + 3.0f*(y1-y2) + y3;
-	const float b = 2.0f*y0 - 5.0f*y1 + 4.0f*y2 - y3;
-	const float c = -y0 + y2;
-
-	const float pos = positionBetweenY1andY2;
-	const float pos2 = pos*pos;
-
-	return 0.5f*pos*(a * pos2 + b * pos + c) + y1;
-}
-
-__global__ void klinearizationCubic(cufftComplex* out, cufftComplex *in, const float* resampleCurve, const int width, const int samples) {
-	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	int j = index%width;
-	int offset = index-j;
-
-	float nx = resampleCurve[j];
-	const int n1 = (int)nx;
-	int n0 = abs(n1 - 1); //using abs() to avoid negative n0 because offset can be 0 and out of bounds memory access may occur
-	int n2 = n1 + 1;
-	int n3 = n2 + 1; //we do not need to worry here about out of bounds memory access as the resampleCurve is restricted to values that avoid out of bound memory acces in resample kernels
-
-	float y0 = in[offset + n0].x;
-	float y1 = in[offset + n1].x;
-	float y2 = in[offset + n2].x;
-	float y3 = in[offset + n3].x;
-
-	out[index].x = cubicHermiteInterpolation(y0,y1,y2,y3,nx-n1);
-	out[index].y = 0;
-}
-
-inline __device__ float lanczosKernel(const float a, const float x) {
-	if(x < 0.00000001f && x > -0.00000001){
-		return 1.0f;
-	}
-	if(x >= -a || x < a){
-		return (a*sinf(M_PI*x)*sinf(M_PI*x/a))/(M_PI*M_PI*x*x); //todo: optimize
-	}
-	return 0.0f;
-}
-
-//inline __device__ float lanczosKernel8(const float x) {
-//	if(x < 0.00001f && x > -0.00001f) {
-//		return 1.0f;
-//	}
-//	if(x >= -8.0f || x < 8.0f) {
-//		return (EIGHT_OVER_PI_SQUARED*__sinf(PI*x)*__sinf(PI_OVER_8*x))/(x*x);
-//	}
-//	return 0.0f;
-//}
-
-inline __device__ float lanczosKernel8(const float x) {
-	const float absX = fabsf(x);
-	const float sincX = sinf(PI*absX)/(PI*absX);
-	const float sincXOver8 = sinf(PI_OVER_8*absX)/(PI_OVER_8*absX);
-	return (absX < 0.00001f) ? 1.0f :(sincX * sincXOver8);
-}
-
-__global__ void klinearizationLanczos(cufftComplex* out, cufftComplex *in, const float* resampleCurve, const int width, const int samples) {
-	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	int j = index%width;
-	int offset = index-j;
-	offset = min(samples-9, max(offset, 8));
-
-	float nx = resampleCurve[j];
-	const int n0 = (int)nx;
-	int nm7 = (n0 - 7);
-	int nm6 = (n0 - 6);
-	int nm5 = (n0 - 5);
-	int nm4 = (n0 - 4);
-	int nm3 = (n0 - 3);
-	int nm2 = (n0 - 2);
-	int nm1 = (n0 - 1);
-	int n1 = (n0 + 1);
-	int n2 = (n0 + 2);
-	int n3 = (n0 + 3);
-	int n4 = (n0 + 4);
-	int n5 = (n0 + 5);
-	int n6 = (n0 + 6);
-	int n7 = (n0 + 7);
-	int n8 = (n0 + 8);
-
-	float ym7 = in[offset + nm7].x;
-	float ym6 = in[offset + nm6].x;
-	float ym5 = in[offset + nm5].x;
-	float ym4 = in[offset + nm4].x;
-	float ym3 = in[offset + nm3].x;
-	float ym2 = in[offset + nm2].x;
-	float ym1 = in[offset + nm1].x;
-	float y0 = in[offset + n0].x;
-	float y1 = in[offset + n1].x;
-	float y2 = in[offset + n2].x;
-	float y3 = in[offset + n3].x;
-	float y4 = in[offset + n4].x;
-	float y5 = in[offset + n5].x;
-	float y6 = in[offset + n6].x;
-	float y7 = in[offset + n7].x;
-	float y8 = in[offset + n8].x;
-
-	float sm7 = ym7 * lanczosKernel8(nx-nm7);
-	float sm6 = ym6 * lanczosKernel8(nx-nm6);
-	float sm5 = ym5 * lanczosKernel8(nx-nm5);
-	float sm4 = ym4 * lanczosKernel8(nx-nm4);
-	float sm3 = ym3 * lanczosKernel8(nx-nm3);
-	float sm2 = ym2 * lanczosKernel8(nx-nm2);
-	float sm1 = ym1 * lanczosKernel8(nx-nm1);
-	float s0 = y0 * lanczosKernel8(nx-n0);
-	float s1 = y1 * lanczosKernel8(nx-n1);
-	float s2 = y2 * lanczosKernel8(nx-n2);
-	float s3 = y3 * lanczosKernel8(nx-n3);
-	float s4 = y4 * lanczosKernel8(nx-n4);
-	float s5 = y5 * lanczosKernel8(nx-n5);
-	float s6 = y6 * lanczosKernel8(nx-n6);
-	float s7 = y7 * lanczosKernel8(nx-n7);
-	float s8 = y8 * lanczosKernel8(nx-n8);
-
-	out[index].x = sm7 + sm6 + sm5 + sm4 + sm3 + sm2 + sm1 + s0+ s1 + s2 + s3 +s4 +s5 +s6 +s7 + s8;
-	out[index].y = 0;
-}
-
 __global__ void windowing(cufftComplex* output, cufftComplex* input, const float* window, const int lineWidth, const int samples) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
 	if (index < samples) {
@@ -338,282 +340,67 @@ __global__ void windowing(cufftComplex* output, cufftComplex* input, const float
 	}
 }
 
-__global__ void klinearizationAndWindowing(cufftComplex* out, cufftComplex *in, const float* resampleCurve, const float* window, const int width, const int samples) {
-	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	int j = index%width;
-	int offset = index-j;
-
-	float n_m = resampleCurve[j];
-	int n1 = (int)n_m;
-	int n2 = n1 + 1;
-
-	float inN1 = in[offset + n1].x;
-	float inN2 = in[offset + n2].x;
-
-	out[index].x = (inN1 + (inN2 - inN1) * (n_m - n1)) * window[j];
-	out[index].y = 0;
-}
-
-__global__ void klinearizationCubicAndWindowing(cufftComplex* out, cufftComplex *in, const float* resampleCurve, const float* window, const int width, const int samples) {
+template <int TAPS>
+__global__ void klinearizationAndWindowing(cufftComplex* out, cufftComplex *in, const int* firstTap, const float* weights, const float* window, const int taps, const int width, const int samples) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
 	int j = index%width;
 	int offset = index-j;
 
-	float nx = resampleCurve[j];
-	const int n1 = (int)nx;
-	int n0 = abs(n1 - 1);
-	int n2 = n1 + 1;
-	int n3 = n2 + 1;
-
-	float y0 = in[offset + n0].x;
-	float y1 = in[offset + n1].x;
-	float y2 = in[offset + n2].x;
-	float y3 = in[offset + n3].x;
-	float pos = nx-n1;
-
-	out[index].x = cubicHermiteInterpolation(y0,y1,y2,y3,pos) * window[j];
-	out[index].y = 0;
-}
-
-__global__ void klinearizationLanczosAndWindowing(cufftComplex* out, cufftComplex *in, const float* resampleCurve, const float* window, const int width, const int samples) {
-	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	int j = index%width;
-	int offset = index-j;
-	offset = min(samples-9, max(offset, 8));
-
-	float nx = resampleCurve[j];
-	const int n0 = (int)nx;
-	int nm7 = (n0 - 7);
-	int nm6 = (n0 - 6);
-	int nm5 = (n0 - 5);
-	int nm4 = (n0 - 4);
-	int nm3 = (n0 - 3);
-	int nm2 = (n0 - 2);
-	int nm1 = (n0 - 1);
-	int n1 = (n0 + 1);
-	int n2 = (n0 + 2);
-	int n3 = (n0 + 3);
-	int n4 = (n0 + 4);
-	int n5 = (n0 + 5);
-	int n6 = (n0 + 6);
-	int n7 = (n0 + 7);
-	int n8 = (n0 + 8);
-
-	float ym7 = in[offset + nm7].x;
-	float ym6 = in[offset + nm6].x;
-	float ym5 = in[offset + nm5].x;
-	float ym4 = in[offset + nm4].x;
-	float ym3 = in[offset + nm3].x;
-	float ym2 = in[offset + nm2].x;
-	float ym1 = in[offset + nm1].x;
-	float y0 = in[offset + n0].x;
-	float y1 = in[offset + n1].x;
-	float y2 = in[offset + n2].x;
-	float y3 = in[offset + n3].x;
-	float y4 = in[offset + n4].x;
-	float y5 = in[offset + n5].x;
-	float y6 = in[offset + n6].x;
-	float y7 = in[offset + n7].x;
-	float y8 = in[offset + n8].x;
-
-	float sm7 = ym7 * lanczosKernel8(nx-nm7);
-	float sm6 = ym6 * lanczosKernel8(nx-nm6);
-	float sm5 = ym5 * lanczosKernel8(nx-nm5);
-	float sm4 = ym4 * lanczosKernel8(nx-nm4);
-	float sm3 = ym3 * lanczosKernel8(nx-nm3);
-	float sm2 = ym2 * lanczosKernel8(nx-nm2);
-	float sm1 = ym1 * lanczosKernel8(nx-nm1);
-	float s0 = y0 * lanczosKernel8(nx-n0);
-	float s1 = y1 * lanczosKernel8(nx-n1);
-	float s2 = y2 * lanczosKernel8(nx-n2);
-	float s3 = y3 * lanczosKernel8(nx-n3);
-	float s4 = y4 * lanczosKernel8(nx-n4);
-	float s5 = y5 * lanczosKernel8(nx-n5);
-	float s6 = y6 * lanczosKernel8(nx-n6);
-	float s7 = y7 * lanczosKernel8(nx-n7);
-	float s8 = y8 * lanczosKernel8(nx-n8);
-
-	out[index].x = (sm7 + sm6 + sm5 + sm4 + sm3 + sm2 + sm1 + s0+ s1 + s2 + s3 + s4 + s5 + s6 + s7 + s8) * window[j];
+	out[index].x = resampleWithPlan<TAPS>(&in[offset], firstTap, weights, taps, j) * window[j];
 	out[index].y = 0;
 }
 
-__global__ void klinearizationAndWindowingAndDispersionCompensation(cufftComplex* out, cufftComplex* in, const float* resampleCurve, const float* window, const cufftComplex* phaseComplex, const int width, const int samples) {
+template <int TAPS>
+__global__ void klinearizationAndWindowingAndDispersionCompensation(cufftComplex* out, cufftComplex* in, const int* firstTap, const float* weights, const float* window, const cufftComplex* phaseComplex, const int taps, const int width, const int samples) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
 	int j = index%width;
 	int offset = index-j;
 
-	float n_m = resampleCurve[j];
-	int n1 = (int)n_m;
-	int n2 = n1 + 1;
-
-	float inN1 = in[offset + n1].x;
-	float inN2 = in[offset + n2].x;
-
-	float linearizedAndWindowedInX = (inN1 + (inN2 - inN1) * (n_m - n1)) * window[j];
+	float linearizedAndWindowedInX = resampleWithPlan<TAPS>(&in[offset], firstTap, weights, taps, j) * window[j];
 	out[index].x = linearizedAndWindowedInX * phaseComplex[j].x;
 	out[index].y = linearizedAndWindowedInX * phaseComplex[j].y;
 }
 
-__global__ void klinearizationCubicAndWindowingAndDispersionCompensation(cufftComplex* out, cufftComplex *in, const float* resampleCurve, const float* window, const cufftComplex* phaseComplex, const int width, const int samples) {
-	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	int j = index%width;
-	int offset = index-j;
 
-	float nx = resampleCurve[j];
-	int n1 = (int)nx;
-	int n0 = abs(n1 - 1);
-	int n2 = n1 + 1;
-	int n3 = n2 + 1;
 
-	float y0 = in[offset + n0].x;
-	float y1 = in[offset + n1].x;
-	float y2 = in[offset + n2].x;
-	float y3 = in[offset + n3].x;
-	float pos = nx-n1;
 
-	float linearizedAndWindowedInX = cubicHermiteInterpolation(y0,y1,y2,y3,pos) * window[j];
-	out[index].x = linearizedAndWindowedInX * phaseComplex[j].x;
-	out[index].y = linearizedAndWindowedInX * phaseComplex[j].y;
-}
-
-__global__ void klinearizationLanczosAndWindowingAndDispersionCompensation(cufftComplex* out, cufftComplex *in, const float* resampleCurve, const float* window, const cufftComplex* phaseComplex, const int width, const int samples) {
-	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	int j = index%width;
-	int offset = index-j;
-	offset = min(samples-9, max(offset, 8));
-
-	float nx = resampleCurve[j];
-	const int n0 = (int)nx;
-	int nm7 = (n0 - 7);
-	int nm6 = (n0 - 6);
-	int nm5 = (n0 - 5);
-	int nm4 = (n0 - 4);
-	int nm3 = (n0 - 3);
-	int nm2 = (n0 - 2);
-	int nm1 = (n0 - 1);
-	int n1 = (n0 + 1);
-	int n2 = (n0 + 2);
-	int n3 = (n0 + 3);
-	int n4 = (n0 + 4);
-	int n5 = (n0 + 5);
-	int n6 = (n0 + 6);
-	int n7 = (n0 + 7);
-	int n8 = (n0 + 8);
-
-	float ym7 = in[offset + nm7].x;
-	float ym6 = in[offset + nm6].x;
-	float ym5 = in[offset + nm5].x;
-	float ym4 = in[offset + nm4].x;
-	float ym3 = in[offset + nm3].x;
-	float ym2 = in[offset + nm2].x;
-	float ym1 = in[offset + nm1].x;
-	float y0 = in[offset + n0].x;
-	float y1 = in[offset + n1].x;
-	float y2 = in[offset + n2].x;
-	float y3 = in[offset + n3].x;
-	float y4 = in[offset + n4].x;
-	float y5 = in[offset + n5].x;
-	float y6 = in[offset + n6].x;
-	float y7 = in[offset + n7].x;
-	float y8 = in[offset + n8].x;
-
-	float sm7 = ym7 * lanczosKernel8(nx-nm7);
-	float sm6 = ym6 * lanczosKernel8(nx-nm6);
-	float sm5 = ym5 * lanczosKernel8(nx-nm5);
-	float sm4 = ym4 * lanczosKernel8(nx-nm4);
-	float sm3 = ym3 * lanczosKernel8(nx-nm3);
-	float sm2 = ym2 * lanczosKernel8(nx-nm2);
-	float sm1 = ym1 * lanczosKernel8(nx-nm1);
-	float s0 = y0 * lanczosKernel8(nx-n0);
-	float s1 = y1 * lanczosKernel8(nx-n1);
-	float s2 = y2 * lanczosKernel8(nx-n2);
-	float s3 = y3 * lanczosKernel8(nx-n3);
-	float s4 = y4 * lanczosKernel8(nx-n4);
-	float s5 = y5 * lanczosKernel8(nx-n5);
-	float s6 = y6 * lanczosKernel8(nx-n6);
-	float s7 = y7 * lanczosKernel8(nx-n7);
-	float s8 = y8 * lanczosKernel8(nx-n8);
-
-	float linearizedAndWindowedInX = (sm7 + sm6 + sm5 + sm4 + sm3 + sm2 + sm1 + s0+ s1 + s2 + s3 + s4 + s5 + s6 + s7 + s8) * window[j];
-	out[index].x = linearizedAndWindowedInX * phaseComplex[j].x;
-	out[index].y = linearizedAndWindowedInX * phaseComplex[j].y;
-}
-
-__global__ void sinusoidalScanCorrection(float* out, float *in, float* sinusoidalResampleCurve, const int width, const int height, const int depth, const int samples) { //width: samplesPerAscan; height: ascansPerBscan, depth: bscansPerBuffer
+/*	Algorithm implemented by Ben Matthias after S.Moon et al., "Reference spectrum extraction and fixed-pattern noise removal in
+optical coherence tomography", Optics Express 18(23):24395-24404, 2010	*/
+//Welford single pass mean and sum of squared deviations (x: mean real part, y: mean imaginary part, z: m2) of one depth sample within one segment.
+//One thread per segment and depth sample, so the segments are processed in parallel.
+__global__ void getSegmentStatistics(float3* statistics, const cufftComplex* in, const int width, const int outputAscanLength, const int segWidth, const int segments) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	if(index < samples-width){
-		int j = index%(width); //pos within ascan
-		int k = (index/width)%height; //pos within bscan
-		int l = index/(width*height); //pos within buffer
-
-		float n_sinusoidal = sinusoidalResampleCurve[k];
-		float x = n_sinusoidal;
-		int x0 = (int)x*width+j+l*width*height;
-		int x1 = x0 + width;
-
-		float f_x0 = in[x0];
-		float f_x1 = in[x1];
-
-		out[index] = f_x0 + (f_x1 - f_x0) * (x - (int)(x));
-	}
-}
-
-__global__ void fillSinusoidalScanCorrectionCurve(float* sinusoidalResampleCurve,  const int length) {
-	int index = blockIdx.x;
-	if (index < length) {
-		sinusoidalResampleCurve[index] = ((float)length/M_PI)*acos((float)(1.0-((2.0*(float)index)/(float)length)));
+	if (index < outputAscanLength*segments) {
+		int segment = index/outputAscanLength;
+		int sample = index%outputAscanLength;
+		const cufftComplex* segmentData = &in[segment*segWidth*width + sample];
+		float3 stat = make_float3(0.0f, 0.0f, 0.0f);
+		for (int j = 0; j < segWidth; j++) {
+			cufftComplex cur = segmentData[j*width];
+			float factor = 1.0f / (float)(j+1);
+			float dx = cur.x - stat.x;
+			float dy = cur.y - stat.y;
+			stat.x += dx*factor;
+			stat.y += dy*factor;
+			stat.z += dx*(cur.x - stat.x) + dy*(cur.y - stat.y);
+		}
+		statistics[segment*outputAscanLength + sample] = stat;
 	}
 }
 
-/*	Algorithm implemented by Ben Matthias after S.Moon et al., "Reference spectrum extraction and fixed-pattern noise removal in
-optical coherence tomography", Optics Express 18(23):24395-24404, 2010	*/
-//todo: optimize cuda code
-__global__ void getMinimumVarianceMean(cufftComplex *meanLine, cufftComplex *in, int width, int height, int segs) {
+__global__ void getMinimumVarianceMean(cufftComplex *meanLine, const float3* statistics, const int outputAscanLength, const int segs) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	if (index < width) {
-		int i, j;
-		cufftComplex cur, segMean, meanAtMinVariance;
-		float segVariance, minVariance;
-		int segWidth = height / segs;
-		int offset;
-		float factor = 1.0f / (float)segWidth;
-
-		for (i = 0; i<segs; i++) {
-			segMean.x = 0.0f;
-			segMean.y = 0.0f;
-			segVariance = 0.0f;
-			offset = i*segWidth*width + index;
-
-			// calculate segmental mean
-			for (j = 0; j < segWidth; j++) {
-				cur = in[offset + j*width];
-				segMean.x = segMean.x + cur.x;
-				segMean.y = segMean.y + cur.y;
-			}
-			segMean.x = segMean.x*factor;
-			segMean.y = segMean.y*factor;
-
-			// calculate segmental variance
-			for (j = 0; j<segWidth; j++) {
-				cur = in[offset + j*width];
-				segVariance += pow(cur.x - segMean.x, 2) + pow(cur.y - segMean.y, 2);
-			}
-			segVariance *= factor;
-
-			if (i == 0) {
-				minVariance = segVariance;
-				meanAtMinVariance = segMean;
-			}
-			else { // remember segmental mean with minimum segmental variance
-				if (segVariance < minVariance) {
-					minVariance = segVariance;
-					meanAtMinVariance = segMean;
-				}
+	if (index < outputAscanLength) {
+		//all segments have the same number of A-scans, so m2 can be compared instead of the variance
+		float3 minVarianceSegment = statistics[index];
+		for (int i = 1; i < segs; i++) {
+			float3 current = statistics[i*outputAscanLength + index];
+			if (current.z < minVarianceSegment.z) {
+				minVarianceSegment = current;
 			}
 		}
-
-		// set segmental mean of minimum-variance segment to meanLine
-		meanLine[index] = meanAtMinVariance;
+		meanLine[index].x = minVarianceSegment.x;
+		meanLine[index].y = minVarianceSegment.y;
 	}
 }
 
@@ -711,185 +498,127 @@ extern "C" void cuda_unregisterStreamingBuffers() {
 }
 
 //Removes half of each processed A-scan (the mirror artefacts), logarithmizes each value of magnitude of remaining A-scan and copies it into an output array. This output array can be used to display the processed OCT data.
-__global__ void postProcessTruncateLog(float *output, const cufftComplex *input, const int outputAscanLength, const int samples, const int bufferNumberInVolume, const float max, const float min, const float addend, const float coeff) {
-	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	if (index < samples / 2) {
-		int lineIndex = index / outputAscanLength;
-		int inputArrayIndex = lineIndex *outputAscanLength + index;
-
-		//Note log scaling: log(sqrt(x*x+y*y)) == 0.5*log(x*x+y*y) --> the calculation in the code below is 20*log(magnitude) and not 10*log...
+__device__ inline float truncateLog(const cufftComplex value, const int outputAscanLength, const float max, const float min, const float addend, const float coeff) {
+	//Note log scaling: log(sqrt(x*x+y*y)) == 0.5*log(x*x+y*y) --> the calculation in the code below is 20*log(magnitude) and not 10*log...
 		//Note fft normalization://(1/(2*outputAscanLength)) is the FFT normalization factor. In addition a multiplication by 2 is performed since the acquired OCT raw signal is a real valued signal, so (1/(2*outputAscanLength)) becomes 1/outputAscanLength. (Why multiply by 2: FFT of a real-valued signal is a complex-valued signal with a symmetric spectrum, where the positive and negative frequency components are identical in magnitude. And since the signal is truncated (negative or positive frequency components are removed), doubling of the remaining components is performed here)
-		//amplitude:
-		float realComponent = input[inputArrayIndex].x;
-		float imaginaryComponent = input[inputArrayIndex].y;
-		output[index] = coeff*((((10.0f*log10f(((realComponent*realComponent) + (imaginaryComponent*imaginaryComponent))/(outputAscanLength))) - min) / (max - min)) + addend);
+	//amplitude:
+	float realComponent = value.x;
+	float imaginaryComponent = value.y;
+	return __saturatef(coeff*((((10.0f*log10f(((realComponent*realComponent) + (imaginaryComponent*imaginaryComponent))/(outputAscanLength))) - min) / (max - min)) + addend)); //Clamp values to be within the interval [+0.0, 1.0].
+}
 
-		output[index] = __saturatef(output[index]); //Clamp values to be within the interval [+0.0, 1.0].
-	}
+__device__ inline float truncateLin(const cufftComplex value, const int outputAscanLength, const float max, const float min, const float addend, const float coeff) {
+	float realComponent = value.x;
+	float imaginaryComponent = value.y;
+	return __saturatef(coeff * ((((sqrt((realComponent*realComponent) + (imaginaryComponent*imaginaryComponent))/(outputAscanLength)) - min) / (max - min)) + addend)); //Clamp values to be within the interval [+0.0, 1.0].
 }
 
-//Removes half of each processed A-scan (the mirror artefacts), calculates magnitude of remaining A-scan and copies it into an output array. This output array can be used to display the processed OCT data.
-__global__ void postProcessTruncateLin(float *output, const cufftComplex *input, const int outputAscanLength, const int samples, const float max, const float min, const float addend, const float coeff) {
+//Without lineGather output A-scan i is the truncated input A-scan i. With lineGather it is the interpolation of the truncated input A-scans lineGather[i].line0 and lineGather[i].line1,
+//which does bscan flip and sinusoidal scan correction while reading the input, so neither a copy of the output nor an additional pass over it is necessary
+template <bool LOG_SCALING, typename T>
+__global__ void postProcessTruncate(T *output, const cufftComplex *input, const CpuLineGather* lineGather, const int outputAscanLength, const int samples, const float max, const float min, const float addend, const float coeff) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
 	if (index < samples / 2) {
 		int lineIndex = index / outputAscanLength;
-		int inputArrayIndex = lineIndex * outputAscanLength + index;
-
-		//amplitude:
-		float realComponent = input[inputArrayIndex].x;
-		float imaginaryComponent = input[inputArrayIndex].y;
-		output[index] = coeff * ((((sqrt((realComponent*realComponent) + (imaginaryComponent*imaginaryComponent))/(outputAscanLength)) - min) / (max - min)) + addend);
-
-		output[index] = __saturatef(output[index]);//Clamp values to be within the interval [+0.0, 1.0].
+		int sampleIndex = index - lineIndex*outputAscanLength;
+		int inputLineLength = 2*outputAscanLength;
+		if (lineGather == NULL) {
+			cufftComplex value = input[lineIndex*inputLineLength + sampleIndex];
+			storeVolumeSample(output[index], LOG_SCALING ? truncateLog(value, outputAscanLength, max, min, addend, coeff) : truncateLin(value, outputAscanLength, max, min, addend, coeff));
+		} else {
+			CpuLineGather gather = lineGather[lineIndex];
+			cufftComplex value0 = input[gather.line0*inputLineLength + sampleIndex];
+			float result = LOG_SCALING ? truncateLog(value0, outputAscanLength, max, min, addend, coeff) : truncateLin(value0, outputAscanLength, max, min, addend, coeff);
+			if (gather.weight != 0.0f) {
+				cufftComplex value1 = input[gather.line1*inputLineLength + sampleIndex];
+				float result1 = LOG_SCALING ? truncateLog(value1, outputAscanLength, max, min, addend, coeff) : truncateLin(value1, outputAscanLength, max, min, addend, coeff);
+				result = result + (result1 - result) * gather.weight;
+			}
+			storeVolumeSample(output[index], result);
+		}
 	}
 }
 
-__global__ void getPostProcessBackground(float* output, float* input, const int samplesPerAscan, const int ascansPerBuffer) {
+template <typename T>
+__global__ void getPostProcessBackground(float* output, const T* input, const int samplesPerAscan, const int ascansPerBuffer) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
 	if (index < samplesPerAscan) {
 		float sum = 0;
 		for (int i = 0; i < ascansPerBuffer; i++){
-			sum += input[index+i*samplesPerAscan];
+			sum += loadVolumeSample(input[index+i*samplesPerAscan]);
 		}
 		output[index] = sum/ascansPerBuffer;
 	}
 }
 
-__global__ void postProcessBackgroundRemoval(float* data, float* background, const float backgroundWeight, const float backgroundOffset, const int samplesPerAscan, const int samplesPerBuffer) {
+template <typename T>
+__global__ void postProcessBackgroundRemoval(T* data, float* background, const float backgroundWeight, const float backgroundOffset, const int samplesPerAscan, const int samplesPerBuffer) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
 	if (index < samplesPerBuffer) {
-		data[index] = __saturatef(data[index] - (backgroundWeight * background[index%samplesPerAscan] + backgroundOffset));
+		storeVolumeSample(data[index], __saturatef(loadVolumeSample(data[index]) - (backgroundWeight * background[index%samplesPerAscan] + backgroundOffset)));
 	}
 }
 
-__global__ void cuda_bscanFlip_slow(float *output, float *input, int samplesPerAscan, int ascansPerBscan, int samplesInVolume) {
-	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	if (index < samplesInVolume) {
-		int samplesPerBscan = ascansPerBscan * samplesPerAscan;
-		int bscanIndex = index / samplesPerBscan;
-		int sampleIndex = index % samplesPerBscan;
-		int ascanIndex = sampleIndex / samplesPerAscan;
-		int mirrorIndex = bscanIndex*samplesPerBscan+((ascansPerBscan - 1) - ascanIndex)*samplesPerAscan + (sampleIndex%samplesPerAscan);
-
-		if (bscanIndex % 2 == 0 && ascanIndex >= ascansPerBscan/2) {
-			float tmp = input[mirrorIndex];
-			output[mirrorIndex] = input[index];
-			output[index] = tmp;
+//tiled transpose of A-scans into depth rows: enFaceVolume[depth*linesInVolume + firstLineInVolume + line] = processedBuffer[line*samplesPerAscan + depth].
+//Every block reads a TRANSPOSE_TILE_DIM x TRANSPOSE_TILE_DIM tile with coalesced loads along depth and writes it with coalesced stores along the A-scans
+template <typename T>
+__global__ void transposeToEnFace(T* enFaceVolume, const T* processedBuffer, const unsigned int samplesPerAscan, const unsigned int linesInVolume, const unsigned int firstLineInVolume, const unsigned int linesInBuffer) {
+	__shared__ T tile[TRANSPOSE_TILE_DIM][TRANSPOSE_TILE_DIM+1]; //+1 avoids shared memory bank conflicts when the tile is read column-wise
+	unsigned int depth = blockIdx.x*TRANSPOSE_TILE_DIM + threadIdx.x;
+	unsigned int line = blockIdx.y*TRANSPOSE_TILE_DIM + threadIdx.y;
+	for (int j = 0; j < TRANSPOSE_TILE_DIM; j += TRANSPOSE_BLOCK_ROWS) {
+		if (depth < samplesPerAscan && line+j < linesInBuffer) {
+			tile[threadIdx.y+j][threadIdx.x] = processedBuffer[(size_t)(line+j)*samplesPerAscan + depth];
 		}
 	}
-}
-
-//todo: optimize! cuda_bscanFlip should be possible with just index < samplesPerBuffer/4
-__global__ void cuda_bscanFlip(float *output, float *input, const int samplesPerAscan, const int ascansPerBscan, const int samplesPerBscan, const int halfSamplesInVolume) {
-	int index = threadIdx.x + blockIdx.x * blockDim.x;
-	if (index < halfSamplesInVolume) {
-		int bscanIndex = (index / samplesPerBscan)*2; //multiplication by 2 gets us just even bscanIndex-values (0, 2, 4, 6, ...) This is necessary because we just want to flip every second Bscan.
-		index = bscanIndex*samplesPerBscan + index%samplesPerBscan; //recalculation of index is necessary here to skip every second Bscan
-		int sampleIndex = index % samplesPerBscan;
-		int ascanIndex = sampleIndex / samplesPerAscan;
-		int mirrorIndex = bscanIndex*samplesPerBscan + ((ascansPerBscan - 1) - ascanIndex)*samplesPerAscan + (sampleIndex%samplesPerAscan);
-
-		if (ascanIndex >= ascansPerBscan / 2) {
-			float tmp = input[mirrorIndex];
-			output[mirrorIndex] = input[index];
-			output[index] = tmp;
+	__syncthreads();
+	line = blockIdx.y*TRANSPOSE_TILE_DIM + threadIdx.x;
+	depth = blockIdx.x*TRANSPOSE_TILE_DIM + threadIdx.y;
+	for (int j = 0; j < TRANSPOSE_TILE_DIM; j += TRANSPOSE_BLOCK_ROWS) {
+		if (line < linesInBuffer && depth+j < samplesPerAscan) {
+			enFaceVolume[(size_t)(depth+j)*linesInVolume + firstLineInVolume + line] = tile[threadIdx.x][threadIdx.y+j];
 		}
 	}
 }
 
-//todo: avoid duplicate code: updateDisplayedBscanFrame and updateDisplayedEnFaceViewFrame only differ in the way how (or in what order) processedVolume[], displayBuffer[] is accessed and what the maximum number of available frames is ("bscansPerVolume" for updateDisplayedBscanFrame and "frameWidth" for updateDisplayedEnFaceViewFrame), the rest of the code is identical --> there should be a way to avoid duplicate code
-__global__ void updateDisplayedBscanFrame(float *displayBuffer, const float* processedVolume, const unsigned int bscansPerVolume, const unsigned int samplesInSingleFrame, const unsigned int frameNr, const unsigned int displayFunctionFrames, const int displayFunction) {
-	int i = threadIdx.x + blockIdx.x * blockDim.x;
-	if (i < samplesInSingleFrame) {
-		//todo: optimize averaging and MIP for very large number of displayFunctionFrames! Maybe Parallel Reduction could improve performance of averaging operation (Also maybe use enum instead of int for displayFunction to improve readability of the code)
-		if(displayFunctionFrames > 1){
-			switch(displayFunction){
-			case 0: //Averaging
-				int frameCount = 0;
-				float sum = 0;
-				for (int j = 0; j < displayFunctionFrames; j++){
-					int frameForAveraging = frameNr+j;
-					if(frameForAveraging < bscansPerVolume){
-						sum += processedVolume[frameForAveraging*samplesInSingleFrame + (samplesInSingleFrame-1) - i];
-						frameCount++;
-					}
-				}
-				displayBuffer[i] = sum/frameCount;
-				break;
-			case 1: //MIP
-				float maxValue = 0;
-				float currentValue = 0;
-				if(displayFunctionFrames > 1){
-					for (int j = 0; j < displayFunctionFrames; j++){
-						int frameForMIP = frameNr+j;
-						if(frameForMIP < bscansPerVolume){
-							currentValue = processedVolume[frameForMIP*samplesInSingleFrame + (samplesInSingleFrame-1) - i];
-							if(maxValue < currentValue){
-								maxValue = currentValue;
-							}
-						}
-					}
-					displayBuffer[i] = maxValue;
-				}
-				break;
-			default:
-				break;
-			}
+//B-scan and en face view only differ in pixelStride and frameStride, see displayprojection.h. Averaging and MIP use the running per pixel state in projection,
+//so moving the window by one frame reads one or two frames per pixel instead of all displayFunctionFrames frames
+template <typename T>
+__global__ void updateDisplayProjection(float* displayBuffer, DisplayProjectionPixel* projection, const T* processedVolume, const unsigned int pixels, const unsigned int pixelStride, const unsigned int frameStride, const unsigned int frameNr, const DisplayProjectionWindow window, const bool projecting) {
+	unsigned int p = threadIdx.x + blockIdx.x * blockDim.x;
+	if (p < pixels) {
+		const T* values = &processedVolume[(size_t)p*pixelStride];
+		if (projecting) {
+			scrollProjectionPixel(projection[p], values, frameStride, window);
+			displayBuffer[(pixels-1)-p] = getProjectionValue(projection[p], window);
 		}
 		else {
-			displayBuffer[i] = processedVolume[frameNr*samplesInSingleFrame + (samplesInSingleFrame-1) - i];
+			displayBuffer[(pixels-1)-p] = loadVolumeSample(values[(size_t)frameNr*frameStride]);
 		}
 	}
 }
 
-__global__ void updateDisplayedEnFaceViewFrame(float *displayBuffer, const float* processedVolume, const unsigned int frameWidth, const unsigned int samplesInSingleFrame, const unsigned int frameNr, const unsigned int displayFunctionFrames, const int displayFunction) {
-	int i = threadIdx.x + blockIdx.x * blockDim.x;
-	if (i < samplesInSingleFrame) {
-		//todo: optimize averaging and MIP for very large number of displayFunctionFrames! Maybe Parallel Reduction could improve performance of averaging operation (Also maybe use enum instead of int for displayFunction to improve readability of the code)
-		if(displayFunctionFrames > 1){
-			switch(displayFunction){
-			case 0: //Averaging
-				int frameCount = 0;
-				float sum = 0;
-				for (int j = 0; j < displayFunctionFrames; j++){
-					int frameForAveraging = frameNr+j;
-					if(frameForAveraging < frameWidth){
-						sum += processedVolume[frameForAveraging+i*frameWidth];
-						frameCount++;
-					}
-				}
-				displayBuffer[(samplesInSingleFrame-1)-i] = sum/frameCount;
-				break;
-			case 1: //MIP
-				float maxValue = 0;
-				float currentValue = 0;
-				if(displayFunctionFrames > 1){
-					for (int j = 0; j < displayFunctionFrames; j++){
-						int frameForMIP = frameNr+j;
-						if(frameForMIP < frameWidth){
-						currentValue = processedVolume[frameForMIP+i*frameWidth];
-							if(maxValue < currentValue){
-								maxValue = currentValue;
-							}
-						}
-					}
-					displayBuffer[(samplesInSingleFrame-1)-i] = maxValue;
-				}
-				break;
-			default:
-				break;
-			}
-		}
-		else {
-			displayBuffer[(samplesInSingleFrame-1)-i] = processedVolume[frameNr+i*frameWidth];
-		}
+template <typename T>
+__global__ void removeDisplayProjectionFrames(DisplayProjectionPixel* projection, const T* processedVolume, const unsigned int pixelStride, const unsigned int frameStride, const DisplayProjectionWindow window, const unsigned int firstFrame, const unsigned int lastFrame, const unsigned int firstPixel, const unsigned int lastPixel) {
+	unsigned int p = firstPixel + threadIdx.x + blockIdx.x * blockDim.x;
+	if (p < lastPixel) {
+		removeProjectionFrames(projection[p], &processedVolume[(size_t)p*pixelStride], frameStride, window, firstFrame, lastFrame);
 	}
 }
 
+template <typename T>
+__global__ void addDisplayProjectionFrames(DisplayProjectionPixel* projection, const T* processedVolume, const unsigned int pixelStride, const unsigned int frameStride, const DisplayProjectionWindow window, const unsigned int firstFrame, const unsigned int lastFrame, const unsigned int firstPixel, const unsigned int lastPixel) {
+	unsigned int p = firstPixel + threadIdx.x + blockIdx.x * blockDim.x;
+	if (p < lastPixel) {
+		addProjectionFrames(projection[p], &processedVolume[(size_t)p*pixelStride], frameStride, window, firstFrame, lastFrame);
+	}
+}
+
+template <typename T>
 #if __CUDACC_VER_MAJOR__ >=12
-__global__ void updateDisplayedVolume(cudaSurfaceObject_t surfaceWrite, const float* processedBuffer, const unsigned int samplesInBuffer, const unsigned int currBufferNr, const unsigned int bscansPerBuffer, dim3 textureDim) {
+__global__ void updateDisplayedVolume(cudaSurfaceObject_t surfaceWrite, const T* processedBuffer, const unsigned int samplesInBuffer, const unsigned int currBufferNr, const unsigned int bscansPerBuffer, dim3 textureDim) {
 #else
-__global__ void updateDisplayedVolume(const float* processedBuffer, const unsigned int samplesInBuffer, const unsigned int currBufferNr, const unsigned int bscansPerBuffer, dim3 textureDim) {
+__global__ void updateDisplayedVolume(const T* processedBuffer, const unsigned int samplesInBuffer, const unsigned int currBufferNr, const unsigned int bscansPerBuffer, dim3 textureDim) {
 #endif
 	for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < samplesInBuffer; i += blockDim.x * gridDim.x){
 		int width = textureDim.x; //Ascans per Bscan
@@ -901,60 +630,146 @@ __global__ void updateDisplayedVolume(const float* processedBuffer, const unsign
 		int z = (depth-1)-(i%depth); //flip back to front
 		int x = i/samplesPerFrame + (currBufferNr)*bscansPerBuffer;
 
-		unsigned char voxel = (unsigned char)(processedBuffer[i] * (255.0));
+		unsigned char voxel = (unsigned char)(loadVolumeSample(processedBuffer[i]) * (255.0));
 		surf3Dwrite(voxel, surfaceWrite, y * sizeof(unsigned char), x, z);
 	}
 }
 
-__global__ void floatToOutput(void *output, const float *input, const int outputBitdepth, const int samplesInProcessedVolume) {
+template <typename T>
+__global__ void floatToOutput(void *output, const T *input, const int outputBitdepth, const int samplesInProcessedVolume) {
 	int index = threadIdx.x + blockIdx.x * blockDim.x;
+	if (index >= samplesInProcessedVolume) {
+		return;
+	}
+	float value = loadVolumeSample(input[index]);
 	if(outputBitdepth <= 8){
 		unsigned char* out = (unsigned char*)output;
-		out[index] = (unsigned char)(input[index] * (255.0)); //float input with values between 0.0 and 1.0 is converted to 8 bit (0 to 255) output
+		out[index] = (unsigned char)(value * (255.0)); //float input with values between 0.0 and 1.0 is converted to 8 bit (0 to 255) output
 	}else if(outputBitdepth > 8 && outputBitdepth <= 10){
 		unsigned short* out = (unsigned short*)output;
-		out[index] = (unsigned short)(input[index] * (1023.0)); //10 bit
+		out[index] = (unsigned short)(value * (1023.0)); //10 bit
 	}else if(outputBitdepth > 10 && outputBitdepth <= 12){
 		unsigned short* out = (unsigned short*)output;
-		out[index] = (unsigned short)(input[index] * (4095.0)); //12 bit
+		out[index] = (unsigned short)(value * (4095.0)); //12 bit
 	}else if(outputBitdepth > 12 && outputBitdepth <= 16){
 		unsigned short* out = (unsigned short*)output;
-		out[index] = (unsigned short)(input[index] * (65535.0)); //16 bit
+		out[index] = (unsigned short)(value * (65535.0)); //16 bit
 	}else if(outputBitdepth > 16 && outputBitdepth <= 24){
 		unsigned int* out = (unsigned int*)output;
-		out[index] = (unsigned int)(input[index] * (16777215.0f)); //24 bit
+		out[index] = (unsigned int)(value * (16777215.0f)); //24 bit
 	}else{
 		unsigned int* out = (unsigned int*)output;
-		out[index] = (unsigned int)(input[index] * (4294967295.0f)); //32 bit
+		out[index] = (unsigned int)(value * (4294967295.0f)); //32 bit
+	}
+}
+
+const CpuLineGather* cuda_updateLineGather(bool bscanFlip, bool sinusoidalScanCorrection, cudaStream_t stream) {
+	if (!bscanFlip && !sinusoidalScanCorrection) {
+		return NULL;
+	}
+	int mode = (bscanFlip ? 1 : 0) | (sinusoidalScanCorrection ? 2 : 0);
+	if (mode != lineGatherMode) {
+		CpuKernels::fillLineGather(h_lineGather.data(), sinusoidalScanCorrection ? h_sinusoidalResampleCurve.data() : NULL, ascansPerBscan, h_lineGather.size(), bscanFlip);
+		checkCudaErrors(cudaMemcpyAsync(d_lineGather, h_lineGather.data(), sizeof(CpuLineGather)*h_lineGather.size(), cudaMemcpyHostToDevice, stream));
+		lineGatherMode = mode;
+	}
+	return d_lineGather;
+}
+
+void cuda_updateResamplingPlan(const float* resampleCurve, int size, INTERPOLATION interpolation, cudaStream_t stream) {
+	if (resampleCurve != NULL && size > 0 && size <= (int)signalLength) {
+		std::copy(resampleCurve, resampleCurve+size, h_resampleCurve.begin());
+	}
+	resamplingPlan.build(h_resampleCurve.data(), (int)signalLength, interpolation);
+	if (resamplingPlan.isBuilt()) {
+		checkCudaErrors(cudaMemcpyAsync(d_resamplingFirstTaps, resamplingPlan.getFirstTaps(), sizeof(int)*signalLength, cudaMemcpyHostToDevice, stream));
+		checkCudaErrors(cudaMemcpyAsync(d_resamplingWeights, resamplingPlan.getWeights(), sizeof(float)*signalLength*resamplingPlan.getTapsPerSample(), cudaMemcpyHostToDevice, stream));
+	}
+}
+
+template <int TAPS>
+void launchKlinearization(cufftComplex* out, cufftComplex* in, bool windowing, bool dispersionCompensation, cudaStream_t stream) {
+	const int taps = resamplingPlan.getTapsPerSample();
+	if (windowing && dispersionCompensation) {
+		klinearizationAndWindowingAndDispersionCompensation<TAPS><<<gridSize, blockSize, 0, stream>>>(out, in, d_resamplingFirstTaps, d_resamplingWeights, d_windowCurve, d_phaseCartesian, taps, signalLength, samplesPerBuffer);
+	} else if (windowing) {
+		klinearizationAndWindowing<TAPS><<<gridSize, blockSize, 0, stream>>>(out, in, d_resamplingFirstTaps, d_resamplingWeights, d_windowCurve, taps, signalLength, samplesPerBuffer);
+	} else {
+		klinearization<TAPS><<<gridSize, blockSize, 0, stream>>>(out, in, d_resamplingFirstTaps, d_resamplingWeights, taps, signalLength, samplesPerBuffer);
 	}
 }
 
-extern "C" void cuda_updateResampleCurve(float* h_resampleCurve, int size, cudaStream_t stream) {
-	if (d_resampleCurve != NULL && h_resampleCurve != NULL && size > 0 && size <= (int)signalLength){
-		checkCudaErrors(cudaMemcpyAsync(d_resampleCurve, h_resampleCurve, size * sizeof(float), cudaMemcpyHostToDevice, stream));
+//the number of taps of the plan is a template parameter, so that the dot product of the common interpolation methods is unrolled
+void cuda_klinearization(cufftComplex* out, cufftComplex* in, bool windowing, bool dispersionCompensation, cudaStream_t stream) {
+	switch (resamplingPlan.getTapsPerSample()) {
+	case 2: launchKlinearization<2>(out, in, windowing, dispersionCompensation, stream); break;
+	case 4: launchKlinearization<4>(out, in, windowing, dispersionCompensation, stream); break;
+	case RESAMPLING_MAX_TAPS: launchKlinearization<RESAMPLING_MAX_TAPS>(out, in, windowing, dispersionCompensation, stream); break;
+	default: launchKlinearization<0>(out, in, windowing, dispersionCompensation, stream); break;
 	}
 }
 
-extern "C" void initializeCuda(void* h_buffer1, void* h_buffer2, OctAlgorithmParameters* parameters) {
+cufftHandle getCachedFftPlan(int signalLength, int batch, cufftType type) {
+	std::tuple<int, int, cufftType> key(signalLength, batch, type);
+	auto it = fftPlanCache.find(key);
+	if (it != fftPlanCache.end()) {
+		return it->second;
+	}
+
+	//every plan holds its own work area in gpu memory, so the cache is limited and emptied if too many different sizes were used
+	if (fftPlanCache.size() >= FFT_PLAN_CACHE_SIZE) {
+		cuda_clearFftPlanCache();
+	}
+	cufftHandle plan;
+	checkCudaErrors(cufftPlan1d(&plan, signalLength, type, batch));
+	fftPlanCache[key] = plan;
+	return plan;
+}
+
+extern "C" void cuda_clearFftPlanCache() {
+	for (auto& entry : fftPlanCache) {
+		cufftDestroy(entry.second);
+	}
+	fftPlanCache.clear();
+}
+
+extern "C" void initializeCuda(void** h_buffers, unsigned int bufferCount, OctAlgorithmParameters* parameters) {
 	signalLength = parameters->samplesPerLine;
 	ascansPerBscan = parameters->ascansPerBscan;
 	bscansPerBuffer = parameters->bscansPerBuffer;
 	buffersPerVolume = parameters->buffersPerVolume;
 	samplesPerBuffer = signalLength*ascansPerBscan*bscansPerBuffer;
 	samplesPerVolume = samplesPerBuffer * buffersPerVolume;
-	host_buffer1 = h_buffer1;
-	host_buffer2 = h_buffer2;
 	params = parameters;
 	bytesPerSample = ceil((double)(parameters->bitDepth) / 8.0);
+	volumeStorage = parameters->volumeStorage;
+	bytesPerVolumeSample = getVolumeSampleSize(volumeStorage);
 
 	checkCudaErrors(cudaStreamCreate(&userRequestStream));
+	checkCudaErrors(cudaStreamCreateWithFlags(&copyStream, cudaStreamNonBlocking));
 
 	for (int i = 0; i < nStreams; i++)
 	{
 		checkCudaErrors(cudaStreamCreateWithFlags(&stream[i], cudaStreamNonBlocking));
 	}
 
-	checkCudaErrors(cudaEventCreateWithFlags(&syncEvent, cudaEventBlockingSync));
+	buffersInFlight = parameters->buffersInFlight < 1 ? 1 : (parameters->buffersInFlight > MAX_BUFFERS_IN_FLIGHT ? MAX_BUFFERS_IN_FLIGHT : parameters->buffersInFlight);
+	for (int i = 0; i < buffersInFlight; i++) {
+		//the host waits for uploadDone, blocking sync avoids a busy waiting cpu core
+		checkCudaErrors(cudaEventCreateWithFlags(&pipelineSlots[i].uploadDone, cudaEventBlockingSync | cudaEventDisableTiming));
+		checkCudaErrors(cudaEventCreateWithFlags(&pipelineSlots[i].processingDone, cudaEventDisableTiming));
+		checkCudaErrors(cudaEventCreateWithFlags(&pipelineSlots[i].outputDone, cudaEventDisableTiming));
+	}
+	checkCudaErrors(cudaEventCreateWithFlags(&displayProjectionEvent, cudaEventDisableTiming));
+	for (int i = 0; i < STAGE_EVENT_SETS; i++) {
+		for (int stage = 0; stage < NUMBER_OF_PROCESSING_STAGES; stage++) {
+			checkCudaErrors(cudaEventCreate(&stageEventSets[i].start[stage]));
+			checkCudaErrors(cudaEventCreate(&stageEventSets[i].end[stage]));
+		}
+		stageEventSets[i].pending = false;
+	}
+	nextStageEventSet = 0;
+	oldestStageEventSet = 0;
 	
 	cudaError_t err = cudaGetLastError();
 	if (err != cudaSuccess) {
@@ -963,21 +778,27 @@ extern "C" void initializeCuda(void* h_buffer1, void* h_buffer2, OctAlgorithmPar
 	checkCudaErrors(cudaPeekAtLastError());
 	checkCudaErrors(cudaDeviceSynchronize());
 
-	//resample curve
-	checkCudaErrors(cudaMalloc((void**)&d_resampleCurve, sizeof(float)*signalLength));
+	//tap tables of the resampling plan, filled in cuda_updateResamplingPlan
+	checkCudaErrors(cudaMalloc((void**)&d_resamplingFirstTaps, sizeof(int)*signalLength));
+	checkCudaErrors(cudaMalloc((void**)&d_resamplingWeights, sizeof(float)*signalLength*RESAMPLING_MAX_TAPS));
+	h_resampleCurve.assign(signalLength, 0.0f);
+	resamplingPlan.build(NULL, 0, parameters->resamplingInterpolation);
 
 	//dispersion curve
 	checkCudaErrors(cudaMalloc((void**)&d_dispersionCurve, sizeof(float)*signalLength));
 
-	//sinusoidal resample curve for sinusoidal scan correction
-	checkCudaErrors(cudaMalloc((void**)&d_sinusoidalResampleCurve, sizeof(float)*ascansPerBscan));
-	fillSinusoidalScanCorrectionCurve<<<ascansPerBscan, 1, 0, stream[0]>>> (d_sinusoidalResampleCurve, ascansPerBscan);
+	//source A-scans of the truncation for bscan flip and sinusoidal scan correction, filled in cuda_updateLineGather
+	checkCudaErrors(cudaMalloc((void**)&d_lineGather, sizeof(CpuLineGather)*ascansPerBscan*bscansPerBuffer));
+	h_lineGather.resize(ascansPerBscan*bscansPerBuffer);
+	h_sinusoidalResampleCurve.resize(ascansPerBscan);
+	CpuKernels::fillSinusoidalScanCorrectionCurve(h_sinusoidalResampleCurve.data(), ascansPerBscan);
+	lineGatherMode = -1;
 
 	//window curve
 	checkCudaErrors(cudaMalloc((void**)&d_windowCurve, sizeof(float)*signalLength));
 
-	//allocate device memory for raw signal	
-	for (int i = 0; i < nBuffers; i++)
+	//allocate device memory for raw signal, one buffer per pipeline slot
+	for (int i = 0; i < buffersInFlight; i++)
 	{
 		checkCudaErrors(cudaMalloc((void**)&d_inputBuffer[i], bytesPerSample*samplesPerBuffer));
 		cudaMemsetAsync(d_inputBuffer[i], 0, bytesPerSample*samplesPerBuffer, stream[0]);
@@ -1000,13 +821,28 @@ extern "C" void initializeCuda(void* h_buffer1, void* h_buffer2, OctAlgorithmPar
 	cudaMemsetAsync(d_phaseCartesian, 0, sizeof(cufftComplex)*signalLength, stream[0]);
 
 	//allocate device memory for processed signal
-	checkCudaErrors(cudaMalloc((void**)&d_processedBuffer, sizeof(float)*samplesPerVolume/2));
+	checkCudaErrors(cudaMalloc((void**)&d_processedBuffer, bytesPerVolumeSample*samplesPerVolume/2));
 	checkCudaErrors(cudaPeekAtLastError());
-	checkCudaErrors(cudaDeviceSynchronize());
 
-	//allocate device memory for temporary buffer for sinusoidal scan correction
-	checkCudaErrors(cudaMalloc((void**)&d_sinusoidalScanTmpBuffer, sizeof(float)*samplesPerBuffer/2));
-	checkCudaErrors(cudaPeekAtLastError());
+	//allocate device memory for the volume ring. Without enough memory processing continues without it
+	volumeRing.init((size_t)parameters->volumeRingMegabytes*1048576, bytesPerVolumeSample*samplesPerVolume/2);
+	if (volumeRing.isEnabled()) {
+		if (cudaMalloc((void**)&d_volumeRing, volumeRing.getMemorySize()) != cudaSuccess || cudaMalloc(&d_volumeRingOutput, sizeof(unsigned int)*(signalLength/2)*ascansPerBscan) != cudaSuccess) {
+			cudaGetLastError();
+			printf("Cuda: Not enough device memory for volume ring of %u MB. Volume ring disabled.\n", parameters->volumeRingMegabytes);
+			if (d_volumeRing != NULL) {
+				cudaFree(d_volumeRing);
+				d_volumeRing = NULL;
+			}
+			volumeRing.init(0, 0);
+		}
+	}
+
+	//allocate device memory for running sums/maxima of averaging and MIP in B-scan and en face view
+	checkCudaErrors(cudaMalloc((void**)&d_bscanProjection, sizeof(DisplayProjectionPixel)*(signalLength/2)*ascansPerBscan));
+	checkCudaErrors(cudaMalloc((void**)&d_enFaceProjection, sizeof(DisplayProjectionPixel)*ascansPerBscan*bscansPerBuffer*buffersPerVolume));
+	bscanProjectionWindow.invalidate();
+	enFaceProjectionWindow.invalidate();
 	checkCudaErrors(cudaDeviceSynchronize());
 
 	//allocate device memory for fft buffer
@@ -1018,6 +854,7 @@ extern "C" void initializeCuda(void* h_buffer1, void* h_buffer2, OctAlgorithmPar
 	//allocate device memory for fixed noise removal mean A-scan
 	checkCudaErrors(cudaMalloc((void**)&d_meanALine, sizeof(cufftComplex)*signalLength));
 	cudaMemsetAsync(d_meanALine, 0, sizeof(cufftComplex)*signalLength, stream[0]);
+	checkCudaErrors(cudaMalloc((void**)&d_segmentStatistics, sizeof(float3)*FIXED_PATTERN_NOISE_REMOVAL_SEGMENTS*(signalLength/2)));
 	checkCudaErrors(cudaPeekAtLastError());
 	checkCudaErrors(cudaDeviceSynchronize());
 	
@@ -1027,17 +864,23 @@ extern "C" void initializeCuda(void* h_buffer1, void* h_buffer2, OctAlgorithmPar
 	checkCudaErrors(cudaPeekAtLastError());
 	checkCudaErrors(cudaDeviceSynchronize());
 
-	//register existing host memory for use by cuda to accelerate cudaMemcpy
+	//register existing host memory of every acquisition buffer for use by cuda to accelerate cudaMemcpy. uploads from pageable memory are staged and synchronous
+	hostBuffers.clear();
+	for (unsigned int i = 0; i < bufferCount; i++) {
+		void* hostBuffer = h_buffers[i];
+		if (hostBuffer == NULL || std::find(hostBuffers.begin(), hostBuffers.end(), hostBuffer) != hostBuffers.end()) {
+			continue; //memory can only be registered once
+		}
 #ifdef __aarch64__
-	checkCudaErrors(cudaHostAlloc((void**)&host_buffer1, samplesPerBuffer * bytesPerSample, cudaHostAllocPortable)); //todo: check if memory is allocated twice and adjust host code such that memory allocation just happens once (cudaHostAlloc will allocate memory but the host already allocated memory)
-	checkCudaErrors(cudaHostAlloc((void**)&host_buffer2, samplesPerBuffer * bytesPerSample, cudaHostAllocPortable));
+		checkCudaErrors(cudaHostAlloc((void**)&hostBuffer, samplesPerBuffer * bytesPerSample, cudaHostAllocPortable)); //todo: check if memory is allocated twice and adjust host code such that memory allocation just happens once (cudaHostAlloc will allocate memory but the host already allocated memory)
 #else
-	checkCudaErrors(cudaHostRegister(host_buffer1, samplesPerBuffer * bytesPerSample, cudaHostRegisterPortable));
-	checkCudaErrors(cudaHostRegister(host_buffer2, samplesPerBuffer * bytesPerSample, cudaHostRegisterPortable));
+		checkCudaErrors(cudaHostRegister(hostBuffer, samplesPerBuffer * bytesPerSample, cudaHostRegisterPortable));
 #endif
+		hostBuffers.push_back(hostBuffer);
+	}
 
-	//create fft plan and set stream
-	cufftPlan1d(&d_plan, signalLength, CUFFT_C2C, ascansPerBscan*bscansPerBuffer);
+	//get fft plan from cache. planning is only done on the first start with a new buffer size
+	d_plan = getCachedFftPlan(signalLength, ascansPerBscan*bscansPerBuffer, CUFFT_C2C);
 	checkCudaErrors(cudaPeekAtLastError());
 	checkCudaErrors(cudaDeviceSynchronize());
 
@@ -1049,8 +892,8 @@ extern "C" void initializeCuda(void* h_buffer1, void* h_buffer2, OctAlgorithmPar
 	streamedBuffers = 0;
 	fixedPatternNoiseDetermined = false;
 
-	//todo: find a way to automatically determine optimal blockSize and optimal gridSize
-	blockSize = 128;
+	//threads per block can be determined for the current geometry and gpu by the autotuner
+	blockSize = isValidCudaBlockSize(parameters->cudaBlockSize, samplesPerBuffer) ? parameters->cudaBlockSize : CUDA_DEFAULT_BLOCK_SIZE;
 	gridSize = samplesPerBuffer / blockSize;
 	currStream = 0;
 	currBuffer = 0;
@@ -1058,7 +901,7 @@ extern "C" void initializeCuda(void* h_buffer1, void* h_buffer2, OctAlgorithmPar
 
 extern "C" void cleanupCuda() {
 	if (cudaInitialized) {
-		for (int i = 0; i < nBuffers; i++)
+		for (int i = 0; i < buffersInFlight; i++)
 		{
 			freeCudaMem(d_inputBuffer[i]);
 		}
@@ -1066,32 +909,60 @@ extern "C" void cleanupCuda() {
 		freeCudaMem(d_windowCurve);
 		freeCudaMem(d_fftBuffer);
 		freeCudaMem(d_meanALine);
+		freeCudaMem(d_segmentStatistics);
 		freeCudaMem(d_postProcBackgroundLine);
 		freeCudaMem(d_processedBuffer);
-		freeCudaMem(d_sinusoidalScanTmpBuffer);
+		if (d_enFaceVolume != NULL) {
+			freeCudaMem(d_enFaceVolume);
+			d_enFaceVolume = NULL; //allocated on demand in cuda_updateEnFaceVolume
+		}
+		enFaceVolumeValid = false;
+		if (d_volumeRing != NULL) {
+			freeCudaMem(d_volumeRing);
+			d_volumeRing = NULL;
+		}
+		if (d_volumeRingOutput != NULL) {
+			freeCudaMem(d_volumeRingOutput);
+			d_volumeRingOutput = NULL;
+		}
+		volumeRing.init(0, 0);
+		freeCudaMem(d_bscanProjection);
+		freeCudaMem(d_enFaceProjection);
 		freeCudaMem(d_inputLinearized);
 		freeCudaMem(d_phaseCartesian);
-		freeCudaMem(d_resampleCurve);
+		freeCudaMem(d_resamplingFirstTaps);
+		freeCudaMem(d_resamplingWeights);
 		freeCudaMem(d_dispersionCurve);
-		freeCudaMem(d_sinusoidalResampleCurve);
+		freeCudaMem(d_lineGather);
 
-		cufftDestroy(d_plan);
+		//d_plan stays in fftPlanCache and is reused on the next start
 
 		checkCudaErrors(cudaStreamDestroy(userRequestStream));
+		checkCudaErrors(cudaStreamDestroy(copyStream));
 		
 		for (int i = 0; i < nStreams; i++)
 		{
 			checkCudaErrors(cudaStreamDestroy(stream[i]));
 		}
 
-		checkCudaErrors(cudaEventDestroy(syncEvent));
-
-		if (host_buffer1 != NULL) {
-			cudaHostUnregister(host_buffer1);
+		for (int i = 0; i < buffersInFlight; i++) {
+			checkCudaErrors(cudaEventDestroy(pipelineSlots[i].uploadDone));
+			checkCudaErrors(cudaEventDestroy(pipelineSlots[i].processingDone));
+			checkCudaErrors(cudaEventDestroy(pipelineSlots[i].outputDone));
+		}
+		checkCudaErrors(cudaEventDestroy(displayProjectionEvent));
+		for (int i = 0; i < STAGE_EVENT_SETS; i++) {
+			for (int stage = 0; stage < NUMBER_OF_PROCESSING_STAGES; stage++) {
+				checkCudaErrors(cudaEventDestroy(stageEventSets[i].start[stage]));
+				checkCudaErrors(cudaEventDestroy(stageEventSets[i].end[stage]));
+			}
+			stageEventSets[i].pending = false;
 		}
-		if (host_buffer2 != NULL) {
-			cudaHostUnregister(host_buffer2);
+
+		for (size_t i = 0; i < hostBuffers.size(); i++) {
+			cudaHostUnregister(hostBuffers[i]);
 		}
+		hostBuffers.clear();
 
 		cudaInitialized = false;
 		fixedPatternNoiseDetermined = false;
@@ -1108,42 +979,125 @@ extern "C" void freeCudaMem(void* data) {
 	}
 }
 
-extern "C" void changeDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
-	void* d_bscanDisplayBuffer = NULL;
-	if (cuBufHandleBscan != NULL) {
-		d_bscanDisplayBuffer = cuda_map(cuBufHandleBscan, userRequestStream);
+void cuda_updateEnFaceVolume(const void* d_currBuffer, const unsigned int bufferNumber, cudaStream_t stream) {
+	//the en face view reads one sample of every A-scan. In d_processedBuffer these samples are signalLength/2 samples apart, in the depth-major copy they are contiguous
+	if (!params->enFaceViewEnabled) {
+		if (d_enFaceVolume != NULL) {
+			freeCudaMem(d_enFaceVolume);
+			d_enFaceVolume = NULL;
+		}
+		enFaceVolumeValid = false;
+		return;
 	}
-	//update 2D b-scan display
-	int width = signalLength;
-	int height = ascansPerBscan;
-	int depth = bscansPerBuffer*buffersPerVolume;
-	int samplesPerFrame = width * height;
-	if (d_bscanDisplayBuffer != NULL) {
-		frameNr = frameNr >= 0 && frameNr < depth ? frameNr : 0;
-		updateDisplayedBscanFrame<<<gridSize/2, blockSize, 0, userRequestStream>>>((float*)d_bscanDisplayBuffer, d_processedBuffer, depth, samplesPerFrame / 2, frameNr, displayFunctionFrames, displayFunction);
+	if (d_enFaceVolume == NULL) {
+		enFaceVolumeValid = false;
+		if (cudaMalloc((void**)&d_enFaceVolume, bytesPerVolumeSample*samplesPerVolume/2) != cudaSuccess) {
+			cudaGetLastError(); //reset error, the en face view falls back to d_processedBuffer
+			d_enFaceVolume = NULL;
+			return;
+		}
 	}
-	if (cuBufHandleBscan != NULL) {
-		cuda_unmap(cuBufHandleBscan, userRequestStream);
+	unsigned int samplesPerAscan = signalLength/2;
+	unsigned int linesPerBuffer = ascansPerBscan*bscansPerBuffer;
+	unsigned int linesPerVolume = linesPerBuffer*buffersPerVolume;
+	dim3 transposeBlock(TRANSPOSE_TILE_DIM, TRANSPOSE_BLOCK_ROWS);
+	if (enFaceVolumeValid) {
+		dim3 transposeGrid((samplesPerAscan+TRANSPOSE_TILE_DIM-1)/TRANSPOSE_TILE_DIM, (linesPerBuffer+TRANSPOSE_TILE_DIM-1)/TRANSPOSE_TILE_DIM);
+		FOR_VOLUME_STORAGE(volumeStorage, transposeToEnFace<VolumeSample><<<transposeGrid, transposeBlock, 0, stream>>>((VolumeSample*)d_enFaceVolume, (const VolumeSample*)d_currBuffer, samplesPerAscan, linesPerVolume, bufferNumber*linesPerBuffer, linesPerBuffer));
+	} else {
+		//the view has just been enabled: copy the whole volume once
+		dim3 transposeGrid((samplesPerAscan+TRANSPOSE_TILE_DIM-1)/TRANSPOSE_TILE_DIM, (linesPerVolume+TRANSPOSE_TILE_DIM-1)/TRANSPOSE_TILE_DIM);
+		FOR_VOLUME_STORAGE(volumeStorage, transposeToEnFace<VolumeSample><<<transposeGrid, transposeBlock, 0, stream>>>((VolumeSample*)d_enFaceVolume, (const VolumeSample*)d_processedBuffer, samplesPerAscan, linesPerVolume, 0, linesPerVolume));
+		enFaceVolumeValid = true;
 	}
 }
 
-//todo: simplify/refactor changeDisplayedEnfaceFrame and changedisplaydBscanFrame. avoid duplicate code
-extern "C" void changeDisplayedEnFaceFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
-	void* d_enFaceViewDisplayBuffer = NULL;
-	if (cuBufHandleEnFaceView != NULL) {
-		d_enFaceViewDisplayBuffer = cuda_map(cuBufHandleEnFaceView, userRequestStream);
+//d_enFaceVolume if it is up to date, d_processedBuffer otherwise
+const void* cuda_getEnFaceSource(unsigned int& pixelStride, unsigned int& frameStride) {
+	if (enFaceVolumeValid) {
+		pixelStride = 1;
+		frameStride = ascansPerBscan*bscansPerBuffer*buffersPerVolume;
+		return d_enFaceVolume;
 	}
-	//update 2D en face view display
-	unsigned int width = bscansPerBuffer*buffersPerVolume;
-	unsigned int height = ascansPerBscan;
-	unsigned int samplesPerFrame = width * height;
-	if (d_enFaceViewDisplayBuffer != NULL) {
-		frameNr = frameNr >= 0 && frameNr < signalLength/2 ? frameNr : 0;
-		updateDisplayedEnFaceViewFrame<<<width, height, 0, userRequestStream>>>((float*)d_enFaceViewDisplayBuffer, d_processedBuffer, signalLength/2, samplesPerFrame, frameNr, displayFunctionFrames, displayFunction);
+	pixelStride = signalLength/2;
+	frameStride = 1;
+	return d_processedBuffer;
+}
+
+//volume of d_volumeRing that was completed volumesAgo volumes before the current one, NULL if volumesAgo is 0 or the volume is not available
+const unsigned char* cuda_getVolumeFromRing(unsigned int volumesAgo) {
+	size_t offset;
+	if (d_volumeRing == NULL || !volumeRing.getVolumeOffset(volumesAgo, offset)) {
+		return NULL;
 	}
-	if (cuBufHandleEnFaceView != NULL) {
-		cuda_unmap(cuBufHandleEnFaceView, userRequestStream);
+	return d_volumeRing + offset;
+}
+
+//B-scan view: pixel p of frame f is d_processedBuffer[p + f*pixelsPerBscan]. En face view: see cuda_getEnFaceSource
+void cuda_removeBufferFromDisplayProjections(const unsigned int bufferNumber, cudaStream_t stream) {
+	//the running sums need the old values of the frames that are about to be overwritten by the current buffer
+	if (!params->bscanViewEnabled) {
+		bscanProjectionWindow.invalidate();
+	}
+	if (!params->enFaceViewEnabled) {
+		enFaceProjectionWindow.invalidate();
 	}
+	unsigned int bscanPixels = (signalLength/2)*ascansPerBscan;
+	unsigned int linesPerBuffer = ascansPerBscan*bscansPerBuffer;
+	unsigned int firstBscan = bufferNumber*bscansPerBuffer;
+	checkCudaErrors(cudaStreamWaitEvent(stream, displayProjectionEvent, 0));
+	if (bscanProjectionWindow.overlaps(firstBscan, firstBscan+bscansPerBuffer)) {
+		FOR_VOLUME_STORAGE(volumeStorage, removeDisplayProjectionFrames<VolumeSample><<<(bscanPixels+blockSize-1)/blockSize, blockSize, 0, stream>>>(d_bscanProjection, (const VolumeSample*)d_processedBuffer, 1, bscanPixels, bscanProjectionWindow, firstBscan, firstBscan+bscansPerBuffer, 0, bscanPixels));
+	}
+	if (enFaceProjectionWindow.valid) {
+		unsigned int pixelStride, frameStride;
+		const void* d_enFaceSource = cuda_getEnFaceSource(pixelStride, frameStride);
+		FOR_VOLUME_STORAGE(volumeStorage, removeDisplayProjectionFrames<VolumeSample><<<(linesPerBuffer+blockSize-1)/blockSize, blockSize, 0, stream>>>(d_enFaceProjection, (const VolumeSample*)d_enFaceSource, pixelStride, frameStride, enFaceProjectionWindow, 0, signalLength/2, bufferNumber*linesPerBuffer, (bufferNumber+1)*linesPerBuffer));
+	}
+}
+
+void cuda_addBufferToDisplayProjections(const unsigned int bufferNumber, cudaStream_t stream) {
+	unsigned int bscanPixels = (signalLength/2)*ascansPerBscan;
+	unsigned int linesPerBuffer = ascansPerBscan*bscansPerBuffer;
+	unsigned int firstBscan = bufferNumber*bscansPerBuffer;
+	if (bscanProjectionWindow.overlaps(firstBscan, firstBscan+bscansPerBuffer)) {
+		FOR_VOLUME_STORAGE(volumeStorage, addDisplayProjectionFrames<VolumeSample><<<(bscanPixels+blockSize-1)/blockSize, blockSize, 0, stream>>>(d_bscanProjection, (const VolumeSample*)d_processedBuffer, 1, bscanPixels, bscanProjectionWindow, firstBscan, firstBscan+bscansPerBuffer, 0, bscanPixels));
+	}
+	if (enFaceProjectionWindow.valid) {
+		unsigned int pixelStride, frameStride;
+		const void* d_enFaceSource = cuda_getEnFaceSource(pixelStride, frameStride);
+		FOR_VOLUME_STORAGE(volumeStorage, addDisplayProjectionFrames<VolumeSample><<<(linesPerBuffer+blockSize-1)/blockSize, blockSize, 0, stream>>>(d_enFaceProjection, (const VolumeSample*)d_enFaceSource, pixelStride, frameStride, enFaceProjectionWindow, 0, signalLength/2, bufferNumber*linesPerBuffer, (bufferNumber+1)*linesPerBuffer));
+	}
+	checkCudaErrors(cudaEventRecord(displayProjectionEvent, stream));
+}
+
+extern "C" void changeDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
+	updateBscanDisplayBuffer(frameNr, displayFunctionFrames, displayFunction, userRequestStream);
+}
+
+extern "C" void changeDisplayedEnFaceFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
+	updateEnFaceDisplayBuffer(frameNr, displayFunctionFrames, displayFunction, userRequestStream);
+}
+
+extern "C" unsigned int cuda_getCompleteVolumesInRing() {
+	return volumeRing.getCompleteVolumes();
+}
+
+extern "C" bool cuda_copyBscanFromVolumeRing(unsigned int volumesAgo, unsigned int bscanNr, void* h_output) {
+	const unsigned char* d_ringVolume = cuda_getVolumeFromRing(volumesAgo);
+	if (!cudaInitialized || d_ringVolume == NULL || h_output == NULL || bscanNr >= bscansPerBuffer*buffersPerVolume) {
+		return false;
+	}
+	//the last buffers of the requested volume may still be copied into the ring by the processing streams
+	for (int i = 0; i < buffersInFlight; i++) {
+		checkCudaErrors(cudaStreamWaitEvent(userRequestStream, pipelineSlots[i].processingDone, 0));
+	}
+	unsigned int samplesPerBscan = (signalLength/2)*ascansPerBscan;
+	const unsigned char* d_bscan = d_ringVolume + bytesPerVolumeSample*samplesPerBscan*bscanNr;
+	FOR_VOLUME_STORAGE(volumeStorage, floatToOutput<VolumeSample><<<(samplesPerBscan+blockSize-1)/blockSize, blockSize, 0, userRequestStream>>>(d_volumeRingOutput, (const VolumeSample*)d_bscan, params->bitDepth, samplesPerBscan));
+	checkCudaErrors(cudaMemcpyAsync(h_output, d_volumeRingOutput, bytesPerSample*samplesPerBscan, cudaMemcpyDeviceToHost, userRequestStream));
+	checkCudaErrors(cudaStreamSynchronize(userRequestStream));
+	return true;
 }
 
 extern "C" inline void updateBscanDisplayBuffer(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction, cudaStream_t stream) {
@@ -1152,13 +1106,25 @@ extern "C" inline void updateBscanDisplayBuffer(unsigned int frameNr, unsigned i
 		d_bscanDisplayBuffer = cuda_map(cuBufHandleBscan, stream);
 	}
 	//update 2D b-scan display
-	int width = signalLength;
-	int height = ascansPerBscan;
-	int depth = bscansPerBuffer * buffersPerVolume;
-	int samplesPerFrame = width * height;
+	unsigned int pixels = (signalLength/2)*ascansPerBscan;
+	unsigned int depth = bscansPerBuffer*buffersPerVolume;
 	if (d_bscanDisplayBuffer != NULL) {
-		frameNr = frameNr >= 0 && frameNr < depth ? frameNr : 0;
-		updateDisplayedBscanFrame<<<gridSize/2, blockSize, 0, stream>>>((float*)d_bscanDisplayBuffer, d_processedBuffer, depth, samplesPerFrame / 2, frameNr, displayFunctionFrames, displayFunction);
+		frameNr = frameNr < depth ? frameNr : 0;
+		//a volume from the volume ring is displayed with a projection that is recomputed from scratch, the running projection always belongs to d_processedBuffer
+		const unsigned char* d_ringVolume = cuda_getVolumeFromRing(params->displayedVolumeAge);
+		if (d_ringVolume != NULL) {
+			bscanProjectionWindow.invalidate();
+		}
+		bool projecting = bscanProjectionWindow.setWindow(frameNr, displayFunctionFrames, displayFunction, depth);
+		const unsigned char* d_source = d_ringVolume != NULL ? d_ringVolume : d_processedBuffer;
+		checkCudaErrors(cudaStreamWaitEvent(stream, displayProjectionEvent, 0));
+		FOR_VOLUME_STORAGE(volumeStorage, updateDisplayProjection<VolumeSample><<<(pixels+blockSize-1)/blockSize, blockSize, 0, stream>>>((float*)d_bscanDisplayBuffer, d_bscanProjection, (const VolumeSample*)d_source, pixels, 1, pixels, frameNr, bscanProjectionWindow, projecting));
+		checkCudaErrors(cudaEventRecord(displayProjectionEvent, stream));
+		if (d_ringVolume != NULL) {
+			bscanProjectionWindow.invalidate();
+		}
+	} else {
+		bscanProjectionWindow.invalidate();
 	}
 	if (cuBufHandleBscan != NULL) {
 		cuda_unmap(cuBufHandleBscan, stream);
@@ -1171,19 +1137,37 @@ extern "C" inline void updateEnFaceDisplayBuffer(unsigned int frameNr, unsigned
 		d_enFaceViewDisplayBuffer = cuda_map(cuBufHandleEnFaceView, stream);
 	}
 	//update 2D en face view display
-	unsigned int width = bscansPerBuffer * buffersPerVolume;
-	unsigned int height = ascansPerBscan;
-	unsigned int samplesPerFrame = width * height;
+	unsigned int pixels = bscansPerBuffer*buffersPerVolume*ascansPerBscan;
+	unsigned int frameWidth = signalLength/2;
 	if (d_enFaceViewDisplayBuffer != NULL) {
-		frameNr = frameNr >= 0 && frameNr < signalLength/2 ? frameNr : 0;
-		updateDisplayedEnFaceViewFrame<<<width, height, 0, stream>>>((float*)d_enFaceViewDisplayBuffer, d_processedBuffer, signalLength/2, samplesPerFrame, frameNr, displayFunctionFrames, displayFunction);
+		frameNr = frameNr < frameWidth ? frameNr : 0;
+		const unsigned char* d_ringVolume = cuda_getVolumeFromRing(params->displayedVolumeAge);
+		if (d_ringVolume != NULL) {
+			enFaceProjectionWindow.invalidate();
+		}
+		bool projecting = enFaceProjectionWindow.setWindow(frameNr, displayFunctionFrames, displayFunction, frameWidth);
+		unsigned int pixelStride, frameStride;
+		const void* d_enFaceSource = cuda_getEnFaceSource(pixelStride, frameStride);
+		if (d_ringVolume != NULL) {
+			pixelStride = signalLength/2;
+			frameStride = 1;
+			d_enFaceSource = d_ringVolume;
+		}
+		checkCudaErrors(cudaStreamWaitEvent(stream, displayProjectionEvent, 0));
+		FOR_VOLUME_STORAGE(volumeStorage, updateDisplayProjection<VolumeSample><<<(pixels+blockSize-1)/blockSize, blockSize, 0, stream>>>((float*)d_enFaceViewDisplayBuffer, d_enFaceProjection, (const VolumeSample*)d_enFaceSource, pixels, pixelStride, frameStride, frameNr, enFaceProjectionWindow, projecting));
+		checkCudaErrors(cudaEventRecord(displayProjectionEvent, stream));
+		if (d_ringVolume != NULL) {
+			enFaceProjectionWindow.invalidate();
+		}
+	} else {
+		enFaceProjectionWindow.invalidate();
 	}
 	if (cuBufHandleEnFaceView != NULL) {
 		cuda_unmap(cuBufHandleEnFaceView, stream);
 	}
 }
 
-extern "C" inline void updateVolumeDisplayBuffer(const float* d_currBuffer, const unsigned int currentBufferNr, const unsigned int bscansPerBuffer, cudaStream_t stream) {
+extern "C" inline void updateVolumeDisplayBuffer(const void* d_currBuffer, const unsigned int currentBufferNr, const unsigned int bscansPerBuffer, cudaStream_t stream) {
 	//map graphics resource for access by cuda
 	cudaArray* d_volumeViewDisplayBuffer = NULL;
 	if (cuBufHandleVolumeView != NULL) {
@@ -1208,7 +1192,7 @@ extern "C" inline void updateVolumeDisplayBuffer(const float* d_currBuffer, cons
 	        }
 	
 	        dim3 texture_dim(height, width, depth); //todo: use consistent naming of width, height, depth, x, y, z, ...
-	        updateDisplayedVolume<< <gridSize/2, blockSize, 0, stream>>>(surfaceWrite, d_currBuffer, samplesPerBuffer/2, currentBufferNr, bscansPerBuffer, texture_dim);
+	        FOR_VOLUME_STORAGE(volumeStorage, updateDisplayedVolume<VolumeSample><< <gridSize/2, blockSize, 0, stream>>>(surfaceWrite, (const VolumeSample*)d_currBuffer, samplesPerBuffer/2, currentBufferNr, bscansPerBuffer, texture_dim));
 	        cudaDestroySurfaceObject(surfaceWrite);
 #else
 		//bind voxel array to a writable cuda surface
@@ -1220,7 +1204,7 @@ extern "C" inline void updateVolumeDisplayBuffer(const float* d_currBuffer, cons
 
 		//write to cuda surface
 		dim3 texture_dim(height, width, depth); //todo: use consistent naming of width, height, depth, x, y, z, ...
-		updateDisplayedVolume<< <gridSize/2, blockSize, 0, stream>>>(d_currBuffer, samplesPerBuffer/2, currentBufferNr, bscansPerBuffer, texture_dim);
+		FOR_VOLUME_STORAGE(volumeStorage, updateDisplayedVolume<VolumeSample><< <gridSize/2, blockSize, 0, stream>>>((const VolumeSample*)d_currBuffer, samplesPerBuffer/2, currentBufferNr, bscansPerBuffer, texture_dim));
 #endif
     }
 
@@ -1230,18 +1214,59 @@ extern "C" inline void updateVolumeDisplayBuffer(const float* d_currBuffer, cons
 	}
 }
 
-inline void streamProcessedData(float* d_currProcessedBuffer, cudaStream_t stream) {
+inline void startStage(StageEventSet& set, PROCESSING_STAGE stage, cudaStream_t stream) {
+	checkCudaErrors(cudaEventRecord(set.start[stage], stream));
+}
+
+inline void endStage(StageEventSet& set, PROCESSING_STAGE stage, cudaStream_t stream) {
+	checkCudaErrors(cudaEventRecord(set.end[stage], stream));
+	set.stageUsed[stage] = true;
+	set.lastStage = stage;
+}
+
+//event sets complete in the order in which they were recorded, so reading stops at the first set that is not complete yet
+void collectStageTimes(bool wait) {
+	StageTimings* timings = StageTimings::getInstance();
+	while (stageEventSets[oldestStageEventSet].pending) {
+		StageEventSet& set = stageEventSets[oldestStageEventSet];
+		if (wait) {
+			checkCudaErrors(cudaEventSynchronize(set.end[set.lastStage]));
+		} else if (cudaEventQuery(set.end[set.lastStage]) != cudaSuccess) {
+			return;
+		}
+		for (int stage = 0; stage < NUMBER_OF_PROCESSING_STAGES; stage++) {
+			float milliseconds = 0.0f;
+			if (set.stageUsed[stage] && cudaEventElapsedTime(&milliseconds, set.start[stage], set.end[stage]) == cudaSuccess) {
+				timings->record(static_cast<PROCESSING_STAGE>(stage), milliseconds);
+			}
+		}
+		set.pending = false;
+		oldestStageEventSet = (oldestStageEventSet+1)%STAGE_EVENT_SETS;
+	}
+}
+
+inline void streamProcessedData(const void* d_currProcessedBuffer, cudaStream_t stream, StageEventSet& stageEvents) {
 	if (streamedBuffers % (params->streamingBuffersToSkip + 1) == 0) {
+		startStage(stageEvents, STAGE_STREAMING, stream);
 		streamedBuffers = 0; //set to zero to avoid overflow
 		streamingBufferNumber = (streamingBufferNumber + 1) % 2;
 		void* hostDestBuffer = streamingBufferNumber == 0 ? host_streamingBuffer1 : host_streamingBuffer2;
-		floatToOutput<<<gridSize / 2, blockSize, 0, stream>>> (d_outputBuffer, d_currProcessedBuffer, params->bitDepth, samplesPerBuffer / 2);
+		FOR_VOLUME_STORAGE(volumeStorage, floatToOutput<VolumeSample><<<gridSize / 2, blockSize, 0, stream>>> (d_outputBuffer, (const VolumeSample*)d_currProcessedBuffer, params->bitDepth, samplesPerBuffer / 2));
 		checkCudaErrors(cudaMemcpyAsync(hostDestBuffer, (void*)d_outputBuffer, (samplesPerBuffer / 2) * bytesPerSample, cudaMemcpyDeviceToHost, stream));
 		checkCudaErrors(cudaLaunchHostFunc(stream, Gpu2HostNotifier::dh2StreamingCallback, hostDestBuffer));
+		endStage(stageEvents, STAGE_STREAMING, stream);
 	}
 	streamedBuffers++;
 }
 
+//copies samplesPerLine samples of every A-scan to pageable host memory. Such copies are synchronous, which is fine for the validation
+inline void captureStage(CAPTURE_STAGE stage, const cufftComplex* d_data, size_t samplesPerLine, cudaStream_t stream) {
+	size_t lines = samplesPerBuffer/signalLength;
+	h_capturedStages[stage].resize(lines*samplesPerLine);
+	checkCudaErrors(cudaMemcpy2DAsync(h_capturedStages[stage].data(), samplesPerLine*sizeof(cufftComplex), d_data, signalLength*sizeof(cufftComplex), samplesPerLine*sizeof(cufftComplex), lines, cudaMemcpyDeviceToHost, stream));
+	stageCaptured[stage] = true;
+}
+
 extern "C" void octCudaPipeline(void* h_inputSignal) {
 	//check if cuda buffers are initialized
 	if (!cudaInitialized) {
@@ -1249,15 +1274,34 @@ extern "C" void octCudaPipeline(void* h_inputSignal) {
 		return;
 	}
 	
+	int previousBuffer = currBuffer;
 	currStream = (currStream+1)%nStreams;
-	currBuffer = (currBuffer+1)%nBuffers;
+	currBuffer = (currBuffer+1)%buffersInFlight;
+	PipelineSlot& slot = pipelineSlots[currBuffer];
+	PipelineSlot& previousSlot = pipelineSlots[previousBuffer];
 
-	//copy raw oct signal from host
+	//copy raw oct signal from host as soon as the input buffer of this slot is not needed anymore by the buffer that used it before
+	checkCudaErrors(cudaStreamWaitEvent(copyStream, slot.processingDone, 0));
 	if (h_inputSignal != NULL) {
-		checkCudaErrors(cudaMemcpyAsync(d_inputBuffer[currBuffer], h_inputSignal, samplesPerBuffer * bytesPerSample, cudaMemcpyHostToDevice, stream[currStream]));
+		checkCudaErrors(cudaMemcpyAsync(d_inputBuffer[currBuffer], h_inputSignal, samplesPerBuffer * bytesPerSample, cudaMemcpyHostToDevice, copyStream));
 	}
+	checkCudaErrors(cudaEventRecord(slot.uploadDone, copyStream));
+
+	//spectral processing uses buffers (d_fftBuffer, d_inputLinearized, ...) that exist only once, so it starts after the previous buffer is through them
+	checkCudaErrors(cudaStreamWaitEvent(stream[currStream], slot.uploadDone, 0));
+	checkCudaErrors(cudaStreamWaitEvent(stream[currStream], previousSlot.processingDone, 0));
+
+	//the event set that is reused now belongs to a buffer that has been completed long ago
+	collectStageTimes(false);
+	if (stageEventSets[nextStageEventSet].pending) {
+		collectStageTimes(true);
+	}
+	StageEventSet& stageEvents = stageEventSets[nextStageEventSet];
+	nextStageEventSet = (nextStageEventSet+1)%STAGE_EVENT_SETS;
+	std::fill(stageEvents.stageUsed, stageEvents.stageUsed+NUMBER_OF_PROCESSING_STAGES, false);
 
 	//start processing: convert input array to cufft complex array
+	startStage(stageEvents, STAGE_CONVERSION, stream[currStream]);
 	if (params->bitshift) {
 		inputToCufftComplex_and_bitshift<<<gridSize, blockSize, 0, stream[currStream]>>> (d_fftBuffer, d_inputBuffer[currBuffer], signalLength,  signalLength, params->bitDepth, samplesPerBuffer);
 	}
@@ -1265,22 +1309,26 @@ extern "C" void octCudaPipeline(void* h_inputSignal) {
 		inputToCufftComplex<<<gridSize, blockSize, 0, stream[currStream]>>> (d_fftBuffer, d_inputBuffer[currBuffer], signalLength, signalLength, params->bitDepth, samplesPerBuffer);
 	}
 	
-	//synchronization: block the host during cudaMemcpyAsync and inputToCufftComplex to prevent the data acquisition of the virtual OCT system from outpacing the processing, ensuring proper synchronization in the pipeline.
-	cudaEventRecord(syncEvent, stream[currStream]);
-	cudaEventSynchronize(syncEvent);
-
 	//rolling average background subtraction
 	if (params->backgroundRemoval){
-		rollingAverageBackgroundRemoval<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, params->rollingAverageWindowSize, signalLength, ascansPerBscan, signalLength*ascansPerBscan, samplesPerBuffer);
+		size_t sharedMemory = sizeof(double)*(signalLength+1);
+		if (sharedMemory + sizeof(double)*ROLLING_AVERAGE_BLOCK_SIZE <= ROLLING_AVERAGE_MAX_SHARED_MEMORY) {
+			rollingAverageBackgroundRemovalPrefixSum<<<samplesPerBuffer/signalLength, ROLLING_AVERAGE_BLOCK_SIZE, sharedMemory, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, params->rollingAverageWindowSize, signalLength);
+		} else {
+			//A-scans with more than about 5900 samples do not fit into shared memory
+			rollingAverageBackgroundRemoval<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, params->rollingAverageWindowSize, signalLength, ascansPerBscan, signalLength*ascansPerBscan, samplesPerBuffer);
+		}
 		cufftComplex* tmpSwapPointer = d_inputLinearized;
 		d_inputLinearized = d_fftBuffer;
 		d_fftBuffer = tmpSwapPointer;
 	}
+	endStage(stageEvents, STAGE_CONVERSION, stream[currStream]);
 
 	//update k-linearization-, dispersion- and windowing-curves if necessary
 	cufftComplex* d_fftBuffer2 = d_fftBuffer;
-	if (params->resampling && params->resamplingUpdated) {
-		cuda_updateResampleCurve(params->resampleCurve, params->resampleCurveLength, stream[currStream]);
+	//the resampling plan is only rebuilt if the curve or the interpolation method changed
+	if (params->resampling && (params->resamplingUpdated || !resamplingPlan.isBuilt() || params->resamplingInterpolation != resamplingPlan.getInterpolation())) {
+		cuda_updateResamplingPlan(params->resamplingUpdated ? params->resampleCurve : NULL, params->resampleCurveLength, params->resamplingInterpolation, stream[currStream]);
 		params->resamplingUpdated = false;
 	}
 	if (params->dispersionCompensation && params->dispersionUpdated) {
@@ -1294,29 +1342,14 @@ extern "C" void octCudaPipeline(void* h_inputSignal) {
 	}
 
 	//k-linearization and windowing
+	startStage(stageEvents, STAGE_RESAMPLING, stream[currStream]);
 	if (d_inputLinearized != NULL && params->resampling && params->windowing && !params->dispersionCompensation) {
-		if(params->resamplingInterpolation == INTERPOLATION::CUBIC) {
-			klinearizationCubicAndWindowing<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, d_windowCurve, signalLength, samplesPerBuffer);
-		}
-		else if(params->resamplingInterpolation == INTERPOLATION::LINEAR) {
-			klinearizationAndWindowing<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, d_windowCurve, signalLength, samplesPerBuffer);
-		}
-		else if(params->resamplingInterpolation == INTERPOLATION::LANCZOS) {
-			klinearizationLanczosAndWindowing<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, d_windowCurve, signalLength, samplesPerBuffer);
-		}
+		cuda_klinearization(d_inputLinearized, d_fftBuffer, true, false, stream[currStream]);
 		d_fftBuffer2 = d_inputLinearized;
 	} else
 		//k-linearization and windowing and dispersion compensation
 	if (d_inputLinearized != NULL && params->resampling && params->windowing && params->dispersionCompensation) {
-		if(params->resamplingInterpolation == INTERPOLATION::CUBIC){
-			klinearizationCubicAndWindowingAndDispersionCompensation<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, d_windowCurve, d_phaseCartesian, signalLength, samplesPerBuffer);
-		}
-		else if(params->resamplingInterpolation == INTERPOLATION::LINEAR) {
-			klinearizationAndWindowingAndDispersionCompensation<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, d_windowCurve, d_phaseCartesian, signalLength, samplesPerBuffer);
-		}
-		else if(params->resamplingInterpolation == INTERPOLATION::LANCZOS) {
-			klinearizationLanczosAndWindowingAndDispersionCompensation<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, d_windowCurve, d_phaseCartesian, signalLength, samplesPerBuffer);
-		}
+		cuda_klinearization(d_inputLinearized, d_fftBuffer, true, true, stream[currStream]);
 		d_fftBuffer2 = d_inputLinearized;
 	} else
 		//dispersion compensation and windowing
@@ -1325,15 +1358,7 @@ extern "C" void octCudaPipeline(void* h_inputSignal) {
 	} else
 		//just k-linearization
 	if (d_inputLinearized != NULL && params->resampling && !params->windowing && !params->dispersionCompensation) {
-		if(params->resamplingInterpolation == INTERPOLATION::CUBIC){
-			klinearizationCubic<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, signalLength, samplesPerBuffer);
-		}
-		else if(params->resamplingInterpolation == INTERPOLATION::LINEAR) {
-			klinearization<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, signalLength, samplesPerBuffer);
-		}
-		else if(params->resamplingInterpolation == INTERPOLATION::LANCZOS) {
-			klinearizationLanczos<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, signalLength, samplesPerBuffer);
-		}
+		cuda_klinearization(d_inputLinearized, d_fftBuffer, false, false, stream[currStream]);
 		d_fftBuffer2 = d_inputLinearized;
 	} else
 		//just windowing
@@ -1346,66 +1371,76 @@ extern "C" void octCudaPipeline(void* h_inputSignal) {
 	} else
 		//k-linearization and dispersion compensation. nobody will use this in a serious manner, so an optimized "klinearizationAndDispersionCompensation" kernel is not necessary
 	if (d_inputLinearized != NULL && params->resampling && !params->windowing && params->dispersionCompensation) {
-		if(params->resamplingInterpolation == INTERPOLATION::CUBIC) {
-			klinearizationCubic<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, signalLength, samplesPerBuffer);
-		}
-		else if(params->resamplingInterpolation == INTERPOLATION::LINEAR) {
-			klinearization<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, signalLength, samplesPerBuffer);
-		}
-		else if(params->resamplingInterpolation == INTERPOLATION::LANCZOS) {
-			klinearizationLanczos<<<gridSize, blockSize, 0, stream[currStream]>>>(d_inputLinearized, d_fftBuffer, d_resampleCurve, signalLength, samplesPerBuffer);
-		}
+		cuda_klinearization(d_inputLinearized, d_fftBuffer, false, false, stream[currStream]);
 		d_fftBuffer2 = d_inputLinearized;
 		dispersionCompensation<<<gridSize, blockSize, 0, stream[currStream]>>> (d_fftBuffer2, d_fftBuffer2, d_phaseCartesian, signalLength, samplesPerBuffer);
 	}
 	
+	if (params->resampling || params->windowing || params->dispersionCompensation) {
+		endStage(stageEvents, STAGE_RESAMPLING, stream[currStream]);
+	}
+	std::fill(stageCaptured, stageCaptured+NUMBER_OF_CAPTURE_STAGES, false);
+	if (stageCapture) {
+		captureStage(CAPTURE_SPECTRA, d_fftBuffer2, signalLength, stream[currStream]);
+	}
+	
 	//IFFT
+	startStage(stageEvents, STAGE_FFT, stream[currStream]);
 	cufftSetStream(d_plan, stream[currStream]);
 	checkCudaErrors(cufftExecC2C(d_plan, d_fftBuffer2, d_fftBuffer2, CUFFT_INVERSE));
+	endStage(stageEvents, STAGE_FFT, stream[currStream]);
+	if (stageCapture) {
+		captureStage(CAPTURE_FFT, d_fftBuffer2, signalLength/2, stream[currStream]);
+	}
 
 	//Fixed-pattern noise removal
 	if(params->fixedPatternNoiseRemoval){
+		startStage(stageEvents, STAGE_FIXED_PATTERN_NOISE, stream[currStream]);
 		int width = signalLength;
-		int height = params->bscansForNoiseDetermination*ascansPerBscan;//ascansPerBscan*bscansPerBuffer;
+		int outputAscanLength = width/2; //just the first half of the mean A-scan is needed, because the second half gets truncated anyway
+		int height = (int)std::min((size_t)params->bscansForNoiseDetermination*ascansPerBscan, ascansPerBscan*bscansPerBuffer);
+		int segments = std::max(1, std::min(FIXED_PATTERN_NOISE_REMOVAL_SEGMENTS, height));
+		int segWidth = height/segments;
 		if((!params->continuousFixedPatternNoiseDetermination && !fixedPatternNoiseDetermined) || params->continuousFixedPatternNoiseDetermination || params->redetermineFixedPatternNoise){
-			getMinimumVarianceMean<<<gridSize, blockSize, 0, stream[currStream]>>>(d_meanALine, d_fftBuffer2, width, height, FIXED_PATTERN_NOISE_REMOVAL_SEGMENTS);
+			getSegmentStatistics<<<(outputAscanLength*segments+blockSize-1)/blockSize, blockSize, 0, stream[currStream]>>>(d_segmentStatistics, d_fftBuffer2, width, outputAscanLength, segWidth, segments);
+			getMinimumVarianceMean<<<(outputAscanLength+blockSize-1)/blockSize, blockSize, 0, stream[currStream]>>>(d_meanALine, d_segmentStatistics, outputAscanLength, segments);
 			fixedPatternNoiseDetermined = true;
 			params->redetermineFixedPatternNoise = false;
 		}
 		meanALineSubtraction<<<gridSize/2, blockSize, 0, stream[currStream]>>>(d_fftBuffer2, d_meanALine, width/2, samplesPerBuffer/2); //here mean a-scan line subtraction of half volume is enough, because in the next step the volume gets truncated anyway
+		endStage(stageEvents, STAGE_FIXED_PATTERN_NOISE, stream[currStream]);
+		if (stageCapture) {
+			captureStage(CAPTURE_FIXED_PATTERN_NOISE_REMOVAL, d_fftBuffer2, signalLength/2, stream[currStream]);
+		}
 	}
 
 	//get current buffer number in volume (a volume may consist of one or more buffers)
 	if(buffersPerVolume > 1){
 		bufferNumberInVolume = (bufferNumberInVolume+1)%buffersPerVolume;
 	}
+	if (bufferNumberInVolume == 0) {
+		volumeRing.startVolume();
+	}
 
-	//get current position in processed volume buffer
-	float* d_currBuffer = &d_processedBuffer[(samplesPerBuffer/2)*bufferNumberInVolume];
+	//get current position in processed volume buffer. The output stage of the previous buffer may still read the processed volume
+	unsigned char* d_currBuffer = &d_processedBuffer[bytesPerVolumeSample*(samplesPerBuffer/2)*bufferNumberInVolume];
+	checkCudaErrors(cudaStreamWaitEvent(stream[currStream], previousSlot.outputDone, 0));
+	startStage(stageEvents, STAGE_POST_PROCESSING, stream[currStream]);
+	cuda_removeBufferFromDisplayProjections(bufferNumberInVolume, stream[currStream]);
 
-	//postProcessTruncate contains: Mirror artefact removal, Log, Magnitude, Copy to output buffer.
+	//postProcessTruncate contains: Mirror artefact removal, Log, Magnitude, Copy to output buffer, flip of every second bscan and sinusoidal scan correction.
+	const CpuLineGather* d_currLineGather = cuda_updateLineGather(params->bscanFlip, params->sinusoidalScanCorrection, stream[currStream]);
 	if (params->signalLogScaling) {
-		postProcessTruncateLog<<<gridSize/2, blockSize, 0, stream[currStream]>>> (d_currBuffer, d_fftBuffer2, signalLength / 2, samplesPerBuffer, bufferNumberInVolume, params->signalGrayscaleMax, params->signalGrayscaleMin, params->signalAddend, params->signalMultiplicator);
+		FOR_VOLUME_STORAGE(volumeStorage, postProcessTruncate<true, VolumeSample><<<gridSize/2, blockSize, 0, stream[currStream]>>> ((VolumeSample*)d_currBuffer, d_fftBuffer2, d_currLineGather, signalLength / 2, samplesPerBuffer, params->signalGrayscaleMax, params->signalGrayscaleMin, params->signalAddend, params->signalMultiplicator));
 	}
 	else {
-		postProcessTruncateLin<<<gridSize/2, blockSize, 0, stream[currStream]>>> (d_currBuffer, d_fftBuffer2, signalLength / 2, samplesPerBuffer, params->signalGrayscaleMax, params->signalGrayscaleMin, params->signalAddend, params->signalMultiplicator);
-	}
-
-	//flip every second bscan
-	if (params->bscanFlip) {
-		cuda_bscanFlip<<<gridSize/2, blockSize, 0, stream[currStream]>>> (d_currBuffer, d_currBuffer, signalLength / 2, ascansPerBscan, (signalLength*ascansPerBscan)/2, samplesPerBuffer/4);
-	}
-
-	//sinusoidal scan correction
-	if(params->sinusoidalScanCorrection && d_sinusoidalScanTmpBuffer != NULL){
-		checkCudaErrors(cudaMemcpyAsync(d_sinusoidalScanTmpBuffer, d_currBuffer, sizeof(float)*samplesPerBuffer/2, cudaMemcpyDeviceToDevice,stream[currStream]));
-		sinusoidalScanCorrection<<<gridSize/2, blockSize, 0, stream[currStream]>>>(d_currBuffer, d_sinusoidalScanTmpBuffer, d_sinusoidalResampleCurve, signalLength/2, ascansPerBscan, bscansPerBuffer, samplesPerBuffer/2);
+		FOR_VOLUME_STORAGE(volumeStorage, postProcessTruncate<false, VolumeSample><<<gridSize/2, blockSize, 0, stream[currStream]>>> ((VolumeSample*)d_currBuffer, d_fftBuffer2, d_currLineGather, signalLength / 2, samplesPerBuffer, params->signalGrayscaleMax, params->signalGrayscaleMin, params->signalAddend, params->signalMultiplicator));
 	}
 	
 	//post process background removal
 	if(params->postProcessBackgroundRemoval){
 		if(params->postProcessBackgroundRecordingRequested){
-			getPostProcessBackground<<<gridSize/2, blockSize, 0, stream[currStream]>>>(d_postProcBackgroundLine, d_currBuffer, signalLength/2, ascansPerBscan );
+			FOR_VOLUME_STORAGE(volumeStorage, getPostProcessBackground<VolumeSample><<<gridSize/2, blockSize, 0, stream[currStream]>>>(d_postProcBackgroundLine, (const VolumeSample*)d_currBuffer, signalLength/2, ascansPerBscan));
 			cuda_copyPostProcessBackgroundToHost(params->postProcessBackground, signalLength/2, stream[currStream]);
 			params->postProcessBackgroundRecordingRequested = false;
 		}
@@ -1413,10 +1448,27 @@ extern "C" void octCudaPipeline(void* h_inputSignal) {
 			cuda_updatePostProcessBackground(params->postProcessBackground, signalLength/2, stream[currStream]);
 			params->postProcessBackgroundUpdated = false;
 		}
-		postProcessBackgroundRemoval<<<gridSize/2, blockSize, 0, stream[currStream]>>>(d_currBuffer, d_postProcBackgroundLine, params->postProcessBackgroundWeight, params->postProcessBackgroundOffset, signalLength/2, samplesPerBuffer/2);
+		FOR_VOLUME_STORAGE(volumeStorage, postProcessBackgroundRemoval<VolumeSample><<<gridSize/2, blockSize, 0, stream[currStream]>>>((VolumeSample*)d_currBuffer, d_postProcBackgroundLine, params->postProcessBackgroundWeight, params->postProcessBackgroundOffset, signalLength/2, samplesPerBuffer/2));
+	}
+
+	//keep a copy of the buffer in the volume ring
+	if (volumeRing.isEnabled()) {
+		size_t bytesPerProcessedBuffer = bytesPerVolumeSample*(samplesPerBuffer/2);
+		checkCudaErrors(cudaMemcpyAsync(d_volumeRing + volumeRing.getCurrentVolumeOffset() + bytesPerProcessedBuffer*bufferNumberInVolume, d_currBuffer, bytesPerProcessedBuffer, cudaMemcpyDeviceToDevice, stream[currStream]));
 	}
 
+	//the spectral buffers are free for the next buffer, display and streaming of this buffer overlap with its processing
+	checkCudaErrors(cudaEventRecord(slot.processingDone, stream[currStream]));
+
+	cuda_updateEnFaceVolume(d_currBuffer, bufferNumberInVolume, stream[currStream]);
+	cuda_addBufferToDisplayProjections(bufferNumberInVolume, stream[currStream]);
+	endStage(stageEvents, STAGE_POST_PROCESSING, stream[currStream]);
+
 	//update display buffers
+	bool displayEnabled = params->bscanViewEnabled || params->enFaceViewEnabled || params->volumeViewEnabled;
+	if (displayEnabled) {
+		startStage(stageEvents, STAGE_DISPLAY, stream[currStream]);
+	}
 	if(params->bscanViewEnabled){
 		updateBscanDisplayBuffer(params->frameNr, params->functionFramesBscan, params->displayFunctionBscan, stream[currStream]);
 	}
@@ -1426,6 +1478,9 @@ extern "C" void octCudaPipeline(void* h_inputSignal) {
 	if(params->volumeViewEnabled){
 		updateVolumeDisplayBuffer(d_currBuffer, bufferNumberInVolume, bscansPerBuffer, stream[currStream]);
 	}
+	if (displayEnabled) {
+		endStage(stageEvents, STAGE_DISPLAY, stream[currStream]);
+	}
 
 	//check errors
 	cudaError_t err = cudaGetLastError();
@@ -1436,8 +1491,35 @@ extern "C" void octCudaPipeline(void* h_inputSignal) {
 	//Copy/Stream processed data to host continuously
 	if (params->streamToHost && !params->streamingParamsChanged) {
 		params->currentBufferNr = bufferNumberInVolume;
-		streamProcessedData(d_currBuffer, stream[currStream]);
+		streamProcessedData(d_currBuffer, stream[currStream], stageEvents);
+	}
+	checkCudaErrors(cudaEventRecord(slot.outputDone, stream[currStream]));
+	stageEvents.pending = true;
+
+	//block the host until the raw data is on the device, so that the acquisition buffer can be reused. Since the upload waits for the slot
+	//to become free, this also prevents the data acquisition of the virtual OCT system from outpacing the processing
+	checkCudaErrors(cudaEventSynchronize(slot.uploadDone));
+}
+
+extern "C" void cuda_synchronize() {
+	if (cudaInitialized) {
+		checkCudaErrors(cudaDeviceSynchronize());
+		collectStageTimes(false);
+	}
+}
+
+extern "C" void cuda_setStageCapture(bool enabled) {
+	stageCapture = enabled;
+	std::fill(stageCaptured, stageCaptured+NUMBER_OF_CAPTURE_STAGES, false);
+}
+
+extern "C" const void* cuda_getCapturedStage(int stage, size_t* samples) {
+	if (stage < 0 || stage >= NUMBER_OF_CAPTURE_STAGES || !stageCaptured[stage]) {
+		*samples = 0;
+		return NULL;
 	}
+	*samples = h_capturedStages[stage].size();
+	return h_capturedStages[stage].data();
 }
 
 extern "C" void cuda_registerGlBufferBscan(GLuint buf) {
@@ -0,0 +1,126 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "cudaprocessingbackend.h"
+
+
+CudaProcessingBackend::CudaProcessingBackend() {
+}
+
+CudaProcessingBackend::~CudaProcessingBackend() {
+	this->cleanup();
+	cuda_clearFftPlanCache();
+}
+
+bool CudaProcessingBackend::isDeviceAvailable() {
+	int deviceCount = 0;
+	cudaError_t err = cudaGetDeviceCount(&deviceCount);
+	if (err != cudaSuccess) {
+		cudaGetLastError(); //reset error state so that it does not show up in later cuda calls
+		return false;
+	}
+	return deviceCount > 0;
+}
+
+std::string CudaProcessingBackend::getDeviceName() const {
+	int device = 0;
+	cudaDeviceProp properties;
+	if (cudaGetDevice(&device) != cudaSuccess || cudaGetDeviceProperties(&properties, device) != cudaSuccess) {
+		cudaGetLastError();
+		return "unknown";
+	}
+	return properties.name;
+}
+
+bool CudaProcessingBackend::init(void** h_buffers, unsigned int bufferCount, OctAlgorithmParameters* params) {
+	initializeCuda(h_buffers, bufferCount, params);
+	return true;
+}
+
+bool CudaProcessingBackend::process(void* h_inputSignal) {
+	octCudaPipeline(h_inputSignal);
+	return true;
+}
+
+void CudaProcessingBackend::synchronize() {
+	cuda_synchronize();
+}
+
+void CudaProcessingBackend::cleanup() {
+	cleanupCuda(); //does nothing if cuda is not initialized
+}
+
+void CudaProcessingBackend::changeDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
+	::changeDisplayedBscanFrame(frameNr, displayFunctionFrames, displayFunction);
+}
+
+void CudaProcessingBackend::changeDisplayedEnFaceFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) {
+	::changeDisplayedEnFaceFrame(frameNr, displayFunctionFrames, displayFunction);
+}
+
+void CudaProcessingBackend::setStageCapture(bool enabled) {
+	cuda_setStageCapture(enabled);
+}
+
+bool CudaProcessingBackend::getCapturedStage(CAPTURE_STAGE stage, std::vector<std::complex<float> >& samples) {
+	//cufftComplex has the memory layout of std::complex<float>
+	size_t count = 0;
+	const std::complex<float>* captured = static_cast<const std::complex<float>*>(cuda_getCapturedStage(stage, &count));
+	if (captured == nullptr) {
+		return false;
+	}
+	samples.assign(captured, captured+count);
+	return true;
+}
+
+unsigned int CudaProcessingBackend::getCompleteVolumesInRing() {
+	return cuda_getCompleteVolumesInRing();
+}
+
+bool CudaProcessingBackend::copyBscanFromVolumeRing(unsigned int volumesAgo, unsigned int bscanNr, void* output) {
+	return cuda_copyBscanFromVolumeRing(volumesAgo, bscanNr, output);
+}
+
+void CudaProcessingBackend::registerGlBufferBscan(unsigned int buf) {
+	cuda_registerGlBufferBscan(buf);
+}
+
+void CudaProcessingBackend::registerGlBufferEnFaceView(unsigned int buf) {
+	cuda_registerGlBufferEnFaceView(buf);
+}
+
+void CudaProcessingBackend::registerGlBufferVolumeView(unsigned int buf) {
+	cuda_registerGlBufferVolumeView(buf);
+}
+
+void CudaProcessingBackend::registerStreamingBuffers(void* h_streamingBuffer1, void* h_streamingBuffer2, size_t bytesPerBuffer) {
+	cuda_registerStreamingBuffers(h_streamingBuffer1, h_streamingBuffer2, bytesPerBuffer);
+}
+
+void CudaProcessingBackend::unregisterStreamingBuffers() {
+	cuda_unregisterStreamingBuffers();
+}
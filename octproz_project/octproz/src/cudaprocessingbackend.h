@@ -0,0 +1,66 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef CUDAPROCESSINGBACKEND_H
+#define CUDAPROCESSINGBACKEND_H
+
+#include "processingbackend.h"
+#include "kernels.h"
+
+
+//wraps the extern "C" functions of cuda_code.cu
+class CudaProcessingBackend : public ProcessingBackend
+{
+public:
+	CudaProcessingBackend();
+	~CudaProcessingBackend();
+
+	static bool isDeviceAvailable();
+
+	const char* getName() const override { return "GPU (CUDA)"; }
+	std::string getDeviceName() const override;
+	bool init(void** h_buffers, unsigned int bufferCount, OctAlgorithmParameters* params) override;
+	bool process(void* h_inputSignal) override;
+	void synchronize() override;
+	void cleanup() override;
+
+	void changeDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) override;
+	void changeDisplayedEnFaceFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) override;
+	void setStageCapture(bool enabled) override;
+	bool getCapturedStage(CAPTURE_STAGE stage, std::vector<std::complex<float> >& samples) override;
+	unsigned int getCompleteVolumesInRing() override;
+	bool copyBscanFromVolumeRing(unsigned int volumesAgo, unsigned int bscanNr, void* output) override;
+
+	void registerGlBufferBscan(unsigned int buf) override;
+	void registerGlBufferEnFaceView(unsigned int buf) override;
+	void registerGlBufferVolumeView(unsigned int buf) override;
+
+	void registerStreamingBuffers(void* h_streamingBuffer1, void* h_streamingBuffer2, size_t bytesPerBuffer) override;
+	void unregisterStreamingBuffers() override;
+};
+
+#endif // CUDAPROCESSINGBACKEND_H
@@ -0,0 +1,183 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef DISPLAYPROJECTION_H
+#define DISPLAYPROJECTION_H
+
+#include <stddef.h>
+#include "octalgorithmparameters.h"
+#include "volumestorage.h"
+
+//the per pixel functions are used by the cpu backend and by the kernels in cuda_code.cu
+#ifdef __CUDACC__
+#define DISPLAY_PROJECTION_FUNCTION __host__ __device__ inline
+#else
+#define DISPLAY_PROJECTION_FUNCTION inline
+#endif
+
+
+/**
+* Averaging and maximum intensity projection (MIP) of the B-scan and en face view are sliding windows of frames over the processed volume.
+* Instead of reading every frame of the window for every displayed pixel, each pixel keeps a running sum (averaging)
+* or the maximum together with the frame it came from (MIP). Scrolling the window by one frame or receiving a new buffer then only
+* reads the frames that entered or changed. A MIP pixel is only rescanned completely if its maximum leaves the window or is overwritten.
+* A view is described by pixelStride and frameStride: the value of pixel p in frame f is processedVolume[p*pixelStride + f*frameStride].
+* T is the sample type of the processed volume, see volumestorage.h.
+**/
+struct DisplayProjectionPixel {
+	double sum;
+	float maxValue;
+	unsigned int maxFrame;
+};
+
+//window [first, last) of the projected frames and the window the pixel state currently belongs to. Lives on the host and is passed by value to the kernels.
+struct DisplayProjectionWindow {
+	unsigned int first;
+	unsigned int last;
+	unsigned int previousFirst;
+	unsigned int previousLast;
+	int displayFunction;
+	bool valid;
+	bool rebuild; ///pixel state has to be recalculated from all frames of the window instead of scrolled from the previous window
+
+	DisplayProjectionWindow() : first(0), last(0), previousFirst(0), previousLast(0), displayFunction(OctAlgorithmParameters::AVERAGING), valid(false), rebuild(true) {}
+
+	void invalidate() {
+		this->valid = false;
+	}
+
+	//moves the window to [frameNr, frameNr+displayFunctionFrames) clipped to framesAvailable. Returns false if only a single frame is displayed and no projection is necessary.
+	//The pixel state has to be updated with scrollProjectionPixel afterwards, otherwise invalidate() has to be called
+	bool setWindow(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction, unsigned int framesAvailable) {
+		if (displayFunctionFrames <= 1 || (displayFunction != OctAlgorithmParameters::AVERAGING && displayFunction != OctAlgorithmParameters::MIP)) {
+			this->valid = false;
+			return false;
+		}
+		unsigned int newLast = frameNr + displayFunctionFrames < framesAvailable ? frameNr + displayFunctionFrames : framesAvailable;
+		unsigned int scrolledFrames = (frameNr > this->first ? frameNr - this->first : this->first - frameNr) + (newLast > this->last ? newLast - this->last : this->last - newLast);
+		this->rebuild = !this->valid || displayFunction != this->displayFunction || scrolledFrames >= newLast - frameNr;
+		this->previousFirst = this->first;
+		this->previousLast = this->last;
+		this->first = frameNr;
+		this->last = newLast;
+		this->displayFunction = displayFunction;
+		this->valid = true;
+		return true;
+	}
+
+	bool overlaps(unsigned int firstFrame, unsigned int lastFrame) const {
+		return this->valid && firstFrame < this->last && lastFrame > this->first;
+	}
+};
+
+
+template <typename T>
+DISPLAY_PROJECTION_FUNCTION void accumulateProjectionFrames(DisplayProjectionPixel& pixel, const T* values, const size_t frameStride, const int displayFunction, const unsigned int firstFrame, const unsigned int lastFrame) {
+	if (displayFunction == OctAlgorithmParameters::MIP) {
+		for (unsigned int f = firstFrame; f < lastFrame; f++) {
+			float value = loadVolumeSample(values[f*frameStride]);
+			if (value > pixel.maxValue) {
+				pixel.maxValue = value;
+				pixel.maxFrame = f;
+			}
+		}
+	} else {
+		double sum = pixel.sum;
+		for (unsigned int f = firstFrame; f < lastFrame; f++) {
+			sum += loadVolumeSample(values[f*frameStride]);
+		}
+		pixel.sum = sum;
+	}
+}
+
+template <typename T>
+DISPLAY_PROJECTION_FUNCTION void rebuildProjectionPixel(DisplayProjectionPixel& pixel, const T* values, const size_t frameStride, const DisplayProjectionWindow& window) {
+	pixel.sum = 0.0;
+	pixel.maxValue = 0.0f;
+	pixel.maxFrame = window.first;
+	accumulateProjectionFrames(pixel, values, frameStride, window.displayFunction, window.first, window.last);
+}
+
+//moves the pixel state from [previousFirst, previousLast) to [first, last). Only the frames that leave or enter the window are read
+template <typename T>
+DISPLAY_PROJECTION_FUNCTION void scrollProjectionPixel(DisplayProjectionPixel& pixel, const T* values, const size_t frameStride, const DisplayProjectionWindow& window) {
+	if (window.rebuild || (window.displayFunction == OctAlgorithmParameters::MIP && (pixel.maxFrame < window.first || pixel.maxFrame >= window.last))) {
+		rebuildProjectionPixel(pixel, values, frameStride, window);
+		return;
+	}
+	if (window.displayFunction != OctAlgorithmParameters::MIP) {
+		double sum = pixel.sum;
+		for (unsigned int f = window.previousFirst; f < window.first && f < window.previousLast; f++) {
+			sum -= loadVolumeSample(values[f*frameStride]);
+		}
+		for (unsigned int f = window.last > window.previousFirst ? window.last : window.previousFirst; f < window.previousLast; f++) {
+			sum -= loadVolumeSample(values[f*frameStride]);
+		}
+		pixel.sum = sum;
+	}
+	accumulateProjectionFrames(pixel, values, frameStride, window.displayFunction, window.first, window.previousFirst < window.last ? window.previousFirst : window.last);
+	accumulateProjectionFrames(pixel, values, frameStride, window.displayFunction, window.previousLast > window.first ? window.previousLast : window.first, window.last);
+}
+
+//has to be called before the frames [firstFrame, lastFrame) of the processed volume are overwritten. Only averaging needs the old values
+template <typename T>
+DISPLAY_PROJECTION_FUNCTION void removeProjectionFrames(DisplayProjectionPixel& pixel, const T* values, const size_t frameStride, const DisplayProjectionWindow& window, unsigned int firstFrame, unsigned int lastFrame) {
+	if (window.displayFunction == OctAlgorithmParameters::MIP) {
+		return;
+	}
+	firstFrame = firstFrame > window.first ? firstFrame : window.first;
+	lastFrame = lastFrame < window.last ? lastFrame : window.last;
+	double sum = pixel.sum;
+	for (unsigned int f = firstFrame; f < lastFrame; f++) {
+		sum -= loadVolumeSample(values[f*frameStride]);
+	}
+	pixel.sum = sum;
+}
+
+//has to be called after the frames [firstFrame, lastFrame) of the processed volume were overwritten
+template <typename T>
+DISPLAY_PROJECTION_FUNCTION void addProjectionFrames(DisplayProjectionPixel& pixel, const T* values, const size_t frameStride, const DisplayProjectionWindow& window, unsigned int firstFrame, unsigned int lastFrame) {
+	firstFrame = firstFrame > window.first ? firstFrame : window.first;
+	lastFrame = lastFrame < window.last ? lastFrame : window.last;
+	if (window.displayFunction == OctAlgorithmParameters::MIP && pixel.maxFrame >= firstFrame && pixel.maxFrame < lastFrame) {
+		//the old maximum may have been replaced by a smaller value
+		rebuildProjectionPixel(pixel, values, frameStride, window);
+		return;
+	}
+	accumulateProjectionFrames(pixel, values, frameStride, window.displayFunction, firstFrame, lastFrame);
+}
+
+DISPLAY_PROJECTION_FUNCTION float getProjectionValue(const DisplayProjectionPixel& pixel, const DisplayProjectionWindow& window) {
+	if (window.displayFunction == OctAlgorithmParameters::MIP) {
+		return pixel.maxValue;
+	}
+	unsigned int frameCount = window.last - window.first;
+	return frameCount > 0 ? static_cast<float>(pixel.sum/frameCount) : 0.0f;
+}
+
+
+#endif // DISPLAYPROJECTION_H
@@ -0,0 +1,138 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "fftplancache.h"
+#include <algorithm>
+#include <stdio.h>
+#include <tuple>
+
+
+bool FftPlanKey::operator<(const FftPlanKey& other) const {
+	return std::tie(this->signalLength, this->batch, this->precision, this->direction, this->inPlace, this->realInput)
+		< std::tie(other.signalLength, other.batch, other.precision, other.direction, other.inPlace, other.realInput);
+}
+
+
+FftPlanCache* FftPlanCache::fftPlanCache = nullptr;
+
+FftPlanCache::FftPlanCache() {
+	this->wisdomLoaded = false;
+}
+
+FftPlanCache* FftPlanCache::getInstance() {
+	fftPlanCache = fftPlanCache != nullptr ? fftPlanCache : new FftPlanCache();
+	return fftPlanCache;
+}
+
+FftPlanCache::~FftPlanCache() {
+	this->clear();
+}
+
+void FftPlanCache::setWisdomFile(const std::string& path) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (path != this->wisdomFile) {
+		this->wisdomFile = path;
+		this->wisdomLoaded = false;
+	}
+}
+
+fftwf_plan FftPlanCache::getPlan(const FftPlanKey& key) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto it = this->plans.find(key);
+	if (it != this->plans.end()) {
+		return it->second;
+	}
+	if (!this->wisdomLoaded) {
+		this->loadWisdom();
+	}
+	fftwf_plan plan = this->createPlan(key);
+	if (plan != nullptr) {
+		this->plans[key] = plan;
+		this->saveWisdom();
+	}
+	return plan;
+}
+
+void FftPlanCache::clear() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	for (auto& entry : this->plans) {
+		fftwf_destroy_plan(entry.second);
+	}
+	this->plans.clear();
+}
+
+fftwf_plan FftPlanCache::createPlan(const FftPlanKey& key) {
+	if (key.precision != FFT_SINGLE || key.signalLength <= 0 || key.batch <= 0) {
+		return nullptr;
+	}
+
+	//plan on scratch buffers because FFTW_MEASURE overwrites the arrays during planning. fftwf_malloc ensures that buffers of the caller
+	//have the same alignment as the scratch buffers, which is required for the new-array execute functions
+	int n = key.signalLength;
+	int outputLength = key.realInput ? n/2+1 : n;
+	size_t outputSize = sizeof(fftwf_complex)*static_cast<size_t>(outputLength)*key.batch;
+	size_t inputSize = key.realInput ? sizeof(float)*static_cast<size_t>(n)*key.batch : sizeof(fftwf_complex)*static_cast<size_t>(n)*key.batch;
+	fftwf_complex* output = static_cast<fftwf_complex*>(fftwf_malloc(key.inPlace ? std::max(inputSize, outputSize) : outputSize));
+	void* input = key.inPlace ? static_cast<void*>(output) : fftwf_malloc(inputSize);
+	if (output == nullptr || input == nullptr) {
+		fftwf_free(output);
+		if (!key.inPlace) {
+			fftwf_free(input);
+		}
+		return nullptr;
+	}
+
+	fftwf_plan plan = nullptr;
+	if (key.realInput) {
+		//an in-place r2c transform needs padded input lines, which is not used by the processing backend
+		int inputDistance = key.inPlace ? 2*outputLength : n;
+		plan = fftwf_plan_many_dft_r2c(1, &n, key.batch, static_cast<float*>(input), NULL, 1, inputDistance, output, NULL, 1, outputLength, FFTW_MEASURE);
+	} else {
+		plan = fftwf_plan_many_dft(1, &n, key.batch, static_cast<fftwf_complex*>(input), NULL, 1, n, output, NULL, 1, n, key.direction, FFTW_MEASURE);
+	}
+
+	fftwf_free(output);
+	if (!key.inPlace) {
+		fftwf_free(input);
+	}
+	return plan;
+}
+
+void FftPlanCache::loadWisdom() {
+	this->wisdomLoaded = true;
+	if (!this->wisdomFile.empty()) {
+		fftwf_import_wisdom_from_filename(this->wisdomFile.c_str()); //fails silently if there is no wisdom file yet
+	}
+}
+
+void FftPlanCache::saveWisdom() {
+	if (!this->wisdomFile.empty()) {
+		if (!fftwf_export_wisdom_to_filename(this->wisdomFile.c_str())) {
+			printf("FFT plan cache: Could not save FFTW wisdom to %s\n", this->wisdomFile.c_str());
+		}
+	}
+}
@@ -0,0 +1,86 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef FFTPLANCACHE_H
+#define FFTPLANCACHE_H
+
+#include <fftw3.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+enum FFT_PRECISION {
+	FFT_SINGLE,
+	FFT_DOUBLE
+};
+
+struct FftPlanKey {
+	int signalLength;
+	int batch;
+	FFT_PRECISION precision;
+	int direction; ///FFTW_FORWARD or FFTW_BACKWARD. Real-to-complex plans are always FFTW_FORWARD
+	bool inPlace;
+	bool realInput;
+
+	bool operator<(const FftPlanKey& other) const;
+};
+
+
+/**
+* Process-wide cache of FFTW plans for the CPU processing backend. Plans are created on first request and are kept until the application
+* terminates, so stopping and restarting the acquisition does not pay the planning cost again. Plans are created with FFTW_MEASURE on scratch
+* buffers of the cache and must be executed with the new-array execute functions (fftwf_execute_dft, fftwf_execute_dft_r2c) on buffers that
+* are allocated with fftwf_malloc, or at offsets within such buffers that keep their alignment (see CPU_FFT_LINES_ALIGNMENT). If a wisdom
+* file is set, the accumulated planner wisdom is loaded from it once and saved to it whenever a new plan was created, so that even the first
+* start after an application restart is fast.
+* @note Singleton pattern. Only single precision plans are supported at the moment, requests for FFT_DOUBLE return nullptr.
+**/
+class FftPlanCache
+{
+public:
+	static FftPlanCache* getInstance();
+	~FftPlanCache();
+
+	void setWisdomFile(const std::string& path);
+	fftwf_plan getPlan(const FftPlanKey& key); ///returns nullptr if the plan could not be created
+	void clear(); ///destroys all cached plans
+
+private:
+	FftPlanCache();
+	static FftPlanCache* fftPlanCache;
+
+	fftwf_plan createPlan(const FftPlanKey& key);
+	void loadWisdom();
+	void saveWisdom();
+
+	std::mutex mutex; ///the fftw planner is not thread safe
+	std::map<FftPlanKey, fftwf_plan> plans;
+	std::string wisdomFile;
+	bool wisdomLoaded;
+};
+
+#endif // FFTPLANCACHE_H
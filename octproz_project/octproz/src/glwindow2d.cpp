@@ -377,6 +377,7 @@ void GLWindow2D::initializeGL() {
 }
 
 void GLWindow2D::paintGL() {
+	TraceSpan span("paint 2D view");
 	//reset matrix state (resets previous translation, rotation and scale operations)
 	glLoadIdentity();
 
@@ -77,6 +77,7 @@
 
 #include "stringspinbox.h"
 #include "outputwindow.h"
+#include "tracer.h"
 
 //#include "octalgorithmparameters.h" //needed for the definition of DISPLAY_FUNCTION enum
 
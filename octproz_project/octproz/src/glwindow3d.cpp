@@ -291,6 +291,7 @@ void GLWindow3D::resizeGL(int w, int h) {
 }
 
 void GLWindow3D::paintGL() {
+	TraceSpan span("paint 3D view");
 	//this->countFPS();
 
 	// Compute geometry
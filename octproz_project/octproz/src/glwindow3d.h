@@ -80,6 +80,7 @@
 #include "trackball.h"
 #include "controlpanel.h"
 #include "settings.h"
+#include "tracer.h"
 
 #define DELAY_TIME_IN_ms 80
 
@@ -26,6 +26,7 @@
 **/
 
 #include "gpu2hostnotifier.h"
+#include "tracer.h"
 
 Gpu2HostNotifier* Gpu2HostNotifier::gpu2hostNotifier = nullptr;
 
@@ -53,9 +54,11 @@ void Gpu2HostNotifier::emitBackgroundRecorded() {
 
 
 void CUDART_CB Gpu2HostNotifier::dh2StreamingCallback(void* currStreamingBuffer) {
+	TraceSpan span("streaming callback");
 	Gpu2HostNotifier::getInstance()->emitCurrentStreamingBuffer(currStreamingBuffer);
 }
 
 void CUDART_CB Gpu2HostNotifier::backgroundSignalCallback(void* backgroundSignal) {
+	TraceSpan span("background callback");
 	Gpu2HostNotifier::getInstance()->emitBackgroundRecorded();
 }
\ No newline at end of file
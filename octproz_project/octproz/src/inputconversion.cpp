@@ -0,0 +1,249 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "inputconversion.h"
+
+#if defined(OCTPROZ_X86)
+#include <immintrin.h>
+#endif
+
+#define UINT32_TO_UNIT_INTERVAL (1.0f/4294967296.0f) //32 bit input with bitshift enabled is scaled to [0, 1) like in inputToCufftComplex_and_bitshift
+
+
+//scalar implementation. Also used for the remaining samples that do not fill a complete simd register
+template <typename T, bool BITSHIFT>
+static inline void convertScalar(float* output, const T* input, size_t first, size_t last) {
+	for (size_t i = first; i < last; i++) {
+		output[i] = static_cast<float>(BITSHIFT ? (input[i] >> 4) : input[i]);
+	}
+}
+
+template <bool BITSHIFT>
+static inline void convertScalar32(float* output, const unsigned int* input, size_t first, size_t last) {
+	for (size_t i = first; i < last; i++) {
+		output[i] = BITSHIFT ? static_cast<float>(input[i])*UINT32_TO_UNIT_INTERVAL : static_cast<float>(input[i]);
+	}
+}
+
+
+#if defined(OCTPROZ_X86)
+//SSE2
+template <bool BITSHIFT>
+TARGET_SSE2 static void convert8Sse2(float* output, const unsigned char* input, size_t first, size_t last) {
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = first;
+	for (; i + 16 <= last; i += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&input[i]));
+		__m128i lo16 = _mm_unpacklo_epi8(bytes, zero);
+		__m128i hi16 = _mm_unpackhi_epi8(bytes, zero);
+		if (BITSHIFT) {
+			lo16 = _mm_srli_epi16(lo16, 4);
+			hi16 = _mm_srli_epi16(hi16, 4);
+		}
+		_mm_storeu_ps(&output[i], _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo16, zero)));
+		_mm_storeu_ps(&output[i+4], _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo16, zero)));
+		_mm_storeu_ps(&output[i+8], _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi16, zero)));
+		_mm_storeu_ps(&output[i+12], _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi16, zero)));
+	}
+	convertScalar<unsigned char, BITSHIFT>(output, input, i, last);
+}
+
+template <bool BITSHIFT>
+TARGET_SSE2 static void convert16Sse2(float* output, const unsigned short* input, size_t first, size_t last) {
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = first;
+	for (; i + 8 <= last; i += 8) {
+		__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&input[i]));
+		if (BITSHIFT) {
+			words = _mm_srli_epi16(words, 4);
+		}
+		_mm_storeu_ps(&output[i], _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)));
+		_mm_storeu_ps(&output[i+4], _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)));
+	}
+	convertScalar<unsigned short, BITSHIFT>(output, input, i, last);
+}
+
+//there is no unsigned 32 bit to float conversion before AVX-512. The upper and lower 16 bits are converted separately and combined, which gives the same rounding as a scalar conversion
+template <bool BITSHIFT>
+TARGET_SSE2 static void convert32Sse2(float* output, const unsigned int* input, size_t first, size_t last) {
+	const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+	const __m128 scaleHigh = _mm_set1_ps(65536.0f);
+	const __m128 scale = _mm_set1_ps(UINT32_TO_UNIT_INTERVAL);
+	size_t i = first;
+	for (; i + 4 <= last; i += 4) {
+		__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&input[i]));
+		__m128 high = _mm_cvtepi32_ps(_mm_srli_epi32(values, 16));
+		__m128 low = _mm_cvtepi32_ps(_mm_and_si128(values, lowMask));
+		__m128 result = _mm_add_ps(_mm_mul_ps(high, scaleHigh), low);
+		if (BITSHIFT) {
+			result = _mm_mul_ps(result, scale);
+		}
+		_mm_storeu_ps(&output[i], result);
+	}
+	convertScalar32<BITSHIFT>(output, input, i, last);
+}
+
+//AVX2
+template <bool BITSHIFT>
+TARGET_AVX2 static void convert8Avx2(float* output, const unsigned char* input, size_t first, size_t last) {
+	size_t i = first;
+	for (; i + 16 <= last; i += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&input[i]));
+		__m256i lo = _mm256_cvtepu8_epi32(bytes);
+		__m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+		if (BITSHIFT) {
+			lo = _mm256_srli_epi32(lo, 4);
+			hi = _mm256_srli_epi32(hi, 4);
+		}
+		_mm256_storeu_ps(&output[i], _mm256_cvtepi32_ps(lo));
+		_mm256_storeu_ps(&output[i+8], _mm256_cvtepi32_ps(hi));
+	}
+	convertScalar<unsigned char, BITSHIFT>(output, input, i, last);
+}
+
+template <bool BITSHIFT>
+TARGET_AVX2 static void convert16Avx2(float* output, const unsigned short* input, size_t first, size_t last) {
+	size_t i = first;
+	for (; i + 16 <= last; i += 16) {
+		__m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&input[i]));
+		if (BITSHIFT) {
+			words = _mm256_srli_epi16(words, 4);
+		}
+		_mm256_storeu_ps(&output[i], _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(words))));
+		_mm256_storeu_ps(&output[i+8], _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(words, 1))));
+	}
+	convertScalar<unsigned short, BITSHIFT>(output, input, i, last);
+}
+
+template <bool BITSHIFT>
+TARGET_AVX2 static void convert32Avx2(float* output, const unsigned int* input, size_t first, size_t last) {
+	const __m256i lowMask = _mm256_set1_epi32(0xFFFF);
+	const __m256 scaleHigh = _mm256_set1_ps(65536.0f);
+	const __m256 scale = _mm256_set1_ps(UINT32_TO_UNIT_INTERVAL);
+	size_t i = first;
+	for (; i + 8 <= last; i += 8) {
+		__m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&input[i]));
+		__m256 high = _mm256_cvtepi32_ps(_mm256_srli_epi32(values, 16));
+		__m256 low = _mm256_cvtepi32_ps(_mm256_and_si256(values, lowMask));
+		__m256 result = _mm256_add_ps(_mm256_mul_ps(high, scaleHigh), low);
+		if (BITSHIFT) {
+			result = _mm256_mul_ps(result, scale);
+		}
+		_mm256_storeu_ps(&output[i], result);
+	}
+	convertScalar32<BITSHIFT>(output, input, i, last);
+}
+
+//AVX-512
+template <bool BITSHIFT>
+TARGET_AVX512 static void convert8Avx512(float* output, const unsigned char* input, size_t first, size_t last) {
+	size_t i = first;
+	for (; i + 16 <= last; i += 16) {
+		__m512i values = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&input[i])));
+		if (BITSHIFT) {
+			values = _mm512_srli_epi32(values, 4);
+		}
+		_mm512_storeu_ps(&output[i], _mm512_cvtepi32_ps(values));
+	}
+	convertScalar<unsigned char, BITSHIFT>(output, input, i, last);
+}
+
+template <bool BITSHIFT>
+TARGET_AVX512 static void convert16Avx512(float* output, const unsigned short* input, size_t first, size_t last) {
+	size_t i = first;
+	for (; i + 16 <= last; i += 16) {
+		__m512i values = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&input[i])));
+		if (BITSHIFT) {
+			values = _mm512_srli_epi32(values, 4);
+		}
+		_mm512_storeu_ps(&output[i], _mm512_cvtepi32_ps(values));
+	}
+	convertScalar<unsigned short, BITSHIFT>(output, input, i, last);
+}
+
+template <bool BITSHIFT>
+TARGET_AVX512 static void convert32Avx512(float* output, const unsigned int* input, size_t first, size_t last) {
+	const __m512 scale = _mm512_set1_ps(UINT32_TO_UNIT_INTERVAL);
+	size_t i = first;
+	for (; i + 16 <= last; i += 16) {
+		__m512 result = _mm512_cvtepu32_ps(_mm512_loadu_si512(&input[i]));
+		if (BITSHIFT) {
+			result = _mm512_mul_ps(result, scale);
+		}
+		_mm512_storeu_ps(&output[i], result);
+	}
+	convertScalar32<BITSHIFT>(output, input, i, last);
+}
+#endif
+
+
+template <bool BITSHIFT>
+static void convert(float* output, const void* input, const unsigned int inputBitdepth, const size_t first, const size_t last, const SIMD_LEVEL simdLevel) {
+	if (inputBitdepth <= 8) {
+		const unsigned char* in = static_cast<const unsigned char*>(input);
+		switch (simdLevel) {
+#if defined(OCTPROZ_X86)
+			case SIMD_AVX512: convert8Avx512<BITSHIFT>(output, in, first, last); return;
+			case SIMD_AVX2: convert8Avx2<BITSHIFT>(output, in, first, last); return;
+			case SIMD_SSE2: convert8Sse2<BITSHIFT>(output, in, first, last); return;
+#endif
+			default: convertScalar<unsigned char, BITSHIFT>(output, in, first, last); return;
+		}
+	} else if (inputBitdepth > 8 && inputBitdepth <= 16) {
+		const unsigned short* in = static_cast<const unsigned short*>(input);
+		switch (simdLevel) {
+#if defined(OCTPROZ_X86)
+			case SIMD_AVX512: convert16Avx512<BITSHIFT>(output, in, first, last); return;
+			case SIMD_AVX2: convert16Avx2<BITSHIFT>(output, in, first, last); return;
+			case SIMD_SSE2: convert16Sse2<BITSHIFT>(output, in, first, last); return;
+#endif
+			default: convertScalar<unsigned short, BITSHIFT>(output, in, first, last); return;
+		}
+	} else {
+		const unsigned int* in = static_cast<const unsigned int*>(input);
+		switch (simdLevel) {
+#if defined(OCTPROZ_X86)
+			case SIMD_AVX512: convert32Avx512<BITSHIFT>(output, in, first, last); return;
+			case SIMD_AVX2: convert32Avx2<BITSHIFT>(output, in, first, last); return;
+			case SIMD_SSE2: convert32Sse2<BITSHIFT>(output, in, first, last); return;
+#endif
+			default: convertScalar32<BITSHIFT>(output, in, first, last); return;
+		}
+	}
+}
+
+void InputConversion::inputToFloat(float* output, const void* input, const unsigned int inputBitdepth, const bool bitshift, const size_t firstSample, const size_t lastSample) {
+	InputConversion::inputToFloat(output, input, inputBitdepth, bitshift, firstSample, lastSample, CpuFeatures::getSimdLevel());
+}
+
+void InputConversion::inputToFloat(float* output, const void* input, const unsigned int inputBitdepth, const bool bitshift, const size_t firstSample, const size_t lastSample, const SIMD_LEVEL simdLevel) {
+	if (bitshift) {
+		convert<true>(output, input, inputBitdepth, firstSample, lastSample, simdLevel);
+	} else {
+		convert<false>(output, input, inputBitdepth, firstSample, lastSample, simdLevel);
+	}
+}
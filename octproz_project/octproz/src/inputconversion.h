@@ -0,0 +1,48 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef INPUTCONVERSION_H
+#define INPUTCONVERSION_H
+
+#include <stddef.h>
+#include "cpufeatures.h"
+
+
+/**
+* Conversion of raw samples (8, 16 or 32 bit unsigned integers) to float for the CPU processing backend.
+* Same results as inputToCufftComplex and inputToCufftComplex_and_bitshift in cuda_code.cu, but the bit depth is evaluated once per call
+* and not for every sample. The SSE2/AVX2/AVX-512 implementation is selected at runtime with CpuFeatures::getSimdLevel().
+**/
+class InputConversion
+{
+public:
+	static void inputToFloat(float* output, const void* input, const unsigned int inputBitdepth, const bool bitshift, const size_t firstSample, const size_t lastSample);
+	static void inputToFloat(float* output, const void* input, const unsigned int inputBitdepth, const bool bitshift, const size_t firstSample, const size_t lastSample, const SIMD_LEVEL simdLevel); ///simdLevel must not be higher than CpuFeatures::getSimdLevel()
+	static size_t getBytesPerSample(const unsigned int inputBitdepth) { return inputBitdepth <= 8 ? 1 : (inputBitdepth <= 16 ? 2 : 4); }
+};
+
+#endif // INPUTCONVERSION_H
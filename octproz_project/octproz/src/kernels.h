@@ -58,14 +58,26 @@
 #include "octalgorithmparameters.h"
 #include "gpu2hostnotifier.h"
 
+#define CUDA_DEFAULT_BLOCK_SIZE 128
+#define CUDA_MAX_BLOCK_SIZE 1024
+
+//most kernels are launched with gridSize or gridSize/2 blocks and without bounds check, so half a buffer has to be a multiple of the block size
+inline bool isValidCudaBlockSize(unsigned int blockSize, size_t samplesPerBuffer) {
+	return blockSize > 0 && blockSize <= CUDA_MAX_BLOCK_SIZE && samplesPerBuffer % (2*(size_t)blockSize) == 0;
+}
+
 
 //cuda_code.cu
-extern "C" void initializeCuda(void* h_buffer1, void* h_buffer2, OctAlgorithmParameters* dispParameters);
+extern "C" void initializeCuda(void** h_buffers, unsigned int bufferCount, OctAlgorithmParameters* dispParameters);
 extern "C" void octCudaPipeline(void* h_inputSignal);
 extern "C" void cleanupCuda();
+extern "C" void cuda_synchronize();
+extern "C" void cuda_clearFftPlanCache();
 extern "C" void freeCudaMem(void* data);
 extern "C" void cuda_registerStreamingBuffers(void* h_streamingBuffer1, void* h_streamingBuffer2, size_t bytesPerBuffer);
 extern "C" void cuda_unregisterStreamingBuffers();
+extern "C" void cuda_setStageCapture(bool enabled);
+extern "C" const void* cuda_getCapturedStage(int stage, size_t* samples); ///cufftComplex samples of the CAPTURE_STAGE of the last buffer, NULL if the stage has not been captured. Call cuda_synchronize() first
 extern "C" void cuda_registerGlBufferBscan(GLuint buf);
 extern "C" void cuda_registerGlBufferEnFaceView(GLuint buf);
 extern "C" void cuda_registerGlBufferVolumeView(GLuint buf);
@@ -76,6 +88,8 @@ extern cudaArray* cuda_map3dTexture(cudaGraphicsResource* res, cudaStream_t stre
 
 extern "C" void changeDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction); ///if framerate is low user can request another bscan to be displayed from already acquired buffer with this function
 extern "C" void changeDisplayedEnFaceFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction);
+extern "C" unsigned int cuda_getCompleteVolumesInRing();
+extern "C" bool cuda_copyBscanFromVolumeRing(unsigned int volumesAgo, unsigned int bscanNr, void* h_output); ///converts the B-scan to the streaming output format, blocks until the copy is done
 extern "C" inline void updateBscanDisplayBuffer(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction, cudaStream_t stream); ///as soon as new buffer is acquired this function is called and the display buffer gets updated
 extern "C" inline void updateEnFaceDisplayBuffer(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction, cudaStream_t stream); ///as soon as new buffer is acquired this function is called and the display buffer gets updated
 
@@ -26,7 +26,10 @@
 **/
 
 #include "octproz.h"
+#include "offlineprocessor.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <stdio.h>
 
 void style() {
 	qApp->setStyleSheet(
@@ -64,7 +67,75 @@ void style() {
 	qApp->setFont(font);
 }
 
+int processOffline(int argc, char *argv[]) {
+	QCoreApplication a(argc, argv);
+	a.setApplicationVersion(APP_VERSION);
+	a.setApplicationName(APP_NAME);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Processes a raw file without GUI and writes the processed buffers to a file.");
+	parser.addHelpOption();
+	QCommandLineOption processOption("process", "Raw file with consecutive acquisition buffers, for example a raw recording.", "raw file");
+	QCommandLineOption settingsOption("settings", "OCTproZ settings file, for example the meta information file of a recording.", "ini file");
+	QCommandLineOption outputOption("output", "Output file. Default: <raw file>_processed.raw", "file");
+	QCommandLineOption systemOption("system", "Settings group with the acquisition parameters. Default: " OFFLINE_PROCESSING_DEFAULT_SYSTEM, "name", OFFLINE_PROCESSING_DEFAULT_SYSTEM);
+	QCommandLineOption backendOption("backend", "cpu or cuda. Default: backend of the settings file", "backend");
+	QCommandLineOption bitDepthOption("bit-depth", "Bit depth of the raw data.", "bits");
+	QCommandLineOption samplesOption("samples", "Samples per raw A-scan.", "count");
+	QCommandLineOption ascansOption("ascans", "A-scans per B-scan.", "count");
+	QCommandLineOption bscansOption("bscans", "B-scans per buffer.", "count");
+	QCommandLineOption buffersPerVolumeOption("buffers-per-volume", "Buffers per volume.", "count");
+	QCommandLineOption buffersOption("buffers", "Process only the first buffers of the file.", "count");
+	QCommandLineOption resampleCurveOption("resampling-curve", "Custom resampling curve for k-linearization (csv).", "file");
+	QCommandLineOption backgroundOption("background", "Background for post processing background removal (csv).", "file");
+	parser.addOptions({processOption, settingsOption, outputOption, systemOption, backendOption, bitDepthOption, samplesOption, ascansOption, bscansOption, buffersPerVolumeOption, buffersOption, resampleCurveOption, backgroundOption});
+	parser.process(a);
+
+	if (!parser.isSet(settingsOption)) {
+		fprintf(stderr, "--settings is required.\n");
+		return 1;
+	}
+	OfflineProcessingOptions options;
+	options.inputFile = parser.value(processOption);
+	options.settingsFile = parser.value(settingsOption);
+	options.systemName = parser.value(systemOption);
+	options.resampleCurveFile = parser.value(resampleCurveOption);
+	options.backgroundFile = parser.value(backgroundOption);
+	options.backend = -1;
+	if (parser.isSet(backendOption)) {
+		options.backend = parser.value(backendOption).toLower() == "cuda" ? CUDA_GPU : MULTITHREADED_CPU;
+	}
+	options.bitDepth = parser.value(bitDepthOption).toUInt();
+	options.samplesPerLine = parser.value(samplesOption).toUInt();
+	options.ascansPerBscan = parser.value(ascansOption).toUInt();
+	options.bscansPerBuffer = parser.value(bscansOption).toUInt();
+	options.buffersPerVolume = parser.value(buffersPerVolumeOption).toUInt();
+	options.maxBuffers = parser.value(buffersOption).toLongLong();
+	options.outputFile = parser.value(outputOption);
+	if (options.outputFile.isEmpty()) {
+		QFileInfo inputInfo(options.inputFile);
+		options.outputFile = inputInfo.path() + "/" + inputInfo.completeBaseName() + "_processed.raw";
+	}
+
+	OfflineProcessor processor;
+	QObject::connect(&processor, &OfflineProcessor::info, [](QString message) {
+		printf("%s\n", qPrintable(message));
+		fflush(stdout);
+	});
+	QObject::connect(&processor, &OfflineProcessor::error, [](QString message) {
+		fprintf(stderr, "Error: %s\n", qPrintable(message));
+	});
+	return processor.run(options) ? 0 : 1;
+}
+
 int main(int argc, char *argv[]) {
+	//headless processing of a raw file: OCTproZ --process <raw file> --settings <ini file> [--output <file>]
+	for (int i = 1; i < argc; i++) {
+		if (QString(argv[i]).startsWith("--process")) {
+			return processOffline(argc, argv);
+		}
+	}
+
 	QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
 	QCoreApplication::setAttribute(Qt::AA_DontCheckOpenGLContextThreadAffinity);
 	QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
@@ -40,9 +40,19 @@ OctAlgorithmParameters::OctAlgorithmParameters()
 	buffersPerVolume(1),
 	bitDepth(8),
 	acquisitionParamsChanged(false),
+	processingBackend(PROCESSING_BACKEND::CUDA_GPU),
+	buffersInFlight(2),
+	pipelineWorkers(1),
+	autotuning(false),
+	cudaBlockSize(0),
+	cpuThreads(0),
+	cpuLinesPerFftBlock(0),
+	volumeRingMegabytes(0),
+	volumeStorage(FLOAT32_VOLUME),
 	bitshift(false),
 	bscanFlip(false),
 	signalLogScaling(false),
+	logAccuracy(LOG_ACCURACY::FAST_LOG_HIGH_ACCURACY),
 	sinusoidalScanCorrection(false),
 	signalGrayscaleMin(0.0f),
 	signalGrayscaleMax(60.0f),
@@ -95,6 +105,7 @@ OctAlgorithmParameters::OctAlgorithmParameters()
 	functionFramesBscan(0),
 	displayFunctionBscan(0),
 	displayFunctionEnFaceView(0),
+	displayedVolumeAge(0),
 	bscanViewEnabled(true),
 	enFaceViewEnabled(true),
 	volumeViewEnabled(false),
@@ -41,6 +41,24 @@ enum INTERPOLATION {
 	LANCZOS
 };
 
+enum PROCESSING_BACKEND {
+	CUDA_GPU,
+	MULTITHREADED_CPU
+};
+
+enum LOG_ACCURACY {
+	EXACT_LOG, ///log10f of the standard library
+	FAST_LOG_HIGH_ACCURACY, ///polynomial approximation, max. error 1e-4 dB
+	FAST_LOG_LOW_ACCURACY ///polynomial approximation, max. error 1e-2 dB
+};
+
+enum VOLUME_STORAGE {
+	FLOAT32_VOLUME,
+	FLOAT16_VOLUME, ///half precision, relative error < 5e-4
+	UINT16_VOLUME, ///65536 gray levels
+	UINT8_VOLUME ///same resolution as the volume view and 8 bit output
+};
+
 struct RecordingParams {
 	QString timestamp;
 	QString fileName;
@@ -91,9 +109,19 @@ public:
 	bool acquisitionParamsChanged;
 	
 	//processing
+	PROCESSING_BACKEND processingBackend; /// Selects the implementation that is used for processing. Changes take effect when processing is started the next time
+	unsigned int buffersInFlight; /// Number of buffers the processing pipeline works on at the same time (upload, processing and output of consecutive buffers overlap). Changes take effect when processing is started the next time
+	unsigned int pipelineWorkers; /// Number of independent workers that transform whole buffers in parallel (CPU processing only). Changes take effect when processing is started the next time
+	bool autotuning; /// Benchmark the processing granularity for the current geometry and hardware when processing is started and reuse the stored result afterwards (see autotuner.h). Overrides pipelineWorkers
+	unsigned int cudaBlockSize; /// Threads per block of the cuda kernels. 0 uses CUDA_DEFAULT_BLOCK_SIZE. Set by the autotuner
+	unsigned int cpuThreads; /// Threads of the conversion and fft stage of the CPU backend. 0 uses all cores. Set by the autotuner
+	unsigned int cpuLinesPerFftBlock; /// A-scans that one thread of the CPU backend converts and transforms at once. 0 uses CPU_FFT_LINES_PER_BLOCK. Set by the autotuner
+	unsigned int volumeRingMegabytes; /// Memory budget of the 4D ring that keeps the last complete processed volumes accessible (see volumering.h). 0 disables the ring. Changes take effect when processing is started the next time
+	VOLUME_STORAGE volumeStorage; /// Sample type of the processed volume. Compact types need 2 or 4 times less memory for the volume and for the depth-major en face copy. Changes take effect when processing is started the next time
 	bool bitshift;	/// Activating/Deactivating bit shift. This is needed if 12 bit values are transported as 2 bytes (= 16 bit) from the Alazar digitizer board ATS9373 for example
 	bool bscanFlip; ///	Activating/Deactivating flipping of every second B-scan. This is needed if B-scans are acquired in forward and backward scan direction
 	bool signalLogScaling; /// This variable is for activating/deactivating log scaling in OCT signal processing
+	LOG_ACCURACY logAccuracy; /// Accuracy of the log calculation of the CPU processing backend. The output is quantized for display anyway, so a fast approximation is usually sufficient
 	bool sinusoidalScanCorrection; /// Activating/Deactivating sinusoidal scan correction (corrects image distortion due to sinus scan of fast axis scanner)
 	float signalGrayscaleMin; /// User defined minimal signal value. Values greater than this will be cut off.
 	float signalGrayscaleMax; /// User defined maximal signal value. Values smaller than this will be cut off.
@@ -149,6 +177,7 @@ public:
 	unsigned int functionFramesBscan;
 	int displayFunctionBscan;
 	int displayFunctionEnFaceView;
+	unsigned int displayedVolumeAge; /// B-scan and en face view show the volume that was completed this many volumes ago from the 4D volume ring. 0 shows the volume that is currently processed
 	enum DISPLAY_FUNCTION {
 		AVERAGING,
 		MIP
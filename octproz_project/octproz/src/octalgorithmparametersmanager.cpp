@@ -1,4 +1,5 @@
 #include "octalgorithmparametersmanager.h"
+#include "settings.h"
 #include <QFile>
 #include <QTextStream>
 
@@ -9,6 +10,69 @@ OctAlgorithmParametersManager::OctAlgorithmParametersManager(QObject *parent) :
 	
 }
 
+void OctAlgorithmParametersManager::applyProcessingSettings(const QVariantMap& processingSettings) {
+	OctAlgorithmParameters* params = this->octParams;
+	params->processingBackend = (PROCESSING_BACKEND)processingSettings.value(PROC_BACKEND, static_cast<int>(CUDA_GPU)).toInt();
+	params->buffersInFlight = processingSettings.value(PROC_BUFFERS_IN_FLIGHT, 2).toUInt();
+	params->pipelineWorkers = processingSettings.value(PROC_PIPELINE_WORKERS, 1).toUInt();
+	params->autotuning = processingSettings.value(PROC_AUTOTUNING, false).toBool();
+	params->volumeStorage = (VOLUME_STORAGE)processingSettings.value(PROC_VOLUME_STORAGE, static_cast<int>(FLOAT32_VOLUME)).toInt();
+	params->volumeRingMegabytes = processingSettings.value(PROC_VOLUME_RING_MEGABYTES, 0).toUInt();
+	params->displayedVolumeAge = processingSettings.value(PROC_DISPLAYED_VOLUME_AGE, 0).toUInt();
+	params->bitshift = processingSettings.value(PROC_BITSHIFT, false).toBool();
+	params->bscanFlip = processingSettings.value(PROC_FLIP_BSCANS, false).toBool();
+	params->signalLogScaling = processingSettings.value(PROC_LOG, true).toBool();
+	params->logAccuracy = (LOG_ACCURACY)processingSettings.value(PROC_LOG_ACCURACY, static_cast<int>(FAST_LOG_HIGH_ACCURACY)).toInt();
+	params->signalGrayscaleMax = processingSettings.value(PROC_MAX, 100.0).toFloat();
+	params->signalGrayscaleMin = processingSettings.value(PROC_MIN, 30.0).toFloat();
+	params->signalMultiplicator = processingSettings.value(PROC_COEFF, 1.0).toFloat();
+	params->signalAddend = processingSettings.value(PROC_ADDEND, 0.0).toFloat();
+	params->backgroundRemoval = processingSettings.value(PROC_REMOVEBACKGROUND, false).toBool();
+	params->rollingAverageWindowSize = processingSettings.value(PROC_REMOVEBACKGROUND_WINDOW_SIZE, 64).toInt();
+	params->fixedPatternNoiseRemoval = processingSettings.value(PROC_FIXED_PATTERN_REMOVAL, false).toBool();
+	params->continuousFixedPatternNoiseDetermination = processingSettings.value(PROC_FIXED_PATTERN_REMOVAL_CONTINUOUSLY, false).toBool();
+	params->bscansForNoiseDetermination = processingSettings.value(PROC_FIXED_PATTERN_REMOVAL_BSCANS, 1).toUInt();
+	params->sinusoidalScanCorrection = processingSettings.value(PROC_SINUSOIDAL_SCAN_CORRECTION, false).toBool();
+	params->postProcessBackgroundRemoval = processingSettings.value(PROC_POST_BACKGROUND_REMOVAL, false).toBool();
+	params->postProcessBackgroundWeight = processingSettings.value(PROC_POST_BACKGROUND_WEIGHT, 1.0).toFloat();
+	params->postProcessBackgroundOffset = processingSettings.value(PROC_POST_BACKGROUND_OFFSET, 0.0).toFloat();
+
+	params->resampling = processingSettings.value(PROC_RESAMPLING, false).toBool();
+	params->resamplingInterpolation = (INTERPOLATION)processingSettings.value(PROC_RESAMPLING_INTERPOLATION, static_cast<int>(LINEAR)).toInt();
+	params->c0 = processingSettings.value(PROC_RESAMPLING_C0, 0.0).toFloat();
+	params->c1 = processingSettings.value(PROC_RESAMPLING_C1, 1024.0).toFloat();
+	params->c2 = processingSettings.value(PROC_RESAMPLING_C2, 0.0).toFloat();
+	params->c3 = processingSettings.value(PROC_RESAMPLING_C3, 0.0).toFloat();
+	params->updateResampleCurve();
+
+	params->dispersionCompensation = processingSettings.value(PROC_DISPERSION_COMPENSATION, false).toBool();
+	params->d0 = processingSettings.value(PROC_DISPERSION_COMPENSATION_D0, 0.0).toFloat();
+	params->d1 = processingSettings.value(PROC_DISPERSION_COMPENSATION_D1, 0.0).toFloat();
+	params->d2 = processingSettings.value(PROC_DISPERSION_COMPENSATION_D2, 0.0).toFloat();
+	params->d3 = processingSettings.value(PROC_DISPERSION_COMPENSATION_D3, 0.0).toFloat();
+	params->updateDispersionCurve();
+
+	params->windowing = processingSettings.value(PROC_WINDOWING, true).toBool();
+	params->window = (WindowFunction::WindowType)processingSettings.value(PROC_WINDOWING_TYPE, 0).toInt();
+	params->windowFillFactor = processingSettings.value(PROC_WINDOWING_FILL_FACTOR, 0.95).toFloat();
+	params->windowCenter = processingSettings.value(PROC_WINDOWING_CENTER_POSITION, 0.5).toFloat();
+	params->updateWindowCurve();
+	params->updatePostProcessingBackgroundCurve();
+}
+
+bool OctAlgorithmParametersManager::loadCustomResampleCurveFromFile(QString fileName) {
+	QVector<float> curve = this->loadCurveFromFromFile(fileName);
+	if(curve.size() > 0){
+		this->octParams->loadCustomResampleCurve(curve.data(), curve.size());
+		this->octParams->useCustomResampleCurve = true;
+		this->octParams->updateResampleCurve();
+		emit info(tr("Custom resampling curve loaded. File used: ") + fileName);
+		return true;
+	}
+	emit error(tr("Custom resampling curve has a size of 0. Check if .csv file with resampling curve is not empty has right format."));
+	return false;
+}
+
 QVector<float> OctAlgorithmParametersManager::loadCurveFromFromFile(QString fileName) {
 	QVector<float> curve;
 	if(fileName == ""){
@@ -29,14 +93,15 @@ QVector<float> OctAlgorithmParametersManager::loadCurveFromFromFile(QString file
 	return curve;
 }
 
-void OctAlgorithmParametersManager::loadPostProcessBackgroundFromFile(QString fileName) {
+bool OctAlgorithmParametersManager::loadPostProcessBackgroundFromFile(QString fileName) {
 	QVector<float> curve = this->loadCurveFromFromFile(fileName);
 	if(curve.size() > 0){
 		this->octParams->loadPostProcessingBackground(curve.data(), curve.size());
 		//this->sidebar->updateBackgroundPlot();
 		emit backgroundDataUpdated();
 		emit info(tr("Background data for post processing loaded. File used: ") + fileName);
-	}else{
-		emit error(tr("Background data has a size of 0. Check if the .csv file with background data is not empty and has the right format."));
+		return true;
 	}
+	emit error(tr("Background data has a size of 0. Check if the .csv file with background data is not empty and has the right format."));
+	return false;
 }
@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QString>
 #include <QVector>
+#include <QVariantMap>
 #include "octalgorithmparameters.h"
 
 class OctAlgorithmParametersManager : public QObject
@@ -12,6 +13,20 @@ class OctAlgorithmParametersManager : public QObject
 public:
 	explicit OctAlgorithmParametersManager(QObject *parent = nullptr);
 
+	/**
+	* Applies the settings of the processing group of a settings file (see PROC_* keys in settings.h) in the same way the sidebar does.
+	* Missing keys get the values of the default settings file. The acquisition parameters have to be set before, as they determine the length of the curves.
+	*
+	* @param processingSettings content of the processing group, for example from Settings::getStoredSettings(PROC)
+	**/
+	void applyProcessingSettings(const QVariantMap& processingSettings);
+
+	/**
+	* Loads a resampling curve for k-linearization from a csv file (sample number;sample value) and activates it.
+	*
+	* @return false if the file could not be read or contains no values
+	**/
+	bool loadCustomResampleCurveFromFile(QString fileName);
 	
 private:
 	OctAlgorithmParameters* octParams;
@@ -20,7 +35,7 @@ private:
 	
 
 public slots:
-	void loadPostProcessBackgroundFromFile(QString fileName);
+	bool loadPostProcessBackgroundFromFile(QString fileName);
 
 signals:
 	void error(QString);
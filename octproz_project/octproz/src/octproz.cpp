@@ -39,6 +39,8 @@ OCTproZ::OCTproZ(QWidget *parent) :
 
 	qApp->setApplicationVersion(APP_VERSION);
 	qApp->setApplicationName(APP_NAME);
+	Tracer::getInstance(); //plugins use the tracer instance that is created here, see tracer.h
+	Tracer::setThreadName("gui");
 
 	this->console = new MessageConsole(this);
 	this->console->setObjectName("Message Console");
@@ -129,7 +131,7 @@ OCTproZ::OCTproZ(QWidget *parent) :
 	#endif
 	connect(&processingThread, &QThread::finished, this->signalProcessing, &Processing::deleteLater);
 
-	connect(this, &OCTproZ::enableRecording, this->signalProcessing, &Processing::slot_enableRecording);
+	connect(this, &OCTproZ::enableRecording, this->signalProcessing, &Processing::slot_enableRecording, Qt::DirectConnection); //posts a control request to the processing thread, see Processing::postControlRequest()
 	connect(this->signalProcessing, &Processing::info, this->console, &MessageConsole::displayInfo);
 	connect(this->signalProcessing, &Processing::error, this->console, &MessageConsole::displayError);
 	connect(this->signalProcessing, &Processing::initializationDone, this, &OCTproZ::slot_enableStopAction);
@@ -139,15 +141,16 @@ OCTproZ::OCTproZ(QWidget *parent) :
 	connect(this->signalProcessing, &Processing::processedRecordDone, this, &OCTproZ::slot_recordingDone);
 	connect(this->signalProcessing, &Processing::rawRecordDone, this, &OCTproZ::slot_recordingDone);
 	//B-scan window connections:
-	connect(this->bscanWindow->getControlPanel(), &ControlPanel2D::displayFrameSettingsChanged, this->signalProcessing, &Processing::slot_updateDisplayedBscanFrame);
-	connect(this->bscanWindow, &GLWindow2D::registerBufferCudaGL, this->signalProcessing, &Processing::slot_registerBscanOpenGLbufferWithCuda);
+	connect(this->bscanWindow->getControlPanel(), &ControlPanel2D::displayFrameSettingsChanged, this->signalProcessing, &Processing::slot_updateDisplayedBscanFrame, Qt::DirectConnection);
+	connect(this->bscanWindow, &GLWindow2D::registerBufferCudaGL, this->signalProcessing, &Processing::slot_registerBscanOpenGLbufferWithCuda, Qt::DirectConnection);
 	//En face view window connections:
-	connect(this->enFaceViewWindow->getControlPanel(), &ControlPanel2D::displayFrameSettingsChanged, this->signalProcessing, &Processing::slot_updateDisplayedEnFaceFrame);
-	connect(this->enFaceViewWindow, &GLWindow2D::registerBufferCudaGL, this->signalProcessing, &Processing::slot_registerEnFaceViewOpenGLbufferWithCuda);
+	connect(this->enFaceViewWindow->getControlPanel(), &ControlPanel2D::displayFrameSettingsChanged, this->signalProcessing, &Processing::slot_updateDisplayedEnFaceFrame, Qt::DirectConnection);
+	connect(this->enFaceViewWindow, &GLWindow2D::registerBufferCudaGL, this->signalProcessing, &Processing::slot_registerEnFaceViewOpenGLbufferWithCuda, Qt::DirectConnection);
 	//Volume window connections:
-	connect(this->volumeWindow, &GLWindow3D::registerBufferCudaGL, this->signalProcessing, &Processing::slot_registerVolumeViewOpenGLbufferWithCuda);
+	connect(this->volumeWindow, &GLWindow3D::registerBufferCudaGL, this->signalProcessing, &Processing::slot_registerVolumeViewOpenGLbufferWithCuda, Qt::DirectConnection);
 	//Processing connections:
 	connect(this->signalProcessing, &Processing::updateInfoBox, this->sidebar, &Sidebar::slot_updateInfoBox);
+	connect(this->signalProcessing, &Processing::updateStageTimings, this->sidebar, &Sidebar::slot_updateStageTimings);
 	connect(this->signalProcessing, &Processing::initOpenGL, this->bscanWindow, &GLWindow2D::createOpenGLContextForProcessing);
 	if(!this->processingInThread){
 		connect(this->signalProcessing, &Processing::initOpenGL, this->enFaceViewWindow, &GLWindow2D::createOpenGLContextForProcessing); //due to opengl context sharing this connect is not necessary
@@ -390,6 +393,10 @@ void OCTproZ::initMenu() {
 	QList<QAction*> klinActions;
 	klinActions << this->actionUseSidebarKLinCurve << this->actionUseCustomKLinCurve << klinSeparator <<this->actionSetCustomKLinCurve; //todo: move k-linearization actions to sidebar class as well as loadResamplingCurveFromFile method. Get the actions from the sidebar to create the extras menu of main window. Save if custom curve is used and add auto loading at startup
 	this->sidebar->addActionsForKlinGroupBoxMenu(klinActions);
+	this->actionRecordTrace = this->extrasMenu->addAction(tr("Record &trace"));
+	this->actionRecordTrace->setCheckable(true);
+	this->actionRecordTrace->setStatusTip(tr("Record a timeline of acquisition, processing, recording and display. The trace is saved in the Chrome trace event format when recording is stopped."));
+	connect(this->actionRecordTrace, &QAction::toggled, this, &OCTproZ::slot_recordTrace);
 
 	//help menu
 	QMenu *helpMenu = this->menuBar()->addMenu(tr("&Help"));
@@ -659,6 +666,8 @@ void OCTproZ::slot_menuExtensions() {
 				connect(this->signalProcessing, &Processing::streamingBufferEnabled, extension, &Extension::enableProcessedDataGrabbing);
 				connect(this->processedDataNotifier, &Gpu2HostNotifier::newGpuDataAvailible, extension, &Extension::processedDataReceived);
 				connect(this->signalProcessing, &Processing::rawData, extension, &Extension::rawDataReceived);
+				connect(extension, &Extension::grabVolumeRingBscanRequest, this->signalProcessing, &Processing::slot_grabBscanFromVolumeRing, Qt::DirectConnection);
+				connect(this->signalProcessing, &Processing::volumeRingBscan, extension, &Extension::volumeRingBscanReceived);
 			}
 	}
 	//else (i.e. extension is visible within sidebar or as separate window) deactivate extension if user unchecked extension in menu
@@ -676,6 +685,8 @@ void OCTproZ::slot_menuExtensions() {
 					disconnect(this->signalProcessing, &Processing::streamingBufferEnabled, extension, &Extension::enableProcessedDataGrabbing);
 					disconnect(this->processedDataNotifier, &Gpu2HostNotifier::newGpuDataAvailible, extension, &Extension::processedDataReceived);
 					disconnect(this->signalProcessing, &Processing::rawData, extension, &Extension::rawDataReceived);
+					disconnect(extension, &Extension::grabVolumeRingBscanRequest, this->signalProcessing, &Processing::slot_grabBscanFromVolumeRing);
+					disconnect(this->signalProcessing, &Processing::volumeRingBscan, extension, &Extension::volumeRingBscanReceived);
 				} else if( extension->getDisplayStyle() == SEPARATE_WINDOW){
 					extensionWidget->close();
 				}
@@ -706,6 +717,8 @@ void OCTproZ::slot_uncheckExtensionInMenu(Extension* extension) {
 	disconnect(this->signalProcessing, &Processing::streamingBufferEnabled, extension, &Extension::enableProcessedDataGrabbing);
 	disconnect(this->processedDataNotifier, &Gpu2HostNotifier::newGpuDataAvailible, extension, &Extension::processedDataReceived);
 	disconnect(this->signalProcessing, &Processing::rawData, extension, &Extension::rawDataReceived);
+	disconnect(extension, &Extension::grabVolumeRingBscanRequest, this->signalProcessing, &Processing::slot_grabBscanFromVolumeRing);
+	disconnect(this->signalProcessing, &Processing::volumeRingBscan, extension, &Extension::volumeRingBscanReceived);
 }
 
 void OCTproZ::slot_enableStopAction() {
@@ -846,6 +859,35 @@ void OCTproZ::slot_loadCustomResamplingCurve() {
 	this->loadResamplingCurveFromFile(fileName);
 }
 
+void OCTproZ::slot_recordTrace(bool enable) {
+	Tracer* tracer = Tracer::getInstance();
+	if (enable) {
+		tracer->start();
+		emit info(tr("Trace recording started."));
+		return;
+	}
+	tracer->stop();
+	QString filters("Chrome trace (*.json)");
+	QString defaultFilter("Chrome trace (*.json)");
+	this->slot_closeOpenGLwindows();
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Save trace"), QDir::currentPath(), filters, &defaultFilter);
+	this->slot_reopenOpenGLwindows();
+	if (fileName == "") {
+		emit info(tr("Trace recording stopped. Trace was not saved."));
+		return;
+	}
+	QString errorMessage;
+	if (!tracer->save(fileName, &errorMessage)) {
+		emit error(tr("Could not save trace to ") + fileName + ": " + errorMessage);
+		return;
+	}
+	unsigned int droppedEvents = tracer->getDroppedEvents();
+	if (droppedEvents > 0) {
+		emit info(tr("Trace buffers were full, events dropped: ") + QString::number(droppedEvents));
+	}
+	emit info(tr("Trace saved to ") + fileName + tr(". Open it with chrome://tracing or ui.perfetto.dev"));
+}
+
 void OCTproZ::setSystem(QString systemName) {
 	if(this->currSystemName == systemName){ //system already activated
 		emit info(tr("System is already open."));
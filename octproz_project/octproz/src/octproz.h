@@ -119,6 +119,7 @@ public slots:
 	void slot_easterEgg();
 	void slot_useCustomResamplingCurve(bool use);
 	void slot_loadCustomResamplingCurve();
+	void slot_recordTrace(bool enable);
 
 
 private:
@@ -174,6 +175,7 @@ private:
 	QAction* actionUseSidebarKLinCurve;
 	QAction* actionUseCustomKLinCurve;
 	QAction* actionSetCustomKLinCurve;
+	QAction* actionRecordTrace;
 
 	MessageConsole* console;
 
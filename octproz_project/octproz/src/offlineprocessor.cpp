@@ -0,0 +1,292 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "offlineprocessor.h"
+#include "cpuprocessingbackend.h"
+#include "cudaprocessingbackend.h"
+#include "cpufeatures.h"
+#include "autotuner.h"
+#include "stagetimings.h"
+#include "gpu2hostnotifier.h"
+#include "settings.h"
+#include <QSettings>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <math.h>
+
+//acquisition parameters in the settings group of the system, these are the keys of Virtual OCT System
+#define SYSTEM_BITDEPTH "bit_depth"
+#define SYSTEM_WIDTH "width"
+#define SYSTEM_HEIGHT "height"
+#define SYSTEM_DEPTH "depth"
+#define SYSTEM_BUFFERS_PER_VOLUME "buffers_per_volume"
+#define SYSTEM_FILEPATH "file_path"
+
+
+OfflineProcessor::OfflineProcessor(QObject* parent) : QObject(parent) {
+	this->octParams = OctAlgorithmParameters::getInstance();
+	this->paramsManager = new OctAlgorithmParametersManager(this);
+	connect(this->paramsManager, &OctAlgorithmParametersManager::info, this, &OfflineProcessor::info);
+	connect(this->paramsManager, &OctAlgorithmParametersManager::error, this, &OfflineProcessor::error);
+	this->backend = nullptr;
+	this->inputBuffer = new AcquisitionBuffer();
+	this->streamingBuffer = new AcquisitionBuffer();
+	this->bytesPerOutputBuffer = 0;
+	this->writtenBuffers = 0;
+	this->writeFailed = false;
+}
+
+OfflineProcessor::~OfflineProcessor() {
+	delete this->backend;
+	delete this->inputBuffer;
+	delete this->streamingBuffer;
+}
+
+bool OfflineProcessor::run(const OfflineProcessingOptions& options) {
+	if (!this->applySettings(options)) {
+		return false;
+	}
+
+	//the file is processed in whole acquisition buffers, a remainder that is smaller than one buffer is ignored
+	QFile inputFile(this->inputFileName);
+	if (!inputFile.open(QIODevice::ReadOnly)) {
+		emit error(tr("Could not open input file: ") + this->inputFileName);
+		return false;
+	}
+	size_t bytesPerSample = static_cast<size_t>(ceil(static_cast<double>(this->octParams->bitDepth) / 8.0));
+	size_t bytesPerBuffer = bytesPerSample * this->octParams->samplesPerLine * this->octParams->ascansPerBscan * this->octParams->bscansPerBuffer;
+	qint64 buffersInFile = inputFile.size() / static_cast<qint64>(bytesPerBuffer);
+	if (buffersInFile == 0) {
+		emit error(tr("Input file is smaller than one buffer (") + QString::number(bytesPerBuffer) + tr(" bytes). Check the acquisition parameters."));
+		return false;
+	}
+	qint64 remainingBytes = inputFile.size() - buffersInFile * static_cast<qint64>(bytesPerBuffer);
+	if (remainingBytes != 0) {
+		emit info(tr("The last ") + QString::number(remainingBytes) + tr(" bytes of the input file do not fill a whole buffer and are ignored."));
+	}
+	qint64 buffersToProcess = options.maxBuffers > 0 ? qMin(options.maxBuffers, buffersInFile) : buffersInFile;
+
+	this->outputFile.setFileName(options.outputFile);
+	if (!this->outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		emit error(tr("Could not open output file: ") + options.outputFile);
+		return false;
+	}
+
+	//page aligned buffers like the acquisition buffers of the acquisition systems
+	if (!this->inputBuffer->allocateMemory(2, bytesPerBuffer) || !this->streamingBuffer->allocateMemory(2, bytesPerBuffer)) {
+		emit error(tr("Could not allocate input and output buffers."));
+		return false;
+	}
+	this->bytesPerOutputBuffer = bytesPerBuffer / 2;
+	void* h_buffer1 = this->inputBuffer->bufferArray[0];
+	void* h_buffer2 = this->inputBuffer->bufferArray[1];
+
+	this->selectBackend();
+	QString backendName = QString(this->backend->getName());
+	if (this->octParams->autotuning) {
+		//the autotuner benchmarks with the first two buffers of the file
+		inputFile.read(static_cast<char*>(h_buffer1), bytesPerBuffer);
+		if (buffersInFile > 1) {
+			inputFile.read(static_cast<char*>(h_buffer2), bytesPerBuffer);
+		}
+		inputFile.seek(0);
+		this->autotune(this->inputBuffer->bufferArray.data(), this->inputBuffer->bufferCnt);
+	} else {
+		this->octParams->cudaBlockSize = 0;
+		this->octParams->cpuThreads = 0;
+		this->octParams->cpuLinesPerFftBlock = 0;
+	}
+	if (!this->backend->init(this->inputBuffer->bufferArray.data(), this->inputBuffer->bufferCnt, this->octParams)) {
+		emit error(tr("Processing initialization failed (") + backendName + tr("). Not enough memory?"));
+		this->backend->cleanup();
+		return false;
+	}
+	this->backend->registerStreamingBuffers(this->streamingBuffer->bufferArray[0], this->streamingBuffer->bufferArray[1], bytesPerBuffer);
+	StageTimings::getInstance()->reset();
+
+	//the streaming callback is called in processing order and the backend does not overwrite a streaming buffer before the callback returned
+	this->writtenBuffers = 0;
+	this->writeFailed = false;
+	QMetaObject::Connection connection = connect(Gpu2HostNotifier::getInstance(), &Gpu2HostNotifier::newGpuDataAvailible, this, &OfflineProcessor::slot_writeProcessedBuffer, Qt::DirectConnection);
+
+	emit info(tr("Processing ") + QString::number(buffersToProcess) + tr(" buffers of ") + this->inputFileName + tr(" (") + backendName + tr(")..."));
+	QElapsedTimer timer;
+	timer.start();
+	QElapsedTimer infoTimer;
+	infoTimer.start();
+	qint64 processedBuffers = 0;
+	bool readFailed = false; //input file or backend failed, the error has been emitted already
+	while (processedBuffers < buffersToProcess && !this->writeFailed) {
+		//process() returns as soon as the buffer has been consumed, so the next buffer can be read while the previous ones are still processed
+		void* h_buffer = processedBuffers % 2 == 0 ? h_buffer1 : h_buffer2;
+		if (inputFile.read(static_cast<char*>(h_buffer), bytesPerBuffer) != static_cast<qint64>(bytesPerBuffer)) {
+			emit error(tr("Could not read buffer ") + QString::number(processedBuffers) + tr(" of the input file."));
+			readFailed = true;
+			break;
+		}
+		if (!this->backend->process(h_buffer)) {
+			emit error(tr("Processing failed (") + backendName + tr("): ") + QString::fromStdString(this->backend->getLastError()));
+			readFailed = true;
+			break;
+		}
+		processedBuffers++;
+
+		if (infoTimer.elapsed() >= OFFLINE_PROCESSING_INFO_INTERVAL_MS) {
+			qreal buffersPerSecond = static_cast<qreal>(processedBuffers) / (timer.elapsed() / 1000.0);
+			emit info(QString::number(processedBuffers) + "/" + QString::number(buffersToProcess) + tr(" buffers, ") + QString::number(buffersPerSecond, 'f', 1) + tr(" buffers per second"));
+			infoTimer.restart();
+		}
+	}
+	this->backend->synchronize();
+	disconnect(connection);
+	qreal seconds = timer.elapsed() / 1000.0;
+	this->backend->unregisterStreamingBuffers();
+	this->backend->cleanup();
+	this->outputFile.close();
+
+	if (this->writeFailed || this->writtenBuffers != processedBuffers) {
+		emit error(tr("Writing the processed data failed. Buffers written: ") + QString::number(this->writtenBuffers) + "/" + QString::number(processedBuffers));
+		return false;
+	}
+	if (readFailed) {
+		return false;
+	}
+	qreal megabytes = processedBuffers * static_cast<qreal>(bytesPerBuffer) / 1048576.0;
+	emit info(tr("Processed ") + QString::number(processedBuffers) + tr(" buffers in ") + QString::number(seconds, 'f', 1) + tr(" s (") + QString::number(processedBuffers / qMax(seconds, 0.001), 'f', 1) + tr(" buffers per second, ")
+		+ QString::number(megabytes / qMax(seconds, 0.001), 'f', 1) + tr(" MB/s raw data). Output written to ") + options.outputFile);
+	return true;
+}
+
+bool OfflineProcessor::applySettings(const OfflineProcessingOptions& options) {
+	if (!QFileInfo::exists(options.settingsFile)) {
+		emit error(tr("Settings file not found: ") + options.settingsFile);
+		return false;
+	}
+	QSettings settings(options.settingsFile, QSettings::IniFormat);
+
+	//acquisition parameters: command line options take precedence over the settings of the system
+	settings.beginGroup(options.systemName);
+	unsigned int bitDepth = options.bitDepth != 0 ? options.bitDepth : settings.value(SYSTEM_BITDEPTH, 0).toUInt();
+	unsigned int samplesPerLine = options.samplesPerLine != 0 ? options.samplesPerLine : settings.value(SYSTEM_WIDTH, 0).toUInt();
+	unsigned int ascansPerBscan = options.ascansPerBscan != 0 ? options.ascansPerBscan : settings.value(SYSTEM_HEIGHT, 0).toUInt();
+	unsigned int bscansPerBuffer = options.bscansPerBuffer != 0 ? options.bscansPerBuffer : settings.value(SYSTEM_DEPTH, 0).toUInt();
+	unsigned int buffersPerVolume = options.buffersPerVolume != 0 ? options.buffersPerVolume : settings.value(SYSTEM_BUFFERS_PER_VOLUME, 0).toUInt();
+	this->inputFileName = options.inputFile.isEmpty() ? settings.value(SYSTEM_FILEPATH).toString() : options.inputFile;
+	settings.endGroup();
+	if (bitDepth == 0 || samplesPerLine == 0 || ascansPerBscan == 0 || bscansPerBuffer == 0 || buffersPerVolume == 0) {
+		emit error(tr("Acquisition parameters are missing. They have to be in the settings group \"") + options.systemName + tr("\" or passed as options."));
+		return false;
+	}
+	if (this->inputFileName.isEmpty()) {
+		emit error(tr("No input file."));
+		return false;
+	}
+	this->octParams->bitDepth = bitDepth;
+	this->octParams->samplesPerLine = samplesPerLine;
+	this->octParams->ascansPerBscan = ascansPerBscan;
+	this->octParams->bscansPerBuffer = bscansPerBuffer;
+	this->octParams->buffersPerVolume = buffersPerVolume;
+	this->octParams->acquisitionParamsChanged = true;
+
+	QVariantMap processingSettings;
+	settings.beginGroup(PROC);
+	QStringList keys = settings.allKeys();
+	for (int i = 0; i < keys.size(); i++) {
+		processingSettings.insert(keys.at(i), settings.value(keys.at(i)));
+	}
+	settings.endGroup();
+	this->paramsManager->applyProcessingSettings(processingSettings);
+	if (options.backend >= 0) {
+		this->octParams->processingBackend = static_cast<PROCESSING_BACKEND>(options.backend);
+	}
+	if (!options.resampleCurveFile.isEmpty() && !this->paramsManager->loadCustomResampleCurveFromFile(options.resampleCurveFile)) {
+		return false;
+	}
+	if (!options.backgroundFile.isEmpty() && !this->paramsManager->loadPostProcessBackgroundFromFile(options.backgroundFile)) {
+		return false;
+	}
+
+	//nothing is displayed, every processed buffer is streamed to the output file
+	this->octParams->bscanViewEnabled = false;
+	this->octParams->enFaceViewEnabled = false;
+	this->octParams->volumeViewEnabled = false;
+	this->octParams->volumeRingMegabytes = 0;
+	this->octParams->displayedVolumeAge = 0;
+	this->octParams->postProcessBackgroundRecordingRequested = false;
+	this->octParams->streamToHost = true;
+	this->octParams->streamingBuffersToSkip = 0;
+	this->octParams->streamingParamsChanged = false;
+	this->octParams->updateBufferSizeInBytes();
+	this->octParams->acquisitionParamsChanged = false;
+	return true;
+}
+
+void OfflineProcessor::selectBackend() {
+	delete this->backend;
+	bool useCuda = this->octParams->processingBackend == CUDA_GPU;
+	if (useCuda && !CudaProcessingBackend::isDeviceAvailable()) {
+		emit info(tr("No CUDA capable GPU found. CPU is used for processing."));
+		useCuda = false;
+	}
+	if (useCuda) {
+		this->backend = new CudaProcessingBackend();
+	} else {
+		CpuProcessingBackend* cpuBackend = new CpuProcessingBackend();
+		emit info(tr("CPU processing uses ") + QString::number(cpuBackend->getThreadCount()) + tr(" threads and ") + QString(CpuFeatures::getSimdLevelName(CpuFeatures::getSimdLevel())) + tr(" vector instructions."));
+		this->backend = cpuBackend;
+	}
+}
+
+void OfflineProcessor::autotune(void** h_buffers, unsigned int bufferCount) {
+	Autotuner autotuner(this->backend, this->octParams);
+	if (autotuner.applyStoredConfiguration()) {
+		emit info(tr("Autotuning: stored configuration is used (") + autotuner.getConfigurationDescription() + tr(")."));
+		return;
+	}
+	emit info(tr("Autotuning for ") + autotuner.getKey() + tr(". This takes a few seconds..."));
+	autotuner.run(h_buffers, bufferCount);
+	emit info(tr("Autotuning done: ") + autotuner.getConfigurationDescription() + tr(", ") + QString::number(autotuner.getBuffersPerSecond(), 'f', 1) + tr(" buffers per second."));
+}
+
+void OfflineProcessor::slot_writeProcessedBuffer(void* buffer, unsigned bitDepth, unsigned int samplesPerLine, unsigned int linesPerFrame, unsigned int framesPerBuffer, unsigned int buffersPerVolume, unsigned int currentBufferNr) {
+	Q_UNUSED(bitDepth);
+	Q_UNUSED(samplesPerLine);
+	Q_UNUSED(linesPerFrame);
+	Q_UNUSED(framesPerBuffer);
+	Q_UNUSED(buffersPerVolume);
+	Q_UNUSED(currentBufferNr);
+
+	if (this->writeFailed) {
+		return;
+	}
+	qint64 written = this->outputFile.write(static_cast<const char*>(buffer), static_cast<qint64>(this->bytesPerOutputBuffer));
+	if (written != static_cast<qint64>(this->bytesPerOutputBuffer)) {
+		this->writeFailed = true;
+		return;
+	}
+	this->writtenBuffers++;
+}
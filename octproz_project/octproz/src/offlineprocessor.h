@@ -0,0 +1,99 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef OFFLINEPROCESSOR_H
+#define OFFLINEPROCESSOR_H
+
+#define OFFLINE_PROCESSING_DEFAULT_SYSTEM "Virtual OCT System"
+#define OFFLINE_PROCESSING_INFO_INTERVAL_MS 5000
+
+#include <QObject>
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include "octproz_devkit.h"
+#include "octalgorithmparameters.h"
+#include "octalgorithmparametersmanager.h"
+#include "processingbackend.h"
+
+
+struct OfflineProcessingOptions {
+	QString inputFile; ///raw file with consecutive acquisition buffers, for example a raw recording. Empty uses the file_path of the system settings group (Virtual OCT System)
+	QString settingsFile; ///OCTproZ settings file, for example the meta information file of a recording
+	QString outputFile; ///processed buffers are written consecutively in the format of processed recordings
+	QString systemName; ///settings group with bit_depth, width, height, depth and buffers_per_volume (the keys of Virtual OCT System)
+	QString resampleCurveFile; ///optional custom resampling curve for k-linearization (csv)
+	QString backgroundFile; ///optional background for post processing background removal (csv)
+	int backend; ///PROCESSING_BACKEND, -1 uses the backend of the settings file
+	unsigned int bitDepth; ///0 uses the value of the settings file, same for the other acquisition parameters
+	unsigned int samplesPerLine;
+	unsigned int ascansPerBscan;
+	unsigned int bscansPerBuffer;
+	unsigned int buffersPerVolume;
+	qint64 maxBuffers; ///0 processes the whole input file
+};
+
+
+/**
+* Processes a raw file without GUI, OpenGL context or acquisition system (OCTproZ --process, see main.cpp).
+* Buffers are read from the input file and passed to the processing backend as fast as it consumes them. The processed buffers are
+* written to the output file by the streaming callback of the backend, which keeps the processing pipeline in order.
+**/
+class OfflineProcessor : public QObject
+{
+	Q_OBJECT
+public:
+	explicit OfflineProcessor(QObject* parent = nullptr);
+	~OfflineProcessor();
+
+	bool run(const OfflineProcessingOptions& options); ///blocks until the whole input file is processed and written. Returns false on any error
+
+private:
+	bool applySettings(const OfflineProcessingOptions& options);
+	void selectBackend();
+	void autotune(void** h_buffers, unsigned int bufferCount);
+
+	OctAlgorithmParameters* octParams;
+	OctAlgorithmParametersManager* paramsManager;
+	ProcessingBackend* backend;
+	AcquisitionBuffer* inputBuffer;
+	AcquisitionBuffer* streamingBuffer;
+	QString inputFileName;
+	QFile outputFile;
+	size_t bytesPerOutputBuffer;
+	qint64 writtenBuffers; ///only accessed by the streaming callback until the backend is synchronized
+	std::atomic<bool> writeFailed;
+
+public slots:
+	void slot_writeProcessedBuffer(void* buffer, unsigned bitDepth, unsigned int samplesPerLine, unsigned int linesPerFrame, unsigned int framesPerBuffer, unsigned int buffersPerVolume, unsigned int currentBufferNr);
+
+signals:
+	void error(QString);
+	void info(QString);
+};
+
+#endif // OFFLINEPROCESSOR_H
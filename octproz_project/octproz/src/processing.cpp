@@ -41,6 +41,15 @@ Processing::Processing(){
 	this->rawRecorder = nullptr;
 	this->processedRecorder = nullptr;
 	this->currBufferNr = 0;
+	this->backend = nullptr;
+	this->glBufferBscan = 0;
+	this->glBufferEnFaceView = 0;
+	this->glTextureVolumeView = 0;
+	this->controlBuffer = nullptr;
+	this->controlConsumerId = -1;
+
+	//fft plans of the cpu backend are cached for the whole session, the planner wisdom is kept on disk to make the first start after a restart fast
+	FftPlanCache::getInstance()->setWisdomFile(QString(SETTINGS_PATH_FFTW_WISDOM_FILE).toLocal8Bit().toStdString());
 
 
 	this->rawRecorder = new Recorder("raw");
@@ -76,29 +85,54 @@ Processing::~Processing(){
 	delete this->context;
 	delete this->streamingBuffer;
 	this->surface->deleteLater();
-	cleanupCuda();
+	delete this->backend;
 	qDebug() << "Processing destructor. Thread ID: " << QThread::currentThreadId();
 }
 
 
 void Processing::slot_start(AcquisitionSystem* system){
 	if (system != nullptr) {
+		this->selectBackend();
+		QString backendName = QString(this->backend->getName());
+
 		//emit initOpenGL(&(this->context), &(this->surface), this->thread());
-		emit info(tr("GPU processing initialization..."));
+		emit info(tr("Processing initialization (") + backendName + tr(")..."));
 		emit initOpenGLenFaceView();
 		emit initOpenGL((this->context), (this->surface), this->thread());
 		QCoreApplication::processEvents();
 
+		//register as consumer before the acquisition system has filled the ring, so that no buffer is missed
 		AcquisitionBuffer* buffer = system->buffer;
-		void* h_buffer1 = buffer->bufferArray[0];
-		void* h_buffer2 = buffer->bufferArray[1];
+		int consumerId = buffer->registerConsumer();
+		if (consumerId < 0) {
+			emit error(tr("Processing could not be registered as consumer of the acquisition buffer."));
+			emit initializationDone();
+			this->finishProcessing(buffer, -1, false);
+			return;
+		}
+		//the backend gets the whole ring, so that every buffer can be page-locked for asynchronous uploads
+		void** h_buffers = buffer->bufferArray.data();
+		unsigned int bufferCount = buffer->bufferCnt;
 		unsigned int width = this->octParams->samplesPerLine;
 		unsigned int height = this->octParams->ascansPerBscan;
 		unsigned int depth = this->octParams->bscansPerBuffer;
 		unsigned int bitDepth = this->octParams->bitDepth;
 		unsigned int buffersPerVolume = this->octParams->buffersPerVolume;
 		this->currBufferNr = buffersPerVolume-1;
-		initializeCuda(h_buffer1, h_buffer2, this->octParams);
+		if (this->octParams->autotuning) {
+			this->autotune(h_buffers, bufferCount);
+		} else {
+			this->octParams->cudaBlockSize = 0;
+			this->octParams->cpuThreads = 0;
+			this->octParams->cpuLinesPerFftBlock = 0;
+		}
+		if (!this->backend->init(h_buffers, bufferCount, this->octParams)) {
+			emit error(tr("Processing initialization failed (") + backendName + tr("). Not enough memory?"));
+			emit initializationDone();
+			this->finishProcessing(buffer, consumerId, false);
+			return;
+		}
+		StageTimings::getInstance()->reset(); //the autotuner processes buffers as well
 
 		//init streaming if streamToHost option was already checked on startup
 		if (this->octParams->streamToHost && !this->octParams->streamingParamsChanged) {
@@ -112,130 +146,259 @@ void Processing::slot_start(AcquisitionSystem* system){
 		QElapsedTimer timer;
 		timer.start();
 		unsigned int processedBuffers = 0;
+		bool processingErrorReported = false; //a backend that fails once usually fails for every following buffer as well
 
-		emit info(tr("GPU processing initialized."));
+		//control requests and display data that gets ready in the background wake up the loop while it waits for the next buffer
+		{
+			std::lock_guard<std::mutex> lock(this->controlMutex);
+			this->controlBuffer = buffer;
+			this->controlConsumerId = consumerId;
+		}
+		this->backend->setDisplayUpdateNotifier([buffer, consumerId]() { buffer->wakeUp(consumerId); });
+
+		//if processing runs in the gui thread the event loop must not be blocked for long
+		bool processingInGuiThread = this->thread() == QCoreApplication::instance()->thread();
+		int waitTimeoutMs = processingInGuiThread ? PROCESSING_GUI_THREAD_WAIT_TIMEOUT_MS : PROCESSING_WAIT_TIMEOUT_MS;
+		QElapsedTimer eventTimer;
+		eventTimer.start();
+
+		emit info(tr("Processing initialized (") + backendName + tr(")."));
 		emit initializationDone();
+		Tracer::setThreadName("processing");
 
 		//acquisition and processing loop
 		while (system->acqusitionRunning) {
-			int bufferPos = buffer->currIndex;
+			//display and parameter requests from other threads
+			this->slot_executeControlRequests();
+
+			//buffers are processed in the order in which the acquisition system published them. the thread sleeps until the next buffer is published, a control request arrives or the timeout has passed
+			unsigned long long sequence = 0;
+			int bufferPos = buffer->waitForBuffer(consumerId, waitTimeoutMs, &sequence);
 			if (bufferPos >= 0) {
-				if (buffer->bufferReadyArray[bufferPos]) {
-					//emit rawData signal to record raw data if recorder is enabled
-					this->currBufferNr = (this->currBufferNr+1)%buffersPerVolume;
-					emit rawData(buffer->bufferArray[bufferPos], bitDepth, width, height, depth, buffersPerVolume, this->currBufferNr);
-					QCoreApplication::processEvents();
-
-					//make OpenGL context current and process raw data on GPU
-					this->context->makeCurrent(this->surface);
-					octCudaPipeline(buffer->bufferArray[bufferPos]); //todo: wrap cuda functions in extra class such that oct processing implementations with other gpu/multi threading frameworks (OpenCL, OpenMP, C++ AMP) can be used interchangeably
-					this->context->doneCurrent();
-
-					//set bufferReadyArray flag to false to indicate that acquisition system is allowed to reuse this buffer
-					buffer->bufferReadyArray[bufferPos] = false;
-
-					//volumes/second calculation every 5 seconds
-					processedBuffers++;
-					qreal elapsedTime = timer.elapsed();
-					qreal captureInfoTime = 5000;
-					if (elapsedTime >= captureInfoTime) {
-						this->buffersPerSecond  = (qreal)processedBuffers / (elapsedTime / 1000.0);
-						qreal volumesPerSecond = buffersPerSecond / static_cast<qreal>(this->octParams->buffersPerVolume);
-						qreal bscansPerSecond = this->buffersPerSecond * (qreal)depth;
-						qreal ascansPerSecond = bscansPerSecond * (qreal)height;
-						qreal bufferSizeMB = (qreal)bufferSizeInBytes / 1048576.0; //1 Kilobyte is 1024 Bytes. 1 Megabyte is equal to 1024 Kilobytes or 1048576 Bytes
-						qreal dataThroughput = this->buffersPerSecond * bufferSizeMB;
-						emit updateInfoBox(QString::number(volumesPerSecond), QString::number(this->buffersPerSecond), QString::number(bscansPerSecond), QString::number(ascansPerSecond), QString::number(bufferSizeMB), QString::number(dataThroughput));
-						processedBuffers = 0;
-						timer.restart();
-					}
-
-					//gpu 2 host-ram streaming
-					if (this->octParams->streamingParamsChanged) {
-						this->enableGpu2HostStreaming(this->octParams->streamToHost);
-						this->octParams->streamingParamsChanged = false;
-					}
+				if (Tracer::getInstance()->isRunning()) {
+					Tracer::counter("acquisition buffer", bufferPos);
+					Tracer::counter("acquisition sequence", static_cast<long long>(sequence));
+					Tracer::counter("acquisition queue depth", buffer->getAvailableBuffers(consumerId) + 1);
+					Tracer::counter("skipped acquisition buffers", static_cast<long long>(buffer->getSkippedBuffers(consumerId)));
+				}
+
+				//emit rawData signal to record raw data if recorder is enabled
+				this->currBufferNr = (this->currBufferNr+1)%buffersPerVolume;
+				Tracer::begin("raw data signal");
+				emit rawData(buffer->bufferArray[bufferPos], bitDepth, width, height, depth, buffersPerVolume, this->currBufferNr);
+				Tracer::end("raw data signal");
+
+				//make OpenGL context current and process raw data
+				Tracer::begin("process");
+				this->context->makeCurrent(this->surface);
+				bool processed = this->backend->process(buffer->bufferArray[bufferPos]);
+				this->context->doneCurrent();
+				if (!processed && !processingErrorReported) {
+					emit error(tr("Processing failed (") + backendName + tr("): ") + QString::fromStdString(this->backend->getLastError()));
+					processingErrorReported = true;
+				}
+				Tracer::end("process");
+
+				//release buffer to indicate that acquisition system is allowed to reuse it
+				buffer->release(consumerId, bufferPos);
+
+				//volumes/second calculation every 5 seconds
+				processedBuffers++;
+				qreal elapsedTime = timer.elapsed();
+				qreal captureInfoTime = 5000;
+				if (elapsedTime >= captureInfoTime) {
+					this->buffersPerSecond  = (qreal)processedBuffers / (elapsedTime / 1000.0);
+					qreal volumesPerSecond = buffersPerSecond / static_cast<qreal>(this->octParams->buffersPerVolume);
+					qreal bscansPerSecond = this->buffersPerSecond * (qreal)depth;
+					qreal ascansPerSecond = bscansPerSecond * (qreal)height;
+					qreal bufferSizeMB = (qreal)bufferSizeInBytes / 1048576.0; //1 Kilobyte is 1024 Bytes. 1 Megabyte is equal to 1024 Kilobytes or 1048576 Bytes
+					qreal dataThroughput = this->buffersPerSecond * bufferSizeMB;
+					emit updateInfoBox(QString::number(volumesPerSecond), QString::number(this->buffersPerSecond), QString::number(bscansPerSecond), QString::number(ascansPerSecond), QString::number(bufferSizeMB), QString::number(dataThroughput));
+					emit updateStageTimings();
+					processedBuffers = 0;
+					timer.restart();
+				}
+
+				//gpu 2 host-ram streaming
+				if (this->octParams->streamingParamsChanged) {
+					this->enableGpu2HostStreaming(this->octParams->streamToHost);
+					this->octParams->streamingParamsChanged = false;
 				}
 			}
-			QCoreApplication::processEvents();
+
+			//pipelined backends may finish display data of earlier buffers while no new buffer is available
+			if (this->backend->hasPendingDisplayUpdates()) {
+				TraceSpan span("upload display data");
+				this->context->makeCurrent(this->surface);
+				this->backend->uploadPendingDisplayUpdates();
+				this->context->doneCurrent();
+			}
+
+			//queued events of this thread (e.g. messages of the recorders) are handled periodically and whenever the loop was idle
+			if (processingInGuiThread || bufferPos < 0 || eventTimer.elapsed() >= PROCESSING_EVENT_INTERVAL_MS) {
+				QCoreApplication::processEvents();
+				eventTimer.restart();
+			}
 			this->isProcessing = true;
 		}
-		this->buffersPerSecond = 0;
-		this->isProcessing = false;
-		emit processingDone();
-		emit updateInfoBox("0", "0", "0", "0", "0", "0");
+		this->finishProcessing(buffer, consumerId, true);
+	}
+}
+
+void Processing::finishProcessing(AcquisitionBuffer* buffer, int consumerId, bool backendInitialized) {
+	{
+		std::lock_guard<std::mutex> lock(this->controlMutex);
+		this->controlBuffer = nullptr;
+		this->controlConsumerId = -1;
+	}
+	this->slot_executeControlRequests();
+	if (consumerId >= 0) {
+		buffer->unregisterConsumer(consumerId);
+	}
+	this->buffersPerSecond = 0;
+	this->isProcessing = false;
+	emit processingDone();
+	emit updateInfoBox("0", "0", "0", "0", "0", "0");
 
+	//buffers that are still in flight have to be finished before the streaming buffers are released
+	if (backendInitialized) {
+		this->backend->synchronize();
+		this->backend->setDisplayUpdateNotifier(std::function<void()>());
 		if (this->octParams->streamToHost) {
 			this->enableGpu2HostStreaming(false);
 		}
-		cleanupCuda();
 	}
+	this->backend->cleanup();
 }
 
-void Processing::slot_enableRecording(RecordingParams recParams) {
-	if (recParams.recordRaw) {
-		if(this->rawRecorder->recordingEnabled) {
-			emit error(tr("Recording of raw data is already running."));
-		}else{
-			emit initRawRecorder(recParams);
-		}
+void Processing::selectBackend() {
+	bool useCuda = this->octParams->processingBackend == CUDA_GPU;
+	if (useCuda && !CudaProcessingBackend::isDeviceAvailable()) {
+		emit info(tr("No CUDA capable GPU found. CPU is used for processing."));
+		useCuda = false;
+	}
+	bool cudaBackendActive = dynamic_cast<CudaProcessingBackend*>(this->backend) != nullptr;
+	if (this->backend != nullptr && useCuda == cudaBackendActive) {
+		return;
 	}
-	if (recParams.recordProcessed) {
-		if(this->processedRecorder->recordingEnabled) {
-			emit error(tr("Recording of processed data is already running."));
-		}else{
-			RecordingParams recProcessedParams = recParams;
-			recProcessedParams.bufferSizeInBytes = recProcessedParams.bufferSizeInBytes/2; //todo: add option to change bitdepth of processed recording
-			emit initProcessedRecorder(recProcessedParams);
+
+	delete this->backend;
+	if (useCuda) {
+		this->backend = new CudaProcessingBackend();
+	} else {
+		CpuProcessingBackend* cpuBackend = new CpuProcessingBackend();
+		emit info(tr("CPU processing uses ") + QString::number(cpuBackend->getThreadCount()) + tr(" threads and ") + QString(CpuFeatures::getSimdLevelName(CpuFeatures::getSimdLevel())) + tr(" vector instructions."));
+		this->backend = cpuBackend;
+	}
+
+	//OpenGL buffers that were already registered with the previous backend need to be registered with the new one
+	if (this->context->makeCurrent(this->surface)) {
+		if (this->glBufferBscan != 0) {
+			this->backend->registerGlBufferBscan(this->glBufferBscan);
+		}
+		if (this->glBufferEnFaceView != 0) {
+			this->backend->registerGlBufferEnFaceView(this->glBufferEnFaceView);
+		}
+		if (this->glTextureVolumeView != 0) {
+			this->backend->registerGlBufferVolumeView(this->glTextureVolumeView);
 		}
+		this->context->doneCurrent();
 	}
 }
 
-void Processing::slot_updateDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction){
-	this->octParams->frameNr = frameNr;
-	this->octParams->functionFramesBscan = displayFunctionFrames;
-	this->octParams->displayFunctionBscan = displayFunction;
-
-	if(this->isProcessing && this->buffersPerSecond > 0.0 && this->buffersPerSecond < LOW_FRAMERATE){
-		this->context->makeCurrent(this->surface);
-		changeDisplayedBscanFrame(frameNr, displayFunctionFrames, displayFunction);
-		this->context->swapBuffers(this->surface);
-		this->context->doneCurrent();
+void Processing::autotune(void** h_buffers, unsigned int bufferCount) {
+	Autotuner autotuner(this->backend, this->octParams);
+	if (autotuner.applyStoredConfiguration()) {
+		emit info(tr("Autotuning: stored configuration is used (") + autotuner.getConfigurationDescription() + tr(")."));
+		return;
 	}
+	emit info(tr("Autotuning for ") + autotuner.getKey() + tr(". This takes a few seconds..."));
+	QCoreApplication::processEvents();
+	this->context->makeCurrent(this->surface);
+	autotuner.run(h_buffers, bufferCount);
+	this->context->doneCurrent();
+	emit info(tr("Autotuning done: ") + autotuner.getConfigurationDescription() + tr(", ") + QString::number(autotuner.getBuffersPerSecond(), 'f', 1) + tr(" buffers per second without display."));
+}
+
+void Processing::slot_enableRecording(RecordingParams recParams) {
+	this->postControlRequest([this, recParams]() {
+		if (recParams.recordRaw) {
+			if(this->rawRecorder->recordingEnabled) {
+				emit error(tr("Recording of raw data is already running."));
+			}else{
+				emit initRawRecorder(recParams);
+			}
+		}
+		if (recParams.recordProcessed) {
+			if(this->processedRecorder->recordingEnabled) {
+				emit error(tr("Recording of processed data is already running."));
+			}else{
+				RecordingParams recProcessedParams = recParams;
+				recProcessedParams.bufferSizeInBytes = recProcessedParams.bufferSizeInBytes/2; //todo: add option to change bitdepth of processed recording
+				emit initProcessedRecorder(recProcessedParams);
+			}
+		}
+	});
+}
+
+void Processing::slot_updateDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction){
+	this->postControlRequest([this, frameNr, displayFunctionFrames, displayFunction]() {
+		this->octParams->frameNr = frameNr;
+		this->octParams->functionFramesBscan = displayFunctionFrames;
+		this->octParams->displayFunctionBscan = displayFunction;
+
+		if(this->isProcessing && this->buffersPerSecond > 0.0 && this->buffersPerSecond < LOW_FRAMERATE){
+			this->context->makeCurrent(this->surface);
+			this->backend->changeDisplayedBscanFrame(frameNr, displayFunctionFrames, displayFunction);
+			this->context->swapBuffers(this->surface);
+			this->context->doneCurrent();
+		}
+	});
 }
 
 void Processing::slot_updateDisplayedEnFaceFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction){
-	this->octParams->frameNrEnFaceView = frameNr;
-	this->octParams->functionFramesEnFaceView = displayFunctionFrames;
-	this->octParams->displayFunctionEnFaceView = displayFunction;
-
-	if(this->isProcessing && this->buffersPerSecond > 0.0 && this->buffersPerSecond < LOW_FRAMERATE){
-		this->context->makeCurrent(this->surface);
-		changeDisplayedEnFaceFrame(frameNr, displayFunctionFrames, displayFunction);
-		this->context->swapBuffers(this->surface);
-		this->context->doneCurrent();
-	}
+	this->postControlRequest([this, frameNr, displayFunctionFrames, displayFunction]() {
+		this->octParams->frameNrEnFaceView = frameNr;
+		this->octParams->functionFramesEnFaceView = displayFunctionFrames;
+		this->octParams->displayFunctionEnFaceView = displayFunction;
+
+		if(this->isProcessing && this->buffersPerSecond > 0.0 && this->buffersPerSecond < LOW_FRAMERATE){
+			this->context->makeCurrent(this->surface);
+			this->backend->changeDisplayedEnFaceFrame(frameNr, displayFunctionFrames, displayFunction);
+			this->context->swapBuffers(this->surface);
+			this->context->doneCurrent();
+		}
+	});
 }
 
 void Processing::slot_registerBscanOpenGLbufferWithCuda(unsigned int bufferId){
-	if(this->context->makeCurrent(this->surface)){
-		cuda_registerGlBufferBscan(bufferId);
-		this->context->doneCurrent();
-	}
+	this->postControlRequest([this, bufferId]() {
+		this->glBufferBscan = bufferId;
+		if(this->backend != nullptr && this->context->makeCurrent(this->surface)){
+			this->backend->registerGlBufferBscan(bufferId);
+			this->context->doneCurrent();
+		}
+	});
 }
 
 void Processing::slot_registerEnFaceViewOpenGLbufferWithCuda(unsigned int bufferId){
-	if(this->context->makeCurrent(this->surface)){
-		cuda_registerGlBufferEnFaceView(bufferId);
-		this->context->doneCurrent();
-	}
+	this->postControlRequest([this, bufferId]() {
+		this->glBufferEnFaceView = bufferId;
+		if(this->backend != nullptr && this->context->makeCurrent(this->surface)){
+			this->backend->registerGlBufferEnFaceView(bufferId);
+			this->context->doneCurrent();
+		}
+	});
 }
 
 void Processing::slot_registerVolumeViewOpenGLbufferWithCuda(unsigned int bufferId){
-	if(this->context->makeCurrent(this->surface)){
-		cuda_registerGlBufferVolumeView(bufferId);
-		this->context->doneCurrent();
-	}
+	this->postControlRequest([this, bufferId]() {
+		this->glTextureVolumeView = bufferId;
+		if(this->backend != nullptr && this->context->makeCurrent(this->surface)){
+			this->backend->registerGlBufferVolumeView(bufferId);
+			this->context->doneCurrent();
+		}
+	});
 }
 
 void Processing::enableGpu2HostStreaming(bool enableStreaming) {
@@ -264,9 +427,60 @@ void Processing::enableGpu2HostStreaming(bool enableStreaming) {
 }
 
 void Processing::registerStreamingHostBuffers(void* h_streamingBuffer1, void* h_streamingBuffer2, size_t bytesPerBuffer) {
-	cuda_registerStreamingBuffers(h_streamingBuffer1, h_streamingBuffer2, bytesPerBuffer);
+	if (this->backend != nullptr) {
+		this->backend->registerStreamingBuffers(h_streamingBuffer1, h_streamingBuffer2, bytesPerBuffer);
+	}
 }
 
 void Processing::unregisterStreamingdHostBuffers() {
-	cuda_unregisterStreamingBuffers();
+	if (this->backend != nullptr) {
+		this->backend->unregisterStreamingBuffers();
+	}
+}
+
+void Processing::slot_grabBscanFromVolumeRing(unsigned int volumesAgo, unsigned int bscanNr) {
+	this->postControlRequest([this, volumesAgo, bscanNr]() {
+		if (!this->isProcessing || this->backend == nullptr) {
+			emit error(tr("Volume ring is only available during processing."));
+			return;
+		}
+		unsigned int samplesPerLine = this->octParams->samplesPerLine/2;
+		unsigned int linesPerFrame = this->octParams->ascansPerBscan;
+		//every request gets its own buffer. QByteArray is implicitly shared, so receivers in other threads can keep it as long as they need it
+		QByteArray bscan(static_cast<int>(sizeof(float)*samplesPerLine*linesPerFrame), Qt::Uninitialized); //large enough for every output bit depth
+		if (!this->backend->copyBscanFromVolumeRing(volumesAgo, bscanNr, bscan.data())) {
+			emit error(tr("Volume ring does not contain B-scan ") + QString::number(bscanNr) + tr(" of the volume ") + QString::number(volumesAgo) + tr(" volumes ago. Complete volumes in ring: ") + QString::number(this->backend->getCompleteVolumesInRing()));
+			return;
+		}
+		emit volumeRingBscan(bscan, this->octParams->bitDepth, samplesPerLine, linesPerFrame, volumesAgo, bscanNr);
+	});
+}
+
+void Processing::slot_executeControlRequests() {
+	std::vector<std::function<void()>> requests;
+	{
+		std::lock_guard<std::mutex> lock(this->controlMutex);
+		requests.swap(this->controlRequests);
+	}
+	for (size_t i = 0; i < requests.size(); i++) {
+		requests[i]();
+	}
+}
+
+void Processing::postControlRequest(const std::function<void()>& request) {
+	AcquisitionBuffer* buffer = nullptr;
+	int consumerId = -1;
+	{
+		std::lock_guard<std::mutex> lock(this->controlMutex);
+		this->controlRequests.push_back(request);
+		buffer = this->controlBuffer;
+		consumerId = this->controlConsumerId;
+	}
+
+	//a running processing loop is woken up directly, otherwise the event loop of the processing thread executes the request
+	if (buffer != nullptr) {
+		buffer->wakeUp(consumerId);
+	} else {
+		QMetaObject::invokeMethod(this, "slot_executeControlRequests", Qt::QueuedConnection);
+	}
 }
@@ -31,7 +31,10 @@
 #include <QObject>
 #include "polynomial.h"
 #include "octproz_devkit.h"
-#include "kernels.h"
+#include "cudaprocessingbackend.h"
+#include "cpuprocessingbackend.h"
+#include "autotuner.h"
+#include "stagetimings.h"
 #include "recorder.h"
 #include "settings.h"
 #include "octalgorithmparameters.h"
@@ -40,8 +43,14 @@
 #include <QElapsedTimer>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
+#include <functional>
+#include <mutex>
+#include <vector>
 
 #define LOW_FRAMERATE 12.5
+#define PROCESSING_WAIT_TIMEOUT_MS 50 //maximum time the processing loop sleeps while waiting for the next acquisition buffer. Limits the delay until a stopped acquisition is noticed
+#define PROCESSING_GUI_THREAD_WAIT_TIMEOUT_MS 5 //used instead of PROCESSING_WAIT_TIMEOUT_MS if processing runs in the gui thread
+#define PROCESSING_EVENT_INTERVAL_MS 50 //queued events of the processing thread are handled at least this often while buffers are processed
 
 
 class Processing : public QObject
@@ -66,10 +75,24 @@ private:
 	Recorder* processedRecorder;
 	AcquisitionBuffer* streamingBuffer;
 	unsigned int currBufferNr;
+	ProcessingBackend* backend;
+	unsigned int glBufferBscan;
+	unsigned int glBufferEnFaceView;
+	unsigned int glTextureVolumeView;
+	std::mutex controlMutex; ///guards controlRequests, controlBuffer and controlConsumerId
+	std::vector<std::function<void()>> controlRequests; ///display and parameter requests from other threads that are executed by the processing thread
+	AcquisitionBuffer* controlBuffer; ///acquisition buffer the processing loop waits on, nullptr if the loop is not running
+	int controlConsumerId;
+
+	void selectBackend(); ///creates the backend that is selected in octParams. Falls back to the cpu backend if no cuda capable gpu is available
+	void autotune(void** h_buffers, unsigned int bufferCount); ///applies the stored autotuning result for the current geometry and backend or determines a new one
+	void postControlRequest(const std::function<void()>& request); ///thread safe. The request is executed by the processing thread, between two buffers if processing is running
+	void finishProcessing(AcquisitionBuffer* buffer, int consumerId, bool backendInitialized); ///teardown at the end of slot_start, also if initialization failed. consumerId is -1 if processing is not registered as consumer
 
 
 public slots :
 	//todo: decide if prefix "slot_" should be used or not and change naming of slots accordingly
+	//slot_enableRecording, slot_updateDisplayed..., slot_register... and slot_grabBscanFromVolumeRing only post a control request and should be connected with Qt::DirectConnection, so they are not delayed until the event loop of the processing thread runs
 	void slot_start(AcquisitionSystem* system);
 	void slot_enableRecording(RecordingParams recParams);
 	void slot_updateDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction);
@@ -80,6 +103,8 @@ public slots :
 	void enableGpu2HostStreaming(bool enableStreaming);
 	void registerStreamingHostBuffers(void* h_streamingBuffer1, void* h_streamingBuffer2, size_t bytesPerBuffer);
 	void unregisterStreamingdHostBuffers();
+	void slot_grabBscanFromVolumeRing(unsigned int volumesAgo, unsigned int bscanNr);
+	void slot_executeControlRequests();
 
 
 signals :
@@ -95,9 +120,11 @@ signals :
 	void processedRecordDone();
 	void rawRecordDone();
 	void rawData(void* rawBuffer, unsigned bitDepth, unsigned int samplesPerLine, unsigned int linesPerFrame, unsigned int framesPerBuffer, unsigned int buffersPerVolume, unsigned int currentBufferNr);
+	void volumeRingBscan(QByteArray buffer, unsigned int bitDepth, unsigned int samplesPerLine, unsigned int linesPerFrame, unsigned int volumesAgo, unsigned int bscanNr);
 	void info(QString info);
 	void error(QString error);
 	void updateInfoBox(QString volumesPerSecond, QString buffersPerSecond, QString bscansPerSecond, QString ascansPerSecond, QString bufferSizeMB, QString dataThroughput);
+	void updateStageTimings(); ///new statistics are available in StageTimings
 };
 
 #endif // PROCESSING_H
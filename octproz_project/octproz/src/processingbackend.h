@@ -0,0 +1,89 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef PROCESSINGBACKEND_H
+#define PROCESSINGBACKEND_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <complex>
+#include <functional>
+#include "octalgorithmparameters.h"
+
+//intermediate results of the processing that can be captured for the validation of octproz_bench. All samples are given like the result of an
+//inverse fft without normalization (CUFFT_INVERSE), so backends that use a forward fft capture the complex conjugate
+enum CAPTURE_STAGE {
+	CAPTURE_SPECTRA, ///input of the fft after conversion, background removal, k-linearization, windowing and dispersion compensation. signalLength samples per A-scan
+	CAPTURE_FFT, ///first signalLength/2 samples of every transformed A-scan
+	CAPTURE_FIXED_PATTERN_NOISE_REMOVAL, ///like CAPTURE_FFT after fixed-pattern noise removal. This is the input of magnitude and log scaling. Only captured if fixed-pattern noise removal is enabled
+	NUMBER_OF_CAPTURE_STAGES
+};
+
+
+/**
+* Interface for OCT processing implementations.
+* Processing owns exactly one backend and calls it from the processing thread. The OpenGL context that is shared with the
+* display windows is current during process(), changeDisplayed...Frame(), registerGlBuffer...() and uploadPendingDisplayUpdates() calls.
+* Backends may work on several buffers at the same time (see OctAlgorithmParameters::buffersInFlight). process() returns as soon as
+* the acquisition buffer has been consumed, the remaining steps of that buffer complete in order in the background.
+**/
+class ProcessingBackend
+{
+public:
+	virtual ~ProcessingBackend() {}
+
+	virtual const char* getName() const = 0;
+	virtual std::string getDeviceName() const = 0; ///processor or gpu that is used. Identifies the hardware of stored autotuning results
+	virtual bool init(void** h_buffers, unsigned int bufferCount, OctAlgorithmParameters* params) = 0; ///h_buffers are all bufferCount acquisition buffers that will be passed to process(), the cuda backend page-locks them
+	virtual bool process(void* h_inputSignal) = 0; ///h_inputSignal may be reused by the acquisition system as soon as this returns. Returns false if the buffer could not be processed, see getLastError()
+	virtual std::string getLastError() const { return std::string(); } ///reason why the last call of init() or process() failed
+	virtual void synchronize() = 0; ///blocks until all buffers passed to process() are completely processed, displayed and streamed
+	virtual void cleanup() = 0;
+
+	virtual bool hasPendingDisplayUpdates() { return false; } ///true if display data has been prepared in the background and still needs to be uploaded with uploadPendingDisplayUpdates()
+	virtual void uploadPendingDisplayUpdates() {}
+	virtual void setDisplayUpdateNotifier(const std::function<void()>& notifier) { (void)notifier; } ///notifier is called from a background thread as soon as hasPendingDisplayUpdates() becomes true, so a processing loop that is waiting for the next buffer can upload the display data. Only set it while no buffer is in flight
+
+	virtual void changeDisplayedBscanFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) = 0; ///if framerate is low user can request another bscan to be displayed from already processed data with this function
+	virtual void changeDisplayedEnFaceFrame(unsigned int frameNr, unsigned int displayFunctionFrames, int displayFunction) = 0;
+
+	virtual void registerGlBufferBscan(unsigned int buf) = 0;
+	virtual void registerGlBufferEnFaceView(unsigned int buf) = 0;
+	virtual void registerGlBufferVolumeView(unsigned int buf) = 0;
+
+	virtual void registerStreamingBuffers(void* h_streamingBuffer1, void* h_streamingBuffer2, size_t bytesPerBuffer) = 0;
+	virtual void unregisterStreamingBuffers() = 0;
+
+	virtual void setStageCapture(bool enabled) { (void)enabled; } ///copies the intermediate results of every processed buffer for getCapturedStage(). Slows down processing, only used by the validation
+	virtual bool getCapturedStage(CAPTURE_STAGE stage, std::vector<std::complex<float> >& samples) { (void)stage; (void)samples; return false; } ///intermediate result of the last processed buffer, call synchronize() first. Returns false if the stage has not been captured
+
+	virtual unsigned int getCompleteVolumesInRing() = 0; ///number of complete volumes in the 4D volume ring, see OctAlgorithmParameters::volumeRingMegabytes
+	virtual bool copyBscanFromVolumeRing(unsigned int volumesAgo, unsigned int bscanNr, void* output) = 0; ///converts B-scan bscanNr of the volume that was completed volumesAgo volumes ago to the streaming output format and copies it to output. Returns false if the volume is not in the ring
+};
+
+#endif // PROCESSINGBACKEND_H
@@ -72,6 +72,7 @@ void Recorder::slot_init(RecordingParams recParams){
 	this->recordingFinished = false;
 	this->recordingEnabled = true;
 	this->isRecording = false;
+	Tracer::setThreadName("recorder");
 	emit info(tr("Recording initialized..."));
 }
 
@@ -107,9 +108,12 @@ void Recorder::slot_record(void* buffer, unsigned bitDepth, unsigned int samples
 	this->isRecording = true;
 
 	//record/copy buffer to current position in recBuffer
+	Tracer::begin("record buffer");
 	void* recBufferPointer = &(this->recBuffer[(this->recordedBuffers)*this->currRecParams.bufferSizeInBytes]);
 	memcpy(recBufferPointer, buffer, this->currRecParams.bufferSizeInBytes);
 	this->recordedBuffers++;
+	Tracer::end("record buffer");
+	Tracer::counter("recorded buffers", this->recordedBuffers);
 
 	//stop recording if enough buffers have been recorded, save recBuffer to disk and release reBuffer memory
 	if (this->recordedBuffers >= this->currRecParams.buffersToRecord) {
@@ -121,6 +125,7 @@ void Recorder::slot_record(void* buffer, unsigned bitDepth, unsigned int samples
 }
 
 void Recorder::saveToDisk() {
+	TraceSpan span("write recording to disk");
 	if (!this->initialized) {
 		emit error(tr("Save recording to disk not possible. Record buffer not initialized."));
 		return;
@@ -0,0 +1,204 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "resamplingplan.h"
+#include "cpufeatures.h"
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#if defined(OCTPROZ_X86)
+#include <immintrin.h>
+#endif
+
+#define LANCZOS_TAPS RESAMPLING_MAX_TAPS
+#define LANCZOS_PI 3.14159265358979323846
+
+
+//lanczos kernel with a = 8, evaluated in double precision since it is only evaluated when the plan is built
+static double lanczosKernel8(const double x) {
+	const double absX = fabs(x);
+	if (absX < 0.00001) {
+		return 1.0;
+	}
+	const double sincX = sin(LANCZOS_PI*absX)/(LANCZOS_PI*absX);
+	const double sincXOver8 = sin(LANCZOS_PI/8.0*absX)/(LANCZOS_PI/8.0*absX);
+	return sincX * sincXOver8;
+}
+
+template <int TAPS>
+static inline void applyTaps(float* out, const float* in, const int* firstTap, const float* weights, const int width) {
+	for (int j = 0; j < width; j++) {
+		const float* x = &in[firstTap[j]];
+		const float* w = &weights[j*TAPS];
+		float sum = 0.0f;
+		for (int t = 0; t < TAPS; t++) {
+			sum += x[t]*w[t];
+		}
+		out[j] = sum;
+	}
+}
+
+static inline void applyTaps(float* out, const float* in, const int* firstTap, const float* weights, const int width, const int taps) {
+	for (int j = 0; j < width; j++) {
+		const float* x = &in[firstTap[j]];
+		const float* w = &weights[j*taps];
+		float sum = 0.0f;
+		for (int t = 0; t < taps; t++) {
+			sum += x[t]*w[t];
+		}
+		out[j] = sum;
+	}
+}
+
+#if defined(OCTPROZ_X86)
+//16 tap dot product with two 8 float registers per output sample
+TARGET_AVX2_FMA static void applyLanczosTapsAvx2(float* out, const float* in, const int* firstTap, const float* weights, const int width) {
+	for (int j = 0; j < width; j++) {
+		const float* x = &in[firstTap[j]];
+		const float* w = &weights[j*LANCZOS_TAPS];
+		__m256 sum = _mm256_mul_ps(_mm256_loadu_ps(x), _mm256_loadu_ps(w));
+		sum = _mm256_fmadd_ps(_mm256_loadu_ps(x + 8), _mm256_loadu_ps(w + 8), sum);
+		__m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+		sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, 1));
+		out[j] = _mm_cvtss_f32(sum4);
+	}
+}
+#endif
+
+
+ResamplingPlan::ResamplingPlan() {
+	this->width = 0;
+	this->tapsPerSample = 0;
+	this->interpolation = INTERPOLATION::LINEAR;
+	this->useAvx2 = CpuFeatures::getSimdLevel() >= SIMD_AVX2 && CpuFeatures::hasFma();
+}
+
+ResamplingPlan::~ResamplingPlan() {
+}
+
+void ResamplingPlan::build(const float* resampleCurve, const int width, const INTERPOLATION interpolation) {
+	this->width = 0;
+	this->interpolation = interpolation;
+	if (resampleCurve == nullptr || width <= 0) {
+		return;
+	}
+	int taps = 2;
+	if (interpolation == INTERPOLATION::CUBIC) {
+		taps = 4;
+	} else if (interpolation == INTERPOLATION::LANCZOS) {
+		taps = LANCZOS_TAPS;
+	}
+	this->width = width;
+	this->tapsPerSample = std::min(taps, width);
+	this->firstTap.assign(width, 0);
+	this->weights.assign(static_cast<size_t>(width)*this->tapsPerSample, 0.0f);
+
+	int tapIndices[LANCZOS_TAPS];
+	double tapWeights[LANCZOS_TAPS];
+	for (int j = 0; j < width; j++) {
+		const double x = resampleCurve[j];
+		switch (interpolation) {
+		case INTERPOLATION::LINEAR: {
+			const int x0 = (int)resampleCurve[j];
+			const double t = x - x0;
+			tapIndices[0] = x0;
+			tapIndices[1] = x0 + 1;
+			tapWeights[0] = 1.0 - t;
+			tapWeights[1] = t;
+			break;
+		}
+		case INTERPOLATION::CUBIC: {
+			//cubic hermite interpolation between y1 and y2, written out as weights of y0..y3
+			const int n1 = (int)resampleCurve[j];
+			const double p = x - n1;
+			const double p2 = p*p;
+			const double p3 = p2*p;
+			tapIndices[0] = abs(n1 - 1);
+			tapIndices[1] = n1;
+			tapIndices[2] = n1 + 1;
+			tapIndices[3] = n1 + 2;
+			tapWeights[0] = 0.5*(-p3 + 2.0*p2 - p);
+			tapWeights[1] = 0.5*(3.0*p3 - 5.0*p2) + 1.0;
+			tapWeights[2] = 0.5*(-3.0*p3 + 4.0*p2 + p);
+			tapWeights[3] = 0.5*(p3 - p2);
+			break;
+		}
+		case INTERPOLATION::LANCZOS: {
+			const int n0 = (int)resampleCurve[j];
+			for (int t = 0; t < LANCZOS_TAPS; t++) {
+				const int n = n0 - 7 + t;
+				tapIndices[t] = n;
+				tapWeights[t] = lanczosKernel8(x - n);
+			}
+			break;
+		}
+		}
+		this->setTaps(j, tapIndices, tapWeights, taps);
+	}
+}
+
+void ResamplingPlan::setTaps(const int sample, const int* tapIndices, const double* tapWeights, const int numberOfTaps) {
+	//clamp taps to the A-scan and choose a window of tapsPerSample consecutive input samples that contains all of them
+	const int lastIndex = this->width - 1;
+	int minIndex = lastIndex;
+	for (int t = 0; t < numberOfTaps; t++) {
+		minIndex = std::min(minIndex, std::min(lastIndex, std::max(0, tapIndices[t])));
+	}
+	const int start = std::min(minIndex, lastIndex + 1 - this->tapsPerSample);
+	this->firstTap[sample] = start;
+	float* w = &this->weights[static_cast<size_t>(sample)*this->tapsPerSample];
+	for (int t = 0; t < numberOfTaps; t++) {
+		const int index = std::min(lastIndex, std::max(0, tapIndices[t]));
+		const int slot = std::min(this->tapsPerSample - 1, std::max(0, index - start));
+		w[slot] += static_cast<float>(tapWeights[t]);
+	}
+}
+
+void ResamplingPlan::apply(float* output, const float* input, const size_t firstLine, const size_t lastLine) const {
+	const int* first = this->firstTap.data();
+	const float* w = this->weights.data();
+	for (size_t line = firstLine; line < lastLine; line++) {
+		const float* in = &input[line*this->width];
+		float* out = &output[line*this->width];
+		switch (this->tapsPerSample) {
+		case 2: applyTaps<2>(out, in, first, w, this->width); break;
+		case 4: applyTaps<4>(out, in, first, w, this->width); break;
+		case LANCZOS_TAPS:
+#if defined(OCTPROZ_X86)
+			if (this->useAvx2) {
+				applyLanczosTapsAvx2(out, in, first, w, this->width);
+				break;
+			}
+#endif
+			applyTaps<LANCZOS_TAPS>(out, in, first, w, this->width);
+			break;
+		default: applyTaps(out, in, first, w, this->width, this->tapsPerSample); break;
+		}
+	}
+}
@@ -0,0 +1,68 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef RESAMPLINGPLAN_H
+#define RESAMPLINGPLAN_H
+
+#include <stddef.h>
+#include <vector>
+#include "octalgorithmparameters.h"
+
+#define RESAMPLING_MAX_TAPS 16 //taps per output sample of Lanczos resampling, the most of all interpolation methods
+
+/**
+* Precomputed k-linearization for the CPU and the cuda processing backend.
+* The resample curve is the same for every A-scan, so the tap positions and interpolation weights (linear: 2 taps, cubic: 4 taps, Lanczos: 16 taps)
+* are calculated once in build() and every output sample becomes a short dot product. Taps that would fall outside the A-scan are clamped to the
+* first/last sample and their weights are merged, so apply() never needs bounds checks.
+**/
+class ResamplingPlan
+{
+public:
+	ResamplingPlan();
+	~ResamplingPlan();
+
+	void build(const float* resampleCurve, const int width, const INTERPOLATION interpolation);
+	void apply(float* output, const float* input, const size_t firstLine, const size_t lastLine) const; ///resamples A-scans firstLine to lastLine-1. Each A-scan has width samples
+	bool isBuilt() const { return this->width > 0; }
+	INTERPOLATION getInterpolation() const { return this->interpolation; }
+	int getTapsPerSample() const { return this->tapsPerSample; }
+	const int* getFirstTaps() const { return this->firstTap.data(); } ///width entries, used by the cuda backend to upload the plan
+	const float* getWeights() const { return this->weights.data(); } ///width*getTapsPerSample() entries
+
+private:
+	void setTaps(const int sample, const int* tapIndices, const double* tapWeights, const int numberOfTaps);
+
+	int width;
+	int tapsPerSample;
+	INTERPOLATION interpolation;
+	bool useAvx2;
+	std::vector<int> firstTap; ///index of the first input sample for every output sample
+	std::vector<float> weights; ///tapsPerSample weights for every output sample
+};
+
+#endif // RESAMPLINGPLAN_H
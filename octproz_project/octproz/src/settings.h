@@ -37,8 +37,66 @@
 #define SETTINGS_FILE_NAME "settings.ini"
 #define SETTINGS_PATH SETTINGS_DIR + "/" + SETTINGS_FILE_NAME
 #define SETTINGS_PATH_BACKGROUND_FILE SETTINGS_DIR + "/background.csv"
+#define SETTINGS_PATH_FFTW_WISDOM_FILE SETTINGS_DIR + "/fftw_wisdom.dat"
 #define TIMESTAMP "timestamp"
 
+//groups and keys of the settings that are edited in the sidebar
+#define REC "record"
+#define PROC "processing"
+#define STREAM "streaming"
+#define REC_PATH "path"
+#define REC_RAW "record_raw"
+#define REC_PROCESSED "record_processed"
+#define REC_SCREENSHOTS "record_screenshots"
+#define REC_STOP "stop_after_record"
+#define REC_META "save_meta_info"
+#define REC_VOLUMES "volumes"
+#define REC_NAME "name"
+#define REC_START_WITH_FIRST_BUFFER "start_with_first_buffer"
+#define REC_DESCRIPTION "description"
+#define PROC_BACKEND "processing_backend"
+#define PROC_BUFFERS_IN_FLIGHT "buffers_in_flight"
+#define PROC_PIPELINE_WORKERS "pipeline_workers"
+#define PROC_AUTOTUNING "autotuning"
+#define PROC_VOLUME_STORAGE "volume_storage"
+#define PROC_VOLUME_RING_MEGABYTES "volume_ring_megabytes"
+#define PROC_DISPLAYED_VOLUME_AGE "displayed_volume_age"
+#define PROC_FLIP_BSCANS "flip_bscans"
+#define PROC_BITSHIFT "bitshift"
+#define PROC_REMOVEBACKGROUND "background_removal"
+#define PROC_REMOVEBACKGROUND_WINDOW_SIZE "background_removal_window_size"
+#define PROC_MIN "min"
+#define PROC_MAX "max"
+#define PROC_LOG "log"
+#define PROC_LOG_ACCURACY "log_accuracy"
+#define PROC_COEFF "coeff"
+#define PROC_ADDEND "addend"
+#define PROC_RESAMPLING "resampling"
+#define PROC_RESAMPLING_INTERPOLATION "resampling_interpolation"
+#define PROC_RESAMPLING_C0 "resampling_c0"
+#define PROC_RESAMPLING_C1 "resampling_c1"
+#define PROC_RESAMPLING_C2 "resampling_c2"
+#define PROC_RESAMPLING_C3 "resampling_c3"
+#define PROC_DISPERSION_COMPENSATION "dispersion_compensation"
+#define PROC_DISPERSION_COMPENSATION_D0 "dispersion_compensation_d0"
+#define PROC_DISPERSION_COMPENSATION_D1 "dispersion_compensation_d1"
+#define PROC_DISPERSION_COMPENSATION_D2 "dispersion_compensation_d2"
+#define PROC_DISPERSION_COMPENSATION_D3 "dispersion_compensation_d3"
+#define PROC_WINDOWING "windowing"
+#define PROC_WINDOWING_TYPE "window_type"
+#define PROC_WINDOWING_FILL_FACTOR "window_fill_factor"
+#define PROC_WINDOWING_CENTER_POSITION "window_center_position"
+#define PROC_FIXED_PATTERN_REMOVAL "fixed_pattern_removal"
+#define PROC_FIXED_PATTERN_REMOVAL_CONTINUOUSLY "fixed_pattern_removal_continuously"
+#define PROC_FIXED_PATTERN_REMOVAL_BSCANS "fixed_pattern_removal_bscans"
+#define PROC_SINUSOIDAL_SCAN_CORRECTION "sinusoidal_scan_correction"
+#define PROC_POST_BACKGROUND_REMOVAL "post_processing_background_removal"
+#define PROC_POST_BACKGROUND_WEIGHT "post_processing_background_removal_weight"
+#define PROC_POST_BACKGROUND_OFFSET "post_processing_background_removal_offset"
+
+#define STREAM_STREAMING "streaming_enabled"
+#define STREAM_STREAMING_SKIP "streaming_skip"
+
 
 
 #include <QStandardPaths>
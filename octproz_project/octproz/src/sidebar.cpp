@@ -81,6 +81,18 @@ void Sidebar::initGui() {
 	//Remove title bar
 	this->dock->setTitleBarWidget(new QWidget());
 
+	//Processing backend ComboBox
+	QStringList backendOptions = { "GPU (CUDA)", "CPU"}; //order has to match enum PROCESSING_BACKEND
+	this->ui.comboBox_processingBackend->addItems(backendOptions);
+
+	//Volume storage ComboBox
+	QStringList volumeStorageOptions = { "32 bit float", "16 bit float", "16 bit integer", "8 bit integer"}; //order has to match enum VOLUME_STORAGE
+	this->ui.comboBox_volumeStorage->addItems(volumeStorageOptions);
+
+	//Log accuracy ComboBox
+	QStringList logAccuracyOptions = { "Exact", "1e-4 dB", "1e-2 dB"}; //order has to match enum LOG_ACCURACY
+	this->ui.comboBox_logAccuracy->addItems(logAccuracyOptions);
+
 	//Interpolation ComboBox
 	QStringList interpolationOptions = { "Linear", "Cubic", "Lanczos"}; //todo: think of better way to add available options
 	this->ui.comboBox_interpolation->addItems(interpolationOptions);
@@ -101,6 +113,12 @@ void Sidebar::initGui() {
 	this->copyInfoAction = new QAction(tr("Copy info to clipboard"), this);
 	connect(copyInfoAction, &QAction::triggered, this, &Sidebar::copyInfoToClipboard);
 	this->ui.groupBox_info->addAction(copyInfoAction);
+	this->copyStageTimingsAction = new QAction(tr("Copy stage timings to clipboard"), this);
+	connect(this->copyStageTimingsAction, &QAction::triggered, this, &Sidebar::copyStageTimingsToClipboard);
+	this->ui.groupBox_stageTimings->addAction(this->copyStageTimingsAction);
+	this->saveStageTimingsAction = new QAction(tr("Save stage timings..."), this);
+	connect(this->saveStageTimingsAction, &QAction::triggered, this, &Sidebar::slot_saveStageTimings);
+	this->ui.groupBox_stageTimings->addAction(this->saveStageTimingsAction);
 
 	//Tool tips
 	this->ui.groupBox_streaming->setToolTip("<html><head/><body><p>"+tr("This setting enables continuous transfer of processed OCT data to memory. This allows all plugins to access the processed OCT data. It must be activated if you want to display processed A-scans in the 1D plot.")+"</p></body></html>"); //html tags are used to enable word wrapping inside tool tip
@@ -176,11 +194,19 @@ void Sidebar::loadSettings() {
 	this->ui.plainTextEdit_description->setPlainText(this->recordSettings.value(REC_DESCRIPTION).toString());
 
 	//Processing
+	this->ui.comboBox_processingBackend->setCurrentIndex(this->processingSettings.value(PROC_BACKEND).toUInt());
+	this->ui.spinBox_buffersInFlight->setValue(this->processingSettings.value(PROC_BUFFERS_IN_FLIGHT, 2).toUInt());
+	this->ui.spinBox_pipelineWorkers->setValue(this->processingSettings.value(PROC_PIPELINE_WORKERS, 1).toUInt());
+	this->ui.checkBox_autotuning->setChecked(this->processingSettings.value(PROC_AUTOTUNING, false).toBool());
+	this->ui.comboBox_volumeStorage->setCurrentIndex(this->processingSettings.value(PROC_VOLUME_STORAGE, static_cast<int>(VOLUME_STORAGE::FLOAT32_VOLUME)).toUInt());
+	this->ui.spinBox_volumeRingMegabytes->setValue(this->processingSettings.value(PROC_VOLUME_RING_MEGABYTES, 0).toUInt());
+	this->ui.spinBox_displayedVolumeAge->setValue(this->processingSettings.value(PROC_DISPLAYED_VOLUME_AGE, 0).toUInt());
 	this->ui.checkBox_bitshift->setChecked(this->processingSettings.value(PROC_BITSHIFT).toBool());
 	this->ui.checkBox_bscanFlip->setChecked(this->processingSettings.value(PROC_FLIP_BSCANS).toBool());
 	this->ui.groupBox_backgroundremoval->setChecked(this->processingSettings.value(PROC_REMOVEBACKGROUND).toBool());
 	this->ui.spinBox_rollingAverageWindowSize->setValue(this->processingSettings.value(PROC_REMOVEBACKGROUND_WINDOW_SIZE).toUInt());
 	this->ui.checkBox_logScaling->setChecked(this->processingSettings.value(PROC_LOG).toBool());
+	this->ui.comboBox_logAccuracy->setCurrentIndex(this->processingSettings.value(PROC_LOG_ACCURACY, static_cast<int>(LOG_ACCURACY::FAST_LOG_HIGH_ACCURACY)).toUInt());
 	this->ui.doubleSpinBox_signalMax->setValue(this->processingSettings.value(PROC_MAX).toDouble());
 	this->ui.doubleSpinBox_signalMin->setValue(this->processingSettings.value(PROC_MIN).toDouble());
 	this->ui.doubleSpinBox_signalMultiplicator->setValue(this->processingSettings.value(PROC_COEFF).toDouble());
@@ -291,9 +317,17 @@ void Sidebar::connectUpdateProcessingParams() {
 
 void Sidebar::updateProcessingParams() {
 	OctAlgorithmParameters* params = OctAlgorithmParameters::getInstance();
+	params->processingBackend = (PROCESSING_BACKEND)this->ui.comboBox_processingBackend->currentIndex();
+	params->buffersInFlight = this->ui.spinBox_buffersInFlight->value();
+	params->pipelineWorkers = this->ui.spinBox_pipelineWorkers->value();
+	params->autotuning = this->ui.checkBox_autotuning->isChecked();
+	params->volumeStorage = (VOLUME_STORAGE)this->ui.comboBox_volumeStorage->currentIndex();
+	params->volumeRingMegabytes = this->ui.spinBox_volumeRingMegabytes->value();
+	params->displayedVolumeAge = this->ui.spinBox_displayedVolumeAge->value();
 	params->bitshift = this->ui.checkBox_bitshift->isChecked();
 	params->bscanFlip = this->ui.checkBox_bscanFlip->isChecked();
 	params->signalLogScaling = this->ui.checkBox_logScaling->isChecked();
+	params->logAccuracy = (LOG_ACCURACY)this->ui.comboBox_logAccuracy->currentIndex();
 	params->signalGrayscaleMax = this->ui.doubleSpinBox_signalMax->value();
 	params->signalGrayscaleMin = this->ui.doubleSpinBox_signalMin->value();
 	params->signalMultiplicator = this->ui.doubleSpinBox_signalMultiplicator->value();
@@ -424,6 +458,42 @@ void Sidebar::slot_updateInfoBox(QString volumesPerSecond, QString buffersPerSec
 	this->ui.label_dataThroughput->setText(dataThroughput);
 }
 
+void Sidebar::slot_updateStageTimings() {
+	//median and 99th percentile of the last STAGE_TIMINGS_WINDOW buffers of every stage that is in use
+	StageTimings* timings = StageTimings::getInstance();
+	QString text = "<table width=\"100%\"><tr><td>" + tr("Stage") + "</td><td align=\"right\">p50 [ms]</td><td align=\"right\">p99 [ms]</td></tr>";
+	for (int i = 0; i < NUMBER_OF_PROCESSING_STAGES; i++) {
+		PROCESSING_STAGE stage = static_cast<PROCESSING_STAGE>(i);
+		StageStatistics statistics = timings->getStatistics(stage);
+		if (statistics.samples == 0) {
+			continue;
+		}
+		text += "<tr><td>" + QString(StageTimings::getStageName(stage)) + "</td><td align=\"right\">" + QString::number(statistics.p50, 'g', 3)
+			+ "</td><td align=\"right\">" + QString::number(statistics.p99, 'g', 3) + "</td></tr>";
+	}
+	text += "</table>";
+	this->ui.label_stageTimings->setText(text);
+}
+
+void Sidebar::slot_saveStageTimings() {
+	emit dialogAboutToOpen();
+	QString filters("CSV (*.csv);;JSON (*.json)");
+	QString defaultFilter("CSV (*.csv)");
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Save stage timings"), QDir::currentPath(), filters, &defaultFilter);
+	emit dialogClosed();
+	if (fileName == "") {
+		return;
+	}
+	StageTimings* timings = StageTimings::getInstance();
+	QByteArray content = QByteArray::fromStdString(defaultFilter == "JSON (*.json)" ? timings->toJson() : timings->toCsv());
+	QFile file(fileName);
+	if (file.open(QFile::WriteOnly|QFile::Truncate) && file.write(content) == content.size()) {
+		emit info(tr("Stage timings saved to ") + fileName);
+	} else {
+		emit error(tr("Could not save stage timings to ") + fileName);
+	}
+}
+
 void Sidebar::slot_updateProcessingParams() {
 	OctAlgorithmParameters* params = OctAlgorithmParameters::getInstance();
 	this->updateResamplingParams();
@@ -538,6 +608,10 @@ void Sidebar::copyInfoToClipboard() {
 	clipboard->setText(infoText);
 }
 
+void Sidebar::copyStageTimingsToClipboard() {
+	QApplication::clipboard()->setText(QString::fromStdString(StageTimings::getInstance()->toCsv()));
+}
+
 void Sidebar::show() {
 	bool visible = this->ui.widget_sidebarContent->isVisible();
 	if (visible) {
@@ -570,11 +644,19 @@ void Sidebar::updateSettingsMaps() {
 	this->recordSettings.insert(REC_DESCRIPTION, this->ui.plainTextEdit_description->toPlainText());
 
 	//Processing
+	this->processingSettings.insert(PROC_BACKEND, this->ui.comboBox_processingBackend->currentIndex());
+	this->processingSettings.insert(PROC_BUFFERS_IN_FLIGHT, this->ui.spinBox_buffersInFlight->value());
+	this->processingSettings.insert(PROC_PIPELINE_WORKERS, this->ui.spinBox_pipelineWorkers->value());
+	this->processingSettings.insert(PROC_AUTOTUNING, this->ui.checkBox_autotuning->isChecked());
+	this->processingSettings.insert(PROC_VOLUME_STORAGE, this->ui.comboBox_volumeStorage->currentIndex());
+	this->processingSettings.insert(PROC_VOLUME_RING_MEGABYTES, this->ui.spinBox_volumeRingMegabytes->value());
+	this->processingSettings.insert(PROC_DISPLAYED_VOLUME_AGE, this->ui.spinBox_displayedVolumeAge->value());
 	this->processingSettings.insert(PROC_BITSHIFT, this->ui.checkBox_bitshift->isChecked());
 	this->processingSettings.insert(PROC_FLIP_BSCANS, this->ui.checkBox_bscanFlip->isChecked());
 	this->processingSettings.insert(PROC_REMOVEBACKGROUND, this->ui.groupBox_backgroundremoval->isChecked());
 	this->processingSettings.insert(PROC_REMOVEBACKGROUND_WINDOW_SIZE, this->ui.spinBox_rollingAverageWindowSize->value());
 	this->processingSettings.insert(PROC_LOG, this->ui.checkBox_logScaling->isChecked());
+	this->processingSettings.insert(PROC_LOG_ACCURACY, this->ui.comboBox_logAccuracy->currentIndex());
 	this->processingSettings.insert(PROC_MAX, this->ui.doubleSpinBox_signalMax->value());
 	this->processingSettings.insert(PROC_MIN, this->ui.doubleSpinBox_signalMin->value());
 	this->processingSettings.insert(PROC_COEFF, this->ui.doubleSpinBox_signalMultiplicator->value());
@@ -0,0 +1,183 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "stagetimings.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+
+StageTimings::StageTimings() {
+	for (int i = 0; i < NUMBER_OF_PROCESSING_STAGES; i++) {
+		this->clear(this->windows[i]);
+	}
+}
+
+StageTimings* StageTimings::getInstance() {
+	//the first call may come from several processing threads at once, the initialization of a local static is thread safe
+	static StageTimings stageTimings;
+	return &stageTimings;
+}
+
+const char* StageTimings::getStageName(PROCESSING_STAGE stage) {
+	switch (stage) {
+		case STAGE_CONVERSION: return "conversion";
+		case STAGE_RESAMPLING: return "resampling";
+		case STAGE_FFT: return "fft";
+		case STAGE_FIXED_PATTERN_NOISE: return "fixed-pattern noise";
+		case STAGE_POST_PROCESSING: return "post-processing";
+		case STAGE_DISPLAY: return "display";
+		case STAGE_STREAMING: return "streaming";
+		default: return "unknown";
+	}
+}
+
+double StageTimings::getMilliseconds(const StageClock::time_point& start, const StageClock::time_point& end) {
+	return std::chrono::duration<double, std::milli>(end-start).count();
+}
+
+double StageTimings::getBinUpperEdge(unsigned int bin) {
+	return STAGE_TIMINGS_MIN_MS*pow(2.0, static_cast<double>(bin)/STAGE_TIMINGS_BINS_PER_OCTAVE);
+}
+
+unsigned int StageTimings::getBin(double milliseconds) {
+	if (!(milliseconds > STAGE_TIMINGS_MIN_MS)) {
+		return 0;
+	}
+	double bin = ceil(log2(milliseconds/STAGE_TIMINGS_MIN_MS)*STAGE_TIMINGS_BINS_PER_OCTAVE);
+	return static_cast<unsigned int>(std::min(bin, static_cast<double>(STAGE_TIMINGS_BINS-1)));
+}
+
+void StageTimings::clear(StageWindow& window) {
+	std::fill(window.histogram, window.histogram+STAGE_TIMINGS_BINS, 0u);
+	window.count = 0;
+	window.next = 0;
+}
+
+void StageTimings::record(PROCESSING_STAGE stage, double milliseconds) {
+	StageWindow& window = this->windows[stage];
+	std::lock_guard<std::mutex> lock(window.mutex);
+
+	//the oldest sample leaves the histogram as soon as the window is full
+	if (window.count == STAGE_TIMINGS_WINDOW) {
+		window.histogram[getBin(window.samples[window.next])]--;
+	} else {
+		window.count++;
+	}
+	//the bin is determined from the stored float, so that the sample leaves the same bin it was counted in
+	window.samples[window.next] = static_cast<float>(milliseconds);
+	window.histogram[getBin(window.samples[window.next])]++;
+	window.next = (window.next+1)%STAGE_TIMINGS_WINDOW;
+}
+
+void StageTimings::reset() {
+	for (int i = 0; i < NUMBER_OF_PROCESSING_STAGES; i++) {
+		std::lock_guard<std::mutex> lock(this->windows[i].mutex);
+		this->clear(this->windows[i]);
+	}
+}
+
+StageStatistics StageTimings::getStatistics(PROCESSING_STAGE stage) {
+	StageWindow& window = this->windows[stage];
+	std::lock_guard<std::mutex> lock(window.mutex);
+	StageStatistics statistics = {window.count, 0.0, 0.0, 0.0, 0.0};
+	if (window.count == 0) {
+		return statistics;
+	}
+	for (unsigned int i = 0; i < window.count; i++) {
+		statistics.mean += window.samples[i];
+		statistics.max = std::max(statistics.max, static_cast<double>(window.samples[i]));
+	}
+	statistics.mean /= window.count;
+
+	//smallest bin that contains at least the requested fraction of the samples
+	unsigned int p50Count = (window.count+1)/2;
+	unsigned int p99Count = static_cast<unsigned int>(ceil(0.99*window.count));
+	unsigned int cumulativeCount = 0;
+	bool p50Found = false;
+	for (unsigned int bin = 0; bin < STAGE_TIMINGS_BINS; bin++) {
+		cumulativeCount += window.histogram[bin];
+		if (!p50Found && cumulativeCount >= p50Count) {
+			statistics.p50 = getBinUpperEdge(bin);
+			p50Found = true;
+		}
+		if (cumulativeCount >= p99Count) {
+			statistics.p99 = getBinUpperEdge(bin);
+			break;
+		}
+	}
+
+	//the last bin is open ended
+	statistics.p50 = std::min(statistics.p50, statistics.max);
+	statistics.p99 = std::min(statistics.p99, statistics.max);
+	return statistics;
+}
+
+std::vector<unsigned int> StageTimings::getHistogram(PROCESSING_STAGE stage) {
+	StageWindow& window = this->windows[stage];
+	std::lock_guard<std::mutex> lock(window.mutex);
+	return std::vector<unsigned int>(window.histogram, window.histogram+STAGE_TIMINGS_BINS);
+}
+
+std::string StageTimings::toCsv() {
+	std::string csv = "stage,samples,mean_ms,p50_ms,p99_ms,max_ms\n";
+	char line[256];
+	for (int i = 0; i < NUMBER_OF_PROCESSING_STAGES; i++) {
+		PROCESSING_STAGE stage = static_cast<PROCESSING_STAGE>(i);
+		StageStatistics statistics = this->getStatistics(stage);
+		snprintf(line, sizeof(line), "%s,%u,%.6f,%.6f,%.6f,%.6f\n", getStageName(stage), statistics.samples, statistics.mean, statistics.p50, statistics.p99, statistics.max);
+		csv += line;
+	}
+	return csv;
+}
+
+std::string StageTimings::toJson() {
+	std::string json = "{\n\t\"window\": " + std::to_string(STAGE_TIMINGS_WINDOW) + ",\n\t\"stages\": [";
+	char text[256];
+	for (int i = 0; i < NUMBER_OF_PROCESSING_STAGES; i++) {
+		PROCESSING_STAGE stage = static_cast<PROCESSING_STAGE>(i);
+		StageStatistics statistics = this->getStatistics(stage);
+		snprintf(text, sizeof(text), "%s\n\t\t{\"stage\": \"%s\", \"samples\": %u, \"mean_ms\": %.6f, \"p50_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f, \"histogram\": [",
+			i == 0 ? "" : ",", getStageName(stage), statistics.samples, statistics.mean, statistics.p50, statistics.p99, statistics.max);
+		json += text;
+
+		//only non-empty bins, every bin is given by its upper edge
+		std::vector<unsigned int> histogram = this->getHistogram(stage);
+		bool first = true;
+		for (unsigned int bin = 0; bin < histogram.size(); bin++) {
+			if (histogram[bin] == 0) {
+				continue;
+			}
+			snprintf(text, sizeof(text), "%s{\"upper_ms\": %.6f, \"count\": %u}", first ? "" : ", ", getBinUpperEdge(bin), histogram[bin]);
+			json += text;
+			first = false;
+		}
+		json += "]}";
+	}
+	json += "\n\t]\n}\n";
+	return json;
+}
@@ -0,0 +1,105 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef STAGETIMINGS_H
+#define STAGETIMINGS_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define STAGE_TIMINGS_WINDOW 1000 //number of most recent samples per stage that the statistics are calculated from
+#define STAGE_TIMINGS_BINS_PER_OCTAVE 8
+#define STAGE_TIMINGS_OCTAVES 26 //histogram range from STAGE_TIMINGS_MIN_MS to STAGE_TIMINGS_MIN_MS*2^STAGE_TIMINGS_OCTAVES (about 1 us to 65 s)
+#define STAGE_TIMINGS_MIN_MS (1.0/1024.0)
+#define STAGE_TIMINGS_BINS (STAGE_TIMINGS_BINS_PER_OCTAVE*STAGE_TIMINGS_OCTAVES+1) //the first bin holds everything below STAGE_TIMINGS_MIN_MS
+
+enum PROCESSING_STAGE {
+	STAGE_CONVERSION, ///conversion of the raw data to float and rolling average background removal
+	STAGE_RESAMPLING, ///k-linearization, windowing and dispersion compensation
+	STAGE_FFT,
+	STAGE_FIXED_PATTERN_NOISE,
+	STAGE_POST_PROCESSING, ///truncation, log scaling, B-scan flip, sinusoidal scan correction, post processing background removal, volume ring, en face volume and running display projections
+	STAGE_DISPLAY, ///B-scan, en face and volume display buffers. The cpu backend includes the upload to OpenGL
+	STAGE_STREAMING, ///conversion to the output format and copy to the streaming buffers
+	NUMBER_OF_PROCESSING_STAGES
+};
+
+typedef std::chrono::steady_clock StageClock;
+
+struct StageStatistics {
+	unsigned int samples; ///number of samples in the window
+	double mean;
+	double p50;
+	double p99;
+	double max;
+};
+
+
+/**
+* Rolling per-stage latency statistics of the processing backends. Every backend reports the time that each stage took for one buffer with
+* record(). For every stage the last STAGE_TIMINGS_WINDOW samples are kept together with a histogram of logarithmically spaced bins
+* (STAGE_TIMINGS_BINS_PER_OCTAVE bins per octave) that is updated incrementally, so that recording a sample costs one short lock and the
+* percentiles can be read at any time. Percentiles are reported as the upper edge of the histogram bin, i.e. with a resolution of about 9 %.
+* Stages whose work is distributed over several threads report the summed thread time divided by the number of threads.
+* @note Singleton pattern. All functions are thread safe.
+**/
+class StageTimings
+{
+public:
+	static StageTimings* getInstance();
+
+	static const char* getStageName(PROCESSING_STAGE stage);
+	static double getMilliseconds(const StageClock::time_point& start, const StageClock::time_point& end);
+	static double getBinUpperEdge(unsigned int bin); ///in milliseconds
+
+	void record(PROCESSING_STAGE stage, double milliseconds);
+	void reset();
+	StageStatistics getStatistics(PROCESSING_STAGE stage);
+	std::vector<unsigned int> getHistogram(PROCESSING_STAGE stage); ///STAGE_TIMINGS_BINS counts of the samples in the window
+	std::string toCsv(); ///one line per stage with samples, mean, p50, p99 and max in milliseconds
+	std::string toJson(); ///statistics and non-empty histogram bins of every stage
+
+private:
+	StageTimings();
+
+	struct StageWindow {
+		std::mutex mutex;
+		float samples[STAGE_TIMINGS_WINDOW];
+		unsigned int histogram[STAGE_TIMINGS_BINS];
+		unsigned int count; ///samples in the window
+		unsigned int next; ///position of the next sample in samples
+	};
+
+	static unsigned int getBin(double milliseconds);
+	void clear(StageWindow& window);
+
+	StageWindow windows[NUMBER_OF_PROCESSING_STAGES];
+};
+
+#endif // STAGETIMINGS_H
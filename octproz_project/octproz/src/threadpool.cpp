@@ -0,0 +1,133 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "threadpool.h"
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(unsigned int numberOfThreads) {
+	this->currentTask = nullptr;
+	this->nextChunk = 0;
+	this->chunkCount = 0;
+	this->chunkSize = 1;
+	this->itemCount = 0;
+	this->activeWorkers = 0;
+	this->generation = 0;
+	this->stopRequested = false;
+	this->threadCount = numberOfThreads > 0 ? numberOfThreads : ThreadPool::getAvailableCores();
+
+	//the calling thread takes part in every parallelFor, so one thread less needs to be spawned
+	for (unsigned int i = 1; i < this->threadCount; i++) {
+		this->workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->stopRequested = true;
+	}
+	this->taskAvailable.notify_all();
+	for (size_t i = 0; i < this->workers.size(); i++) {
+		this->workers[i].join();
+	}
+}
+
+unsigned int ThreadPool::getAvailableCores() {
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t)>& task, size_t grainSize) {
+	if (count == 0) {
+		return;
+	}
+	if (this->workers.empty() || count <= grainSize) {
+		task(0, count);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(this->mutex);
+		//workers that woke up late for the previous call may still be leaving runChunks(), wait for them before the shared state is reset
+		this->taskDone.wait(lock, [this]{ return this->activeWorkers == 0; });
+
+		//a few chunks per thread give some load balancing without too much scheduling overhead
+		size_t chunksWanted = static_cast<size_t>(this->threadCount) * 4;
+		this->chunkSize = std::max(grainSize, (count + chunksWanted - 1) / chunksWanted);
+		this->chunkCount = (count + this->chunkSize - 1) / this->chunkSize;
+		this->itemCount = count;
+		this->currentTask = &task;
+		this->nextChunk = 0;
+		this->generation++;
+	}
+	this->taskAvailable.notify_all();
+
+	this->runChunks(&task);
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->taskDone.wait(lock, [this]{ return this->activeWorkers == 0 && this->nextChunk >= this->chunkCount; });
+	this->currentTask = nullptr;
+}
+
+void ThreadPool::runChunks(const std::function<void(size_t, size_t)>* task) {
+	size_t chunk = this->nextChunk.fetch_add(1);
+	while (chunk < this->chunkCount) {
+		size_t begin = chunk * this->chunkSize;
+		size_t end = std::min(begin + this->chunkSize, this->itemCount);
+		(*task)(begin, end);
+		chunk = this->nextChunk.fetch_add(1);
+	}
+}
+
+void ThreadPool::workerLoop() {
+	unsigned long long lastGeneration = 0;
+	while (true) {
+		const std::function<void(size_t, size_t)>* task = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->taskAvailable.wait(lock, [this, lastGeneration]{ return this->stopRequested || this->generation != lastGeneration; });
+			if (this->stopRequested) {
+				return;
+			}
+			lastGeneration = this->generation;
+			task = this->currentTask;
+			if (task == nullptr) {
+				continue;
+			}
+			this->activeWorkers++;
+		}
+
+		this->runChunks(task);
+
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->activeWorkers--;
+		}
+		this->taskDone.notify_all();
+	}
+}
@@ -0,0 +1,73 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/**
+* Minimal fork-join thread pool used by the CPU processing backend.
+* parallelFor() splits an index range into chunks that are processed by the worker threads and by the calling thread.
+* The call blocks until all chunks are done. Nested parallelFor() calls from inside a task are not supported.
+**/
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int numberOfThreads = 0); ///numberOfThreads = 0 uses all available cores
+	~ThreadPool();
+
+	unsigned int getThreadCount() const { return this->threadCount; }
+	void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& task, size_t grainSize = 1);
+
+	static unsigned int getAvailableCores();
+
+private:
+	void workerLoop();
+	void runChunks(const std::function<void(size_t, size_t)>* task);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable taskDone;
+	const std::function<void(size_t, size_t)>* currentTask;
+	std::atomic<size_t> nextChunk;
+	size_t chunkCount;
+	size_t chunkSize;
+	size_t itemCount;
+	unsigned int activeWorkers;
+	unsigned int threadCount;
+	unsigned long long generation;
+	bool stopRequested;
+};
+
+#endif // THREADPOOL_H
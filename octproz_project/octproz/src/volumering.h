@@ -0,0 +1,102 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef VOLUMERING_H
+#define VOLUMERING_H
+
+#include <stddef.h>
+
+
+/**
+* Bookkeeping of the 4D ring of processed volumes that is used by both processing backends. The backends store every processed buffer
+* a second time in the volume slot currentVolume of the ring, so that the last complete volumes stay accessible while the processed volume is overwritten.
+* Volumes are addressed by their age: 1 is the most recently completed volume, getCompleteVolumes() the oldest one.
+* The slot memory (bytesPerVolume per slot) is owned by the backend, host memory for the cpu backend, device memory for the cuda backend.
+**/
+struct VolumeRing {
+	unsigned int volumes; ///number of volume slots, 0 if the ring is disabled
+	unsigned int currentVolume; ///slot that receives the buffers of the volume that is currently processed
+	unsigned int completeVolumes; ///complete volumes in the ring, at most volumes-1 because currentVolume is not complete
+	size_t bytesPerVolume;
+	bool started;
+
+	VolumeRing() : volumes(0), currentVolume(0), completeVolumes(0), bytesPerVolume(0), started(false) {}
+
+	//as many volumes as fit into memoryBudget. At least 2 volumes are necessary to keep one complete volume while the next one is received
+	void init(size_t memoryBudget, size_t bytesPerVolume) {
+		this->bytesPerVolume = bytesPerVolume;
+		this->volumes = bytesPerVolume > 0 ? static_cast<unsigned int>(memoryBudget/bytesPerVolume) : 0;
+		this->volumes = this->volumes >= 2 ? this->volumes : 0;
+		this->reset();
+	}
+
+	void reset() {
+		this->currentVolume = 0;
+		this->completeVolumes = 0;
+		this->started = false;
+	}
+
+	bool isEnabled() const {
+		return this->volumes > 0;
+	}
+
+	size_t getMemorySize() const {
+		return this->volumes*this->bytesPerVolume;
+	}
+
+	unsigned int getCompleteVolumes() const {
+		return this->completeVolumes;
+	}
+
+	//has to be called before the first buffer of a volume is stored. The volume in currentVolume is complete from then on
+	void startVolume() {
+		if (!this->isEnabled()) {
+			return;
+		}
+		if (this->started) {
+			this->currentVolume = (this->currentVolume+1)%this->volumes;
+			this->completeVolumes = this->completeVolumes+1 < this->volumes ? this->completeVolumes+1 : this->volumes-1;
+		}
+		this->started = true;
+	}
+
+	//byte offset of the volume that was completed volumesAgo volumes before the current one. Returns false if there is no such volume
+	bool getVolumeOffset(unsigned int volumesAgo, size_t& offset) const {
+		if (volumesAgo < 1 || volumesAgo > this->completeVolumes) {
+			return false;
+		}
+		offset = ((this->currentVolume + this->volumes - volumesAgo)%this->volumes)*this->bytesPerVolume;
+		return true;
+	}
+
+	size_t getCurrentVolumeOffset() const {
+		return this->currentVolume*this->bytesPerVolume;
+	}
+};
+
+
+#endif // VOLUMERING_H
@@ -0,0 +1,168 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef VOLUMESTORAGE_H
+#define VOLUMESTORAGE_H
+
+#include <stddef.h>
+#include "octalgorithmparameters.h"
+
+//the conversion functions are used by the cpu backend and by the kernels in cuda_code.cu
+#ifdef __CUDACC__
+#define VOLUME_STORAGE_FUNCTION __host__ __device__ inline
+#else
+#define VOLUME_STORAGE_FUNCTION inline
+#endif
+
+
+/**
+* Sample types of the processed volume, see VOLUME_STORAGE in octalgorithmparameters.h.
+* Processed samples are saturated to [0, 1], so the integer types store round(value * (2^n - 1)). value = sample / (2^n - 1)
+* converts back without error: 8 bit display data and n bit output of an integer volume are the same as if they were calculated from float samples
+* that were rounded to the stored resolution.
+**/
+struct VolumeHalf {
+	unsigned short bits; ///IEEE 754 binary16
+};
+
+VOLUME_STORAGE_FUNCTION unsigned int volumeFloatBits(float value) {
+	union { float f; unsigned int u; } bits;
+	bits.f = value;
+	return bits.u;
+}
+
+VOLUME_STORAGE_FUNCTION float volumeBitsFloat(unsigned int value) {
+	union { float f; unsigned int u; } bits;
+	bits.u = value;
+	return bits.f;
+}
+
+//round to nearest even, overflow becomes infinity. Processed samples never leave [0, 1], the general case is only handled for completeness
+VOLUME_STORAGE_FUNCTION unsigned short floatToHalfBits(float value) {
+	unsigned int f = volumeFloatBits(value);
+	unsigned int sign = (f >> 16) & 0x8000;
+	unsigned int mantissa = f & 0x7fffff;
+	int exponent = static_cast<int>((f >> 23) & 0xff) - 127 + 15;
+	if (((f >> 23) & 0xff) == 0xff) {
+		return static_cast<unsigned short>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0)); //infinity or NaN
+	}
+	if (exponent >= 31) {
+		return static_cast<unsigned short>(sign | 0x7c00);
+	}
+	if (exponent <= 0) {
+		if (exponent < -10) {
+			return static_cast<unsigned short>(sign);
+		}
+		mantissa |= 0x800000;
+		unsigned int shift = static_cast<unsigned int>(14 - exponent);
+		unsigned int half = mantissa >> shift;
+		unsigned int remainder = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1))) {
+			half++;
+		}
+		return static_cast<unsigned short>(sign | half);
+	}
+	unsigned int half = sign | (static_cast<unsigned int>(exponent) << 10) | (mantissa >> 13);
+	unsigned int remainder = mantissa & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+		half++; //a carry into the exponent is the correctly rounded result
+	}
+	return static_cast<unsigned short>(half);
+}
+
+VOLUME_STORAGE_FUNCTION float halfBitsToFloat(unsigned short half) {
+	unsigned int sign = (static_cast<unsigned int>(half) & 0x8000) << 16;
+	unsigned int exponent = (half >> 10) & 0x1f;
+	unsigned int mantissa = half & 0x3ff;
+	if (exponent == 0) {
+		float value = static_cast<float>(mantissa) * 5.9604644775390625e-8f; //2^-24
+		return sign != 0 ? -value : value;
+	}
+	if (exponent == 31) {
+		return volumeBitsFloat(sign | 0x7f800000 | (mantissa << 13));
+	}
+	return volumeBitsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+VOLUME_STORAGE_FUNCTION float saturateVolumeSample(float value) {
+	return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f; //NaN becomes 0
+}
+
+VOLUME_STORAGE_FUNCTION void storeVolumeSample(float& sample, float value) {
+	sample = value;
+}
+
+VOLUME_STORAGE_FUNCTION void storeVolumeSample(VolumeHalf& sample, float value) {
+	sample.bits = floatToHalfBits(value);
+}
+
+VOLUME_STORAGE_FUNCTION void storeVolumeSample(unsigned short& sample, float value) {
+	sample = static_cast<unsigned short>(saturateVolumeSample(value) * 65535.0f + 0.5f);
+}
+
+VOLUME_STORAGE_FUNCTION void storeVolumeSample(unsigned char& sample, float value) {
+	sample = static_cast<unsigned char>(saturateVolumeSample(value) * 255.0f + 0.5f);
+}
+
+VOLUME_STORAGE_FUNCTION float loadVolumeSample(float sample) {
+	return sample;
+}
+
+VOLUME_STORAGE_FUNCTION float loadVolumeSample(VolumeHalf sample) {
+	return halfBitsToFloat(sample.bits);
+}
+
+VOLUME_STORAGE_FUNCTION float loadVolumeSample(unsigned short sample) {
+	return static_cast<float>(sample) / 65535.0f;
+}
+
+VOLUME_STORAGE_FUNCTION float loadVolumeSample(unsigned char sample) {
+	return static_cast<float>(sample) / 255.0f;
+}
+
+inline size_t getVolumeSampleSize(VOLUME_STORAGE storage) {
+	switch (storage) {
+	case FLOAT16_VOLUME: return sizeof(VolumeHalf);
+	case UINT16_VOLUME: return sizeof(unsigned short);
+	case UINT8_VOLUME: return sizeof(unsigned char);
+	default: return sizeof(float);
+	}
+}
+
+//executes the statement with VolumeSample defined as the sample type of storage, e.g.
+//FOR_VOLUME_STORAGE(storage, kernel<VolumeSample><<<grid, block>>>(static_cast<VolumeSample*>(volume)));
+#define FOR_VOLUME_STORAGE(storage, ...) \
+	switch (storage) { \
+	case FLOAT16_VOLUME: { typedef VolumeHalf VolumeSample; __VA_ARGS__; break; } \
+	case UINT16_VOLUME: { typedef unsigned short VolumeSample; __VA_ARGS__; break; } \
+	case UINT8_VOLUME: { typedef unsigned char VolumeSample; __VA_ARGS__; break; } \
+	default: { typedef float VolumeSample; __VA_ARGS__; break; } \
+	}
+
+
+#endif // VOLUMESTORAGE_H
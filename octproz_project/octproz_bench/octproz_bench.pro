@@ -0,0 +1,79 @@
+#headless benchmark and validation of the processing pipeline and stress test of the acquisition buffer ring. Uses the processing sources of OCTproZ, see performance.md
+
+QT += core gui
+
+TARGET = octproz_bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+OCTPROZSOURCEDIR = $$shell_path($$PWD/../octproz/src)
+BENCHSOURCEDIR = $$shell_path($$PWD/src)
+DEVKITSOURCEDIR = $$shell_path($$PWD/../octproz_devkit/src)
+
+INCLUDEPATH += \
+	$$OCTPROZSOURCEDIR \
+	$$BENCHSOURCEDIR \
+	$$DEVKITSOURCEDIR
+
+SOURCES += \
+	$$BENCHSOURCEDIR/main.cpp \
+	$$BENCHSOURCEDIR/benchmark.cpp \
+	$$BENCHSOURCEDIR/referencepipeline.cpp \
+	$$BENCHSOURCEDIR/validation.cpp \
+	$$BENCHSOURCEDIR/ringstress.cpp \
+	$$OCTPROZSOURCEDIR/octalgorithmparameters.cpp \
+	$$OCTPROZSOURCEDIR/polynomial.cpp \
+	$$OCTPROZSOURCEDIR/windowfunction.cpp \
+	$$OCTPROZSOURCEDIR/gpu2hostnotifier.cpp \
+	$$DEVKITSOURCEDIR/tracer.cpp \
+	$$DEVKITSOURCEDIR/acquisitionbuffer.cpp \
+	$$OCTPROZSOURCEDIR/threadpool.cpp \
+	$$OCTPROZSOURCEDIR/cpukernels.cpp \
+	$$OCTPROZSOURCEDIR/cpufeatures.cpp \
+	$$OCTPROZSOURCEDIR/inputconversion.cpp \
+	$$OCTPROZSOURCEDIR/resamplingplan.cpp \
+	$$OCTPROZSOURCEDIR/fftplancache.cpp \
+	$$OCTPROZSOURCEDIR/stagetimings.cpp \
+	$$OCTPROZSOURCEDIR/cpuprocessingbackend.cpp \
+	$$OCTPROZSOURCEDIR/cudaprocessingbackend.cpp
+
+HEADERS += \
+	$$BENCHSOURCEDIR/benchmark.h \
+	$$BENCHSOURCEDIR/referencepipeline.h \
+	$$BENCHSOURCEDIR/validation.h \
+	$$BENCHSOURCEDIR/ringstress.h \
+	$$OCTPROZSOURCEDIR/octalgorithmparameters.h \
+	$$OCTPROZSOURCEDIR/polynomial.h \
+	$$OCTPROZSOURCEDIR/windowfunction.h \
+	$$OCTPROZSOURCEDIR/gpu2hostnotifier.h \
+	$$DEVKITSOURCEDIR/tracer.h \
+	$$DEVKITSOURCEDIR/acquisitionbuffer.h \
+	$$OCTPROZSOURCEDIR/kernels.h \
+	$$OCTPROZSOURCEDIR/threadpool.h \
+	$$OCTPROZSOURCEDIR/cpukernels.h \
+	$$OCTPROZSOURCEDIR/cpufeatures.h \
+	$$OCTPROZSOURCEDIR/inputconversion.h \
+	$$OCTPROZSOURCEDIR/resamplingplan.h \
+	$$OCTPROZSOURCEDIR/fftplancache.h \
+	$$OCTPROZSOURCEDIR/stagetimings.h \
+	$$OCTPROZSOURCEDIR/displayprojection.h \
+	$$OCTPROZSOURCEDIR/volumestorage.h \
+	$$OCTPROZSOURCEDIR/volumering.h \
+	$$OCTPROZSOURCEDIR/processingbackend.h \
+	$$OCTPROZSOURCEDIR/cpuprocessingbackend.h \
+	$$OCTPROZSOURCEDIR/cudaprocessingbackend.h
+
+#the cuda code contains the OpenGL interop of the display path, even though the benchmark does not display anything
+unix{
+	LIBS += -lGL -lGLU -lX11 -lglut
+}
+win32{
+	LIBS += -lopengl32 -lglu32 -lpsapi
+}
+
+#include cuda configuration
+include(../octproz/pri/cuda.pri)
+
+#include fftw configuration (needed by the cpu processing backend)
+include(../octproz/pri/fftw.pri)
@@ -0,0 +1,360 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef _USE_MATH_DEFINES
+	#define _USE_MATH_DEFINES
+#endif
+
+#include "benchmark.h"
+#include "cpuprocessingbackend.h"
+#include "cudaprocessingbackend.h"
+#include "cpufeatures.h"
+#include "stagetimings.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+
+Benchmark::Benchmark(const BenchmarkOptions& options) {
+	this->options = options;
+	if (this->options.backend == CUDA_GPU && CudaProcessingBackend::isDeviceAvailable()) {
+		this->backend = new CudaProcessingBackend();
+	} else {
+		this->options.backend = MULTITHREADED_CPU;
+		this->backend = new CpuProcessingBackend(this->options.cpuThreads);
+	}
+}
+
+Benchmark::~Benchmark() {
+	delete this->backend;
+}
+
+QList<BenchmarkConfiguration> Benchmark::getPerformanceConfigurations() {
+	//name, bit depth, samples per raw A-scan, A-scans per B-scan, B-scans per buffer, buffers per volume, B-scans for noise determination, stream processed data to ram
+	QList<BenchmarkConfiguration> configurations;
+	configurations.append({"office_computer", 12, 1024, 512, 32, 8, 1, true});
+	configurations.append({"lab_computer", 12, 1024, 512, 256, 1, 26, false});
+	configurations.append({"gaming_computer", 12, 1024, 512, 256, 1, 1, false});
+	configurations.append({"jetson_nano", 12, 1024, 512, 32, 8, 1, true});
+	return configurations;
+}
+
+QJsonObject Benchmark::getSystemInfo() const {
+	QJsonObject info;
+	info.insert("backend", QString(this->backend->getName()));
+	info.insert("device", QString::fromStdString(this->backend->getDeviceName()));
+	info.insert("processor", QString::fromStdString(CpuFeatures::getProcessorName()));
+	info.insert("simd", QString(CpuFeatures::getSimdLevelName(CpuFeatures::getSimdLevel())));
+	info.insert("buffers_in_flight", static_cast<int>(this->options.buffersInFlight));
+	info.insert("pipeline_workers", static_cast<int>(this->options.pipelineWorkers));
+	info.insert("volume_storage", static_cast<int>(this->options.volumeStorage));
+	info.insert("input", this->options.inputFile.isEmpty() ? QString("synthetic") : this->options.inputFile);
+	CpuProcessingBackend* cpuBackend = dynamic_cast<CpuProcessingBackend*>(this->backend);
+	if (cpuBackend != nullptr) {
+		info.insert("threads", static_cast<int>(cpuBackend->getThreadCount()));
+	}
+	return info;
+}
+
+QJsonObject Benchmark::run(const BenchmarkConfiguration& configuration) {
+	QJsonObject result;
+	result.insert("configuration", configuration.name);
+	result.insert("bit_depth", static_cast<int>(configuration.bitDepth));
+	result.insert("samples_per_line", static_cast<int>(configuration.samplesPerLine));
+	result.insert("ascans_per_bscan", static_cast<int>(configuration.ascansPerBscan));
+	result.insert("bscans_per_buffer", static_cast<int>(configuration.bscansPerBuffer));
+	result.insert("buffers_per_volume", static_cast<int>(configuration.buffersPerVolume));
+	result.insert("stream_to_host", configuration.streamToHost);
+
+	QString error;
+	if (!this->prepareInput(configuration, error)) {
+		result.insert("error", error);
+		return result;
+	}
+	this->applyParameters(configuration);
+	OctAlgorithmParameters* params = OctAlgorithmParameters::getInstance();
+	void* inputs[2] = {this->inputBuffers[0].data(), this->inputBuffers[1].data()};
+	double deviceMemoryBefore = this->getUsedDeviceMemoryMegabytes();
+
+	QElapsedTimer timer;
+	timer.start();
+	if (!this->backend->init(inputs, 2, params)) {
+		this->backend->cleanup();
+		result.insert("error", QString("Processing initialization failed. Not enough memory?"));
+		return result;
+	}
+	if (configuration.streamToHost) {
+		size_t bytesPerStreamingBuffer = static_cast<size_t>(ceil(configuration.bitDepth/8.0))*configuration.samplesPerLine*configuration.ascansPerBscan*configuration.bscansPerBuffer;
+		for (int i = 0; i < 2; i++) {
+			this->streamingBuffers[i].resize(bytesPerStreamingBuffer);
+		}
+		this->backend->registerStreamingBuffers(this->streamingBuffers[0].data(), this->streamingBuffers[1].data(), bytesPerStreamingBuffer);
+	}
+	double initMilliseconds = timer.nsecsElapsed()/1.0e6;
+
+	//the first buffers include the fixed-pattern noise determination and the first access to all buffers
+	timer.restart();
+	bool processed = true;
+	for (int i = 0; i < BENCHMARK_WARMUP_BUFFERS; i++) {
+		processed = this->backend->process(inputs[i%2]) && processed;
+	}
+	this->backend->synchronize();
+	if (!processed) {
+		if (configuration.streamToHost) {
+			this->backend->unregisterStreamingBuffers();
+		}
+		this->backend->cleanup();
+		result.insert("error", QString("Processing failed: ") + QString::fromStdString(this->backend->getLastError()));
+		return result;
+	}
+	double warmupMilliseconds = timer.nsecsElapsed()/1.0e6;
+
+	//process() returns as soon as the buffer has been consumed, the remaining stages run in the background if several buffers are in flight
+	qint64 submitNanoseconds = 0;
+	unsigned int processedBuffers = 0;
+	StageTimings* timings = StageTimings::getInstance();
+	timings->reset();
+	timer.restart();
+	while (processedBuffers < 2 || timer.elapsed() < this->options.seconds*1000.0) {
+		QElapsedTimer submitTimer;
+		submitTimer.start();
+		this->backend->process(inputs[processedBuffers%2]);
+		submitNanoseconds += submitTimer.nsecsElapsed();
+		processedBuffers++;
+	}
+	qint64 submittedNanoseconds = timer.nsecsElapsed();
+	this->backend->synchronize();
+	double seconds = timer.nsecsElapsed()/1.0e9;
+	double drainMilliseconds = (timer.nsecsElapsed()-submittedNanoseconds)/1.0e6;
+	double deviceMemory = this->getUsedDeviceMemoryMegabytes()-deviceMemoryBefore;
+
+	if (configuration.streamToHost) {
+		this->backend->unregisterStreamingBuffers();
+	}
+	this->backend->cleanup();
+
+	double buffersPerSecond = processedBuffers/seconds;
+	double ascansPerBuffer = static_cast<double>(configuration.ascansPerBscan)*configuration.bscansPerBuffer;
+	double bufferSizeMegabytes = this->inputBuffers[0].size()/1048576.0;
+	result.insert("buffers", static_cast<int>(processedBuffers));
+	result.insert("seconds", seconds);
+	result.insert("buffers_per_second", buffersPerSecond);
+	result.insert("volumes_per_second", buffersPerSecond/configuration.buffersPerVolume);
+	result.insert("ascans_per_second", buffersPerSecond*ascansPerBuffer);
+	result.insert("buffer_size_mb", bufferSizeMegabytes);
+	result.insert("data_throughput_mb_per_second", buffersPerSecond*bufferSizeMegabytes);
+
+	QJsonObject stages;
+	stages.insert("init", initMilliseconds);
+	stages.insert("warmup", warmupMilliseconds);
+	stages.insert("submit_per_buffer", submitNanoseconds/1.0e6/processedBuffers);
+	stages.insert("drain", drainMilliseconds);
+	result.insert("stages_ms", stages);
+
+	//per-stage statistics reported by the backend for the measured buffers (at most the last STAGE_TIMINGS_WINDOW)
+	QJsonObject processingStages;
+	for (int i = 0; i < NUMBER_OF_PROCESSING_STAGES; i++) {
+		PROCESSING_STAGE stage = static_cast<PROCESSING_STAGE>(i);
+		StageStatistics statistics = timings->getStatistics(stage);
+		if (statistics.samples == 0) {
+			continue;
+		}
+		QJsonObject stageObject;
+		stageObject.insert("samples", static_cast<int>(statistics.samples));
+		stageObject.insert("mean", statistics.mean);
+		stageObject.insert("p50", statistics.p50);
+		stageObject.insert("p99", statistics.p99);
+		stageObject.insert("max", statistics.max);
+		processingStages.insert(StageTimings::getStageName(stage), stageObject);
+	}
+	result.insert("processing_stages_ms", processingStages);
+
+	QJsonObject memory;
+	memory.insert("host_peak", getPeakHostMemoryMegabytes());
+	memory.insert("device", deviceMemory);
+	result.insert("memory_mb", memory);
+	return result;
+}
+
+bool Benchmark::prepareInput(const BenchmarkConfiguration& configuration, QString& error) {
+	size_t bytesPerBuffer = InputConversion::getBytesPerSample(configuration.bitDepth)*static_cast<size_t>(configuration.samplesPerLine)*configuration.ascansPerBscan*configuration.bscansPerBuffer;
+	for (int i = 0; i < 2; i++) {
+		this->inputBuffers[i].assign(bytesPerBuffer, 0);
+	}
+	if (this->options.inputFile.isEmpty()) {
+		this->generateSyntheticInput(configuration);
+		return true;
+	}
+
+	//the first two buffers of the file are used. A file with a single buffer is used for both
+	QFile file(this->options.inputFile);
+	if (!file.open(QIODevice::ReadOnly)) {
+		error = "Could not open " + this->options.inputFile;
+		return false;
+	}
+	for (int i = 0; i < 2; i++) {
+		if (file.read(reinterpret_cast<char*>(this->inputBuffers[i].data()), bytesPerBuffer) != static_cast<qint64>(bytesPerBuffer)) {
+			if (i == 0) {
+				error = this->options.inputFile + " is smaller than one buffer (" + QString::number(bytesPerBuffer) + " bytes)";
+				return false;
+			}
+			this->inputBuffers[1] = this->inputBuffers[0];
+		}
+	}
+	return true;
+}
+
+void Benchmark::generateSyntheticInput(const BenchmarkConfiguration& configuration) {
+	//three reflectors on a gaussian source spectrum, stored like the 12 bit samples of performance.md that are shifted by 4 bits
+	const size_t samplesPerLine = configuration.samplesPerLine;
+	const size_t samplesPerBscan = samplesPerLine*configuration.ascansPerBscan;
+	const size_t bytesPerSample = InputConversion::getBytesPerSample(configuration.bitDepth);
+	const unsigned int shift = configuration.bitDepth <= 12 && bytesPerSample == 2 ? 4 : 0;
+	const double maxValue = pow(2.0, configuration.bitDepth)-1.0;
+	const double depths[3] = {0.08, 0.2, 0.35};
+	const double amplitudes[3] = {0.2, 0.1, 0.05};
+	std::vector<unsigned int> bscan(samplesPerBscan);
+	for (int buffer = 0; buffer < 2; buffer++) {
+		for (size_t line = 0; line < configuration.ascansPerBscan; line++) {
+			double phase = 0.05*line + buffer;
+			for (size_t s = 0; s < samplesPerLine; s++) {
+				double x = static_cast<double>(s)/samplesPerLine;
+				double envelope = exp(-pow((x-0.5)/0.25, 2.0));
+				double fringes = 0.0;
+				for (int r = 0; r < 3; r++) {
+					fringes += amplitudes[r]*cos(2.0*M_PI*depths[r]*s + phase*(r+1));
+				}
+				double value = maxValue*(0.5 + 0.4*envelope*(0.5 + fringes));
+				bscan[line*samplesPerLine+s] = static_cast<unsigned int>(std::max(0.0, std::min(maxValue, value))) << shift;
+			}
+		}
+		unsigned char* data = this->inputBuffers[buffer].data();
+		for (size_t i = 0; i < samplesPerBscan; i++) {
+			memcpy(data + i*bytesPerSample, &bscan[i], bytesPerSample); //little endian, like the acquisition buffers
+		}
+		for (size_t b = 1; b < configuration.bscansPerBuffer; b++) {
+			memcpy(data + b*samplesPerBscan*bytesPerSample, data, samplesPerBscan*bytesPerSample);
+		}
+	}
+}
+
+void Benchmark::applyParameters(const BenchmarkConfiguration& configuration) {
+	//octproz settings of performance.md
+	OctAlgorithmParameters* params = OctAlgorithmParameters::getInstance();
+	params->samplesPerLine = configuration.samplesPerLine;
+	params->ascansPerBscan = configuration.ascansPerBscan;
+	params->bscansPerBuffer = configuration.bscansPerBuffer;
+	params->buffersPerVolume = configuration.buffersPerVolume;
+	params->bitDepth = configuration.bitDepth;
+	params->acquisitionParamsChanged = true;
+
+	params->processingBackend = this->options.backend;
+	params->buffersInFlight = this->options.buffersInFlight;
+	params->pipelineWorkers = this->options.pipelineWorkers;
+	params->volumeStorage = this->options.volumeStorage;
+	params->bitshift = true;
+	params->bscanFlip = true;
+	params->resampling = true;
+	params->resamplingInterpolation = LINEAR;
+	params->c0 = 0.0f;
+	params->c1 = static_cast<float>(configuration.samplesPerLine-1);
+	params->c2 = 0.0f;
+	params->c3 = 0.0f;
+	params->updateResampleCurve();
+	params->dispersionCompensation = true;
+	params->d0 = 0.0f;
+	params->d1 = 0.0f;
+	params->d2 = 0.0f;
+	params->d3 = 0.0f;
+	params->updateDispersionCurve();
+	params->windowing = true;
+	params->window = WindowFunction::Hanning;
+	params->windowCenter = 0.5f;
+	params->windowFillFactor = 0.95f;
+	params->updateWindowCurve();
+	params->fixedPatternNoiseRemoval = true;
+	params->continuousFixedPatternNoiseDetermination = false;
+	params->bscansForNoiseDetermination = configuration.bscansForNoiseDetermination;
+	params->backgroundRemoval = false;
+	params->sinusoidalScanCorrection = false;
+	params->signalLogScaling = true;
+	params->signalGrayscaleMax = 100.0f;
+	params->signalGrayscaleMin = 30.0f;
+	params->signalMultiplicator = 1.0f;
+	params->signalAddend = 0.0f;
+	params->postProcessBackgroundRemoval = false;
+	params->updatePostProcessingBackgroundCurve();
+	params->volumeRingMegabytes = 0;
+	params->bscanViewEnabled = false;
+	params->enFaceViewEnabled = false;
+	params->volumeViewEnabled = false;
+	params->streamToHost = configuration.streamToHost;
+	params->streamingBuffersToSkip = 0;
+	params->streamingParamsChanged = false; //true until the sidebar has applied the streaming settings
+	params->acquisitionParamsChanged = false;
+}
+
+double Benchmark::getPeakHostMemoryMegabytes() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0.0;
+	}
+	return counters.PeakWorkingSetSize/1048576.0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0.0;
+	}
+#if defined(__APPLE__)
+	return usage.ru_maxrss/1048576.0; //bytes on macOS
+#else
+	return usage.ru_maxrss/1024.0; //kilobytes on linux
+#endif
+#endif
+}
+
+double Benchmark::getUsedDeviceMemoryMegabytes() const {
+	if (this->options.backend != CUDA_GPU) {
+		return 0.0;
+	}
+	size_t freeBytes = 0;
+	size_t totalBytes = 0;
+	if (cudaMemGetInfo(&freeBytes, &totalBytes) != cudaSuccess) {
+		cudaGetLastError();
+		return 0.0;
+	}
+	return (totalBytes-freeBytes)/1048576.0;
+}
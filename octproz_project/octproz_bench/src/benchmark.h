@@ -0,0 +1,93 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "processingbackend.h"
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <vector>
+
+#define BENCHMARK_DEFAULT_SECONDS 5.0
+#define BENCHMARK_WARMUP_BUFFERS 2
+
+//one column of the parameter table in performance.md. Display is not part of the benchmark, all rows correspond to "without 3D view"
+struct BenchmarkConfiguration {
+	QString name;
+	unsigned int bitDepth;
+	unsigned int samplesPerLine;
+	unsigned int ascansPerBscan;
+	unsigned int bscansPerBuffer;
+	unsigned int buffersPerVolume;
+	unsigned int bscansForNoiseDetermination;
+	bool streamToHost;
+};
+
+//processing options that are not part of the performance.md table
+struct BenchmarkOptions {
+	PROCESSING_BACKEND backend;
+	unsigned int cpuThreads; ///0 uses all cores
+	unsigned int buffersInFlight;
+	unsigned int pipelineWorkers;
+	VOLUME_STORAGE volumeStorage;
+	double seconds; ///measurement time per configuration, the warm-up buffers are not included
+	QString inputFile; ///raw data in the format of the acquisition buffer. Synthetic interferograms are used if this is empty
+};
+
+
+/**
+* Runs the processing pipeline of OCTproZ without GUI, OpenGL context and acquisition system. Every configuration is initialized, warmed up
+* with BENCHMARK_WARMUP_BUFFERS buffers (this includes the determination of the fixed-pattern noise), and then the two input buffers are
+* processed alternately for the given time. The acquisition buffers are not refilled, so only processing and streaming to host memory are
+* measured, which is the "A-scan rate without 3D view" of performance.md.
+**/
+class Benchmark
+{
+public:
+	Benchmark(const BenchmarkOptions& options);
+	~Benchmark();
+
+	static QList<BenchmarkConfiguration> getPerformanceConfigurations(); ///parameter table of performance.md
+	QJsonObject getSystemInfo() const;
+	QJsonObject run(const BenchmarkConfiguration& configuration); ///result of one configuration. Contains "error" if the configuration could not be run
+
+private:
+	bool prepareInput(const BenchmarkConfiguration& configuration, QString& error);
+	void generateSyntheticInput(const BenchmarkConfiguration& configuration);
+	void applyParameters(const BenchmarkConfiguration& configuration);
+	static double getPeakHostMemoryMegabytes();
+	double getUsedDeviceMemoryMegabytes() const; ///0 if the cpu backend is used
+
+	BenchmarkOptions options;
+	ProcessingBackend* backend;
+	std::vector<unsigned char> inputBuffers[2];
+	std::vector<unsigned char> streamingBuffers[2];
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,227 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "benchmark.h"
+#include "validation.h"
+#include "ringstress.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QFile>
+#include <QTextStream>
+
+//writes the report to fileName or to stdout if fileName is empty
+static bool writeReport(const QJsonObject& report, const QString& fileName) {
+	QByteArray json = QJsonDocument(report).toJson();
+	if (fileName.isEmpty()) {
+		QTextStream(stdout) << json;
+		return true;
+	}
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+		QTextStream(stderr) << "Could not write " << fileName << "\n";
+		return false;
+	}
+	return true;
+}
+
+//runs the checks of the validation, see validation.h. Returns the exit code
+static int validate(const BenchmarkOptions& options, const QStringList& selected, bool list, const QString& outputFile) {
+	QTextStream err(stderr);
+	QList<ValidationCheck> checks = Validation::getChecks();
+	if (list) {
+		QTextStream out(stdout);
+		for (const ValidationCheck& check : checks) {
+			out << check.name << "\n";
+		}
+		return 0;
+	}
+	for (const QString& name : selected) {
+		bool found = false;
+		for (const ValidationCheck& check : checks) {
+			found = found || check.name == name;
+		}
+		if (!found) {
+			err << "Unknown check: " << name << "\n";
+			return 1;
+		}
+	}
+
+	Validation validation(options);
+	QJsonArray results;
+	bool passed = true;
+	for (const ValidationCheck& check : checks) {
+		if (!selected.isEmpty() && !selected.contains(check.name)) {
+			continue;
+		}
+		err << "Checking " << check.name << "...\n";
+		err.flush();
+		QJsonObject result = validation.run(check);
+		if (result.contains("error")) {
+			err << check.name << ": " << result.value("error").toString() << "\n";
+		} else if (!result.value("passed").toBool()) {
+			//the first failing stage points to the step that deviates, the output is compared last
+			for (const QJsonValue& value : result.value("stages").toArray()) {
+				QJsonObject stage = value.toObject();
+				if (!stage.value("passed").toBool()) {
+					err << check.name << ", stage " << stage.value("stage").toString() << ": max. relative error " << stage.value("max_error").toDouble() << " (tolerance " << stage.value("max_error_tolerance").toDouble()
+						<< "), rms relative error " << stage.value("rms_error").toDouble() << " (tolerance " << stage.value("rms_error_tolerance").toDouble() << ")\n";
+				}
+			}
+			if (!result.value("output_passed").toBool()) {
+				err << check.name << ": max. error " << result.value("max_error").toDouble() << " (tolerance " << result.value("max_error_tolerance").toDouble()
+					<< "), rms error " << result.value("rms_error").toDouble() << " (tolerance " << result.value("rms_error_tolerance").toDouble() << ")\n";
+			}
+		}
+		passed = passed && result.value("passed").toBool();
+		results.append(result);
+	}
+
+	QJsonObject report;
+	report.insert("system", validation.getSystemInfo());
+	report.insert("checks", results);
+	report.insert("passed", passed);
+	if (!writeReport(report, outputFile)) {
+		return 1;
+	}
+	return passed ? 0 : 1;
+}
+
+//runs the stress test of the acquisition buffer ring, see ringstress.h. Returns the exit code
+static int stressRing(const QString& outputFile) {
+	QTextStream err(stderr);
+	err << "Running the ring stress test...\n";
+	err.flush();
+	RingStress stress;
+	QJsonObject result = stress.run();
+	if (result.contains("error")) {
+		err << result.value("error").toString() << "\n";
+	}
+	for (const QJsonValue& error : result.value("errors").toArray()) {
+		err << error.toString() << "\n";
+	}
+	if (!writeReport(result, outputFile)) {
+		return 1;
+	}
+	return result.value("passed").toBool() ? 0 : 1;
+}
+
+//headless benchmark of the processing pipeline, see performance.md
+//example: octproz_bench --backend cpu --configuration lab_computer --seconds 10 --output lab.json
+//with --validate the output of the backend is compared with the double precision reference instead: octproz_bench --validate --backend cuda
+//with --ring-stress the acquisition buffer ring is tested with one producer and several consumers instead
+int main(int argc, char *argv[]) {
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("octproz_bench");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Measures the processing throughput of OCTproZ for the configurations of performance.md and prints the results as JSON.");
+	parser.addHelpOption();
+	QCommandLineOption backendOption("backend", "Processing backend: cpu or cuda. Falls back to cpu if no cuda device is available.", "backend", "cuda");
+	QCommandLineOption configurationOption("configuration", "Configuration to run, can be given several times. All configurations are run by default.", "name");
+	QCommandLineOption listOption("list", "List the available configurations (the validation checks with --validate) and exit.");
+	QCommandLineOption inputOption("input", "Raw data file in the format of the acquisition buffer. Synthetic interferograms are used by default.", "file");
+	QCommandLineOption secondsOption("seconds", "Measurement time per configuration.", "seconds", QString::number(BENCHMARK_DEFAULT_SECONDS));
+	QCommandLineOption buffersInFlightOption("buffers-in-flight", "Buffers the processing pipeline works on at the same time.", "count", "2");
+	QCommandLineOption workersOption("workers", "Pipeline workers of the cpu backend.", "count", "1");
+	QCommandLineOption volumeStorageOption("volume-storage", "Sample type of the processed volume: 0 = float32, 1 = float16, 2 = uint16, 3 = uint8.", "type", "0");
+	QCommandLineOption threadsOption("threads", "Threads of the cpu backend, 0 uses all cores.", "count", "0");
+	QCommandLineOption outputOption("output", "Write the results to this file instead of stdout.", "file");
+	QCommandLineOption validateOption("validate", "Compare the output of the backend with the double precision reference pipeline instead of measuring the throughput. Exits with 1 if a check fails.");
+	QCommandLineOption checkOption("check", "Validation check to run, can be given several times. All checks are run by default.", "name");
+	QCommandLineOption ringStressOption("ring-stress", "Stress test of the acquisition buffer ring with one producer and steady, slow, pausing and late consumers. Exits with 1 if a consumer gets an overwritten buffer or a sequence out of order.");
+	parser.addOptions({backendOption, configurationOption, listOption, inputOption, secondsOption, buffersInFlightOption, workersOption, volumeStorageOption, threadsOption, outputOption, validateOption, checkOption, ringStressOption});
+	parser.process(app);
+
+	if (parser.isSet(ringStressOption)) {
+		return stressRing(parser.value(outputOption));
+	}
+
+	QTextStream err(stderr);
+	BenchmarkOptions options;
+	options.backend = parser.value(backendOption) == "cpu" ? MULTITHREADED_CPU : CUDA_GPU;
+	options.cpuThreads = parser.value(threadsOption).toUInt();
+	options.buffersInFlight = qMax(1u, parser.value(buffersInFlightOption).toUInt());
+	options.pipelineWorkers = qMax(1u, parser.value(workersOption).toUInt());
+	options.volumeStorage = static_cast<VOLUME_STORAGE>(qMin(static_cast<unsigned int>(UINT8_VOLUME), parser.value(volumeStorageOption).toUInt()));
+	options.seconds = parser.value(secondsOption).toDouble();
+	options.inputFile = parser.value(inputOption);
+
+	if (parser.isSet(validateOption)) {
+		return validate(options, parser.values(checkOption), parser.isSet(listOption), parser.value(outputOption));
+	}
+
+	QList<BenchmarkConfiguration> configurations = Benchmark::getPerformanceConfigurations();
+	if (parser.isSet(listOption)) {
+		QTextStream out(stdout);
+		for (const BenchmarkConfiguration& configuration : configurations) {
+			out << configuration.name << "\n";
+		}
+		return 0;
+	}
+	QStringList selected = parser.values(configurationOption);
+	if (!selected.isEmpty()) {
+		QList<BenchmarkConfiguration> selectedConfigurations;
+		for (const QString& name : selected) {
+			bool found = false;
+			for (const BenchmarkConfiguration& configuration : configurations) {
+				if (configuration.name == name) {
+					selectedConfigurations.append(configuration);
+					found = true;
+				}
+			}
+			if (!found) {
+				err << "Unknown configuration: " << name << "\n";
+				return 1;
+			}
+		}
+		configurations = selectedConfigurations;
+	}
+
+	Benchmark benchmark(options);
+	QJsonArray results;
+	bool failed = false;
+	for (const BenchmarkConfiguration& configuration : configurations) {
+		err << "Running " << configuration.name << "...\n";
+		err.flush();
+		QJsonObject result = benchmark.run(configuration);
+		if (result.contains("error")) {
+			err << configuration.name << ": " << result.value("error").toString() << "\n";
+			failed = true;
+		}
+		results.append(result);
+	}
+
+	QJsonObject report;
+	report.insert("system", benchmark.getSystemInfo());
+	report.insert("results", results);
+	if (!writeReport(report, parser.value(outputOption))) {
+		return 1;
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,316 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef _USE_MATH_DEFINES
+	#define _USE_MATH_DEFINES
+#endif
+
+#include "referencepipeline.h"
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+
+
+ReferencePipeline::ReferencePipeline(const OctAlgorithmParameters* params) {
+	this->params = params;
+	this->signalLength = static_cast<int>(params->samplesPerLine);
+	this->outputAscanLength = this->signalLength/2;
+	this->ascansPerBscan = static_cast<int>(params->ascansPerBscan);
+	this->linesPerBuffer = static_cast<int>(params->ascansPerBscan*params->bscansPerBuffer);
+	this->signal.resize(static_cast<size_t>(this->signalLength)*this->linesPerBuffer);
+	this->spectra.resize(this->signal.size());
+	this->transformedAscans.resize(static_cast<size_t>(this->outputAscanLength)*this->linesPerBuffer);
+	this->ascans.resize(this->transformedAscans.size());
+	this->twiddles.resize(this->signalLength);
+	for (int n = 0; n < this->signalLength; n++) {
+		double angle = 2.0*M_PI*n/this->signalLength;
+		this->twiddles[n] = std::complex<double>(cos(angle), sin(angle));
+	}
+	this->fixedPatternNoiseDetermined = false;
+	this->noiseSegments = 0;
+	this->noiseSegmentWidth = 0;
+	this->meanALine.assign(this->outputAscanLength, std::complex<double>(0.0, 0.0));
+	this->postProcessBackgroundRecorded = false;
+}
+
+ReferencePipeline::~ReferencePipeline() {
+}
+
+void ReferencePipeline::process(const void* input, std::vector<double>& output) {
+	this->convert(input);
+	if (this->params->backgroundRemoval) {
+		this->removeRollingAverageBackground();
+	}
+	if (this->params->resampling) {
+		this->resample();
+	}
+	this->applyWindowAndDispersion();
+	this->transform();
+	this->ascans = this->transformedAscans;
+	if (this->params->fixedPatternNoiseRemoval) {
+		this->removeFixedPatternNoise();
+	}
+	this->truncate(output);
+	if (this->params->postProcessBackgroundRemoval) {
+		this->removePostProcessBackground(output);
+	}
+}
+
+void ReferencePipeline::convert(const void* input) {
+	//inputToCufftComplex and inputToCufftComplex_and_bitshift
+	const unsigned int bitDepth = this->params->bitDepth;
+	const bool bitshift = this->params->bitshift;
+	for (size_t i = 0; i < this->signal.size(); i++) {
+		if (bitDepth <= 8) {
+			unsigned int value = static_cast<const uint8_t*>(input)[i];
+			this->signal[i] = bitshift ? (value >> 4) : value;
+		} else if (bitDepth <= 16) {
+			unsigned int value = static_cast<const uint16_t*>(input)[i];
+			this->signal[i] = bitshift ? (value >> 4) : value;
+		} else {
+			uint32_t value = static_cast<const uint32_t*>(input)[i];
+			this->signal[i] = bitshift ? value/4294967296.0 : value;
+		}
+	}
+}
+
+void ReferencePipeline::removeRollingAverageBackground() {
+	//the window of sample j is [j-windowSize+1, j+windowSize], clamped to the A-scan
+	const int windowSize = this->params->rollingAverageWindowSize;
+	std::vector<double> line(this->signalLength);
+	for (int l = 0; l < this->linesPerBuffer; l++) {
+		double* samples = &this->signal[static_cast<size_t>(l)*this->signalLength];
+		std::copy(samples, samples+this->signalLength, line.begin());
+		for (int j = 0; j < this->signalLength; j++) {
+			int first = std::max(0, j-windowSize+1);
+			int last = std::min(this->signalLength-1, j+windowSize);
+			double sum = 0.0;
+			for (int k = first; k <= last; k++) {
+				sum += line[k];
+			}
+			samples[j] = line[j] - sum/(last-first+1);
+		}
+	}
+}
+
+double ReferencePipeline::lanczosKernel(double x) {
+	//lanczos kernel with a = 8, see ResamplingPlan of the processing backends
+	if (fabs(x) < 1.0e-12) {
+		return 1.0;
+	}
+	if (fabs(x) >= 8.0) {
+		return 0.0;
+	}
+	return (sin(M_PI*x)/(M_PI*x))*(sin(M_PI*x/8.0)/(M_PI*x/8.0));
+}
+
+void ReferencePipeline::resample() {
+	//output sample j is the input A-scan interpolated at resampleCurve[j]. Taps outside the A-scan are clamped to the first/last sample
+	const INTERPOLATION interpolation = this->params->resamplingInterpolation;
+	const int last = this->signalLength-1;
+	std::vector<double> line(this->signalLength);
+	auto tap = [&](int k) { return line[std::min(last, std::max(0, k))]; };
+	for (int l = 0; l < this->linesPerBuffer; l++) {
+		double* samples = &this->signal[static_cast<size_t>(l)*this->signalLength];
+		std::copy(samples, samples+this->signalLength, line.begin());
+		for (int j = 0; j < this->signalLength; j++) {
+			double x = this->params->resampleCurve[j];
+			int n = static_cast<int>(floor(x));
+			double t = x-n;
+			if (interpolation == CUBIC) {
+				//catmull-rom spline through the samples n-1, n, n+1 and n+2
+				double y0 = tap(n-1);
+				double y1 = tap(n);
+				double y2 = tap(n+1);
+				double y3 = tap(n+2);
+				samples[j] = y1 + 0.5*t*((y2-y0) + t*((2.0*y0-5.0*y1+4.0*y2-y3) + t*(3.0*(y1-y2)+y3-y0)));
+			} else if (interpolation == LANCZOS) {
+				double sum = 0.0;
+				for (int k = n-7; k <= n+8; k++) {
+					sum += tap(k)*lanczosKernel(x-k);
+				}
+				samples[j] = sum;
+			} else {
+				samples[j] = tap(n) + (tap(n+1)-tap(n))*t;
+			}
+		}
+	}
+}
+
+void ReferencePipeline::applyWindowAndDispersion() {
+	//the dispersive phase is applied as exp(i*phase), same as fillDispersivePhase with factor 1 and direction 1
+	const bool windowing = this->params->windowing;
+	const bool dispersionCompensation = this->params->dispersionCompensation;
+	for (int l = 0; l < this->linesPerBuffer; l++) {
+		size_t offset = static_cast<size_t>(l)*this->signalLength;
+		for (int j = 0; j < this->signalLength; j++) {
+			std::complex<double> value(this->signal[offset+j], 0.0);
+			if (windowing) {
+				value *= static_cast<double>(this->params->windowCurve[j]);
+			}
+			if (dispersionCompensation) {
+				value *= std::polar(1.0, static_cast<double>(this->params->dispersionCurve[j]));
+			}
+			this->spectra[offset+j] = value;
+		}
+	}
+}
+
+void ReferencePipeline::transform() {
+	//naive inverse DFT without normalization (CUFFT_INVERSE). Only the first half of every A-scan is calculated, the second half is truncated anyway
+	for (int l = 0; l < this->linesPerBuffer; l++) {
+		const std::complex<double>* in = &this->spectra[static_cast<size_t>(l)*this->signalLength];
+		std::complex<double>* out = &this->transformedAscans[static_cast<size_t>(l)*this->outputAscanLength];
+		for (int k = 0; k < this->outputAscanLength; k++) {
+			std::complex<double> sum(0.0, 0.0);
+			int twiddle = 0;
+			for (int n = 0; n < this->signalLength; n++) {
+				sum += in[n]*this->twiddles[twiddle];
+				twiddle += k;
+				if (twiddle >= this->signalLength) {
+					twiddle -= this->signalLength;
+				}
+			}
+			out[k] = sum;
+		}
+	}
+}
+
+void ReferencePipeline::removeFixedPatternNoise() {
+	//mean A-scan of the segment with minimum variance (S. Moon et al., Optics Express 18(23):24395-24404, 2010), subtracted from every A-scan
+	const int height = std::min(static_cast<int>(this->params->bscansForNoiseDetermination)*this->ascansPerBscan, this->linesPerBuffer);
+	const int segments = std::max(1, std::min(FIXED_PATTERN_NOISE_REMOVAL_SEGMENTS, height));
+	const int segmentWidth = height/segments;
+	//in continuous mode all segments are determined again from every buffer
+	if (!this->fixedPatternNoiseDetermined || this->params->continuousFixedPatternNoiseDetermination || this->params->redetermineFixedPatternNoise) {
+		this->noiseSegments = segments;
+		this->noiseSegmentWidth = segmentWidth;
+		this->segmentMeans.assign(static_cast<size_t>(segments)*this->outputAscanLength, std::complex<double>(0.0, 0.0));
+		this->segmentSquaredDeviations.assign(this->segmentMeans.size(), 0.0);
+		for (int s = 0; s < segments; s++) {
+			this->updateNoiseSegment(s);
+		}
+		this->fixedPatternNoiseDetermined = true;
+	}
+
+	//all segments have the same number of A-scans, so the sums of squared deviations can be compared instead of the variances. The first minimum wins
+	for (int k = 0; k < this->outputAscanLength; k++) {
+		int minimum = 0;
+		for (int s = 1; s < this->noiseSegments; s++) {
+			if (this->segmentSquaredDeviations[static_cast<size_t>(s)*this->outputAscanLength+k] < this->segmentSquaredDeviations[static_cast<size_t>(minimum)*this->outputAscanLength+k]) {
+				minimum = s;
+			}
+		}
+		this->meanALine[k] = this->segmentMeans[static_cast<size_t>(minimum)*this->outputAscanLength+k];
+	}
+	for (int l = 0; l < this->linesPerBuffer; l++) {
+		std::complex<double>* ascan = &this->ascans[static_cast<size_t>(l)*this->outputAscanLength];
+		for (int k = 0; k < this->outputAscanLength; k++) {
+			ascan[k] -= this->meanALine[k];
+		}
+	}
+}
+
+void ReferencePipeline::updateNoiseSegment(int segment) {
+	//two pass mean and sum of squared deviations of A-scans segment*noiseSegmentWidth to (segment+1)*noiseSegmentWidth-1 of the current buffer
+	const int firstLine = segment*this->noiseSegmentWidth;
+	for (int k = 0; k < this->outputAscanLength; k++) {
+		std::complex<double> mean(0.0, 0.0);
+		for (int l = firstLine; l < firstLine+this->noiseSegmentWidth; l++) {
+			mean += this->ascans[static_cast<size_t>(l)*this->outputAscanLength+k];
+		}
+		mean /= static_cast<double>(this->noiseSegmentWidth);
+		double squaredDeviations = 0.0;
+		for (int l = firstLine; l < firstLine+this->noiseSegmentWidth; l++) {
+			squaredDeviations += std::norm(this->ascans[static_cast<size_t>(l)*this->outputAscanLength+k]-mean);
+		}
+		this->segmentMeans[static_cast<size_t>(segment)*this->outputAscanLength+k] = mean;
+		this->segmentSquaredDeviations[static_cast<size_t>(segment)*this->outputAscanLength+k] = squaredDeviations;
+	}
+}
+
+void ReferencePipeline::truncate(std::vector<double>& output) const {
+	//magnitude of the first half of every A-scan, log or linear scaling to [0, 1], then flip of every second B-scan and then sinusoidal scan correction
+	const double max = this->params->signalGrayscaleMax;
+	const double min = this->params->signalGrayscaleMin;
+	const double coeff = this->params->signalMultiplicator;
+	const double addend = this->params->signalAddend;
+	const bool logScaling = this->params->signalLogScaling;
+	std::vector<double> scaled(this->ascans.size());
+	for (size_t i = 0; i < this->ascans.size(); i++) {
+		double value = logScaling ? 10.0*log10(std::norm(this->ascans[i])/this->outputAscanLength) : std::abs(this->ascans[i])/this->outputAscanLength;
+		scaled[i] = saturate(coeff*((value-min)/(max-min) + addend));
+	}
+
+	//B-scans with even index are stored in reverse A-scan order
+	std::vector<double> flipped(scaled.size());
+	for (int l = 0; l < this->linesPerBuffer; l++) {
+		int bscan = l/this->ascansPerBscan;
+		int source = (this->params->bscanFlip && bscan%2 == 0) ? bscan*this->ascansPerBscan + (this->ascansPerBscan-1-l%this->ascansPerBscan) : l;
+		std::copy(&scaled[static_cast<size_t>(source)*this->outputAscanLength], &scaled[static_cast<size_t>(source+1)*this->outputAscanLength], &flipped[static_cast<size_t>(l)*this->outputAscanLength]);
+	}
+
+	//A-scan l is taken from position (ascansPerBscan/pi)*acos(1-2*p/ascansPerBscan) of its B-scan (p: position of l in the B-scan). The last A-scan of the buffer is kept
+	output.resize(flipped.size());
+	for (int l = 0; l < this->linesPerBuffer; l++) {
+		double* out = &output[static_cast<size_t>(l)*this->outputAscanLength];
+		if (!this->params->sinusoidalScanCorrection || l+1 == this->linesPerBuffer) {
+			std::copy(&flipped[static_cast<size_t>(l)*this->outputAscanLength], &flipped[static_cast<size_t>(l+1)*this->outputAscanLength], out);
+			continue;
+		}
+		int p = l%this->ascansPerBscan;
+		double x = (this->ascansPerBscan/M_PI)*acos(1.0-2.0*p/this->ascansPerBscan);
+		int line0 = (l/this->ascansPerBscan)*this->ascansPerBscan + static_cast<int>(floor(x));
+		int line1 = std::min(line0+1, this->linesPerBuffer-1);
+		double weight = x-floor(x);
+		for (int k = 0; k < this->outputAscanLength; k++) {
+			double value0 = flipped[static_cast<size_t>(line0)*this->outputAscanLength+k];
+			double value1 = flipped[static_cast<size_t>(line1)*this->outputAscanLength+k];
+			out[k] = value0 + (value1-value0)*weight;
+		}
+	}
+}
+
+void ReferencePipeline::removePostProcessBackground(std::vector<double>& output) {
+	//a requested background is the mean of the A-scans of the first B-scan of the current buffer. Otherwise the background of the parameters is used
+	if (this->params->postProcessBackgroundRecordingRequested) {
+		this->postProcessBackground.assign(this->outputAscanLength, 0.0);
+		for (int l = 0; l < this->ascansPerBscan; l++) {
+			for (int k = 0; k < this->outputAscanLength; k++) {
+				this->postProcessBackground[k] += output[static_cast<size_t>(l)*this->outputAscanLength+k]/this->ascansPerBscan;
+			}
+		}
+		this->postProcessBackgroundRecorded = true;
+	}
+	const double weight = this->params->postProcessBackgroundWeight;
+	const double offset = this->params->postProcessBackgroundOffset;
+	for (size_t i = 0; i < output.size(); i++) {
+		int k = static_cast<int>(i%this->outputAscanLength);
+		double background = this->postProcessBackgroundRecorded ? this->postProcessBackground[k] : this->params->postProcessBackground[k];
+		output[i] = saturate(output[i] - (weight*background + offset));
+	}
+}
@@ -0,0 +1,94 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef REFERENCEPIPELINE_H
+#define REFERENCEPIPELINE_H
+
+#include "octalgorithmparameters.h"
+#include <complex>
+#include <vector>
+
+
+/**
+* Slow double precision implementation of every processing stage of octCudaPipeline in cuda_code.cu. It is the golden reference of the
+* validation (see validation.h) and is written as plainly as possible from the definition of each stage: direct rolling average, resampling
+* with clamped taps, naive DFT, two pass segment statistics and so on. No code is shared with the processing backends, only the curves of
+* OctAlgorithmParameters (resample curve, window, dispersion phase and post processing background) are used as they are.
+* Like the backends the reference keeps the fixed-pattern noise and the recorded post processing background of previous buffers.
+* Display and conversion to the output bit depth are not part of the reference, the result is the processed volume with values in [0, 1].
+**/
+class ReferencePipeline
+{
+public:
+	ReferencePipeline(const OctAlgorithmParameters* params);
+	~ReferencePipeline();
+
+	void process(const void* input, std::vector<double>& output); ///output: samplesPerLine/2 samples for every A-scan of the buffer, in the order of the processed volume of the backends
+
+	//intermediate results of the last process() call, in the layout of CAPTURE_STAGE of processingbackend.h
+	const std::vector<std::complex<double> >& getSpectra() const { return this->spectra; } ///input of the fft, samplesPerLine samples per A-scan
+	const std::vector<std::complex<double> >& getTransformedAscans() const { return this->transformedAscans; } ///first half of every transformed A-scan
+	const std::vector<std::complex<double> >& getAscans() const { return this->ascans; } ///transformed A-scans after fixed-pattern noise removal (if enabled), the input of magnitude and scaling
+
+private:
+	void convert(const void* input);
+	void removeRollingAverageBackground();
+	void resample();
+	void applyWindowAndDispersion();
+	void transform();
+	void removeFixedPatternNoise();
+	void updateNoiseSegment(int segment);
+	void truncate(std::vector<double>& output) const;
+	void removePostProcessBackground(std::vector<double>& output);
+
+	static double lanczosKernel(double x);
+	static double saturate(double value) { return value > 0.0 ? (value < 1.0 ? value : 1.0) : 0.0; } ///NaN becomes 0, same as the backends
+
+	const OctAlgorithmParameters* params;
+	int signalLength;
+	int outputAscanLength;
+	int ascansPerBscan;
+	int linesPerBuffer;
+
+	std::vector<double> signal; ///real valued spectra of the buffer
+	std::vector<std::complex<double> > spectra; ///spectra after windowing and dispersion compensation
+	std::vector<std::complex<double> > transformedAscans; ///first half of the transformed spectra, outputAscanLength samples per A-scan
+	std::vector<std::complex<double> > ascans; ///transformedAscans after fixed-pattern noise removal
+	std::vector<std::complex<double> > twiddles; ///exp(2*pi*i*n/signalLength), inverse transform like CUFFT_INVERSE
+
+	bool fixedPatternNoiseDetermined;
+	int noiseSegments;
+	int noiseSegmentWidth;
+	std::vector<std::complex<double> > segmentMeans; ///noiseSegments x outputAscanLength
+	std::vector<double> segmentSquaredDeviations; ///noiseSegments x outputAscanLength
+	std::vector<std::complex<double> > meanALine;
+
+	bool postProcessBackgroundRecorded;
+	std::vector<double> postProcessBackground;
+};
+
+#endif // REFERENCEPIPELINE_H
@@ -0,0 +1,248 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#include "ringstress.h"
+#include <QJsonArray>
+#include <chrono>
+#include <random>
+#include <thread>
+
+static const char* consumerTypeNames[] = {"steady", "slow", "pausing", "late"};
+
+
+RingStress::RingStress() {
+	this->buffer = new AcquisitionBuffer();
+	this->producerDone = false;
+	this->failed = false;
+	this->stalls = 0;
+}
+
+RingStress::~RingStress() {
+	delete this->buffer;
+}
+
+QJsonObject RingStress::run() {
+	QJsonObject result;
+	if (!this->buffer->allocateMemory(RINGSTRESS_BUFFERS, RINGSTRESS_BYTES_PER_BUFFER)) {
+		result.insert("error", QString("Could not allocate the acquisition buffer."));
+		result.insert("passed", false);
+		return result;
+	}
+
+	//one more consumer than the ring supports, so late consumers also run into registerConsumer() returning -1
+	RINGSTRESS_CONSUMER types[] = {STEADY_CONSUMER, STEADY_CONSUMER, SLOW_CONSUMER, PAUSING_CONSUMER};
+	this->consumers.clear();
+	for (unsigned int i = 0; i < sizeof(types)/sizeof(types[0]) + RINGSTRESS_LATE_CONSUMERS; i++) {
+		RingStressConsumer consumer;
+		consumer.type = i < sizeof(types)/sizeof(types[0]) ? types[i] : LATE_CONSUMER;
+		consumer.consumerId = -1;
+		consumer.seed = 1000 + i;
+		consumer.lastSequence = 0;
+		consumer.acquired = 0;
+		consumer.skipped = 0;
+		consumer.registrations = 0;
+		//consumers that are registered before the producer starts have to get every buffer until they unregister
+		if (consumer.type != LATE_CONSUMER) {
+			consumer.consumerId = this->buffer->registerConsumer();
+			consumer.registrations = 1;
+		}
+		this->consumers.push_back(consumer);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	threads.emplace_back(&RingStress::produce, this);
+	for (unsigned int i = 0; i < this->consumers.size(); i++) {
+		threads.emplace_back(&RingStress::consume, this, &this->consumers[i]);
+	}
+	for (unsigned int i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	QJsonArray consumerResults;
+	for (const RingStressConsumer& consumer : this->consumers) {
+		if (!this->failed && (consumer.type == STEADY_CONSUMER || consumer.type == SLOW_CONSUMER)) {
+			unsigned long long expected = consumer.type == STEADY_CONSUMER ? RINGSTRESS_SEQUENCES / 2 : RINGSTRESS_SEQUENCES * 3 / 4;
+			if (consumer.acquired != expected || consumer.lastSequence != expected || consumer.skipped != 0) {
+				this->fail(QString("%1 consumer acquired %2 buffers up to sequence %3 and skipped %4, expected %5 buffers without skipping.")
+					.arg(consumerTypeNames[consumer.type]).arg(consumer.acquired).arg(consumer.lastSequence).arg(consumer.skipped).arg(expected));
+			}
+		}
+		QJsonObject consumerResult;
+		consumerResult.insert("type", QString(consumerTypeNames[consumer.type]));
+		consumerResult.insert("registrations", static_cast<double>(consumer.registrations));
+		consumerResult.insert("acquired", static_cast<double>(consumer.acquired));
+		consumerResult.insert("skipped", static_cast<double>(consumer.skipped));
+		consumerResult.insert("last_sequence", static_cast<double>(consumer.lastSequence));
+		consumerResults.append(consumerResult);
+	}
+	if (!this->failed && this->buffer->getPublishedSequence() != RINGSTRESS_SEQUENCES) {
+		this->fail(QString("The producer published %1 of %2 buffers.").arg(this->buffer->getPublishedSequence()).arg(RINGSTRESS_SEQUENCES));
+	}
+
+	result.insert("buffers", RINGSTRESS_BUFFERS);
+	result.insert("published", static_cast<double>(this->buffer->getPublishedSequence()));
+	result.insert("producer_timeouts", static_cast<double>(this->stalls));
+	result.insert("seconds", seconds);
+	result.insert("consumers", consumerResults);
+	result.insert("errors", QJsonArray::fromStringList(this->errors));
+	result.insert("passed", !this->failed);
+	return result;
+}
+
+void RingStress::produce() {
+	unsigned int wordCount = RINGSTRESS_BYTES_PER_BUFFER / sizeof(unsigned long long);
+	std::chrono::steady_clock::time_point lastPublish = std::chrono::steady_clock::now();
+	unsigned long long sequence = 1;
+	while (sequence <= RINGSTRESS_SEQUENCES && !this->failed) {
+		int index = this->buffer->waitForWrite(100);
+		if (index < 0) {
+			this->stalls++;
+			if (std::chrono::steady_clock::now() - lastPublish > std::chrono::milliseconds(RINGSTRESS_STALL_TIMEOUT_MS)) {
+				this->fail(QString("The producer did not get a free buffer for %1 ms after publishing sequence %2.").arg(RINGSTRESS_STALL_TIMEOUT_MS).arg(sequence - 1));
+			}
+			continue;
+		}
+		unsigned long long* words = static_cast<unsigned long long*>(this->buffer->bufferArray[index]);
+		for (unsigned int i = 0; i < wordCount; i++) {
+			words[i] = sequence * wordCount + i;
+		}
+		this->buffer->publish(index);
+		if (this->buffer->getPublishedSequence() != sequence) {
+			this->fail(QString("Buffer %1 was published with sequence %2 instead of %3.").arg(index).arg(this->buffer->getPublishedSequence()).arg(sequence));
+		}
+		lastPublish = std::chrono::steady_clock::now();
+		sequence++;
+	}
+	this->producerDone = true;
+}
+
+void RingStress::consume(RingStressConsumer* consumer) {
+	std::mt19937 random(consumer->seed);
+	QString name = QString("%1 consumer").arg(consumerTypeNames[consumer->type]);
+	bool gapless = consumer->type == STEADY_CONSUMER || consumer->type == SLOW_CONSUMER;
+	unsigned long long stopSequence = consumer->type == STEADY_CONSUMER ? RINGSTRESS_SEQUENCES / 2 : RINGSTRESS_SEQUENCES * 3 / 4;
+	unsigned long long quota = 0; //buffers until a pausing or late consumer unregisters
+	if (consumer->type == LATE_CONSUMER) {
+		std::this_thread::sleep_for(std::chrono::microseconds(random() % 2000));
+	}
+
+	while (!this->failed) {
+		if (consumer->consumerId < 0) {
+			consumer->consumerId = this->buffer->registerConsumer();
+			if (consumer->consumerId < 0) {
+				if (this->producerDone) {
+					break;
+				}
+				std::this_thread::yield();
+				continue;
+			}
+			consumer->registrations++;
+		}
+		if (quota == 0) {
+			quota = consumer->type == PAUSING_CONSUMER ? 64 + random() % 512 : 1 + random() % 16;
+		}
+		int consumerId = consumer->consumerId;
+		unsigned long long sequence = 0;
+		int index = this->buffer->waitForBuffer(consumerId, 10, &sequence);
+		if (index < 0) {
+			//buffers that were published before producerDone was set are still consumed
+			if (this->producerDone && (index = this->buffer->acquire(consumerId, &sequence)) < 0) {
+				break;
+			}
+			if (index < 0) {
+				continue;
+			}
+		}
+
+		if (sequence <= consumer->lastSequence) {
+			this->fail(QString("%1 acquired sequence %2 after sequence %3.").arg(name).arg(sequence).arg(consumer->lastSequence));
+		} else if (gapless && sequence != consumer->lastSequence + 1) {
+			this->fail(QString("%1 acquired sequence %2 after sequence %3, although it was registered before the first publish.").arg(name).arg(sequence).arg(consumer->lastSequence));
+		}
+		if (!this->checkPattern(index, sequence)) {
+			this->fail(QString("%1 acquired buffer %2 with sequence %3, but the buffer contains another sequence.").arg(name).arg(index).arg(sequence));
+		}
+		consumer->lastSequence = sequence;
+		consumer->acquired++;
+
+		//hold the buffer for a while. The producer must not write into it until it is released
+		if (consumer->type == SLOW_CONSUMER && random() % 8 == 0) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		} else if (consumer->type == PAUSING_CONSUMER || consumer->type == LATE_CONSUMER) {
+			if (random() % 32 == 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			} else if (random() % 4 == 0) {
+				std::this_thread::yield();
+			}
+		}
+		if (!this->checkPattern(index, sequence)) {
+			this->fail(QString("%1 held buffer %2 with sequence %3, but the producer overwrote it.").arg(name).arg(index).arg(sequence));
+		}
+
+		bool last = gapless ? sequence >= stopSequence : --quota == 0;
+		//a late consumer that unregisters without releasing its buffer hands it back to the producer as well
+		if (!last || consumer->type != LATE_CONSUMER || random() % 4 != 0) {
+			this->buffer->release(consumerId, index);
+		}
+		if (last) {
+			consumer->skipped += this->buffer->getSkippedBuffers(consumerId);
+			this->buffer->unregisterConsumer(consumerId);
+			consumer->consumerId = -1;
+			if (gapless) {
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(consumer->type == PAUSING_CONSUMER ? 1000 : random() % 500));
+		}
+	}
+
+	if (consumer->consumerId >= 0) {
+		consumer->skipped += this->buffer->getSkippedBuffers(consumer->consumerId);
+		this->buffer->unregisterConsumer(consumer->consumerId);
+		consumer->consumerId = -1;
+	}
+}
+
+bool RingStress::checkPattern(int index, unsigned long long sequence) const {
+	unsigned int wordCount = RINGSTRESS_BYTES_PER_BUFFER / sizeof(unsigned long long);
+	const volatile unsigned long long* words = static_cast<const volatile unsigned long long*>(this->buffer->bufferArray[index]);
+	for (unsigned int i = 0; i < wordCount; i++) {
+		if (words[i] != sequence * wordCount + i) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void RingStress::fail(const QString& message) {
+	std::lock_guard<std::mutex> lock(this->errorMutex);
+	if (this->errors.size() < RINGSTRESS_MAX_ERRORS) {
+		this->errors.append(message);
+	}
+	this->failed = true;
+}
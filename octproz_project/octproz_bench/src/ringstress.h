@@ -0,0 +1,93 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef RINGSTRESS_H
+#define RINGSTRESS_H
+
+#include "acquisitionbuffer.h"
+#include <QJsonObject>
+#include <QStringList>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define RINGSTRESS_BUFFERS 4 ///small ring, so the producer wraps around while consumers still hold buffers
+#define RINGSTRESS_BYTES_PER_BUFFER 4096
+#define RINGSTRESS_SEQUENCES 100000 ///buffers the producer publishes
+#define RINGSTRESS_LATE_CONSUMERS 5
+#define RINGSTRESS_STALL_TIMEOUT_MS 10000 ///the run fails if the producer does not get a free buffer for this long
+#define RINGSTRESS_MAX_ERRORS 16 ///only the first errors are reported
+
+enum RINGSTRESS_CONSUMER {
+	STEADY_CONSUMER, ///registered before the first buffer is published, consumes every buffer and unregisters after half of the sequences
+	SLOW_CONSUMER, ///like the steady consumer, but holds some buffers for a while so the producer has to wait. Unregisters after three quarters of the sequences
+	PAUSING_CONSUMER, ///registered from the start, unregisters now and then and skips the buffers that are published in the meantime
+	LATE_CONSUMER ///registers after the producer has started, consumes a few buffers and unregisters again, sometimes without releasing the last buffer
+};
+
+struct RingStressConsumer {
+	RINGSTRESS_CONSUMER type;
+	int consumerId; ///-1 while not registered
+	unsigned int seed;
+	unsigned long long lastSequence; ///last acquired sequence number, must increase over all registrations
+	unsigned long long acquired;
+	unsigned long long skipped; ///skipped buffers of all registrations, see AcquisitionBuffer::getSkippedBuffers()
+	unsigned long long registrations;
+};
+
+
+/**
+* Stress test of the AcquisitionBuffer ring. One producer publishes RINGSTRESS_SEQUENCES buffers, each filled with a pattern derived from its sequence
+* number, while steady, slow, pausing and late consumers (see RINGSTRESS_CONSUMER) acquire, hold and release them. Every acquired buffer is checked
+* when it is acquired and again after it has been held, so a buffer that the producer overwrites while a registered consumer still holds it is
+* detected. The test also checks that the sequence numbers of every consumer increase, that consumers registered before the first publish get every
+* buffer without gaps and that the producer never stalls. See the ring stress section of performance.md.
+**/
+class RingStress
+{
+public:
+	RingStress();
+	~RingStress();
+
+	QJsonObject run(); ///result with "passed" and the first errors
+
+private:
+	void produce();
+	void consume(RingStressConsumer* consumer);
+	bool checkPattern(int index, unsigned long long sequence) const;
+	void fail(const QString& message);
+
+	AcquisitionBuffer* buffer;
+	std::vector<RingStressConsumer> consumers;
+	std::atomic<bool> producerDone;
+	std::atomic<bool> failed;
+	std::mutex errorMutex;
+	QStringList errors;
+	unsigned long long stalls;
+};
+
+#endif // RINGSTRESS_H
@@ -0,0 +1,372 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef _USE_MATH_DEFINES
+	#define _USE_MATH_DEFINES
+#endif
+
+#include "validation.h"
+#include "cpuprocessingbackend.h"
+#include "cudaprocessingbackend.h"
+#include <QJsonArray>
+#include <algorithm>
+#include <math.h>
+
+//tolerance of the 16 bit output: the streamed samples are truncated to VALIDATION_BIT_DEPTH bits
+#define VALIDATION_OUTPUT_LSB (1.0/65535.0)
+
+//intermediate results that are compared in addition to the output, see CAPTURE_STAGE. The errors are relative to the root mean square magnitude
+//of the reference samples of the stage, so the tolerances do not depend on the bit shift or on the amplitude of the interferograms
+struct ValidationStage {
+	CAPTURE_STAGE stage;
+	const char* name;
+	double maxErrorTolerance;
+	double rmsErrorTolerance;
+};
+
+static const ValidationStage validationStages[] = {
+	{CAPTURE_SPECTRA, "spectra", 1.0e-5, 1.0e-6},
+	{CAPTURE_FFT, "fft", 2.0e-5, 2.0e-6},
+	{CAPTURE_FIXED_PATTERN_NOISE_REMOVAL, "fixed_pattern_noise_removal", 3.0e-5, 3.0e-6}
+};
+
+//relative deviation of the captured samples from the reference samples of the stage
+static QJsonObject compareStage(const ValidationStage& stage, const std::vector<std::complex<double> >& reference, const std::vector<std::complex<float> >& captured, size_t samplesPerLine) {
+	double referencePower = 0.0;
+	double maxError = -1.0;
+	double sumOfSquaredErrors = 0.0;
+	size_t worstSample = 0;
+	for (size_t s = 0; s < reference.size(); s++) {
+		double error = std::abs(reference[s] - std::complex<double>(captured[s]));
+		referencePower += std::norm(reference[s]);
+		sumOfSquaredErrors += error*error;
+		if (error > maxError) {
+			maxError = error;
+			worstSample = s;
+		}
+	}
+	double scale = referencePower > 0.0 ? sqrt(referencePower/reference.size()) : 1.0;
+	double rmsError = sqrt(sumOfSquaredErrors/reference.size())/scale;
+	maxError /= scale;
+
+	QJsonObject result;
+	result.insert("stage", QString(stage.name));
+	result.insert("max_error", maxError);
+	result.insert("max_error_tolerance", stage.maxErrorTolerance);
+	result.insert("rms_error", rmsError);
+	result.insert("rms_error_tolerance", stage.rmsErrorTolerance);
+	result.insert("reference_rms", scale);
+	result.insert("max_error_ascan", static_cast<int>(worstSample/samplesPerLine));
+	result.insert("max_error_sample", static_cast<int>(worstSample%samplesPerLine));
+	result.insert("passed", maxError <= stage.maxErrorTolerance && rmsError <= stage.rmsErrorTolerance);
+	return result;
+}
+
+
+Validation::Validation(const BenchmarkOptions& options) {
+	this->options = options;
+	if (this->options.backend == CUDA_GPU && CudaProcessingBackend::isDeviceAvailable()) {
+		this->backend = new CudaProcessingBackend();
+	} else {
+		this->options.backend = MULTITHREADED_CPU;
+		this->backend = new CpuProcessingBackend(this->options.cpuThreads);
+	}
+	this->generateInterferograms();
+}
+
+Validation::~Validation() {
+	delete this->backend;
+}
+
+QList<ValidationCheck> Validation::getChecks() {
+	//name, bitshift, rolling average background removal, resampling, interpolation, windowing, dispersion compensation, fixed-pattern noise removal,
+	//continuous fixed-pattern noise determination, bscan flip, sinusoidal scan correction, post processing background removal, log scaling,
+	//max error tolerance, rms error tolerance
+	QList<ValidationCheck> checks;
+	checks.append({"conversion_fft_log", false, false, false, LINEAR, false, false, false, false, false, false, false, true, 1.0e-3, 1.0e-5});
+	checks.append({"bitshift", true, false, false, LINEAR, false, false, false, false, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"rolling_average_background_removal", true, true, false, LINEAR, false, false, false, false, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"resampling_linear", true, true, true, LINEAR, false, false, false, false, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"resampling_cubic", true, true, true, CUBIC, false, false, false, false, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"resampling_lanczos", true, true, true, LANCZOS, false, false, false, false, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"windowing", true, true, true, LINEAR, true, false, false, false, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"dispersion_compensation", true, true, true, LINEAR, true, true, false, false, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"dispersion_compensation_without_resampling", true, true, false, LINEAR, true, true, false, false, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"fixed_pattern_noise_removal", true, true, true, LINEAR, true, true, true, false, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"continuous_fixed_pattern_noise_removal", true, true, true, LINEAR, true, true, true, true, false, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"bscan_flip", true, true, true, LINEAR, true, true, true, false, true, false, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"sinusoidal_scan_correction", true, true, true, LINEAR, true, true, true, false, true, true, false, true, 1.0e-4, 1.0e-5});
+	checks.append({"post_process_background_removal", true, true, true, LINEAR, true, true, true, false, true, true, true, true, 2.0e-4, 2.0e-5});
+	checks.append({"linear_scaling", true, true, true, LINEAR, true, true, true, false, true, true, true, false, 1.0e-4, 1.0e-5});
+	checks.append({"all_stages_cubic", true, true, true, CUBIC, true, true, true, false, true, true, true, true, 2.0e-4, 2.0e-5});
+	checks.append({"all_stages_lanczos", true, true, true, LANCZOS, true, true, true, false, true, true, true, true, 2.0e-4, 2.0e-5});
+	return checks;
+}
+
+QJsonObject Validation::getSystemInfo() const {
+	QJsonObject info;
+	info.insert("backend", QString(this->backend->getName()));
+	info.insert("device", QString::fromStdString(this->backend->getDeviceName()));
+	info.insert("buffers_in_flight", static_cast<int>(this->options.buffersInFlight));
+	info.insert("pipeline_workers", static_cast<int>(this->options.pipelineWorkers));
+	info.insert("volume_storage", static_cast<int>(this->options.volumeStorage));
+	info.insert("log_accuracy", static_cast<int>(OctAlgorithmParameters::getInstance()->logAccuracy));
+	return info;
+}
+
+QJsonObject Validation::run(const ValidationCheck& check) {
+	QJsonObject result;
+	result.insert("check", check.name);
+	this->applyParameters(check);
+	OctAlgorithmParameters* params = OctAlgorithmParameters::getInstance();
+
+	//the reference runs first because the backends reset the request flags of the parameters (e.g. postProcessBackgroundRecordingRequested).
+	//All buffers are the same, so the fixed-pattern noise and the background that both determine from the first buffer are also valid for the others
+	//(except for the continuous fixed-pattern noise check, whose backend gets a different buffer first, see below)
+	std::vector<double> reference;
+	ReferencePipeline referencePipeline(params);
+	referencePipeline.process(this->inputBuffer.data(), reference);
+
+	void* input = this->inputBuffer.data();
+	if (!this->backend->init(&input, 1, params)) {
+		this->backend->cleanup();
+		result.insert("error", QString("Processing initialization failed. Not enough memory?"));
+		return result;
+	}
+	size_t samplesPerStreamingBuffer = reference.size();
+	for (int i = 0; i < 2; i++) {
+		this->streamingBuffers[i].assign(samplesPerStreamingBuffer, 0);
+	}
+	this->backend->registerStreamingBuffers(this->streamingBuffers[0].data(), this->streamingBuffers[1].data(), samplesPerStreamingBuffer*sizeof(unsigned short));
+	this->backend->setStageCapture(true);
+	bool processed = true;
+	if (check.continuousFixedPatternNoiseDetermination) {
+		//first a buffer with mirrored A-scans, which changes the phase of the fixed-pattern component. The mean A-scan of this buffer
+		//does not match the following ones, so the check only passes if the fixed-pattern noise is determined again from every buffer
+		std::vector<unsigned short> interferograms(this->inputBuffer);
+		for (size_t line = 0; line < this->inputBuffer.size()/VALIDATION_SAMPLES_PER_LINE; line++) {
+			std::reverse(this->inputBuffer.begin()+line*VALIDATION_SAMPLES_PER_LINE, this->inputBuffer.begin()+(line+1)*VALIDATION_SAMPLES_PER_LINE);
+		}
+		processed = this->backend->process(input);
+		this->backend->synchronize();
+		std::copy(interferograms.begin(), interferograms.end(), this->inputBuffer.begin());
+	}
+	for (int i = 0; i < VALIDATION_BUFFERS; i++) {
+		processed = this->backend->process(input) && processed;
+	}
+	this->backend->synchronize();
+
+	//intermediate results of the last buffer. Fixed-pattern noise removal is only compared if the check enables it
+	const std::vector<std::complex<double> >* referenceStages[NUMBER_OF_CAPTURE_STAGES] = {&referencePipeline.getSpectra(), &referencePipeline.getTransformedAscans(), &referencePipeline.getAscans()};
+	QJsonArray stageResults;
+	QString captureError;
+	bool stagesPassed = true;
+	std::vector<std::complex<float> > captured;
+	for (const ValidationStage& stage : validationStages) {
+		if (!processed || (stage.stage == CAPTURE_FIXED_PATTERN_NOISE_REMOVAL && !check.fixedPatternNoiseRemoval)) {
+			continue;
+		}
+		const std::vector<std::complex<double> >& referenceStage = *referenceStages[stage.stage];
+		if (!this->backend->getCapturedStage(stage.stage, captured) || captured.size() != referenceStage.size()) {
+			captureError = QString("The backend did not capture the stage ") + stage.name + ".";
+			break;
+		}
+		size_t samplesPerLine = stage.stage == CAPTURE_SPECTRA ? VALIDATION_SAMPLES_PER_LINE : VALIDATION_SAMPLES_PER_LINE/2;
+		QJsonObject stageResult = compareStage(stage, referenceStage, captured, samplesPerLine);
+		stagesPassed = stagesPassed && stageResult.value("passed").toBool();
+		stageResults.append(stageResult);
+	}
+	this->backend->setStageCapture(false);
+	this->backend->unregisterStreamingBuffers();
+	this->backend->cleanup();
+	if (!processed) {
+		result.insert("error", QString("Processing failed: ") + QString::fromStdString(this->backend->getLastError()));
+		return result;
+	}
+	if (!captureError.isEmpty()) {
+		result.insert("error", captureError);
+		return result;
+	}
+
+	//deviation of every streamed sample from the reference
+	double maxError = -1.0;
+	double sumOfSquaredErrors = 0.0;
+	size_t worstSample = 0;
+	int worstBuffer = 0;
+	for (int i = 0; i < 2; i++) {
+		for (size_t s = 0; s < samplesPerStreamingBuffer; s++) {
+			double error = fabs(this->streamingBuffers[i][s]*VALIDATION_OUTPUT_LSB - reference[s]);
+			sumOfSquaredErrors += error*error;
+			if (error > maxError) {
+				maxError = error;
+				worstSample = s;
+				worstBuffer = i;
+			}
+		}
+	}
+	double rmsError = sqrt(sumOfSquaredErrors/(2.0*samplesPerStreamingBuffer));
+	double maxErrorTolerance = 0.0;
+	double rmsErrorTolerance = 0.0;
+	this->getTolerances(check, maxErrorTolerance, rmsErrorTolerance);
+	bool outputPassed = maxError <= maxErrorTolerance && rmsError <= rmsErrorTolerance;
+
+	unsigned int outputAscanLength = VALIDATION_SAMPLES_PER_LINE/2;
+	result.insert("max_error", maxError);
+	result.insert("max_error_tolerance", maxErrorTolerance);
+	result.insert("rms_error", rmsError);
+	result.insert("rms_error_tolerance", rmsErrorTolerance);
+	result.insert("max_error_ascan", static_cast<int>(worstSample/outputAscanLength));
+	result.insert("max_error_depth", static_cast<int>(worstSample%outputAscanLength));
+	result.insert("max_error_reference", reference[worstSample]);
+	result.insert("max_error_backend", this->streamingBuffers[worstBuffer][worstSample]*VALIDATION_OUTPUT_LSB);
+	result.insert("output_passed", outputPassed);
+	result.insert("stages", stageResults);
+	result.insert("passed", outputPassed && stagesPassed);
+	return result;
+}
+
+void Validation::generateInterferograms() {
+	//three reflectors whose amplitude grows and whose phase changes from A-scan to A-scan (so the variance of the fixed-pattern noise segments
+	//differs clearly), plus a fixed-pattern component that is the same in every A-scan. The full 16 bit range is used, so bitshift has to round down
+	const size_t samplesPerLine = VALIDATION_SAMPLES_PER_LINE;
+	const size_t lines = VALIDATION_ASCANS_PER_BSCAN*VALIDATION_BSCANS_PER_BUFFER;
+	const double maxValue = 65535.0;
+	const double depths[3] = {0.08, 0.2, 0.35};
+	const double amplitudes[3] = {0.2, 0.1, 0.05};
+	unsigned int noiseState = 12345;
+	this->inputBuffer.resize(samplesPerLine*lines);
+	for (size_t line = 0; line < lines; line++) {
+		double modulation = 0.6 + 0.4*line/(lines-1);
+		for (size_t s = 0; s < samplesPerLine; s++) {
+			double x = static_cast<double>(s)/samplesPerLine;
+			double envelope = exp(-pow((x-0.5)/0.3, 2.0));
+			double fringes = 0.1*cos(2.0*M_PI*0.31*s);
+			for (int r = 0; r < 3; r++) {
+				fringes += modulation*amplitudes[r]*cos(2.0*M_PI*depths[r]*s + 0.05*line*(r+1));
+			}
+			noiseState = noiseState*1664525u + 1013904223u; //deterministic uniform noise of VALIDATION_NOISE counts
+			double noise = VALIDATION_NOISE*((noiseState >> 8)/16777216.0 - 0.5);
+			double value = maxValue*(0.5 + 0.4*envelope*(0.5 + fringes)) + noise;
+			this->inputBuffer[line*samplesPerLine+s] = static_cast<unsigned short>(std::max(0.0, std::min(maxValue, value)));
+		}
+	}
+}
+
+void Validation::applyParameters(const ValidationCheck& check) {
+	OctAlgorithmParameters* params = OctAlgorithmParameters::getInstance();
+	params->samplesPerLine = VALIDATION_SAMPLES_PER_LINE;
+	params->ascansPerBscan = VALIDATION_ASCANS_PER_BSCAN;
+	params->bscansPerBuffer = VALIDATION_BSCANS_PER_BUFFER;
+	params->buffersPerVolume = 1;
+	params->bitDepth = VALIDATION_BIT_DEPTH;
+	params->acquisitionParamsChanged = true;
+
+	params->processingBackend = this->options.backend;
+	params->buffersInFlight = this->options.buffersInFlight;
+	params->pipelineWorkers = this->options.pipelineWorkers;
+	params->volumeStorage = this->options.volumeStorage;
+	params->bitshift = check.bitshift;
+	params->backgroundRemoval = check.backgroundRemoval;
+	params->rollingAverageWindowSize = 16;
+
+	//the resample curve runs from 8 to samplesPerLine-9, so all taps of every interpolation are inside the A-scan
+	params->resampling = check.resampling;
+	params->resamplingInterpolation = check.interpolation;
+	params->useCustomResampleCurve = false;
+	params->c0 = 8.0f;
+	params->c2 = 24.0f;
+	params->c1 = static_cast<float>(VALIDATION_SAMPLES_PER_LINE-17)-params->c2;
+	params->c3 = 0.0f;
+	params->updateResampleCurve();
+	params->windowing = check.windowing;
+	params->window = WindowFunction::Hanning;
+	params->windowCenter = 0.5f;
+	params->windowFillFactor = 0.95f;
+	params->updateWindowCurve();
+	params->dispersionCompensation = check.dispersionCompensation;
+	params->d0 = 0.0f;
+	params->d1 = 0.0f;
+	params->d2 = 30.0f;
+	params->d3 = -10.0f;
+	params->updateDispersionCurve();
+	params->fixedPatternNoiseRemoval = check.fixedPatternNoiseRemoval;
+	params->continuousFixedPatternNoiseDetermination = check.continuousFixedPatternNoiseDetermination;
+	params->redetermineFixedPatternNoise = false;
+	params->bscansForNoiseDetermination = VALIDATION_BSCANS_PER_BUFFER;
+	params->bscanFlip = check.bscanFlip;
+	params->sinusoidalScanCorrection = check.sinusoidalScanCorrection;
+
+	//log scaling: the noise floor and the reflectors are in the output range. Linear scaling: the strongest reflector is at about 0.7
+	params->signalLogScaling = check.logScaling;
+	params->signalGrayscaleMax = check.logScaling ? 120.0f : 50.0f;
+	params->signalGrayscaleMin = 0.0f;
+	params->signalMultiplicator = 1.0f;
+	params->signalAddend = 0.0f;
+	params->postProcessBackgroundRemoval = check.postProcessBackgroundRemoval;
+	params->postProcessBackgroundRecordingRequested = check.postProcessBackgroundRemoval;
+	params->postProcessBackgroundWeight = 0.5f;
+	params->postProcessBackgroundOffset = 0.02f;
+	params->updatePostProcessingBackgroundCurve();
+	params->volumeRingMegabytes = 0;
+	params->bscanViewEnabled = false;
+	params->enFaceViewEnabled = false;
+	params->volumeViewEnabled = false;
+	params->streamToHost = true;
+	params->streamingBuffersToSkip = 0;
+	params->streamingParamsChanged = false;
+	params->acquisitionParamsChanged = false;
+}
+
+void Validation::getTolerances(const ValidationCheck& check, double& maxError, double& rmsError) const {
+	OctAlgorithmParameters* params = OctAlgorithmParameters::getInstance();
+
+	//truncation of the output to 16 bit
+	maxError = check.maxErrorTolerance + VALIDATION_OUTPUT_LSB;
+	rmsError = check.rmsErrorTolerance + VALIDATION_OUTPUT_LSB;
+
+	//rounding of the compact volume storage types. Post processing background removal is applied to the stored samples and rounds again
+	double storageError = 0.0;
+	switch (this->options.volumeStorage) {
+		case FLOAT16_VOLUME: storageError = 4.9e-4; break; //relative error of half precision, all samples are <= 1
+		case UINT16_VOLUME: storageError = 0.5/65535.0; break;
+		case UINT8_VOLUME: storageError = 0.5/255.0; break;
+		default: break;
+	}
+	if (check.postProcessBackgroundRemoval) {
+		storageError *= 2.0 + params->postProcessBackgroundWeight;
+	}
+	maxError += storageError;
+	rmsError += storageError;
+
+	//fast log approximation of the cpu backend, see LOG_ACCURACY
+	if (check.logScaling && this->options.backend == MULTITHREADED_CPU && params->logAccuracy != EXACT_LOG) {
+		double decibels = params->logAccuracy == FAST_LOG_HIGH_ACCURACY ? 1.0e-4 : 1.0e-2;
+		double logError = decibels*params->signalMultiplicator/(params->signalGrayscaleMax-params->signalGrayscaleMin);
+		maxError += logError;
+		rmsError += logError;
+	}
+}
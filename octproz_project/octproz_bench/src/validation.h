@@ -0,0 +1,97 @@
+/**
+**  This file is part of OCTproZ.
+**  OCTproZ is an open source software for processig of optical
+**  coherence tomography (OCT) raw data.
+**  Copyright (C) 2019-2022 Miroslav Zabic
+**
+**  OCTproZ is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+#ifndef VALIDATION_H
+#define VALIDATION_H
+
+#include "benchmark.h"
+#include "referencepipeline.h"
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <vector>
+
+//geometry of the synthetic interferograms. 16 bit output keeps the quantization error of the streamed data far below the tolerances
+#define VALIDATION_BIT_DEPTH 16
+#define VALIDATION_SAMPLES_PER_LINE 1024
+#define VALIDATION_ASCANS_PER_BSCAN 64
+#define VALIDATION_BSCANS_PER_BUFFER 4
+#define VALIDATION_BUFFERS 2 ///every check processes the same buffer this many times and compares every streamed buffer
+#define VALIDATION_NOISE 64.0 ///peak to peak amplitude of the uniform noise of the synthetic interferograms in 16 bit counts
+
+//one check of the validation. Every check enables the processing stages of the previous check plus one more (or switches the interpolation or scaling),
+//so the first failing check points to the stage that deviates from the reference. Tolerances are in units of the normalized output (0 to 1)
+struct ValidationCheck {
+	QString name;
+	bool bitshift;
+	bool backgroundRemoval;
+	bool resampling;
+	INTERPOLATION interpolation;
+	bool windowing;
+	bool dispersionCompensation;
+	bool fixedPatternNoiseRemoval;
+	bool continuousFixedPatternNoiseDetermination;
+	bool bscanFlip;
+	bool sinusoidalScanCorrection;
+	bool postProcessBackgroundRemoval;
+	bool logScaling;
+	double maxErrorTolerance; ///largest deviation of a single sample for float32 volume storage and exact log, see Validation::getTolerances()
+	double rmsErrorTolerance; ///root mean square deviation of all samples for float32 volume storage and exact log
+};
+
+
+/**
+* Compares the streamed output of a processing backend with the double precision ReferencePipeline. Synthetic interferograms with three
+* reflectors, A-scan dependent amplitude and phase and a fixed-pattern component are processed by both for every check of getChecks(). The check
+* passes if the maximum and the root mean square deviation are within the tolerances. The tolerances of getChecks() cover float32 arithmetic
+* (FFT, fixed-pattern noise statistics, single precision curves); the quantization of the 16 bit output, compact volume storage and the fast log
+* of the cpu backend are added by getTolerances(). The intermediate results of the backend (spectra before the fft, transformed A-scans and A-scans
+* after fixed-pattern noise removal, see CAPTURE_STAGE) are compared with those of the reference as well, each with its own tolerance relative to
+* the magnitude of the stage, so a deviation is attributed to the stage where it first appears. See the validation section of performance.md.
+**/
+class Validation
+{
+public:
+	Validation(const BenchmarkOptions& options);
+	~Validation();
+
+	static QList<ValidationCheck> getChecks();
+	QJsonObject getSystemInfo() const;
+	QJsonObject run(const ValidationCheck& check); ///result of one check with "passed". Contains "error" if the check could not be run
+
+private:
+	void generateInterferograms();
+	void applyParameters(const ValidationCheck& check);
+	void getTolerances(const ValidationCheck& check, double& maxError, double& rmsError) const;
+
+	BenchmarkOptions options;
+	ProcessingBackend* backend;
+	std::vector<unsigned short> inputBuffer;
+	std::vector<unsigned short> streamingBuffers[2];
+};
+
+#endif // VALIDATION_H
@@ -30,7 +30,8 @@ SOURCES += \
 	src/acquisitionbuffer.cpp \
 	src/acquisitionparameter.cpp \
 	src/acquisitionsystem.cpp \
-	src/extension.cpp
+	src/extension.cpp \
+	src/tracer.cpp
 
 
 HEADERS += \
@@ -39,7 +40,8 @@ HEADERS += \
 	src/acquisitionparameter.h \
 	src/acquisitionsystem.h \
 	src/extension.h \
-	src/plugin.h
+	src/plugin.h \
+	src/tracer.h
 
 unix {
 	target.path = /usr/lib
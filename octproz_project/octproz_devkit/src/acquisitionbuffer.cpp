@@ -23,23 +23,56 @@ SOFTWARE.
 */
 
 #include "acquisitionbuffer.h"
+#include <chrono>
 
 
-AcquisitionBuffer::AcquisitionBuffer() : QObject() {
-	this->bufferCnt = 0;
-	this->bytesPerBuffer = bytesPerBuffer;
-	this->bufferArray.resize(bufferCnt);
-	this->bufferReadyArray.resize(bufferCnt);
-	this->currIndex = -1;
+AcquisitionBufferReadyFlag::operator bool() const {
+	if (this->index < 0 || this->index >= static_cast<int>(this->buffer->depth)) {
+		return false;
+	}
+	return this->buffer->isInUse(this->buffer->slotArray[this->index]);
+}
+
+AcquisitionBufferReadyFlag& AcquisitionBufferReadyFlag::operator=(bool ready) {
+	if (this->index < 0 || this->index >= static_cast<int>(this->buffer->depth)) {
+		return *this;
+	}
+	if (ready) {
+		this->buffer->publish(this->index);
+	} else {
+		this->buffer->slotArray[this->index].holders.store(0, std::memory_order_release);
+		this->buffer->notifyProducer();
+	}
+	return *this;
+}
 
-	for (unsigned int i = 0; i < this->bufferCnt; i++) {
-		this->bufferArray[i] = nullptr;
-		this->bufferReadyArray[i] = false;
+int AcquisitionBufferReadyArray::size() const {
+	return static_cast<int>(this->buffer->depth);
+}
+
+
+AcquisitionBuffer::AcquisitionBuffer() : QObject(), bufferReadyArray(this) {
+	this->bufferCnt = 0;
+	this->bytesPerBuffer = 0;
+	this->slotArray = nullptr;
+	this->publishedIndices = nullptr;
+	this->publishedSequence = 0;
+	this->registeredConsumers = 0;
+	this->depth = 0;
+	this->writeIndex = 0;
+	this->waitingConsumers = 0;
+	this->waitingProducers = 0;
+	for (int i = 0; i < ACQUISITIONBUFFER_MAX_CONSUMERS; i++) {
+		this->consumers[i].nextSequence = 1;
+		this->consumers[i].skipped = 0;
+		this->consumers[i].wakeUpRequested = false;
 	}
 }
 
 AcquisitionBuffer::~AcquisitionBuffer() {
 	releaseMemory();
+	delete[] this->slotArray;
+	delete[] this->publishedIndices;
 }
 
 bool AcquisitionBuffer::allocateMemory(unsigned int bufferCnt, size_t bytesPerBuffer) {
@@ -48,7 +81,7 @@ bool AcquisitionBuffer::allocateMemory(unsigned int bufferCnt, size_t bytesPerBu
 	this->releaseMemory();
 	this->bufferArray.clear();
 	this->bufferArray.resize(bufferCnt);
-	this->bufferReadyArray.resize(bufferCnt);
+	this->resetRing(bufferCnt);
 	bool success = true;
 
 	// Allocate page aligned memory
@@ -73,3 +106,234 @@ void AcquisitionBuffer::releaseMemory() {
 		}
 	}
 }
+
+int AcquisitionBuffer::beginWrite() {
+	if (this->depth == 0 || this->isInUse(this->slotArray[this->writeIndex])) {
+		return -1;
+	}
+	return this->writeIndex;
+}
+
+void AcquisitionBuffer::publish(int index) {
+	if (index < 0 || index >= static_cast<int>(this->depth)) {
+		return;
+	}
+	//single producer: only this thread modifies publishedSequence
+	unsigned long long sequence = this->publishedSequence.load(std::memory_order_relaxed) + 1;
+	//every consumer that is registered at this point has to release the buffer, consumers that register later skip it
+	unsigned int consumers = this->registeredConsumers.load(std::memory_order_acquire);
+	AcquisitionBufferSlot& slot = this->slotArray[index];
+	slot.sequence.store(sequence, std::memory_order_relaxed);
+	slot.holders.store(consumers != 0 ? consumers : ACQUISITIONBUFFER_UNCLAIMED, std::memory_order_release);
+	this->publishedIndices[sequence % this->depth].store(index, std::memory_order_relaxed);
+	this->publishedSequence.store(sequence, std::memory_order_release);
+	this->currIndex = index;
+	this->writeIndex = (index + 1) % this->depth;
+	this->notifyConsumers();
+}
+
+int AcquisitionBuffer::waitForWrite(int timeoutMs) {
+	int index = this->beginWrite();
+	if (index >= 0 || this->depth == 0) {
+		return index;
+	}
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	std::unique_lock<std::mutex> lock(this->waitMutex);
+	this->waitingProducers.fetch_add(1);
+	std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the fence in notifyProducer(), either the released buffer is seen here or the notification is sent
+	while ((index = this->beginWrite()) < 0) {
+		if (this->bufferReleased.wait_until(lock, deadline) == std::cv_status::timeout) {
+			index = this->beginWrite();
+			break;
+		}
+	}
+	this->waitingProducers.fetch_sub(1);
+	return index;
+}
+
+int AcquisitionBuffer::registerConsumer() {
+	unsigned int registered = this->registeredConsumers.load(std::memory_order_acquire);
+	int consumerId = -1;
+	do {
+		for (consumerId = 0; consumerId < ACQUISITIONBUFFER_MAX_CONSUMERS && (registered & (1u << consumerId)) != 0; consumerId++) {}
+		if (consumerId >= ACQUISITIONBUFFER_MAX_CONSUMERS) {
+			return -1;
+		}
+	} while (!this->registeredConsumers.compare_exchange_weak(registered, registered | (1u << consumerId), std::memory_order_acq_rel));
+	unsigned int consumerBit = 1u << consumerId;
+
+	//every publish() that sees the new bit is counted for this consumer, so it starts right after the buffers that are already published
+	Consumer& consumer = this->consumers[consumerId];
+	unsigned long long published = this->publishedSequence.load(std::memory_order_acquire);
+	consumer.nextSequence = published + 1;
+	consumer.skipped = 0;
+	consumer.wakeUpRequested.store(false, std::memory_order_relaxed);
+
+	//a previous consumer with the same id may have left its bit in buffers it did not release, and nobody else waits for unclaimed buffers
+	unsigned long long oldest = published >= this->depth ? published - this->depth + 1 : 1;
+	for (unsigned int i = 0; i < this->depth; i++) {
+		AcquisitionBufferSlot& slot = this->slotArray[i];
+		if (slot.sequence.load(std::memory_order_acquire) <= published) {
+			slot.holders.fetch_and(~consumerBit, std::memory_order_acq_rel);
+		}
+	}
+	for (unsigned long long sequence = oldest; sequence <= published; sequence++) {
+		int index = this->publishedIndices[sequence % this->depth].load(std::memory_order_relaxed);
+		AcquisitionBufferSlot& slot = this->slotArray[index];
+		unsigned int expected = ACQUISITIONBUFFER_UNCLAIMED;
+		if (slot.sequence.load(std::memory_order_acquire) == sequence && slot.holders.compare_exchange_strong(expected, consumerBit, std::memory_order_acq_rel)) {
+			//unclaimed buffers are never reused by the producer, so the sequence number can not have changed
+			consumer.nextSequence = qMin(consumer.nextSequence, sequence);
+		}
+	}
+	this->notifyProducer();
+	return consumerId;
+}
+
+void AcquisitionBuffer::unregisterConsumer(int consumerId) {
+	if (consumerId < 0 || consumerId >= ACQUISITIONBUFFER_MAX_CONSUMERS) {
+		return;
+	}
+	//bits of unregistered consumers are ignored by isInUse(), so buffers the consumer still holds become available to the producer
+	unsigned int consumerBit = 1u << consumerId;
+	if ((this->registeredConsumers.fetch_and(~consumerBit, std::memory_order_acq_rel) & consumerBit) != 0) {
+		this->notifyProducer();
+	}
+}
+
+int AcquisitionBuffer::acquire(int consumerId, unsigned long long* sequence) {
+	if (consumerId < 0 || consumerId >= ACQUISITIONBUFFER_MAX_CONSUMERS || this->depth == 0) {
+		return -1;
+	}
+	Consumer& consumer = this->consumers[consumerId];
+	unsigned long long published = this->publishedSequence.load(std::memory_order_acquire);
+
+	//sequence numbers older than the ring depth have been overwritten in publishedIndices
+	if (published >= this->depth && consumer.nextSequence + this->depth <= published) {
+		unsigned long long oldest = published - this->depth + 1;
+		consumer.skipped += oldest - consumer.nextSequence;
+		consumer.nextSequence = oldest;
+	}
+
+	while (consumer.nextSequence <= published) {
+		unsigned long long next = consumer.nextSequence++;
+		int index = this->publishedIndices[next % this->depth].load(std::memory_order_relaxed);
+		AcquisitionBufferSlot& slot = this->slotArray[index];
+		//a publish() that ran while the consumer registered may have missed it and marked the buffer as unclaimed. The buffer is claimed here,
+		//otherwise it would wait for the next consumer that registers. Publishes after the registration see the consumer, so the slot can not have been republished as unclaimed
+		unsigned int unclaimed = ACQUISITIONBUFFER_UNCLAIMED;
+		bool claimed = slot.sequence.load(std::memory_order_acquire) == next && slot.holders.compare_exchange_strong(unclaimed, 1u << consumerId, std::memory_order_acq_rel);
+		//the sequence number is checked again because the slot could have been republished between the first check and the holder check
+		if (claimed || (slot.sequence.load(std::memory_order_acquire) == next && (slot.holders.load(std::memory_order_acquire) & (1u << consumerId)) != 0 && slot.sequence.load(std::memory_order_acquire) == next)) {
+			if (sequence != nullptr) {
+				*sequence = next;
+			}
+			return index;
+		}
+		consumer.skipped++;
+	}
+	return -1;
+}
+
+int AcquisitionBuffer::waitForBuffer(int consumerId, int timeoutMs, unsigned long long* sequence) {
+	int index = this->acquire(consumerId, sequence);
+	if (index >= 0 || consumerId < 0 || consumerId >= ACQUISITIONBUFFER_MAX_CONSUMERS) {
+		return index;
+	}
+	Consumer& consumer = this->consumers[consumerId];
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	std::unique_lock<std::mutex> lock(this->waitMutex);
+	this->waitingConsumers.fetch_add(1);
+	std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the fence in notifyConsumers()
+	while ((index = this->acquire(consumerId, sequence)) < 0) {
+		if (consumer.wakeUpRequested.exchange(false, std::memory_order_acq_rel)) {
+			break;
+		}
+		if (this->bufferPublished.wait_until(lock, deadline) == std::cv_status::timeout) {
+			index = this->acquire(consumerId, sequence);
+			break;
+		}
+	}
+	this->waitingConsumers.fetch_sub(1);
+	return index;
+}
+
+void AcquisitionBuffer::wakeUp(int consumerId) {
+	if (consumerId < 0 || consumerId >= ACQUISITIONBUFFER_MAX_CONSUMERS) {
+		return;
+	}
+	this->consumers[consumerId].wakeUpRequested.store(true, std::memory_order_release);
+	this->notifyConsumers();
+}
+
+void AcquisitionBuffer::release(int consumerId, int index) {
+	if (consumerId < 0 || consumerId >= ACQUISITIONBUFFER_MAX_CONSUMERS || index < 0 || index >= static_cast<int>(this->depth)) {
+		return;
+	}
+	//the last consumer that releases the buffer hands it back to the producer. releasing twice has no effect
+	AcquisitionBufferSlot& slot = this->slotArray[index];
+	unsigned int consumerBit = 1u << consumerId;
+	unsigned int holders = slot.holders.fetch_and(~consumerBit, std::memory_order_acq_rel);
+	if ((holders & consumerBit) != 0 && !this->isInUse(slot)) {
+		this->notifyProducer();
+	}
+}
+
+unsigned int AcquisitionBuffer::getAvailableBuffers(int consumerId) const {
+	if (consumerId < 0 || consumerId >= ACQUISITIONBUFFER_MAX_CONSUMERS) {
+		return 0;
+	}
+	unsigned long long published = this->publishedSequence.load(std::memory_order_acquire);
+	unsigned long long next = this->consumers[consumerId].nextSequence;
+	return next > published ? 0 : static_cast<unsigned int>(qMin(published - next + 1, static_cast<unsigned long long>(this->depth)));
+}
+
+unsigned long long AcquisitionBuffer::getSkippedBuffers(int consumerId) const {
+	if (consumerId < 0 || consumerId >= ACQUISITIONBUFFER_MAX_CONSUMERS) {
+		return 0;
+	}
+	return this->consumers[consumerId].skipped;
+}
+
+bool AcquisitionBuffer::isInUse(const AcquisitionBufferSlot& slot) const {
+	unsigned int holders = slot.holders.load(std::memory_order_acquire);
+	return (holders & (this->registeredConsumers.load(std::memory_order_acquire) | ACQUISITIONBUFFER_UNCLAIMED)) != 0;
+}
+
+void AcquisitionBuffer::notifyConsumers() {
+	//the mutex is only locked if a consumer is actually waiting, so publish() stays lock-free as long as consumers keep up
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (this->waitingConsumers.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(this->waitMutex);
+		this->bufferPublished.notify_all();
+	}
+}
+
+void AcquisitionBuffer::notifyProducer() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (this->waitingProducers.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(this->waitMutex);
+		this->bufferReleased.notify_all();
+	}
+}
+
+void AcquisitionBuffer::resetRing(unsigned int depth) {
+	delete[] this->slotArray;
+	delete[] this->publishedIndices;
+	this->depth = depth;
+	this->slotArray = depth > 0 ? new AcquisitionBufferSlot[depth] : nullptr;
+	this->publishedIndices = depth > 0 ? new std::atomic<int>[depth] : nullptr;
+	for (unsigned int i = 0; i < depth; i++) {
+		this->slotArray[i].sequence = 0;
+		this->slotArray[i].holders = 0;
+		this->publishedIndices[i] = 0;
+	}
+	this->publishedSequence = 0;
+	this->writeIndex = 0;
+	this->currIndex = -1;
+	for (int i = 0; i < ACQUISITIONBUFFER_MAX_CONSUMERS; i++) {
+		this->consumers[i].nextSequence = 1;
+		this->consumers[i].skipped = 0;
+		this->consumers[i].wakeUpRequested = false;
+	}
+}
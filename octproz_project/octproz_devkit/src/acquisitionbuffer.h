@@ -28,6 +28,9 @@ SOFTWARE.
 #include <qobject.h>
 #include <qvector.h>
 #include <qstring.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 #ifdef _WIN32
 	#include <conio.h>
@@ -39,7 +42,84 @@ SOFTWARE.
 	#define posix_memalign_free free
 #endif
 
+#define ACQUISITIONBUFFER_MAX_CONSUMERS 8
+#define ACQUISITIONBUFFER_UNCLAIMED 0x80000000u //holder bit of buffers that were published while no consumer was registered
 
+
+class AcquisitionBuffer;
+
+struct AcquisitionBufferSlot
+{
+	std::atomic<unsigned long long> sequence; ///< Sequence number of the data in the slot, 0 if nothing has been published into it yet
+	std::atomic<unsigned int> holders; ///< Bit i is set while consumer i has not released the slot yet. The slot is in use as long as a bit of a registered consumer or ACQUISITIONBUFFER_UNCLAIMED is set
+};
+
+/**
+* Ready flag of one buffer, returned by AcquisitionBuffer::bufferReadyArray[i]. Reading uses acquire semantics.
+* Assigning true publishes the buffer (see AcquisitionBuffer::publish()), assigning false releases it for all consumers.
+**/
+class AcquisitionBufferReadyFlag
+{
+public:
+	AcquisitionBufferReadyFlag(AcquisitionBuffer* buffer, int index) : buffer(buffer), index(index) {}
+	operator bool() const;
+	AcquisitionBufferReadyFlag& operator=(bool ready);
+	AcquisitionBufferReadyFlag& operator=(const AcquisitionBufferReadyFlag& other) { return *this = static_cast<bool>(other); }
+
+private:
+	AcquisitionBuffer* buffer;
+	int index;
+};
+
+/**
+* Replaces the former QVector<bool> bufferReadyArray so that acquisition systems and extensions that index it keep compiling.
+**/
+class AcquisitionBufferReadyArray
+{
+public:
+	explicit AcquisitionBufferReadyArray(AcquisitionBuffer* buffer) : buffer(buffer) {}
+	AcquisitionBufferReadyFlag operator[](int index) { return AcquisitionBufferReadyFlag(this->buffer, index); }
+	bool operator[](int index) const { return AcquisitionBufferReadyFlag(this->buffer, index); }
+	int size() const;
+
+private:
+	AcquisitionBufferReadyArray(const AcquisitionBufferReadyArray&);
+	AcquisitionBufferReadyArray& operator=(const AcquisitionBufferReadyArray&);
+	AcquisitionBuffer* buffer;
+};
+
+/**
+* Index of the most recently published buffer, stored and loaded with release/acquire semantics. Replaces the former int currIndex.
+**/
+class AcquisitionBufferIndex
+{
+public:
+	AcquisitionBufferIndex() : index(-1) {}
+	operator int() const { return this->index.load(std::memory_order_acquire); }
+	AcquisitionBufferIndex& operator=(int index) { this->index.store(index, std::memory_order_release); return *this; }
+
+private:
+	AcquisitionBufferIndex(const AcquisitionBufferIndex&);
+	AcquisitionBufferIndex& operator=(const AcquisitionBufferIndex&);
+	std::atomic<int> index;
+};
+
+
+/**
+* Page aligned acquisition buffers, organized as lock-free ring with a single producer (the acquisition system) and up to
+* ACQUISITIONBUFFER_MAX_CONSUMERS consumers. The depth of the ring is the bufferCnt passed to allocateMemory().
+*
+* Producer: beginWrite() returns the next free buffer or -1 if all consumers still hold it, publish() hands the written
+* buffer to the consumers. Every published buffer gets a sequence number that increases by one with each publish().
+* Consumer: registerConsumer() once, then acquire() the buffers in sequence order and release() each of them when done.
+* A buffer is reused by the producer only after every consumer that was registered when it was published has released it.
+* A consumer that registers during the acquisition starts with the next published buffer. Buffers that are published while
+* no consumer is registered are handed to the first consumer that registers.
+*
+* None of these calls block or lock. waitForWrite() and waitForBuffer() are the blocking variants with timeout, they only sleep on
+* a condition variable if nothing is available and are woken up by publish() and release(). The former handshake over bufferReadyArray and currIndex still works: setting
+* bufferReadyArray[i] to true publishes buffer i, setting it to false releases it.
+**/
 class AcquisitionBuffer : public QObject
 {
 	Q_OBJECT
@@ -50,13 +130,54 @@ public:
 	bool allocateMemory(unsigned int bufferCnt, size_t bytesPerBuffer);
 	void releaseMemory();
 
+	int beginWrite(); ///< Index of the buffer the producer has to write next, -1 if it is still in use. Only call from the producer thread
+	void publish(int index); ///< Makes the written buffer available to all registered consumers. Only call from the producer thread
+	int waitForWrite(int timeoutMs); ///< Like beginWrite() but blocks until a buffer has been released or timeoutMs milliseconds have passed
+	unsigned long long getPublishedSequence() const { return this->publishedSequence.load(std::memory_order_acquire); } ///< Sequence number of the most recently published buffer, 0 before the first publish()
+
+	int registerConsumer(); ///< Returns the consumer id or -1 if ACQUISITIONBUFFER_MAX_CONSUMERS consumers are registered
+	void unregisterConsumer(int consumerId); ///< Buffers the consumer has not released yet are no longer held by it
+	int acquire(int consumerId, unsigned long long* sequence = nullptr); ///< Index of the next published buffer in sequence order or -1 if there is none. Buffers that have been released and reused in the meantime are skipped
+	int waitForBuffer(int consumerId, int timeoutMs, unsigned long long* sequence = nullptr); ///< Like acquire() but blocks until a buffer has been published, wakeUp() is called or timeoutMs milliseconds have passed
+	void wakeUp(int consumerId); ///< Interrupts the current or, if the consumer is not waiting, the next waitForBuffer() call of the consumer. Can be called from any thread
+	void release(int consumerId, int index);
+	unsigned int getAvailableBuffers(int consumerId) const; ///< Number of published buffers the consumer has not acquired yet. Only call from the consumer thread
+	unsigned long long getSkippedBuffers(int consumerId) const; ///< Buffers the consumer missed because they were reused before it acquired them. Only call from the consumer thread
+
 	QVector<void*> bufferArray;
-	QVector<bool> bufferReadyArray;
-	int currIndex;
+	AcquisitionBufferReadyArray bufferReadyArray;
+	AcquisitionBufferIndex currIndex;
 	unsigned int bufferCnt;
 	size_t bytesPerBuffer;
 
 private:
+	friend class AcquisitionBufferReadyFlag;
+	friend class AcquisitionBufferReadyArray;
+
+	struct Consumer
+	{
+		unsigned long long nextSequence; ///< Only accessed by the consumer thread
+		unsigned long long skipped; ///< Only accessed by the consumer thread
+		std::atomic<bool> wakeUpRequested;
+	};
+
+	void resetRing(unsigned int depth);
+	bool isInUse(const AcquisitionBufferSlot& slot) const;
+	void notifyConsumers();
+	void notifyProducer();
+
+	AcquisitionBufferSlot* slotArray;
+	std::atomic<int>* publishedIndices; ///< Buffer index of sequence number s is stored at s % depth
+	std::atomic<unsigned long long> publishedSequence;
+	std::atomic<unsigned int> registeredConsumers; ///< Bit i is set while consumer i is registered
+	Consumer consumers[ACQUISITIONBUFFER_MAX_CONSUMERS];
+	unsigned int depth;
+	int writeIndex; ///< Only accessed by the producer thread
+	std::mutex waitMutex; ///< Only locked by waiting threads and by threads that wake them up
+	std::condition_variable bufferPublished;
+	std::condition_variable bufferReleased;
+	std::atomic<int> waitingConsumers;
+	std::atomic<int> waitingProducers;
 
 
 public slots:
@@ -31,6 +31,7 @@ SOFTWARE.
 #include <QDebug>
 #include <QThread>
 #include <QCloseEvent>
+#include <QByteArray>
 #include "plugin.h"
 #include "acquisitionsystem.h"
 
@@ -127,8 +128,20 @@ public slots:
 	 */
 	void enableProcessedDataGrabbing(bool enabled){this->processedGrabbingAllowed = enabled;}
 
+	/*!
+	 * \brief volumeRingBscanReceived is called as answer to grabVolumeRingBscanRequest. Experimental! May be removed in future versions.
+	 * \param buffer processed B-scan in the same format as in processedDataReceived. Every answer has its own buffer that can be kept as long as needed
+	 * \param bitDepth bit depth of each elements
+	 * \param samplesPerLine number of elements in a single A-scan
+	 * \param linesPerFrame A-scans per B-scan
+	 * \param volumesAgo age of the volume that was requested, 1 is the last complete volume
+	 * \param bscanNr B-scan number within the volume
+	 */
+	virtual void volumeRingBscanReceived(QByteArray buffer, unsigned int bitDepth, unsigned int samplesPerLine, unsigned int linesPerFrame, unsigned int volumesAgo, unsigned int bscanNr){}
+
 
 signals:
+	void grabVolumeRingBscanRequest(unsigned int volumesAgo, unsigned int bscanNr); ///< Experimental! May be removed in future versions. This signal can be used to request a B-scan of one of the last volumes that are kept in the volume ring (see "Volume ring" in the processing settings). The B-scan is delivered to volumeRingBscanReceived
 
 
 };
@@ -29,6 +29,7 @@ SOFTWARE.
 #include "acquisitionbuffer.h"
 #include "acquisitionparameter.h"
 #include "extension.h"
+#include "tracer.h"
 
 class OCTproZ_DevKit
 {
@@ -0,0 +1,251 @@
+/*
+MIT License
+
+Copyright (c) 2019-2022 Miroslav Zabic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QVariant>
+#include <QFile>
+#include <chrono>
+#include <string>
+#include <stdio.h>
+
+
+Tracer::Tracer() {
+	this->running = false;
+	this->session = 0;
+	this->startTime = now();
+}
+
+Tracer::~Tracer() {
+	for (size_t i = 0; i < this->threadBuffers.size(); i++) {
+		delete this->threadBuffers[i];
+	}
+}
+
+Tracer* Tracer::getInstance() {
+	//every module (OCTproZ and each plugin) has its own copy of this pointer, but all of them point to the same instance
+	static std::atomic<Tracer*> tracer(nullptr);
+	static std::mutex instanceMutex;
+	Tracer* instance = tracer.load(std::memory_order_acquire);
+	if (instance != nullptr) {
+		return instance;
+	}
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	instance = tracer.load(std::memory_order_relaxed);
+	if (instance == nullptr) {
+		QCoreApplication* app = QCoreApplication::instance();
+		if (app != nullptr) {
+			QVariant property = app->property(TRACER_INSTANCE_PROPERTY);
+			if (property.isValid()) {
+				instance = static_cast<Tracer*>(property.value<void*>());
+			} else {
+				instance = new Tracer();
+				app->setProperty(TRACER_INSTANCE_PROPERTY, QVariant::fromValue(static_cast<void*>(instance)));
+			}
+		} else {
+			instance = new Tracer();
+		}
+		tracer.store(instance, std::memory_order_release);
+	}
+	return instance;
+}
+
+void Tracer::start() {
+	this->startTime = now();
+	this->session.fetch_add(1, std::memory_order_acq_rel);
+	this->running.store(true, std::memory_order_release);
+}
+
+void Tracer::stop() {
+	this->running.store(false, std::memory_order_release);
+}
+
+unsigned int Tracer::getDroppedEvents() {
+	std::vector<TraceThreadBuffer*> buffers = this->getCurrentSessionBuffers();
+	unsigned int dropped = 0;
+	for (size_t i = 0; i < buffers.size(); i++) {
+		dropped += buffers[i]->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+void Tracer::begin(const char* name) {
+	Tracer* tracer = getInstance();
+	if (tracer->isRunning()) {
+		tracer->record(name, 'B', 0);
+	}
+}
+
+void Tracer::end(const char* name) {
+	Tracer* tracer = getInstance();
+	if (tracer->isRunning()) {
+		tracer->record(name, 'E', 0);
+	}
+}
+
+void Tracer::counter(const char* name, long long value) {
+	Tracer* tracer = getInstance();
+	if (tracer->isRunning()) {
+		tracer->record(name, 'C', value);
+	}
+}
+
+void Tracer::instant(const char* name) {
+	Tracer* tracer = getInstance();
+	if (tracer->isRunning()) {
+		tracer->record(name, 'i', 0);
+	}
+}
+
+void Tracer::setThreadName(const char* name) {
+	getInstance()->getThreadBuffer()->threadName.store(name, std::memory_order_release);
+}
+
+void Tracer::record(const char* name, char phase, long long value) {
+	TraceThreadBuffer* buffer = this->getThreadBuffer();
+
+	//a new session started since the last event of this thread: discard the old events. only this thread writes count, so no lock is needed
+	unsigned int currentSession = this->session.load(std::memory_order_acquire);
+	if (buffer->session.load(std::memory_order_relaxed) != currentSession) {
+		buffer->count.store(0, std::memory_order_release);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+		buffer->session.store(currentSession, std::memory_order_release);
+	}
+	if (buffer->events.empty()) {
+		buffer->events.resize(TRACER_EVENTS_PER_THREAD);
+	}
+
+	unsigned int count = buffer->count.load(std::memory_order_relaxed);
+	if (count >= buffer->events.size()) {
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	TraceEvent& event = buffer->events[count];
+	event.name = name;
+	event.phase = phase;
+	event.timestamp = now();
+	event.value = value;
+	buffer->count.store(count + 1, std::memory_order_release);
+}
+
+TraceThreadBuffer* Tracer::getThreadBuffer() {
+	thread_local TraceThreadBuffer* threadBuffer = nullptr;
+	if (threadBuffer == nullptr) {
+		TraceThreadBuffer* buffer = new TraceThreadBuffer();
+		buffer->count = 0;
+		buffer->dropped = 0;
+		buffer->session = 0;
+		buffer->threadName = nullptr;
+		std::lock_guard<std::mutex> lock(this->mutex);
+		buffer->threadId = static_cast<unsigned int>(this->threadBuffers.size()) + 1;
+		this->threadBuffers.push_back(buffer);
+		threadBuffer = buffer;
+	}
+	return threadBuffer;
+}
+
+std::vector<TraceThreadBuffer*> Tracer::getCurrentSessionBuffers() {
+	unsigned int currentSession = this->session.load(std::memory_order_acquire);
+	std::vector<TraceThreadBuffer*> buffers;
+	std::lock_guard<std::mutex> lock(this->mutex);
+	for (size_t i = 0; i < this->threadBuffers.size(); i++) {
+		if (this->threadBuffers[i]->session.load(std::memory_order_acquire) == currentSession) {
+			buffers.push_back(this->threadBuffers[i]);
+		}
+	}
+	return buffers;
+}
+
+long long Tracer::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void appendEscaped(std::string& json, const char* text) {
+	for (const char* c = text; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			json += '\\';
+		}
+		json += *c;
+	}
+}
+
+bool Tracer::save(const QString& fileName, QString* errorMessage) {
+	std::vector<TraceThreadBuffer*> buffers = this->getCurrentSessionBuffers();
+	long long traceStart = this->startTime.load();
+	char number[96];
+
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	for (size_t i = 0; i < buffers.size(); i++) {
+		TraceThreadBuffer* buffer = buffers[i];
+		const char* threadName = buffer->threadName.load(std::memory_order_acquire);
+		if (threadName != nullptr) {
+			snprintf(number, sizeof(number), "%u", buffer->threadId);
+			json += first ? "" : ",\n";
+			json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+			json += number;
+			json += ",\"args\":{\"name\":\"";
+			appendEscaped(json, threadName);
+			json += "\"}}";
+			first = false;
+		}
+
+		//only events that were completely written before count was published are exported
+		unsigned int count = buffer->count.load(std::memory_order_acquire);
+		for (unsigned int j = 0; j < count; j++) {
+			const TraceEvent& event = buffer->events[j];
+			json += first ? "" : ",\n";
+			json += "{\"name\":\"";
+			appendEscaped(json, event.name);
+			snprintf(number, sizeof(number), "\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u", event.phase, static_cast<double>(event.timestamp - traceStart) / 1000.0, buffer->threadId);
+			json += number;
+			if (event.phase == 'C') {
+				snprintf(number, sizeof(number), ",\"args\":{\"value\":%lld}", event.value);
+				json += number;
+			} else if (event.phase == 'i') {
+				json += ",\"s\":\"t\"";
+			}
+			json += "}";
+			first = false;
+		}
+	}
+	json += "\n]}\n";
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		if (errorMessage != nullptr) {
+			*errorMessage = file.errorString();
+		}
+		return false;
+	}
+	qint64 written = file.write(json.data(), static_cast<qint64>(json.size()));
+	file.close();
+	if (written != static_cast<qint64>(json.size())) {
+		if (errorMessage != nullptr) {
+			*errorMessage = file.errorString();
+		}
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,115 @@
+/*
+MIT License
+
+Copyright (c) 2019-2022 Miroslav Zabic
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define TRACER_EVENTS_PER_THREAD 262144 //32 bytes per event, the buffer of a thread is allocated when the thread records its first event
+#define TRACER_INSTANCE_PROPERTY "octproz_tracer"
+
+
+struct TraceEvent
+{
+	const char* name; ///< Must be a string literal (or outlive the trace), only the pointer is stored
+	char phase; ///< Chrome trace event phase: 'B' begin, 'E' end, 'C' counter, 'i' instant
+	long long timestamp; ///< std::chrono::steady_clock time in nanoseconds
+	long long value; ///< Value of counter events
+};
+
+struct TraceThreadBuffer
+{
+	std::vector<TraceEvent> events;
+	std::atomic<unsigned int> count; ///< Number of completely written events. Only the owning thread writes, the exporting thread reads with acquire semantics
+	std::atomic<unsigned int> dropped; ///< Events that did not fit into the buffer
+	std::atomic<unsigned int> session; ///< Tracing session the events belong to
+	std::atomic<const char*> threadName;
+	unsigned int threadId;
+};
+
+
+/**
+* Opt-in tracer for the timeline from acquisition to display. Begin/end spans, counters and instant events are
+* written into fixed size per-thread buffers without any locking, so acquisition, processing, recording and
+* rendering threads do not synchronize with each other while tracing. save() writes the Chrome trace event format
+* that can be opened in chrome://tracing or https://ui.perfetto.dev
+* When tracing is not running every call returns after a single relaxed atomic load.
+*
+* Plugins link their own copy of the dev kit. To let all of them write into the same trace, the instance is stored
+* as dynamic property of the QCoreApplication instance. OCTproZ creates the instance at startup.
+**/
+class Tracer
+{
+public:
+	static Tracer* getInstance();
+
+	void start();
+	void stop();
+	bool isRunning() const { return this->running.load(std::memory_order_relaxed); }
+	bool save(const QString& fileName, QString* errorMessage = nullptr);
+	unsigned int getDroppedEvents();
+
+	static void begin(const char* name);
+	static void end(const char* name);
+	static void counter(const char* name, long long value);
+	static void instant(const char* name);
+	static void setThreadName(const char* name); ///< Name of the calling thread in the trace, must be a string literal
+
+private:
+	Tracer();
+	~Tracer();
+
+	void record(const char* name, char phase, long long value);
+	TraceThreadBuffer* getThreadBuffer();
+	std::vector<TraceThreadBuffer*> getCurrentSessionBuffers(); ///< Buffers of all threads that recorded events since start()
+	static long long now();
+
+	std::atomic<bool> running;
+	std::atomic<unsigned int> session;
+	std::atomic<long long> startTime;
+	std::mutex mutex; ///< Guards threadBuffers. Only locked when a thread records its first event and when the trace is exported
+	std::vector<TraceThreadBuffer*> threadBuffers;
+};
+
+
+/**
+* Records a begin event on construction and the matching end event on destruction.
+**/
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char* name) : name(name) { Tracer::begin(name); }
+	~TraceSpan() { Tracer::end(this->name); }
+
+private:
+	TraceSpan(const TraceSpan&);
+	TraceSpan& operator=(const TraceSpan&);
+	const char* name;
+};
+
+#endif // TRACER_H
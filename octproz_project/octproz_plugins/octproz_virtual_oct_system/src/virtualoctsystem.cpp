@@ -50,7 +50,7 @@ bool VirtualOCTSystem::init() {
 
 	//allocate buffer memory
 	size_t bufferSize = currParams.width*currParams.height*currParams.depth*ceil((double)this->currParams.bitDepth / 8.0);
-	this->buffer->allocateMemory(2, bufferSize);
+	this->buffer->allocateMemory(ACQUISITION_BUFFERS, bufferSize);
 
 	//create additional buffers if user wants to read multiple buffers per file and copy entire file to ram
 	if(currParams.buffersFromFile > 2 && currParams.copyFileToRam){
@@ -170,32 +170,33 @@ void VirtualOCTSystem::acqcuisitionSimulation(){
 	fclose(this->file);
 	qDebug() << "file closed";
 
+	//fill remaining buffers of the ring alternately with the two buffers from file
+	for(unsigned int i = 2; i < this->buffer->bufferCnt; i++){
+		memcpy(this->buffer->bufferArray[i], this->buffer->bufferArray[i%2], numberOfElements*sizeOfElement);
+	}
+
 	//acquisition begins!
 	emit enableGui(false);
 	this->acqusitionRunning = true;
-	this->buffer->currIndex = 1;
 	emit acquisitionStarted(this);
+	Tracer::setThreadName("acquisition");
 	while (this->acqusitionRunning) {
-		//wait until processing thread is done with copying data from previous buffer. This is not necessary in real oct systems, since they usually do not provide new data as fast as this virtual oct system. In real oct systems just check the bufferReadyArray flag of the next buffer.
-		while(this->buffer->bufferReadyArray[buffer->currIndex] == true && this->acqusitionRunning){
-			QThread::usleep(100);
-			QCoreApplication::processEvents();
+		//wait until the next buffer of the ring has been released by all consumers. the thread sleeps until a buffer is released or the timeout has passed
+		Tracer::begin("wait for processing");
+		int nextIndex = this->buffer->waitForWrite(ACQUISITION_WAIT_TIMEOUT_MS);
+		Tracer::end("wait for processing");
+
+		//handle queued events of the acquisition thread, e.g. stopAcquisition()
+		QCoreApplication::processEvents();
+		if(nextIndex < 0){
+			continue;
 		}
 
-		//calculate index of next buffer
-		int nextIndex = (this->buffer->currIndex+1)%2;
-
-		//set acquisition buffer index, so that processing thread knows current buffer
-		this->buffer->currIndex = nextIndex;
-
-		//check bufferReadyArray flag to see if acquisition system is allowed to reuse this buffer and write new data in acquisition buffer. Once the bufferReadyArray flag is false, the acquisition system is allowed to reuse the buffer. If bufferReadyArray is true the processing thread is still copying data from the buffer.
-		if(buffer->bufferReadyArray[nextIndex] == false){
+		//actual data acquisition could be placed here. the content of this->buffer->bufferArray[nextIndex] could be modified here, but the acquisition buffer already contains the desired data so we just publish it
+		//publish buffer to allow processing of it
+		this->buffer->publish(nextIndex);
+		Tracer::counter("acquisition buffer", nextIndex);
 
-			//actual data acquisition could be placed here. the content of this->buffer->bufferArray[nextIndex] could be modified here, but the acquisition buffer already contains the desired data so we just set the bufferReadyArray to true
-			//set bufferReadyArray to true to allow processing of buffer
-			this->buffer->bufferReadyArray[nextIndex] = true;
-
-		}
 		//user defined wait time
 		QThread::usleep((this->currParams.waitTimeUs));
 	}
@@ -221,40 +222,38 @@ void VirtualOCTSystem::acqcuisitionSimulationLargeFile() {
 	//acquisition begins!
 	emit enableGui(false);
 	this->acqusitionRunning = true;
-	this->buffer->currIndex = 1;
-	int nextIndex = 0;
 	emit acquisitionStarted(this);
+	Tracer::setThreadName("acquisition");
 	while (this->acqusitionRunning) {
-		//wait until processing thread is done with copying data from previous buffer. This is not necessary in real oct systems, since they usually do not provide new data as fast as this virtual oct system. In real oct systems just check the bufferReadyArray flag of the next buffer.
-		while(this->buffer->bufferReadyArray[buffer->currIndex] == true && this->acqusitionRunning){
-			QThread::usleep(100);
-			QCoreApplication::processEvents();
+		//wait until the next buffer of the ring has been released by all consumers. the thread sleeps until a buffer is released or the timeout has passed
+		Tracer::begin("wait for processing");
+		int nextIndex = this->buffer->waitForWrite(ACQUISITION_WAIT_TIMEOUT_MS);
+		Tracer::end("wait for processing");
+
+		//handle queued events of the acquisition thread, e.g. stopAcquisition()
+		QCoreApplication::processEvents();
+		if(nextIndex < 0){
+			continue;
 		}
 
-		//check bufferReadyArray flag to see if acquisition system is allowed to reuse this buffer and write new data in acquisition buffer. Once the bufferReadyArray flag is false, the acquisition system is allowed to reuse the buffer. If bufferReadyArray is true the processing thread is still copying data from the buffer.
-		if(this->buffer->bufferReadyArray[nextIndex] == false){
-			//get current buffer positions
-			void* currAcquisitionBuf = static_cast<void*>(this->buffer->bufferArray[nextIndex]);
-
-			//copy data from file to acquisitionBuffer
-			bigFile.read(static_cast<char*>(currAcquisitionBuf), bufferSizeInBytes);
+		//get current buffer position
+		void* currAcquisitionBuf = static_cast<void*>(this->buffer->bufferArray[nextIndex]);
 
-			//rewind file if necessary
-			readBuffers++;
-			if(readBuffers >= this->currParams.buffersFromFile){
-				bigFile.seekg(0);
-				readBuffers = 0;
-			}
+		//copy data from file to acquisitionBuffer
+		Tracer::begin("read file");
+		bigFile.read(static_cast<char*>(currAcquisitionBuf), bufferSizeInBytes);
+		Tracer::end("read file");
 
-			//set acquisition buffer index, so that processing thread knows current buffer
-			this->buffer->currIndex = nextIndex;
-
-			//set bufferReadyArray to true to allow processing of buffer
-			this->buffer->bufferReadyArray[nextIndex] = true;
-
-			//calculate index of next buffer
-			nextIndex = (this->buffer->currIndex+1)%2;
+		//rewind file if necessary
+		readBuffers++;
+		if(readBuffers >= this->currParams.buffersFromFile){
+			bigFile.seekg(0);
+			readBuffers = 0;
 		}
+
+		//publish buffer to allow processing of it
+		this->buffer->publish(nextIndex);
+		Tracer::counter("acquisition buffer", nextIndex);
 		//user defined wait time
 		QThread::usleep((this->currParams.waitTimeUs));
 	}
@@ -281,36 +280,34 @@ void VirtualOCTSystem::acquisitionSimulationWithMultiFileBuffers() {
 	//acquisition begins!
 	emit enableGui(false);
 	this->acqusitionRunning = true;
-	this->buffer->currIndex = 0;
-	int nextIndex = 1;
 	int streamBufferIndex = currParams.buffersFromFile-1;
 	emit acquisitionStarted(this);
+	Tracer::setThreadName("acquisition");
 	while (this->acqusitionRunning) {
-		//wait until processing thread is done with copying data from previous buffer. This is not necessary in real oct systems, since they usually do not provide new data as fast as this virtual oct system. In real oct systems just check the bufferReadyArray flag of the next buffer.
-		while(this->buffer->bufferReadyArray[buffer->currIndex] == true && this->acqusitionRunning){
-			QThread::usleep(100);
-			QCoreApplication::processEvents();
+		//wait until the next buffer of the ring has been released by all consumers. the thread sleeps until a buffer is released or the timeout has passed
+		Tracer::begin("wait for processing");
+		int nextIndex = this->buffer->waitForWrite(ACQUISITION_WAIT_TIMEOUT_MS);
+		Tracer::end("wait for processing");
+
+		//handle queued events of the acquisition thread, e.g. stopAcquisition()
+		QCoreApplication::processEvents();
+		if(nextIndex < 0){
+			continue;
 		}
 
-		//set acquisition buffer index, so that processing thread knows current buffer
-		this->buffer->currIndex = nextIndex;
+		//get current buffer positions
+		streamBufferIndex = (streamBufferIndex+1)%currParams.buffersFromFile;
+		void* currAcquisitionBuf = static_cast<void*>(this->buffer->bufferArray[nextIndex]);
+		void* currMultiBuf = static_cast<void*>(this->streamBuffer->bufferArray[streamBufferIndex]);
 
-		//check bufferReadyArray flag to see if acquisition system is allowed to reuse this buffer and write new data in acquisition buffer. Once the bufferReadyArray flag is false, the acquisition system is allowed to reuse the buffer. If bufferReadyArray is true the processing thread is still copying data from the buffer.
-		if(this->buffer->bufferReadyArray[nextIndex] == false){
-			//get current buffer positions
-			streamBufferIndex = (streamBufferIndex+1)%currParams.buffersFromFile;
-			void* currAcquisitionBuf = static_cast<void*>(this->buffer->bufferArray[nextIndex]);
-			void* currMultiBuf = static_cast<void*>(this->streamBuffer->bufferArray[streamBufferIndex]);
+		//copy data from streamBuffer to acquisitionBuffer
+		Tracer::begin("copy file buffer");
+		memcpy(currAcquisitionBuf, currMultiBuf, bufferSizeInBytes);
+		Tracer::end("copy file buffer");
 
-			//copy data from streamBuffer to acquisitionBuffer
-			memcpy(currAcquisitionBuf, currMultiBuf, bufferSizeInBytes);
-
-			//set bufferReadyArray to true to allow processing of buffer
-			this->buffer->bufferReadyArray[nextIndex] = true;
-
-			//calculate index of next buffer
-			nextIndex = (this->buffer->currIndex+1)%2;
-		}
+		//publish buffer to allow processing of it
+		this->buffer->publish(nextIndex);
+		Tracer::counter("acquisition buffer", nextIndex);
 		//user defined wait time
 		QThread::usleep((this->currParams.waitTimeUs));
 	}
@@ -26,6 +26,8 @@ SOFTWARE.
 #define OCTSYSTEMSIMULATORPLUGIN_H
 
 #define STREAM_BUFFER_SIZE 2097152
+#define ACQUISITION_BUFFERS 4 //depth of the acquisition buffer ring
+#define ACQUISITION_WAIT_TIMEOUT_MS 50 //maximum time the acquisition loop sleeps while all acquisition buffers are in use
 
 #include <QObject>
 #include <QCoreApplication>
@@ -3,7 +3,8 @@ TEMPLATE = subdirs
 SUBDIRS = \
 	octproz_devkit \
 	octproz_plugins \
-	octproz
+	octproz \
+	octproz_bench
 
 octproz_plugins.depends = octproz_devkit
 octproz.depends = octproz_devkit